@@ -0,0 +1,51 @@
+// Source/AudioBlockOps.h
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <cstring>
+
+/** Block helpers (vectorised where it matters) and the worker pool shared by the
+ *  encoders and capture sinks.
+ */
+namespace AudioBlockOps
+{
+    /** out = mean of the input channels. SIMD via FloatVectorOperations. */
+    inline void downmixToMono(const float* const* in, int numChannels, int startSample, float* out, int numSamples) noexcept
+    {
+        if (numChannels <= 0)
+        {
+            juce::FloatVectorOperations::clear(out, numSamples);
+            return;
+        }
+
+        const float gain = 1.0f / (float)numChannels;
+        juce::FloatVectorOperations::copyWithMultiply(out, in[0] + startSample, gain, numSamples);
+        for (int ch = 1; ch < numChannels; ++ch)
+            juce::FloatVectorOperations::addWithMultiply(out, in[ch] + startSample, gain, numSamples);
+    }
+
+    /** Zeroes NaN/Inf in place and returns how many were replaced.
+     *  Branch-free on the bit pattern (all-ones exponent) so the loop vectorises.
+     */
+    inline int sanitise(float* data, int numSamples) noexcept
+    {
+        int fixed = 0;
+        for (int i = 0; i < numSamples; ++i)
+        {
+            juce::uint32 bits;
+            std::memcpy(&bits, data + i, sizeof(bits));
+            const juce::uint32 bad = (bits & 0x7f800000u) == 0x7f800000u;
+            fixed += (int)bad;
+            bits &= bad - 1u;   // all ones when finite, zero otherwise
+            std::memcpy(data + i, &bits, sizeof(bits));
+        }
+        return fixed;
+    }
+
+    /** Shared pool for background encoding and capture, so jobs never spawn their own threads. */
+    inline juce::ThreadPool& getWorkerPool()
+    {
+        static juce::ThreadPool pool(2);
+        return pool;
+    }
+}
@@ -0,0 +1,168 @@
+// Source/BackgroundAudioCapture.cpp
+#include "BackgroundAudioCapture.h"
+#include "AudioBlockOps.h"
+
+class BackgroundAudioCapture::DrainJob : public juce::ThreadPoolJob
+{
+public:
+    explicit DrainJob(BackgroundAudioCapture& o) : juce::ThreadPoolJob("AudioCaptureDrain"), owner(o) {}
+
+    JobStatus runJob() override
+    {
+        // Drain in bursts; returning gives the pool thread to whatever is queued behind us
+        bool wroteAny = false;
+        while (!shouldExit() && owner.drainOnce())
+            wroteAny = true;
+
+        if (owner.stopping)
+            return jobHasFinished;
+
+        // Idle with nothing else waiting for a thread: block until push() has data
+        // (or the timeout, in case a wake-up raced the flag) instead of polling
+        if (!wroteAny && !otherJobsQueued())
+        {
+            owner.drainerWaiting.store(true);
+            if (owner.fifo.getNumReady() == 0 && !owner.stopping)
+                owner.dataReady.wait(50);
+            owner.drainerWaiting.store(false);
+        }
+
+        return jobNeedsRunningAgain;
+    }
+
+private:
+    // Jobs queued on the shared pool that aren't running yet, other capture drains aside
+    static bool otherJobsQueued()
+    {
+        auto countOthers = [](const juce::StringArray& names)
+            {
+                int n = 0;
+                for (const auto& name : names)
+                    n += name != "AudioCaptureDrain" ? 1 : 0;
+                return n;
+            };
+
+        auto& pool = AudioBlockOps::getWorkerPool();
+        return countOthers(pool.getNamesOfAllJobs(false)) > countOthers(pool.getNamesOfAllJobs(true));
+    }
+
+    BackgroundAudioCapture& owner;
+};
+
+BackgroundAudioCapture::BackgroundAudioCapture(std::unique_ptr<AudioCaptureSink> s, double fifoSeconds)
+    : sink(std::move(s)),
+    fifo(juce::jmax(4096, (int)(fifoSeconds * (sink ? sink->getSampleRate() : 48000.0))))
+{
+    jassert(sink != nullptr);
+
+    const int channels = sink ? sink->getNumChannels() : 1;
+    ring.setSize(channels, fifo.getTotalSize());
+    channelPtrs.resize((size_t)channels);
+
+    job = std::make_unique<DrainJob>(*this);
+    AudioBlockOps::getWorkerPool().addJob(job.get(), false);
+}
+
+BackgroundAudioCapture::~BackgroundAudioCapture()
+{
+    stop();
+}
+
+bool BackgroundAudioCapture::push(const juce::AudioBuffer<float>& block, int startSample, int numSamples) noexcept
+{
+    if (stopping.load(std::memory_order_relaxed) || numSamples <= 0)
+        return numSamples <= 0;
+
+    const int accepted = juce::jmin(numSamples, fifo.getFreeSpace());
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite(accepted, start1, size1, start2, size2);
+
+    const int inChannels = block.getNumChannels();
+    const int outChannels = ring.getNumChannels();
+    auto* const* in = block.getArrayOfReadPointers();
+
+    auto copyRegion = [&](int ringStart, int count, int srcOffset)
+        {
+            if (count <= 0)
+                return;
+
+            if (outChannels == 1 && inChannels > 1)
+            {
+                AudioBlockOps::downmixToMono(in, inChannels, startSample + srcOffset, ring.getWritePointer(0, ringStart), count);
+                return;
+            }
+
+            for (int ch = 0; ch < outChannels; ++ch)
+            {
+                if (ch < inChannels)
+                    juce::FloatVectorOperations::copy(ring.getWritePointer(ch, ringStart), in[ch] + startSample + srcOffset, count);
+                else
+                    juce::FloatVectorOperations::clear(ring.getWritePointer(ch, ringStart), count);
+            }
+        };
+
+    copyRegion(start1, size1, 0);
+    copyRegion(start2, size2, size1);
+    fifo.finishedWrite(size1 + size2);
+
+    captured += size1 + size2;
+
+    // Only when the drainer is actually parked, so at most one signal per idle spell
+    if (size1 + size2 > 0 && drainerWaiting.load(std::memory_order_relaxed) && drainerWaiting.exchange(false))
+        dataReady.signal();
+
+    if (accepted < numSamples)
+    {
+        dropped += numSamples - accepted;
+        return false;
+    }
+    return true;
+}
+
+bool BackgroundAudioCapture::drainOnce()
+{
+    const int ready = fifo.getNumReady();
+    if (ready <= 0 || sink == nullptr)
+        return false;
+
+    int start1, size1, start2, size2;
+    fifo.prepareToRead(ready, start1, size1, start2, size2);
+
+    auto writeRegion = [this](int start, int count)
+        {
+            if (count <= 0)
+                return;
+
+            for (size_t ch = 0; ch < channelPtrs.size(); ++ch)
+                channelPtrs[ch] = ring.getReadPointer((int)ch, start);
+
+            sink->write(channelPtrs.data(), count);
+        };
+
+    writeRegion(start1, size1);
+    writeRegion(start2, size2);
+    fifo.finishedRead(size1 + size2);
+    return true;
+}
+
+void BackgroundAudioCapture::stop()
+{
+    if (job == nullptr)
+        return;
+
+    stopping = true;
+    dataReady.signal();
+
+    // The job reads the FIFO and the sink, so it must be off the pool before it is deleted;
+    // if it hasn't noticed stopping by now, interrupt it and wait without a timeout
+    auto& pool = AudioBlockOps::getWorkerPool();
+    if (!pool.waitForJobToFinish(job.get(), 10000))
+        pool.removeJob(job.get(), true, -1);
+    job.reset();
+
+    // Worker is gone; flush the tail on this thread
+    while (drainOnce()) {}
+
+    if (sink)
+        sink->finish();
+}
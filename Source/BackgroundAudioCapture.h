@@ -0,0 +1,52 @@
+// Source/BackgroundAudioCapture.h
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <atomic>
+#include <vector>
+#include "WavStreamWriter.h"
+
+/** Feeds an AudioCaptureSink from the audio thread.
+ *
+ *  push() only copies (or downmixes, SIMD) into a preallocated lock-free FIFO; a job
+ *  on the shared AudioBlockOps worker pool drains it into the sink. When idle the job
+ *  yields its thread to any other queued job, and otherwise parks on an event that
+ *  push() signals once data arrives. If the worker falls behind by more than the FIFO
+ *  length, the overflow is dropped and counted rather than blocking the caller.
+ */
+class BackgroundAudioCapture
+{
+public:
+    BackgroundAudioCapture(std::unique_ptr<AudioCaptureSink> sink, double fifoSeconds = 10.0);
+    ~BackgroundAudioCapture();
+
+    /** Realtime-safe: no allocation, and no lock except the one event signal that wakes a
+     *  parked drainer (uncontended, once per idle spell). Returns false if samples were dropped. */
+    bool push(const juce::AudioBuffer<float>& block, int startSample, int numSamples) noexcept;
+
+    /** Writes whatever is still queued, finalises the sink and releases the worker. */
+    void stop();
+
+    bool isRunning() const { return job != nullptr; }
+    juce::int64 getNumDropped() const { return dropped.load(); }
+    juce::int64 getNumCaptured() const { return captured.load(); }
+
+private:
+    class DrainJob;
+
+    bool drainOnce();
+
+    std::unique_ptr<AudioCaptureSink> sink;
+    juce::AbstractFifo fifo;
+    juce::AudioBuffer<float> ring;
+    std::vector<const float*> channelPtrs;
+
+    std::unique_ptr<DrainJob> job;
+    std::atomic<bool> stopping{ false };
+    std::atomic<bool> drainerWaiting{ false };
+    juce::WaitableEvent dataReady;
+    std::atomic<juce::int64> dropped{ 0 }, captured{ 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BackgroundAudioCapture)
+};
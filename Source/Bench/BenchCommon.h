@@ -0,0 +1,121 @@
+// Source/Bench/BenchCommon.h
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#if JUCE_WINDOWS
+ #include <windows.h>
+ #include <psapi.h>
+#else
+ #include <sys/resource.h>
+#endif
+
+/** Small helpers shared by the headless benchmark executables. */
+namespace bench
+{
+    inline double nowMs() { return juce::Time::getMillisecondCounterHiRes(); }
+
+    /** Collects samples for one stage and reports percentiles. */
+    class Series
+    {
+    public:
+        void add(double v) { values.push_back(v); }
+        bool isEmpty() const { return values.empty(); }
+        size_t size() const { return values.size(); }
+
+        double sum() const
+        {
+            double s = 0.0;
+            for (auto v : values) s += v;
+            return s;
+        }
+
+        double mean() const { return values.empty() ? 0.0 : sum() / (double)values.size(); }
+
+        // Nearest-rank percentile, p in [0, 100]
+        double percentile(double p) const
+        {
+            if (values.empty())
+                return 0.0;
+
+            auto sorted = values;
+            std::sort(sorted.begin(), sorted.end());
+            const auto rank = (size_t)std::ceil(p / 100.0 * (double)sorted.size());
+            return sorted[juce::jlimit<size_t>(0, sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+        }
+
+        juce::var toJson() const
+        {
+            juce::DynamicObject::Ptr o = new juce::DynamicObject();
+            o->setProperty("count", (int)values.size());
+            o->setProperty("mean", mean());
+            o->setProperty("p50", percentile(50.0));
+            o->setProperty("p95", percentile(95.0));
+            o->setProperty("p99", percentile(99.0));
+            o->setProperty("max", values.empty() ? 0.0 : *std::max_element(values.begin(), values.end()));
+            return juce::var(o.get());
+        }
+
+    private:
+        std::vector<double> values;
+    };
+
+    /** Peak resident set size of this process in bytes (0 if unavailable). */
+    inline juce::int64 peakRssBytes()
+    {
+       #if JUCE_WINDOWS
+        PROCESS_MEMORY_COUNTERS pmc{};
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+            return (juce::int64)pmc.PeakWorkingSetSize;
+        return 0;
+       #else
+        rusage ru{};
+        if (getrusage(RUSAGE_SELF, &ru) != 0)
+            return 0;
+        #if JUCE_MAC
+         return (juce::int64)ru.ru_maxrss;          // bytes on macOS
+        #else
+         return (juce::int64)ru.ru_maxrss * 1024;   // kilobytes on Linux
+        #endif
+       #endif
+    }
+
+    /** Identifies the build/host so results from different commits can be lined up. */
+    inline juce::var environmentJson()
+    {
+        juce::DynamicObject::Ptr o = new juce::DynamicObject();
+        o->setProperty("timestamp", juce::Time::getCurrentTime().toISO8601(true));
+        o->setProperty("os", juce::SystemStats::getOperatingSystemName());
+        o->setProperty("cpu", juce::SystemStats::getCpuModel());
+        o->setProperty("numCpus", juce::SystemStats::getNumCpus());
+        o->setProperty("numPhysicalCpus", juce::SystemStats::getNumPhysicalCpus());
+       #if defined(WFW_BUILD_ID)
+        o->setProperty("build", juce::String(WFW_BUILD_ID));
+       #endif
+        return juce::var(o.get());
+    }
+
+    /** Minimal "--key value" / "--flag" argument lookup. */
+    inline juce::String argValue(const juce::StringArray& args, const juce::String& key, const juce::String& fallback = {})
+    {
+        const int i = args.indexOf(key);
+        return (i >= 0 && i + 1 < args.size()) ? args[i + 1] : fallback;
+    }
+
+    inline bool writeJson(const juce::var& result, const juce::String& outPath)
+    {
+        const auto text = juce::JSON::toString(result, false);
+
+        if (outPath.isEmpty() || outPath == "-")
+        {
+            std::cout << text << std::endl;
+            return true;
+        }
+
+        return juce::File::getCurrentWorkingDirectory().getChildFile(outPath).replaceWithText(text);
+    }
+}
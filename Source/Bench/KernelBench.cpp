@@ -0,0 +1,500 @@
+// Source/Bench/KernelBench.cpp
+//
+// Micro-benchmarks for the individual hot paths of the pipeline:
+//   resample   WhisperEngine::resampleTo16k
+//   mel        whisper_pcm_to_mel_with_state (fft + log_mel_spectrogram), needs --model
+//   spm        SentencePiece encode/decode via marianTokenRoundTrip, needs --marian
+//   wav        WavEncoderAsync::encodeMono (memory) / WavStreamWriter::toFile
+//   logits     the sampler's log-softmax + probs and argmax over one vocabulary row,
+//              scalar vs SIMD; the row comes from a real decode with --model. Exits
+//              non-zero if the two disagree on the argmax or the log-softmax
+//
+//   WhisperFreeWinKernelBench [--filter resample,mel,...] [--threads 1,2,4]
+//                             [--min-time-ms 500] [--model ggml.bin] [--marian dir] [--out file.json]
+//
+// Inputs are synthetic with fixed seeds so numbers line up across commits.
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include "BenchCommon.h"
+#include "../WhisperEngine.h"
+#include "../WavEncoder.h"
+#include "../WavStreamWriter.h"
+#include "../marian_c_api.h"
+#include "../third_party/whisper-ext.h"
+
+namespace
+{
+    struct Options
+    {
+        juce::StringArray filter;
+        juce::Array<int> threads;
+        double minTimeMs = 500.0;
+        int minIters = 5;
+    };
+
+    // Speech-like test signal: a few harmonics with a slow envelope plus noise
+    juce::AudioBuffer<float> makeSignal(int numChannels, int numSamples, double sampleRate, juce::int64 seed)
+    {
+        juce::Random rng(seed);
+        juce::AudioBuffer<float> buf(numChannels, numSamples);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            auto* d = buf.getWritePointer(ch);
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const double t = i / sampleRate;
+                const double env = 0.5 + 0.5 * std::sin(juce::MathConstants<double>::twoPi * 3.0 * t);
+                double s = 0.0;
+                for (int h = 1; h <= 4; ++h)
+                    s += std::sin(juce::MathConstants<double>::twoPi * 180.0 * h * t) / h;
+                d[i] = (float)(0.25 * env * s) + (rng.nextFloat() - 0.5f) * 0.02f;
+            }
+        }
+        return buf;
+    }
+
+    /** Worker threads started once for a whole runKernel. run() releases them all at once
+     *  (the caller doing share 0) and returns when the last has finished, so a round's
+     *  time is between those two crossings, without thread start-up or join.
+     */
+    class RoundRunner
+    {
+    public:
+        RoundRunner(int threads, const std::function<void(int)>& f) : fn(f)
+        {
+            for (int t = 1; t < threads; ++t)
+                workers.emplace_back([this, t] { workerLoop(t); });
+        }
+
+        ~RoundRunner()
+        {
+            {
+                std::lock_guard<std::mutex> lg(lock);
+                quit = true;
+                ++generation;
+            }
+            start.notify_all();
+            for (auto& th : workers)
+                th.join();
+        }
+
+        void run()
+        {
+            {
+                std::lock_guard<std::mutex> lg(lock);
+                pending = (int)workers.size();
+                ++generation;
+            }
+            start.notify_all();
+
+            fn(0);
+
+            std::unique_lock<std::mutex> lk(lock);
+            done.wait(lk, [this] { return pending == 0; });
+        }
+
+    private:
+        void workerLoop(int t)
+        {
+            juce::uint64 seen = 0;
+            for (;;)
+            {
+                {
+                    std::unique_lock<std::mutex> lk(lock);
+                    start.wait(lk, [&] { return generation != seen; });
+                    seen = generation;
+                    if (quit)
+                        return;
+                }
+
+                fn(t);
+
+                std::lock_guard<std::mutex> lg(lock);
+                if (--pending == 0)
+                    done.notify_one();
+            }
+        }
+
+        const std::function<void(int)>& fn;
+        std::vector<std::thread> workers;
+        std::mutex lock;
+        std::condition_variable start, done;
+        juce::uint64 generation = 0;
+        int pending = 0;
+        bool quit = false;
+    };
+
+    /** Runs fn on `threads` workers concurrently until minTime has elapsed.
+     *  Each sample is the wall time of one round (every worker ran fn once).
+     */
+    bench::Series runKernel(const Options& opt, int threads, const std::function<void(int)>& fn)
+    {
+        bench::Series s;
+        RoundRunner runner(juce::jmax(1, threads), fn);
+
+        runner.run(); // warm-up
+
+        const double start = bench::nowMs();
+        while ((int)s.size() < opt.minIters || bench::nowMs() - start < opt.minTimeMs)
+        {
+            const double t0 = bench::nowMs();
+            runner.run();
+            s.add(bench::nowMs() - t0);
+        }
+        return s;
+    }
+
+    juce::var report(const juce::String& kernel, const juce::String& variant, int threads,
+        const bench::Series& s, double itemsPerRound, const juce::String& unit)
+    {
+        juce::DynamicObject::Ptr o = new juce::DynamicObject();
+        o->setProperty("kernel", kernel);
+        o->setProperty("variant", variant);
+        o->setProperty("threads", threads);
+        o->setProperty("ms", s.toJson());
+
+        const double p50 = s.percentile(50.0);
+        o->setProperty("unit", unit);
+        o->setProperty("throughput", p50 > 0.0 ? itemsPerRound * 1000.0 / p50 : 0.0);
+
+        std::cerr << kernel << "/" << variant << " x" << threads << ": p50 "
+                  << juce::String(p50, 3) << " ms" << std::endl;
+        return juce::var(o.get());
+    }
+
+    bool enabled(const Options& opt, const juce::String& kernel)
+    {
+        return opt.filter.isEmpty() || opt.filter.contains(kernel);
+    }
+
+    void benchResample(const Options& opt, juce::Array<juce::var>& out)
+    {
+        for (double rate : { 44100.0, 48000.0 })
+        {
+            for (double seconds : { 1.0, 5.0, 30.0 })
+            {
+                const auto in = makeSignal(1, (int)(rate * seconds), rate, 1);
+                for (int threads : opt.threads)
+                {
+                    auto s = runKernel(opt, threads, [&](int)
+                        {
+                            auto o = WhisperEngine::resampleTo16k(in, rate);
+                            juce::ignoreUnused(o);
+                        });
+                    out.add(report("resample", juce::String((int)rate) + "Hz_" + juce::String(seconds, 0) + "s",
+                        threads, s, seconds * threads, "audio_s/s"));
+                }
+            }
+        }
+    }
+
+    void benchMel(const Options& opt, const juce::File& modelFile, juce::Array<juce::var>& out)
+    {
+        auto cparams = whisper_context_default_params();
+        cparams.use_gpu = false;
+        auto* ctx = whisper_init_from_file_with_params_no_state(modelFile.getFullPathName().toRawUTF8(), cparams);
+        if (!ctx)
+        {
+            std::cerr << "mel: failed to load " << modelFile.getFullPathName() << std::endl;
+            return;
+        }
+
+        auto* state = whisper_init_state(ctx);
+
+        for (double seconds : { 1.0, 10.0, 30.0 })
+        {
+            const auto in = makeSignal(1, (int)(16000.0 * seconds), 16000.0, 2);
+            for (int threads : opt.threads)
+            {
+                // whisper parallelises the mel itself, so this sweeps n_threads on one state
+                auto s = runKernel(opt, 1, [&](int)
+                    {
+                        whisper_pcm_to_mel_with_state(ctx, state, in.getReadPointer(0), in.getNumSamples(), threads);
+                    });
+                out.add(report("mel", juce::String(seconds, 0) + "s", threads, s, seconds, "audio_s/s"));
+            }
+        }
+
+        whisper_free_state(state);
+        whisper_free(ctx);
+    }
+
+    void benchSentencePiece(const Options& opt, const juce::File& modelDir, juce::Array<juce::var>& out)
+    {
+        char err[512] = {};
+        auto* t = marianCreateTranslator(modelDir.getFullPathName().toRawUTF8(), err, (int)sizeof(err));
+        if (!t)
+        {
+            std::cerr << "spm: " << err << std::endl;
+            return;
+        }
+
+        const juce::String sentence = "Das ist ein kurzer Testsatz, der ungefaehr so lang ist wie ein typisches Segment. ";
+        struct Variant { const char* name; int repeats; };
+        for (auto v : { Variant{ "short", 1 }, Variant{ "segment", 4 }, Variant{ "paragraph", 32 } })
+        {
+            const auto text = sentence.repeatedString(v.repeats).trim();
+            std::atomic<int> pieces{ 0 };
+
+            for (int threads : opt.threads)
+            {
+                auto s = runKernel(opt, threads, [&](int)
+                    {
+                        char buf[16384];
+                        pieces = marianTokenRoundTrip(t, text.toRawUTF8(), buf, (int)sizeof(buf));
+                    });
+                out.add(report("spm", v.name, threads, s, (double)juce::jmax(0, pieces.load()) * threads, "pieces/s"));
+            }
+        }
+
+        marianDestroyTranslator(t);
+    }
+
+    void benchWav(const Options& opt, juce::Array<juce::var>& out)
+    {
+        const double rate = 48000.0;
+        const auto tmpDir = juce::File::getSpecialLocation(juce::File::tempDirectory);
+
+        for (double seconds : { 1.0, 30.0, 300.0 })
+        {
+            const auto mono = makeSignal(1, (int)(rate * seconds), rate, 3);
+            const double mb = mono.getNumSamples() * 2.0 / (1024.0 * 1024.0); // 16-bit output
+
+            for (int threads : opt.threads)
+            {
+                auto sMem = runKernel(opt, threads, [&](int)
+                    {
+                        auto block = WavEncoderAsync::encodeMono(mono, rate, 16, 16384, nullptr);
+                        juce::ignoreUnused(block);
+                    });
+                out.add(report("wav", "memory_" + juce::String(seconds, 0) + "s", threads, sMem, mb * threads, "MB/s"));
+
+                auto sFile = runKernel(opt, threads, [&](int worker)
+                    {
+                        const auto f = tmpDir.getChildFile("wfw_kernelbench_" + juce::String(worker) + ".wav");
+                        auto w = WavStreamWriter::toFile(f, rate, 1, 16, mono.getNumSamples());
+                        if (!w)
+                            return;
+
+                        const float* ch = mono.getReadPointer(0);
+                        for (int pos = 0; pos < mono.getNumSamples(); pos += 16384)
+                        {
+                            const float* p = ch + pos;
+                            w->write(&p, juce::jmin(16384, mono.getNumSamples() - pos));
+                        }
+                        w->finish();
+                    });
+                out.add(report("wav", "file_" + juce::String(seconds, 0) + "s", threads, sFile, mb * threads, "MB/s"));
+            }
+        }
+
+        for (int t = 0; t < 64; ++t)
+            tmpDir.getChildFile("wfw_kernelbench_" + juce::String(t) + ".wav").deleteFile();
+    }
+
+    // Logits-like row: roughly normal scores with a few strong candidates, and -inf for
+    // the tokens a run suppresses, as whisper_process_logits sees after its masks
+    std::vector<float> makeLogitsRow(int nVocab, juce::int64 seed)
+    {
+        juce::Random rng(seed);
+        std::vector<float> row((size_t)nVocab);
+
+        for (auto& x : row)
+            x = 3.0f * (rng.nextFloat() + rng.nextFloat() + rng.nextFloat() + rng.nextFloat() - 2.0f);
+        for (int k = 0; k < 8; ++k)
+            row[(size_t)rng.nextInt(nVocab)] = 12.0f + 4.0f * rng.nextFloat();
+        for (int i = 0; i < nVocab; i += 97)
+            row[(size_t)i] = -INFINITY;
+        return row;
+    }
+
+    // The decoder's raw logits for the last step of a short greedy run on the test signal
+    std::vector<float> modelLogitsRow(const juce::File& modelFile)
+    {
+        auto cparams = whisper_context_default_params();
+        cparams.use_gpu = false;
+        auto* ctx = whisper_init_from_file_with_params_no_state(modelFile.getFullPathName().toRawUTF8(), cparams);
+        if (!ctx)
+        {
+            std::cerr << "logits: failed to load " << modelFile.getFullPathName() << std::endl;
+            return {};
+        }
+
+        std::vector<float> row;
+        auto* state = whisper_init_state(ctx);
+        const auto in = makeSignal(1, 16000 * 5, 16000.0, 4);
+
+        auto params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+        params.print_progress = false;
+        params.print_realtime = false;
+        params.temperature_inc = 0.0f;
+
+        if (whisper_full_with_state(ctx, state, params, in.getReadPointer(0), in.getNumSamples()) == 0)
+        {
+            const int nVocab = whisper_n_vocab(ctx);
+            const float* logits = whisper_get_logits_from_state(state);
+            row.assign(logits, logits + nVocab);
+
+            // the per-run masks the sampler applies on every step
+            for (auto id : { whisper_token_not(ctx), whisper_token_sot(ctx), whisper_token_solm(ctx),
+                             whisper_token_prev(ctx), whisper_token_nosp(ctx),
+                             whisper_token_translate(ctx), whisper_token_transcribe(ctx) })
+                row[(size_t)id] = -INFINITY;
+        }
+
+        whisper_free_state(state);
+        whisper_free(ctx);
+        return row;
+    }
+
+    /** Times both kernels on the row and checks the SIMD one against the scalar one.
+     *  Returns false if they pick different tokens or their log-probs drift apart.
+     */
+    bool benchLogitsRow(const Options& opt, const juce::String& name, const std::vector<float>& row,
+        juce::Array<juce::var>& out)
+    {
+        const int n = (int)row.size();
+        const int maxThreads = juce::jmax(1, *std::max_element(opt.threads.begin(), opt.threads.end()));
+
+        std::vector<float> refLogprobs((size_t)n), refProbs((size_t)n), logprobs((size_t)n), probs((size_t)n);
+        whisper_ext_logits_log_softmax(row.data(), refLogprobs.data(), refProbs.data(), n, 0);
+        whisper_ext_logits_log_softmax(row.data(), logprobs.data(), probs.data(), n, 1);
+
+        const int refArgmax = whisper_ext_logits_argmax(row.data(), n, 0);
+        const int argmax = whisper_ext_logits_argmax(row.data(), n, 1);
+
+        double maxLogprobErr = 0.0, maxProbErr = 0.0;
+        bool sameMask = true;
+        for (int i = 0; i < n; ++i)
+        {
+            if (std::isinf(refLogprobs[(size_t)i]) || std::isinf(logprobs[(size_t)i]))
+            {
+                sameMask = sameMask && refLogprobs[(size_t)i] == logprobs[(size_t)i] && probs[(size_t)i] == 0.0f;
+                continue;
+            }
+            maxLogprobErr = juce::jmax(maxLogprobErr, (double)std::abs(refLogprobs[(size_t)i] - logprobs[(size_t)i]));
+            maxProbErr = juce::jmax(maxProbErr, (double)std::abs(refProbs[(size_t)i] - probs[(size_t)i]));
+        }
+
+        // log-softmax differs only by the rounding of the log-sum-exp; probs by expf's
+        const bool ok = argmax == refArgmax && sameMask && maxLogprobErr <= 1e-4 && maxProbErr <= 1e-5;
+        std::cerr << "logits/" << name << ": argmax " << refArgmax << (argmax == refArgmax ? " (same)" : " vs " + juce::String(argmax))
+                  << ", max |d logprob| " << maxLogprobErr << ", max |d prob| " << maxProbErr
+                  << (ok ? "" : "  MISMATCH") << std::endl;
+
+        std::vector<std::vector<float>> bufLogprobs((size_t)maxThreads, std::vector<float>((size_t)n));
+        std::vector<std::vector<float>> bufProbs((size_t)maxThreads, std::vector<float>((size_t)n));
+
+        for (int simd : { 0, 1 })
+        {
+            for (int threads : opt.threads)
+            {
+                auto s = runKernel(opt, threads, [&](int worker)
+                    {
+                        whisper_ext_logits_log_softmax(row.data(), bufLogprobs[(size_t)worker].data(),
+                            bufProbs[(size_t)worker].data(), n, simd);
+                        const int best = whisper_ext_logits_argmax(row.data(), n, simd);
+                        juce::ignoreUnused(best);
+                    });
+
+                auto r = report("logits", name + (simd ? "_simd" : "_scalar"), threads, s, (double)threads, "rows/s");
+                if (auto* o = r.getDynamicObject())
+                {
+                    o->setProperty("vocab", n);
+                    o->setProperty("matchesScalar", ok);
+                    o->setProperty("maxLogprobErr", maxLogprobErr);
+                }
+                out.add(r);
+            }
+        }
+
+        return ok;
+    }
+
+    bool benchLogits(const Options& opt, const juce::String& modelPath, juce::Array<juce::var>& out)
+    {
+        // 51865 is the multilingual vocabulary (51866 for large-v3)
+        bool ok = benchLogitsRow(opt, "synthetic", makeLogitsRow(51865, 5), out);
+
+        if (modelPath.isNotEmpty())
+        {
+            const auto row = modelLogitsRow(juce::File::getCurrentWorkingDirectory().getChildFile(modelPath));
+            if (!row.empty())
+                ok = benchLogitsRow(opt, "model", row, out) && ok;
+        }
+        return ok;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInit;
+
+    juce::StringArray args;
+    for (int i = 1; i < argc; ++i)
+        args.add(juce::String::fromUTF8(argv[i]));
+
+    Options opt;
+    opt.filter.addTokens(bench::argValue(args, "--filter"), ",", {});
+    opt.filter.removeEmptyStrings();
+    opt.minTimeMs = juce::jmax(1.0, bench::argValue(args, "--min-time-ms", "500").getDoubleValue());
+    opt.minIters = juce::jmax(1, bench::argValue(args, "--min-iters", "5").getIntValue());
+
+    juce::StringArray threadList;
+    threadList.addTokens(bench::argValue(args, "--threads",
+        "1," + juce::String(juce::jmax(1, juce::SystemStats::getNumCpus() / 2))), ",", {});
+    for (const auto& t : threadList)
+        if (t.getIntValue() > 0)
+            opt.threads.addIfNotAlreadyThere(t.getIntValue());
+    if (opt.threads.isEmpty())
+        opt.threads.add(1);
+
+    const auto cwd = juce::File::getCurrentWorkingDirectory();
+    const auto modelPath = bench::argValue(args, "--model");
+    const auto marianPath = bench::argValue(args, "--marian");
+
+    juce::Array<juce::var> results;
+
+    if (enabled(opt, "resample"))
+        benchResample(opt, results);
+
+    if (enabled(opt, "mel"))
+    {
+        if (modelPath.isNotEmpty())
+            benchMel(opt, cwd.getChildFile(modelPath), results);
+        else if (opt.filter.contains("mel"))
+            std::cerr << "mel: skipped, pass --model" << std::endl;
+    }
+
+    if (enabled(opt, "spm"))
+    {
+        if (marianPath.isNotEmpty())
+            benchSentencePiece(opt, cwd.getChildFile(marianPath), results);
+        else if (opt.filter.contains("spm"))
+            std::cerr << "spm: skipped, pass --marian" << std::endl;
+    }
+
+    if (enabled(opt, "wav"))
+        benchWav(opt, results);
+
+    bool checksPassed = true;
+    if (enabled(opt, "logits"))
+        checksPassed = benchLogits(opt, modelPath, results);
+
+    juce::DynamicObject::Ptr result = new juce::DynamicObject();
+    result->setProperty("benchmark", "kernels");
+    result->setProperty("environment", bench::environmentJson());
+    result->setProperty("minTimeMs", opt.minTimeMs);
+    result->setProperty("results", results);
+    result->setProperty("checksPassed", checksPassed);
+
+    const bool written = bench::writeJson(juce::var(result.get()), bench::argValue(args, "--out", "-"));
+    return written && checksPassed ? 0 : 1;
+}
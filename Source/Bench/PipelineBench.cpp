@@ -0,0 +1,367 @@
+// Source/Bench/PipelineBench.cpp
+//
+// Headless ASR+MT benchmark. Runs a corpus of WAV files through the same
+// WhisperEngine / TranslationEngine the plugin uses and prints JSON.
+//
+//   WhisperFreeWinBench --model ggml-base.bin [--marian <dir>] --corpus <dir|file>...
+//                       [--repeat N] [--warmup N] [--quant q5_1] [--draft ggml-tiny.bin [--speculative K]] [--batched]
+//                       [--decoding beam=5,budget=1500] [--threadpool off|cpus=0-7,poll=10] [--memory huge=thp,numa=interleave]
+//                       [--out result.json] [--trace timeline.json]
+//
+// --batched turns on batched decoding, then checks that every clip, decoded alone and with
+// all clips at once, gives the text of a plain whisper_full run; --draft checks speculative
+// decoding's text against the same run. The exit code is 1 on any mismatch.
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <iostream>
+#include <thread>
+#include "BenchCommon.h"
+#include "../WhisperEngine.h"
+#include "../TranslationEngine.h"
+#include "../Metrics.h"
+#include "../Trace.h"
+
+namespace
+{
+    struct Clip
+    {
+        juce::File file;
+        juce::AudioBuffer<float> mono;
+        double sampleRate = 0.0;
+    };
+
+    juce::Array<juce::File> collectCorpus(const juce::StringArray& args)
+    {
+        juce::Array<juce::File> files;
+        const auto cwd = juce::File::getCurrentWorkingDirectory();
+
+        for (int i = 0; i < args.size(); ++i)
+        {
+            if (args[i] != "--corpus")
+                continue;
+
+            // Every non-flag argument after --corpus is a file or directory
+            for (int j = i + 1; j < args.size() && !args[j].startsWith("--"); ++j)
+            {
+                const auto f = cwd.getChildFile(args[j]);
+                if (f.isDirectory())
+                    files.addArray(f.findChildFiles(juce::File::findFiles, true, "*.wav"));
+                else if (f.existsAsFile())
+                    files.add(f);
+            }
+        }
+
+        files.sort();
+        return files;
+    }
+
+    bool loadClip(juce::AudioFormatManager& fm, const juce::File& f, Clip& clip)
+    {
+        std::unique_ptr<juce::AudioFormatReader> reader(fm.createReaderFor(f));
+        if (!reader || reader->lengthInSamples <= 0)
+            return false;
+
+        const int n = (int)reader->lengthInSamples;
+        const int chans = juce::jmax(1, (int)reader->numChannels);
+
+        juce::AudioBuffer<float> all(chans, n);
+        reader->read(&all, 0, n, 0, true, true);
+
+        clip.file = f;
+        clip.sampleRate = reader->sampleRate;
+        clip.mono.setSize(1, n);
+        clip.mono.clear();
+        for (int ch = 0; ch < chans; ++ch)
+            clip.mono.addFrom(0, 0, all, ch, 0, n, 1.0f / float(chans));
+        return true;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInit;
+
+    juce::StringArray args;
+    for (int i = 1; i < argc; ++i)
+        args.add(juce::String::fromUTF8(argv[i]));
+
+    const auto cwd = juce::File::getCurrentWorkingDirectory();
+    const auto modelPath = bench::argValue(args, "--model");
+    const auto marianPath = bench::argValue(args, "--marian");
+    const int repeat = juce::jmax(1, bench::argValue(args, "--repeat", "1").getIntValue());
+    const int warmup = juce::jmax(0, bench::argValue(args, "--warmup", "1").getIntValue());
+    const auto outPath = bench::argValue(args, "--out", "-");
+    const auto tracePath = bench::argValue(args, "--trace");
+    const bool verbose = args.contains("--verbose");
+    const auto quant = WhisperEngine::quantisationFromName(bench::argValue(args, "--quant"));
+    const auto draftPath = bench::argValue(args, "--draft");
+    const int speculative = draftPath.isNotEmpty() ? bench::argValue(args, "--speculative", "4").getIntValue() : 0;
+    const auto decodingSpec = bench::argValue(args, "--decoding");
+    const auto threadPoolSpec = bench::argValue(args, "--threadpool");
+    const auto memorySpec = bench::argValue(args, "--memory");
+    const bool batched = args.contains("--batched");
+
+    const auto corpus = collectCorpus(args);
+    if (modelPath.isEmpty() || corpus.isEmpty())
+    {
+        std::cerr << "usage: WhisperFreeWinBench --model <ggml.bin> [--marian <dir>] --corpus <dir|wav>... "
+                     "[--repeat N] [--warmup N] [--quant q8_0|q5_1|q4_k] [--draft <ggml.bin> [--speculative K]] [--batched] [--decoding key=value,...] [--threadpool off|key=value,...] [--memory key=value,...] [--out file.json] [--verbose]" << std::endl;
+        return 2;
+    }
+
+    std::function<void(const juce::String&)> logCb;
+    if (verbose)
+        logCb = [](const juce::String& s) { std::cerr << s << std::endl; };
+
+    WhisperEngine whisper;
+    whisper.setQuantisation(quant);
+    whisper.setDecodingOptions(WhisperEngine::decodingOptionsFromString(decodingSpec));
+    whisper.setThreadPoolOptions(WhisperEngine::threadPoolOptionsFromString(threadPoolSpec));
+    whisper.setMemoryPlacement(WhisperEngine::memoryPlacementFromString(memorySpec));
+    whisper.setBatchedDecoding(batched);
+    const double tLoad = bench::nowMs();
+    if (!whisper.loadModel(cwd.getChildFile(modelPath), logCb))
+    {
+        std::cerr << "Failed to load Whisper model: " << modelPath << std::endl;
+        return 1;
+    }
+    const double whisperLoadMs = bench::nowMs() - tLoad;
+
+    if (draftPath.isNotEmpty())
+    {
+        if (!whisper.loadFallbackModel(cwd.getChildFile(draftPath), logCb))
+        {
+            std::cerr << "Failed to load draft model: " << draftPath << std::endl;
+            return 1;
+        }
+        whisper.setSpeculativeDecoding(speculative);
+    }
+
+    TranslationEngine translator;
+    double marianLoadMs = 0.0;
+    if (marianPath.isNotEmpty())
+    {
+        juce::String err;
+        const double t0 = bench::nowMs();
+        if (!translator.initialise(cwd.getChildFile(marianPath), err))
+        {
+            std::cerr << "Failed to load Marian model: " << err << std::endl;
+            return 1;
+        }
+        marianLoadMs = bench::nowMs() - t0;
+    }
+
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    std::vector<Clip> clips;
+    for (const auto& f : corpus)
+    {
+        Clip c;
+        if (loadClip(formatManager, f, c))
+            clips.push_back(std::move(c));
+        else
+            std::cerr << "Skipping unreadable file: " << f.getFullPathName() << std::endl;
+    }
+
+    if (clips.empty())
+        return 1;
+
+    // Warm caches, allocator pools and the first whisper_state
+    for (int w = 0; w < warmup; ++w)
+        whisper.transcribe(clips.front().mono, clips.front().sampleRate, nullptr, nullptr);
+
+   #if WFW_ENABLE_TRACE
+    Trace::installWhisperHooks();
+    Trace::clear();
+   #endif
+
+    // Only measured jobs go into the mel/encode/decode breakdown
+    Metrics::get().reset();
+
+    bench::Series resampleMs, asrMs, mtMs, totalMs, rtf;
+    double audioSeconds = 0.0, processingMs = 0.0, asrTotalMs = 0.0, mtTotalMs = 0.0;
+    juce::int64 asrTokens = 0, mtTokens = 0;
+    juce::Array<juce::var> perFile;
+
+    for (int r = 0; r < repeat; ++r)
+    {
+        for (const auto& clip : clips)
+        {
+            WFW_TRACE_SCOPE("bench", "clip");
+
+            WhisperEngine::JobStats st;
+            const double t0 = bench::nowMs();
+            const auto text = whisper.transcribe(clip.mono, clip.sampleRate, nullptr, logCb, &st);
+
+            double mt = 0.0;
+            int nMtTokens = 0;
+            if (translator.isReady() && text.isNotEmpty())
+            {
+                const double tMt = bench::nowMs();
+                translator.translate(text, logCb, &nMtTokens);
+                mt = bench::nowMs() - tMt;
+                mtMs.add(mt);
+            }
+
+            const double total = bench::nowMs() - t0;
+
+            resampleMs.add(st.resampleMs);
+            asrMs.add(st.asrMs);
+            totalMs.add(total);
+            rtf.add(st.audioSeconds > 0.0 ? total / (st.audioSeconds * 1000.0) : 0.0);
+
+            audioSeconds += st.audioSeconds;
+            processingMs += total;
+            asrTotalMs += st.asrMs;
+            mtTotalMs += mt;
+            asrTokens += st.numTokens;
+            mtTokens += nMtTokens;
+
+            if (r == 0)
+            {
+                juce::DynamicObject::Ptr o = new juce::DynamicObject();
+                o->setProperty("file", clip.file.getFileName());
+                o->setProperty("audioSeconds", st.audioSeconds);
+                o->setProperty("totalMs", total);
+                o->setProperty("asrTokens", st.numTokens);
+                o->setProperty("transcript", text);
+                perFile.add(juce::var(o.get()));
+            }
+        }
+    }
+
+    // Measured jobs only; the checks below run more
+    const auto metrics = Metrics::get().snapshot();
+
+    // The reference both checks below compare with: a plain whisper_full run of each clip
+    std::vector<juce::String> reference;
+    if (speculative > 0 || batched)
+    {
+        whisper.setSpeculativeDecoding(0);
+        whisper.setBatchedDecoding(false);
+        for (const auto& clip : clips)
+            reference.push_back(whisper.transcribe(clip.mono, clip.sampleRate, nullptr, logCb));
+        whisper.setSpeculativeDecoding(speculative);
+        whisper.setBatchedDecoding(batched);
+    }
+
+    // Speculative decoding must give whisper_full's own greedy text
+    int speculativeMismatches = 0;
+    if (speculative > 0)
+    {
+        for (int i = 0; i < perFile.size() && i < (int)clips.size(); ++i)
+        {
+            const auto drafted = perFile[i].getProperty("transcript", {}).toString();
+            const bool match = drafted == reference[(size_t)i];
+
+            if (auto* o = perFile[i].getDynamicObject())
+                o->setProperty("matchesWhisperFull", match);
+
+            if (!match)
+            {
+                ++speculativeMismatches;
+                std::cerr << "Speculative text differs from whisper_full: " << clips[(size_t)i].file.getFileName() << std::endl
+                          << "  speculative:  " << drafted << std::endl
+                          << "  whisper_full: " << reference[(size_t)i] << std::endl;
+            }
+        }
+    }
+
+    // Batched decoding must give whisper_full's own text, alone and sharing steps with other jobs
+    int batchedMismatches = 0;
+    if (batched)
+    {
+
+        // Up to the scheduler's 16 streams at once
+        std::vector<juce::String> concurrent(clips.size());
+        for (size_t first = 0; first < clips.size(); first += 16)
+        {
+            std::vector<std::thread> jobs;
+            for (size_t i = first; i < juce::jmin(clips.size(), first + 16); ++i)
+                jobs.emplace_back([&, i] { concurrent[i] = whisper.transcribe(clips[i].mono, clips[i].sampleRate, nullptr, nullptr); });
+            for (auto& j : jobs)
+                j.join();
+        }
+
+        for (int i = 0; i < perFile.size() && i < (int)clips.size(); ++i)
+        {
+            const auto alone = perFile[i].getProperty("transcript", {}).toString();
+            const bool match = alone == reference[(size_t)i] && concurrent[(size_t)i] == reference[(size_t)i];
+
+            if (auto* o = perFile[i].getDynamicObject())
+                o->setProperty("batchedMatchesWhisperFull", match);
+
+            if (!match)
+            {
+                ++batchedMismatches;
+                std::cerr << "Batched text differs from whisper_full: " << clips[(size_t)i].file.getFileName() << std::endl
+                          << "  batched:      " << alone << std::endl
+                          << "  concurrent:   " << concurrent[(size_t)i] << std::endl
+                          << "  whisper_full: " << reference[(size_t)i] << std::endl;
+            }
+        }
+    }
+
+    juce::DynamicObject::Ptr stages = new juce::DynamicObject();
+    stages->setProperty("resample_ms", resampleMs.toJson());
+    stages->setProperty("asr_ms", asrMs.toJson());
+    if (!mtMs.isEmpty())
+        stages->setProperty("mt_ms", mtMs.toJson());
+    stages->setProperty("total_ms", totalMs.toJson());
+
+    juce::DynamicObject::Ptr summary = new juce::DynamicObject();
+    summary->setProperty("jobs", (int)totalMs.size());
+    summary->setProperty("audioSeconds", audioSeconds);
+    summary->setProperty("processingSeconds", processingMs / 1000.0);
+    summary->setProperty("realTimeFactor", audioSeconds > 0.0 ? processingMs / (audioSeconds * 1000.0) : 0.0);
+    summary->setProperty("rtf", rtf.toJson());
+    summary->setProperty("asrTokensPerSec", asrTotalMs > 0.0 ? (double)asrTokens * 1000.0 / asrTotalMs : 0.0);
+    summary->setProperty("mtTokensPerSec", mtTotalMs > 0.0 ? (double)mtTokens * 1000.0 / mtTotalMs : 0.0);
+    summary->setProperty("peakRssBytes", bench::peakRssBytes());
+    if (speculative > 0)
+    {
+        summary->setProperty("draftAcceptance", whisper.getSpeculativeAcceptanceRate());
+        summary->setProperty("speculativeMismatches", speculativeMismatches);
+    }
+    if (batched)
+        summary->setProperty("batchedMismatches", batchedMismatches);
+
+    juce::DynamicObject::Ptr config = new juce::DynamicObject();
+    config->setProperty("model", juce::File(modelPath).getFileName());
+    config->setProperty("quantisation", WhisperEngine::getQuantisationName(quant));
+    config->setProperty("draftModel", draftPath.isNotEmpty() ? juce::File(draftPath).getFileName() : juce::String());
+    config->setProperty("speculativeTokens", speculative);
+    config->setProperty("batchedDecoding", batched);
+    config->setProperty("decoding", decodingSpec);
+    config->setProperty("threadPool", threadPoolSpec.isEmpty() ? juce::String("default") : threadPoolSpec);
+    config->setProperty("memory", memorySpec.isEmpty() ? juce::String("default") : memorySpec);
+    config->setProperty("marian", marianPath);
+    config->setProperty("files", (int)clips.size());
+    config->setProperty("repeat", repeat);
+    config->setProperty("warmup", warmup);
+    config->setProperty("whisperLoadMs", whisperLoadMs);
+    config->setProperty("marianLoadMs", marianLoadMs);
+
+    juce::DynamicObject::Ptr result = new juce::DynamicObject();
+    result->setProperty("benchmark", "pipeline");
+    result->setProperty("environment", bench::environmentJson());
+    result->setProperty("config", juce::var(config.get()));
+    result->setProperty("summary", juce::var(summary.get()));
+    result->setProperty("stages", juce::var(stages.get()));
+    result->setProperty("files", perFile);
+    result->setProperty("metrics", Metrics::toJson(metrics));
+
+    if (tracePath.isNotEmpty())
+    {
+       #if WFW_ENABLE_TRACE
+        Trace::exportChromeJson(cwd.getChildFile(tracePath));
+       #else
+        std::cerr << "--trace ignored: build with -DWFW_ENABLE_TRACE=ON" << std::endl;
+       #endif
+    }
+
+    const bool written = bench::writeJson(juce::var(result.get()), outPath);
+    return written && batchedMismatches == 0 && speculativeMismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,168 @@
+// Source/DecodeScheduler.cpp
+#include "DecodeScheduler.h"
+#include "Trace.h"
+#include "third_party/whisper-ext.h"
+
+DecodeScheduler::DecodeScheduler(whisper_context* ctx, int maxStreamsIn, int numThreadsIn, double gatherMsIn)
+    : maxStreams(juce::jmax(1, maxStreamsIn)),
+    numThreads(juce::jmax(1, numThreadsIn)),
+    gatherMs(juce::jmax(0.0, gatherMsIn))
+{
+    decoder = whisper_ext_batch_decoder_init(ctx, maxStreams);
+    if (decoder != nullptr)
+        worker = std::thread([this] { run(); });
+}
+
+DecodeScheduler::~DecodeScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        quit = true;
+    }
+    wake.notify_all();
+
+    if (worker.joinable())
+        worker.join();
+
+    whisper_ext_batch_decoder_free(decoder);
+}
+
+DecodeScheduler::Stream::Stream(DecodeScheduler& s, whisper_state* st, const JobToken* c)
+    : scheduler(s), state(st), cancel(c)
+{
+    {
+        std::lock_guard<std::mutex> lg(scheduler.lock);
+        ++scheduler.numAttached;
+    }
+    whisper_ext_set_decode_callback(state, &Stream::decodeStep, this);
+}
+
+DecodeScheduler::Stream::~Stream()
+{
+    whisper_ext_set_decode_callback(state, nullptr, nullptr);
+
+    // One fewer stream to wait for; a step held back for this one can go now
+    {
+        std::lock_guard<std::mutex> lg(scheduler.lock);
+        --scheduler.numAttached;
+    }
+    scheduler.wake.notify_all();
+}
+
+int DecodeScheduler::Stream::decodeStep(whisper_state* st, const whisper_token* tokens, int nTokens, int nPast,
+    float* logits, void* userData)
+{
+    auto* self = static_cast<Stream*>(userData);
+
+    Step step;
+    step.state = st;
+    step.tokens = tokens;
+    step.nTokens = nTokens;
+    step.nPast = nPast;
+    step.logits = logits;
+    step.cancel = self->cancel;
+    return self->scheduler.decode(step) ? 0 : 1;
+}
+
+bool DecodeScheduler::decode(Step& step)
+{
+    if (decoder == nullptr || (step.cancel != nullptr && step.cancel->isCancelled()))
+        return false;
+
+    step.queuedAt = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lk(lock);
+    if (quit)
+        return false;
+
+    waiting.push_back(&step);
+    wake.notify_all();
+    finished.wait(lk, [&step] { return step.done; });
+    return step.ok;
+}
+
+double DecodeScheduler::getMeanBatchSize() const noexcept
+{
+    const auto steps = numSteps.load();
+    return steps > 0 ? (double)numStreamSteps.load() / (double)steps : 0.0;
+}
+
+void DecodeScheduler::run()
+{
+    WFW_TRACE_THREAD_NAME("DecodeScheduler");
+
+    std::vector<Step*> batch;
+    std::vector<whisper_ext_stream_step> steps;
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lk(lock);
+            wake.wait(lk, [this] { return quit || !waiting.empty(); });
+
+            // Hold the oldest step until every attached stream has one waiting, or its gather time is up
+            const auto deadline = waiting.empty() ? std::chrono::steady_clock::now()
+                : waiting.front()->queuedAt + std::chrono::microseconds((juce::int64)(gatherMs * 1000.0));
+            wake.wait_until(lk, deadline, [this]
+                {
+                    return quit || (int)waiting.size() >= juce::jmin(maxStreams, numAttached);
+                });
+
+            if (quit)
+            {
+                for (auto* s : waiting)
+                    s->done = true;
+                waiting.clear();
+                finished.notify_all();
+                return;
+            }
+
+            // Cancelled streams leave before the step rather than after it
+            bool anyCancelled = false;
+            for (auto it = waiting.begin(); it != waiting.end();)
+            {
+                if ((*it)->cancel != nullptr && (*it)->cancel->isCancelled())
+                {
+                    (*it)->done = true;
+                    it = waiting.erase(it);
+                    anyCancelled = true;
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+
+            if (anyCancelled)
+                finished.notify_all();
+
+            const int n = juce::jmin(maxStreams, (int)waiting.size());
+            batch.assign(waiting.begin(), waiting.begin() + n);
+            waiting.erase(waiting.begin(), waiting.begin() + n);
+        }
+
+        if (batch.empty())
+            continue;
+
+        steps.clear();
+        for (auto* s : batch)
+            steps.push_back({ s->state, s->tokens, s->nTokens, s->nPast, s->logits });
+
+        int rc;
+        {
+            WFW_TRACE_SCOPE("asr", "batchedDecodeStep");
+            rc = whisper_ext_batch_decode(decoder, steps.data(), (int)steps.size(), numThreads);
+        }
+
+        ++numSteps;
+        numStreamSteps += (juce::uint64)batch.size();
+
+        std::lock_guard<std::mutex> lg(lock);
+        for (auto* s : batch)
+        {
+            s->ok = rc == 0;
+            s->done = true;
+        }
+        finished.notify_all();
+    }
+}
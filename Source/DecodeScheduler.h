@@ -0,0 +1,95 @@
+// Source/DecodeScheduler.h
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "JobHandle.h"
+
+extern "C" {
+#include <whisper.h>
+}
+
+struct whisper_ext_batch_decoder;
+
+/** Continuous batching of Whisper decoder steps across concurrent jobs.
+ *
+ *  Each job runs its own whisper_full with a Stream attached to its state. The
+ *  decoder passes of its greedy, temperature-0 attempts then come here instead
+ *  of running on the state: one thread advances every stream that is waiting
+ *  in a single batched graph, so the decoder weights are read once per step
+ *  instead of once per stream. Logits processing, timestamps, seeking and the
+ *  temperature fallbacks stay whisper_full's own, so a job's text is the same
+ *  as without batching; fallbacks, which decode several candidates, run on the
+ *  job's state as usual.
+ *
+ *  A step is held until every attached stream is waiting for one, or for at
+ *  most gatherMs if some stream is busy elsewhere (encoding, sampling, a
+ *  fallback). Streams join and leave between steps.
+ */
+class DecodeScheduler
+{
+public:
+    DecodeScheduler(whisper_context* ctx, int maxStreams, int numThreads, double gatherMs = 2.0);
+    ~DecodeScheduler();
+
+    bool isValid() const noexcept { return decoder != nullptr; }
+
+    /** Routes a state's whisper_full decoder passes through the scheduler while it exists.
+     *  A step that is cancelled, or whose batch fails, fails that whisper_full run.
+     */
+    class Stream
+    {
+    public:
+        Stream(DecodeScheduler& scheduler, whisper_state* state, const JobToken* cancel = nullptr);
+        ~Stream();
+
+    private:
+        static int decodeStep(whisper_state* state, const whisper_token* tokens, int nTokens, int nPast,
+                              float* logits, void* userData);
+
+        DecodeScheduler& scheduler;
+        whisper_state* const state;
+        const JobToken* const cancel;
+
+        JUCE_DECLARE_NON_COPYABLE(Stream)
+    };
+
+    // Average number of streams sharing a step so far
+    double getMeanBatchSize() const noexcept;
+
+private:
+    struct Step
+    {
+        whisper_state* state = nullptr;
+        const whisper_token* tokens = nullptr;
+        int nTokens = 0, nPast = 0;
+        float* logits = nullptr;
+        const JobToken* cancel = nullptr;
+        std::chrono::steady_clock::time_point queuedAt;
+        bool done = false, ok = false;      // guarded by lock
+    };
+
+    bool decode(Step& step);
+    void run();
+
+    whisper_ext_batch_decoder* decoder = nullptr;
+    const int maxStreams, numThreads;
+    const double gatherMs;
+
+    std::mutex lock;
+    std::condition_variable wake, finished;
+    std::vector<Step*> waiting;
+    int numAttached = 0;
+    bool quit = false;
+
+    std::atomic<juce::uint64> numSteps{ 0 }, numStreamSteps{ 0 };
+
+    std::thread worker;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DecodeScheduler)
+};
@@ -0,0 +1,140 @@
+// Source/EncodeBatcher.cpp
+#include "EncodeBatcher.h"
+#include "Trace.h"
+#include "third_party/whisper-ext.h"
+
+EncodeBatcher::EncodeBatcher(whisper_context* ctx, int maxBatchIn, double deadlineMsIn, int numThreadsIn)
+    : maxBatch(juce::jmax(1, maxBatchIn)),
+    numThreads(juce::jmax(1, numThreadsIn)),
+    deadlineMs(juce::jmax(0.0, deadlineMsIn))
+{
+    encoder = whisper_ext_batch_encoder_init(ctx, maxBatch);
+    if (encoder != nullptr)
+        worker = std::thread([this] { run(); });
+}
+
+EncodeBatcher::~EncodeBatcher()
+{
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        quit = true;
+    }
+    wake.notify_all();
+
+    if (worker.joinable())
+        worker.join();
+
+    whisper_ext_batch_encoder_free(encoder);
+}
+
+bool EncodeBatcher::encode(whisper_state* state, int melOffset, const JobToken* cancel)
+{
+    if (encoder == nullptr || state == nullptr)
+        return false;
+
+    Window w;
+    w.state = state;
+    w.melOffset = melOffset;
+    w.cancel = cancel;
+    w.queuedAt = std::chrono::steady_clock::now();
+
+    // The batch fills in this state's cross-attention KV; the job's own encode must then be skipped
+    whisper_ext_set_reuse_encoding(state, 1);
+
+    std::unique_lock<std::mutex> lk(lock);
+    if (quit)
+        return false;
+
+    waiting.push_back(&w);
+    wake.notify_all();
+    finished.wait(lk, [&w] { return w.done; });
+    return w.ok;
+}
+
+double EncodeBatcher::getMeanBatchSize() const noexcept
+{
+    const auto batches = numBatches.load();
+    return batches > 0 ? (double)numWindows.load() / (double)batches : 0.0;
+}
+
+void EncodeBatcher::run()
+{
+    WFW_TRACE_THREAD_NAME("EncodeBatcher");
+
+    std::vector<Window*> batch;
+    std::vector<whisper_state*> states;
+    std::vector<int> offsets;
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lk(lock);
+            wake.wait(lk, [this] { return quit || !waiting.empty(); });
+
+            // Hold the oldest window until the batch is full or its deadline passes
+            const auto deadline = waiting.empty() ? std::chrono::steady_clock::now()
+                : waiting.front()->queuedAt + std::chrono::microseconds((juce::int64)(deadlineMs * 1000.0));
+            wake.wait_until(lk, deadline, [this] { return quit || (int)waiting.size() >= maxBatch; });
+
+            if (quit)
+            {
+                for (auto* w : waiting)
+                    w->done = true;
+                waiting.clear();
+                finished.notify_all();
+                return;
+            }
+
+            // Windows cancelled while they waited don't take a slot in the batch
+            bool anyCancelled = false;
+            for (auto it = waiting.begin(); it != waiting.end();)
+            {
+                if ((*it)->cancel != nullptr && (*it)->cancel->isCancelled())
+                {
+                    (*it)->done = true;
+                    it = waiting.erase(it);
+                    anyCancelled = true;
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+
+            if (anyCancelled)
+                finished.notify_all();
+
+            const int n = juce::jmin(maxBatch, (int)waiting.size());
+            batch.assign(waiting.begin(), waiting.begin() + n);
+            waiting.erase(waiting.begin(), waiting.begin() + n);
+        }
+
+        if (batch.empty())
+            continue;
+
+        states.clear();
+        offsets.clear();
+        for (auto* w : batch)
+        {
+            states.push_back(w->state);
+            offsets.push_back(w->melOffset);
+        }
+
+        int rc;
+        {
+            WFW_TRACE_SCOPE("asr", "batchedEncode");
+            rc = whisper_ext_batch_encode(encoder, states.data(), offsets.data(), (int)states.size(), numThreads);
+        }
+
+        ++numBatches;
+        numWindows += (juce::uint64)batch.size();
+
+        std::lock_guard<std::mutex> lg(lock);
+        for (auto* w : batch)
+        {
+            w->ok = rc == 0;
+            w->done = true;
+        }
+        finished.notify_all();
+    }
+}
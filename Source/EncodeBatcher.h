@@ -0,0 +1,68 @@
+// Source/EncodeBatcher.h
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "JobHandle.h"
+
+extern "C" {
+#include <whisper.h>
+}
+
+struct whisper_ext_batch_encoder;
+
+/** Stacks encoder windows from concurrent jobs into one encoder graph.
+ *
+ *  A job whose mel is ready calls encode() and blocks. The batcher thread takes
+ *  the first waiting window, gathers more for at most deadlineMs or until
+ *  maxBatch are waiting, and encodes them together: one set of large matmuls
+ *  instead of several medium ones. A job alone in the queue therefore waits at
+ *  most the deadline before its encode starts.
+ */
+class EncodeBatcher
+{
+public:
+    EncodeBatcher(whisper_context* ctx, int maxBatch, double deadlineMs, int numThreads);
+    ~EncodeBatcher();
+
+    bool isValid() const noexcept { return encoder != nullptr; }
+
+    // Encodes the window at melOffset (10 ms frames) of the state's current mel.
+    // On success the state holds the encoding and reuse-encoding is enabled on it.
+    // A window cancelled before its batch is dispatched is dropped and returns false.
+    bool encode(whisper_state* state, int melOffset, const JobToken* cancel = nullptr);
+
+    double getMeanBatchSize() const noexcept;
+
+private:
+    struct Window
+    {
+        whisper_state* state = nullptr;
+        int melOffset = 0;
+        const JobToken* cancel = nullptr;
+        std::chrono::steady_clock::time_point queuedAt;
+        bool done = false, ok = false;     // guarded by lock
+    };
+
+    void run();
+
+    whisper_ext_batch_encoder* encoder = nullptr;
+    const int maxBatch, numThreads;
+    const double deadlineMs;
+
+    std::mutex lock;
+    std::condition_variable wake, finished;
+    std::vector<Window*> waiting;
+    bool quit = false;
+
+    std::atomic<juce::uint64> numBatches{ 0 }, numWindows{ 0 };
+
+    std::thread worker;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(EncodeBatcher)
+};
@@ -0,0 +1,265 @@
+// Source/EngineClient.cpp
+#include "EngineClient.h"
+
+EngineClient::EngineClient(LogFn log, int ringSeconds)
+    : juce::InterprocessConnection(false, EngineProtocol::connectionMagic),
+    juce::Thread("EngineClientFeeder"),
+    logCb(std::move(log)),
+    ringSamples(juce::jmax(1, ringSeconds) * 48000)
+{
+}
+
+EngineClient::~EngineClient()
+{
+    disconnect();
+}
+
+bool EngineClient::connect(int port, int timeoutMs)
+{
+    disconnect();
+
+    // Fresh ring per connection so nothing half-sent to a previous daemon is replayed
+    ring = SharedAudioRing::createTemporary(ringSamples);
+    if (ring == nullptr)
+    {
+        if (logCb) logCb("[Engine] Could not create the shared audio ring");
+        return false;
+    }
+
+    if (!connectToSocket("127.0.0.1", port, timeoutMs))
+    {
+        if (logCb) logCb("[Engine] No engine service on port " + juce::String(port));
+        return false;
+    }
+
+    broken = false;
+    welcomeReceived.reset();
+    sendMessage(EngineProtocol::makeHello(ring->getFile(),
+        "WhisperFreeWin pid " + juce::String(juce::SystemStats::getProcessId())));
+
+    if (!welcomeReceived.wait(timeoutMs) || !welcomed)
+    {
+        if (logCb) logCb("[Engine] Engine service did not accept the connection");
+        juce::InterprocessConnection::disconnect();
+        return false;
+    }
+
+    startThread();
+    return true;
+}
+
+void EngineClient::disconnect()
+{
+    signalThreadShouldExit();
+    notify();
+    stopThread(3000);
+
+    juce::InterprocessConnection::disconnect();
+    welcomed = false;
+
+    {
+        const juce::ScopedLock sl(uploadLock);
+        uploads.clear();
+    }
+    failAll("disconnected");
+    ring.reset();
+}
+
+juce::uint32 EngineClient::submit(const juce::AudioBuffer<float>& mono, double sampleRate, bool translate, ResultFn onResult)
+{
+    if (!isConnected() || mono.getNumSamples() <= 0)
+        return 0;
+
+    juce::uint32 id;
+    {
+        const juce::ScopedLock sl(pendingLock);
+        id = nextId++;
+        if (nextId == 0)
+            nextId = 1;
+        pending[id] = std::move(onResult);
+    }
+
+    Upload u;
+    u.id = id;
+    u.audio.setSize(1, mono.getNumSamples());
+    u.audio.copyFrom(0, 0, mono, 0, 0, mono.getNumSamples());
+    u.sampleRate = sampleRate;
+    u.translate = translate;
+
+    {
+        const juce::ScopedLock sl(uploadLock);
+        uploads.push_back(std::move(u));
+    }
+    notify();
+    return id;
+}
+
+bool EngineClient::transcribeSync(const juce::AudioBuffer<float>& mono, double sampleRate, bool translate,
+                                  juce::String& transcript, juce::String& translation, int timeoutMs)
+{
+    struct State
+    {
+        juce::WaitableEvent done;
+        bool ok = false;
+        juce::String transcript, translation;
+    };
+
+    auto state = std::make_shared<State>();
+
+    const auto id = submit(mono, sampleRate, translate,
+        [state](bool ok, const juce::String& t, const juce::String& tr)
+        {
+            state->ok = ok;
+            state->transcript = t;
+            state->translation = tr;
+            state->done.signal();
+        });
+
+    if (id == 0)
+        return false;
+
+    if (!state->done.wait(timeoutMs))
+    {
+        const juce::ScopedLock sl(pendingLock);
+        pending.erase(id);
+        return false;
+    }
+
+    if (!state->ok)
+        return false;
+
+    transcript = state->transcript;
+    translation = state->translation;
+    return true;
+}
+
+int EngineClient::getNumPending() const
+{
+    const juce::ScopedLock sl(pendingLock);
+    return (int)pending.size();
+}
+
+void EngineClient::run()
+{
+    while (!threadShouldExit())
+    {
+        Upload u;
+        {
+            const juce::ScopedLock sl(uploadLock);
+            if (!uploads.empty())
+            {
+                u = std::move(uploads.front());
+                uploads.pop_front();
+            }
+        }
+
+        if (u.id == 0)
+        {
+            wait(100);
+            continue;
+        }
+
+        // The daemon reads exactly numSamples for this job, in announcement order
+        if (!sendMessage(EngineProtocol::makeJob(u.id, u.sampleRate, u.audio.getNumSamples(), u.translate)))
+            break;
+
+        const float* src = u.audio.getReadPointer(0);
+        int remaining = u.audio.getNumSamples();
+
+        while (remaining > 0 && !threadShouldExit() && isConnectedInt)
+        {
+            const int n = ring->write(src, remaining);
+            if (n == SharedAudioRing::invalidHeader)
+            {
+                // Only the socket: stopping this thread, the ring and the pending jobs are
+                // left to connectionLost() and disconnect() on the owner's side
+                if (logCb) logCb("[Engine] Shared audio ring is corrupt; disconnecting");
+                broken = true;
+                juce::InterprocessConnection::disconnect();
+                return;
+            }
+
+            src += n;
+            remaining -= n;
+
+            if (n == 0)
+                wait(2); // daemon is behind; it drains the ring as fast as it can read
+        }
+    }
+}
+
+void EngineClient::connectionMade()
+{
+    isConnectedInt = true;
+}
+
+void EngineClient::connectionLost()
+{
+    const bool wasWelcomed = welcomed.exchange(false);
+    isConnectedInt = false;
+    welcomeReceived.signal();
+    notify();
+
+    if (wasWelcomed)
+    {
+        if (logCb) logCb("[Engine] Lost connection to the engine service");
+        failAll("engine service went away");
+    }
+}
+
+void EngineClient::messageReceived(const juce::MemoryBlock& block)
+{
+    EngineProtocol::Message m;
+    if (!EngineProtocol::decode(block, m))
+        return;
+
+    switch (m.kind)
+    {
+        case EngineProtocol::Kind::welcome:
+            welcomed = m.ok;
+            if (logCb) logCb(m.ok ? "[Engine] Connected to engine service (" + m.text + ")"
+                                  : "[Engine] Engine service refused: " + m.text);
+            welcomeReceived.signal();
+            break;
+
+        case EngineProtocol::Kind::result:
+        {
+            ResultFn fn;
+            {
+                const juce::ScopedLock sl(pendingLock);
+                auto it = pending.find(m.id);
+                if (it == pending.end())
+                    return;
+
+                fn = std::move(it->second);
+                pending.erase(it);
+            }
+
+            if (fn) fn(m.ok, m.text, m.text2);
+            break;
+        }
+
+        case EngineProtocol::Kind::log:
+            if (logCb) logCb("[Engine] " + m.text);
+            break;
+
+        case EngineProtocol::Kind::hello:
+        case EngineProtocol::Kind::job:
+            break;
+    }
+}
+
+void EngineClient::failAll(const juce::String& reason)
+{
+    std::map<juce::uint32, ResultFn> failed;
+    {
+        const juce::ScopedLock sl(pendingLock);
+        failed.swap(pending);
+    }
+
+    for (auto& [id, fn] : failed)
+    {
+        juce::ignoreUnused(id);
+        if (fn) fn(false, reason, {});
+    }
+}
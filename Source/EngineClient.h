@@ -0,0 +1,79 @@
+// Source/EngineClient.h
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <juce_events/juce_events.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <deque>
+#include <map>
+#include "EngineProtocol.h"
+#include "SharedAudioRing.h"
+
+/** Client side of the shared engine daemon (WhisperFreeWinEngine).
+ *
+ *  The daemon holds the Whisper and Marian models once for every plugin instance
+ *  on the machine. Jobs are announced over a loopback connection and their audio
+ *  is streamed through a SharedAudioRing by a feeder thread; results come back on
+ *  the connection thread. If the daemon goes away, pending jobs fail and
+ *  isConnected() turns false so the caller can fall back to local engines.
+ */
+class EngineClient : private juce::InterprocessConnection,
+                     private juce::Thread
+{
+public:
+    using LogFn = std::function<void(const juce::String&)>;
+    using ResultFn = std::function<void(bool ok, const juce::String& transcript, const juce::String& translation)>;
+
+    explicit EngineClient(LogFn log, int ringSeconds = 10);
+    ~EngineClient() override;
+
+    bool connect(int port = EngineProtocol::defaultPort, int timeoutMs = 2000);
+    void disconnect();
+
+    bool isConnected() const noexcept { return welcomed.load() && isConnectedInt.load() && !broken.load(); }
+
+    // Copies the buffer and queues it; returns the job id, 0 if not connected
+    juce::uint32 submit(const juce::AudioBuffer<float>& mono, double sampleRate, bool translate, ResultFn onResult);
+
+    // Blocking helper on top of submit(); returns false on failure, disconnect or timeout
+    bool transcribeSync(const juce::AudioBuffer<float>& mono, double sampleRate, bool translate,
+                        juce::String& transcript, juce::String& translation, int timeoutMs = 60000);
+
+    int getNumPending() const;
+
+private:
+    struct Upload
+    {
+        juce::uint32 id = 0;
+        juce::AudioBuffer<float> audio;
+        double sampleRate = 0.0;
+        bool translate = false;
+    };
+
+    // InterprocessConnection
+    void connectionMade() override;
+    void connectionLost() override;
+    void messageReceived(const juce::MemoryBlock&) override;
+
+    // Feeder: announces each job and streams its samples into the ring
+    void run() override;
+
+    void failAll(const juce::String& reason);
+
+    LogFn logCb;
+    const int ringSamples;
+    std::unique_ptr<SharedAudioRing> ring;
+
+    juce::CriticalSection uploadLock;
+    std::deque<Upload> uploads;
+
+    mutable juce::CriticalSection pendingLock;
+    std::map<juce::uint32, ResultFn> pending;
+    juce::uint32 nextId = 1;
+
+    std::atomic<bool> isConnectedInt{ false }, welcomed{ false };
+    std::atomic<bool> broken{ false };     // the feeder found the ring corrupt and dropped the connection
+    juce::WaitableEvent welcomeReceived;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(EngineClient)
+};
@@ -0,0 +1,402 @@
+// Source/EngineDaemon/EngineDaemonMain.cpp
+//
+// Shared inference service. Holds one WhisperEngine and one TranslationEngine for
+// every plugin instance on the machine; EngineClient connects over loopback,
+// streams audio through a SharedAudioRing and gets transcripts back.
+//
+//   WhisperFreeWinEngine --model ggml-base.bin [--marian <dir>] [--port N] [--jobs N]
+//                        [--rpc host:port,host:port] [--quant q8_0|q5_1|q4_k] [--batch-decode]
+//                        [--encode-batch N] [--encode-deadline ms] [--draft ggml-tiny.bin [--speculative K]]
+//                        [--decoding beam=5,fallbacks=2,budget=1500] [--threadpool cpus=0-15,poll=10]
+//                        [--memory huge=thp,numa=node] [--verbose]
+//
+// All clients share one scheduler (a ThreadPool over the engines' state pools), so
+// extra plugin instances cost a socket and a ring, not another copy of the weights.
+
+#include <juce_core/juce_core.h>
+#include <juce_events/juce_events.h>
+#include <csignal>
+#include <deque>
+#include <iostream>
+#include "../EngineProtocol.h"
+#include "../SharedAudioRing.h"
+#include "../WhisperEngine.h"
+#include "../TranslationEngine.h"
+#include "../Metrics.h"
+
+namespace
+{
+    std::atomic<bool> quitRequested{ false };
+
+    juce::String argValue(const juce::StringArray& args, const juce::String& name, const juce::String& fallback = {})
+    {
+        const int i = args.indexOf(name);
+        return (i >= 0 && i + 1 < args.size()) ? args[i + 1] : fallback;
+    }
+
+    struct Engines
+    {
+        WhisperEngine asr;
+        TranslationEngine mt;
+        std::function<void(const juce::String&)> log;
+        juce::String description;
+    };
+
+    class Session : public juce::InterprocessConnection,
+                    public std::enable_shared_from_this<Session>,
+                    private juce::Thread
+    {
+    public:
+        Session(Engines& e, juce::ThreadPool& s, int sessionId)
+            : juce::InterprocessConnection(false, EngineProtocol::connectionMagic),
+            juce::Thread("EngineSession" + juce::String(sessionId)),
+            engines(e), scheduler(s), id(sessionId)
+        {
+        }
+
+        ~Session() override
+        {
+            signalThreadShouldExit();
+            notify();
+            stopThread(5000);
+            disconnect();
+        }
+
+        bool isDead() const noexcept { return dead.load(); }
+
+        void sendResult(juce::uint32 jobId, bool ok, const juce::String& transcript, const juce::String& translation)
+        {
+            const juce::ScopedLock sl(sendLock);
+            sendMessage(EngineProtocol::makeResult(jobId, ok, transcript, translation));
+        }
+
+    private:
+        // Ten minutes at 192 kHz: anything longer is a broken or hostile client
+        static constexpr int maxJobSamples = 192000 * 600;
+
+        struct Job
+        {
+            juce::uint32 id = 0;
+            double sampleRate = 0.0;
+            int numSamples = 0;
+            bool translate = false;
+        };
+
+        void connectionMade() override
+        {
+            if (engines.log) engines.log("[Engine] Session " + juce::String(id) + " connected");
+        }
+
+        void connectionLost() override
+        {
+            dead = true;
+            lifetime->cancel();     // nobody is left to read this session's results
+            notify();
+            if (engines.log) engines.log("[Engine] Session " + juce::String(id) + " closed");
+        }
+
+        void messageReceived(const juce::MemoryBlock& block) override
+        {
+            EngineProtocol::Message m;
+            if (!EngineProtocol::decode(block, m))
+                return;
+
+            if (m.kind == EngineProtocol::Kind::hello)
+            {
+                // Only rings a client could have made with createTemporary(); never an arbitrary path
+                if (juce::File::isAbsolutePath(m.text))
+                    ring = SharedAudioRing::openTemporary(juce::File(m.text));
+
+                {
+                    const juce::ScopedLock sl(sendLock);
+                    sendMessage(EngineProtocol::makeWelcome(ring != nullptr,
+                        ring != nullptr ? engines.description : "cannot map " + m.text));
+                }
+
+                if (ring != nullptr)
+                {
+                    if (engines.log) engines.log("[Engine] Session " + juce::String(id) + " is " + m.text2);
+                    startThread();
+                }
+                return;
+            }
+
+            if (m.kind == EngineProtocol::Kind::job && m.numSamples > 0 && m.numSamples <= maxJobSamples)
+            {
+                {
+                    const juce::ScopedLock sl(jobLock);
+                    jobs.push_back({ m.id, m.sampleRate, m.numSamples, m.translate });
+                }
+                notify();
+            }
+        }
+
+        // Pulls each announced job's samples out of the ring, then hands it to the scheduler
+        void run() override
+        {
+            while (!threadShouldExit() && !dead)
+            {
+                Job job;
+                {
+                    const juce::ScopedLock sl(jobLock);
+                    if (!jobs.empty())
+                    {
+                        job = jobs.front();
+                        jobs.pop_front();
+                    }
+                }
+
+                if (job.id == 0)
+                {
+                    wait(100);
+                    continue;
+                }
+
+                juce::AudioBuffer<float> audio(1, job.numSamples);
+                float* dst = audio.getWritePointer(0);
+                int got = 0;
+                double lastProgressMs = juce::Time::getMillisecondCounterHiRes();
+
+                while (got < job.numSamples && !threadShouldExit() && !dead)
+                {
+                    const int n = ring->read(dst + got, job.numSamples - got);
+                    if (n == SharedAudioRing::invalidHeader)
+                    {
+                        if (engines.log) engines.log("[Engine] Session " + juce::String(id) + " sent an invalid ring header; closing");
+                        dead = true;
+                        lifetime->cancel();
+                        break;
+                    }
+
+                    got += n;
+
+                    if (n > 0)
+                    {
+                        lastProgressMs = juce::Time::getMillisecondCounterHiRes();
+                        continue;
+                    }
+
+                    // A client that stops feeding mid-job has lost track of the stream
+                    if (juce::Time::getMillisecondCounterHiRes() - lastProgressMs > 10000.0)
+                    {
+                        if (engines.log) engines.log("[Engine] Session " + juce::String(id) + " stalled; closing");
+                        dead = true;
+                        break;
+                    }
+
+                    wait(2);
+                }
+
+                if (got < job.numSamples)
+                    break;
+
+                // The reaper may already have dropped the last owner and be in ~Session,
+                // waiting for this thread; shared_from_this() would throw there
+                auto self = weak_from_this().lock();
+                if (self == nullptr)
+                    break;
+
+                Metrics::get().increment(Metrics::Counter::jobsQueued);
+                const double enqueuedMs = juce::Time::getMillisecondCounterHiRes();
+
+                scheduler.addJob([self = std::move(self), job, audio = std::move(audio), enqueuedMs, &e = engines]
+                    {
+                        Metrics::get().record(Metrics::Stage::queueWait, juce::Time::getMillisecondCounterHiRes() - enqueuedMs);
+
+                        const auto* cancel = self->lifetime.get();
+                        WhisperEngine::JobStats stats;
+                        const auto text = e.asr.transcribe(audio, job.sampleRate, nullptr, e.log, &stats, cancel);
+                        if (!cancel->isCancelled())
+                            Metrics::get().increment(Metrics::jobOutcome(stats.succeeded, text.isNotEmpty()));
+
+                        juce::String translated;
+                        if (job.translate && text.isNotEmpty() && e.mt.isReady())
+                            translated = e.mt.translate(text, e.log, nullptr, cancel);
+
+                        if (!self->isDead())
+                            self->sendResult(job.id, text.isNotEmpty(), text, translated);
+                    });
+            }
+        }
+
+        Engines& engines;
+        juce::ThreadPool& scheduler;
+        const int id;
+
+        std::unique_ptr<SharedAudioRing> ring;
+        juce::CriticalSection jobLock, sendLock;
+        std::deque<Job> jobs;
+        std::atomic<bool> dead{ false };
+        const JobHandle lifetime = makeJobHandle();  // cancels every job of this session
+    };
+
+    class Daemon : public juce::InterprocessConnectionServer
+    {
+    public:
+        Daemon(Engines& e, int numJobs) : engines(e), scheduler(juce::jmax(1, numJobs)) {}
+
+        ~Daemon() override
+        {
+            stop();
+            scheduler.removeAllJobs(false, 60000);
+
+            const juce::ScopedLock sl(sessionLock);
+            sessions.clear();
+        }
+
+        // Drops sessions whose client has gone and whose jobs have all finished
+        void reap()
+        {
+            std::vector<std::shared_ptr<Session>> gone;
+            {
+                const juce::ScopedLock sl(sessionLock);
+                for (auto it = sessions.begin(); it != sessions.end();)
+                {
+                    if ((*it)->isDead() && it->use_count() == 1)
+                    {
+                        gone.push_back(std::move(*it));
+                        it = sessions.erase(it);
+                    }
+                    else
+                    {
+                        ++it;
+                    }
+                }
+            }
+        }
+
+        int getNumSessions() const
+        {
+            const juce::ScopedLock sl(sessionLock);
+            return (int)sessions.size();
+        }
+
+    private:
+        juce::InterprocessConnection* createConnectionObject() override
+        {
+            auto s = std::make_shared<Session>(engines, scheduler, ++lastSessionId);
+            const juce::ScopedLock sl(sessionLock);
+            sessions.push_back(s);
+            return s.get();
+        }
+
+        Engines& engines;
+        juce::ThreadPool scheduler;
+
+        mutable juce::CriticalSection sessionLock;
+        std::vector<std::shared_ptr<Session>> sessions;
+        int lastSessionId = 0;
+    };
+}
+
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInit;
+
+    juce::StringArray args;
+    for (int i = 1; i < argc; ++i)
+        args.add(juce::String::fromUTF8(argv[i]));
+
+    const auto cwd = juce::File::getCurrentWorkingDirectory();
+    const auto modelPath = argValue(args, "--model");
+    const auto marianPath = argValue(args, "--marian");
+    const int port = argValue(args, "--port", juce::String(EngineProtocol::defaultPort)).getIntValue();
+    const int numJobs = argValue(args, "--jobs", "2").getIntValue();
+    const auto rpcEndpoints = juce::StringArray::fromTokens(argValue(args, "--rpc"), ",", {});
+    const auto quant = WhisperEngine::quantisationFromName(argValue(args, "--quant"));
+    const bool batchDecode = args.contains("--batch-decode");
+    const int encodeBatch = argValue(args, "--encode-batch", "1").getIntValue();
+    const double encodeDeadlineMs = argValue(args, "--encode-deadline", "15").getDoubleValue();
+    const auto draftPath = argValue(args, "--draft");
+    const int speculative = argValue(args, "--speculative", "4").getIntValue();
+    const auto decoding = WhisperEngine::decodingOptionsFromString(argValue(args, "--decoding"));
+    const auto threadPool = WhisperEngine::threadPoolOptionsFromString(argValue(args, "--threadpool"));
+    const auto memory = WhisperEngine::memoryPlacementFromString(argValue(args, "--memory"));
+    const bool verbose = args.contains("--verbose");
+
+    if (modelPath.isEmpty())
+    {
+        std::cerr << "usage: WhisperFreeWinEngine --model <ggml.bin> [--marian <dir>] [--port N] [--jobs N] "
+                     "[--rpc host:port,...] [--quant q8_0|q5_1|q4_k] [--batch-decode] [--encode-batch N] [--encode-deadline ms] "
+                     "[--draft <ggml.bin> [--speculative K]] [--decoding key=value,...] [--threadpool off|key=value,...] [--memory key=value,...] [--verbose]" << std::endl;
+        return 2;
+    }
+
+    auto print = [](const juce::String& s) { std::cerr << s << std::endl; };
+
+    Engines engines;
+    if (verbose)
+        engines.log = print;
+
+    // Encoding offloaded to ggml-rpc servers; a lost server takes this process down, not the DAW
+    engines.asr.setRpcEndpoints(rpcEndpoints);
+    engines.asr.setQuantisation(quant);
+
+    // One set of persistent (optionally pinned) workers for every graph of every session
+    engines.asr.setThreadPoolOptions(threadPool);
+
+    // On multi-socket hosts numa=node gives every node its own copy of the weights
+    engines.asr.setMemoryPlacement(memory);
+
+    // Concurrent sessions' decoder steps share one graph per step
+    engines.asr.setBatchedDecoding(batchDecode);
+    engines.asr.setBatchedEncoding(encodeBatch, encodeDeadlineMs);
+
+    // Fallback steps and a per-job budget bound how long one hard window can hold a worker
+    engines.asr.setDecodingOptions(decoding);
+
+    const auto modelFile = cwd.getChildFile(modelPath);
+    if (!engines.asr.loadModel(modelFile, print))
+    {
+        std::cerr << "could not load " << modelFile.getFullPathName() << std::endl;
+        return 1;
+    }
+    engines.description = modelFile.getFileName();
+
+    // A small model with the same tokenizer drafts tokens the main one verifies in batches
+    if (draftPath.isNotEmpty())
+    {
+        if (engines.asr.loadFallbackModel(cwd.getChildFile(draftPath), print))
+        {
+            engines.asr.setSpeculativeDecoding(speculative);
+            engines.description << " (draft " << cwd.getChildFile(draftPath).getFileName() << ")";
+        }
+        else
+        {
+            std::cerr << "could not load draft " << draftPath << " (continuing without it)" << std::endl;
+        }
+    }
+
+    if (marianPath.isNotEmpty())
+    {
+        juce::String err;
+        if (!engines.mt.initialise(cwd.getChildFile(marianPath), err))
+            std::cerr << "[MT] " << err << " (continuing without translation)" << std::endl;
+        else
+            engines.description << " + " << cwd.getChildFile(marianPath).getFileName();
+    }
+
+    Daemon daemon(engines, numJobs);
+
+    // Loopback only: the ring files are local, and this is not a network service
+    if (!daemon.beginWaitingForSocket(port, "127.0.0.1"))
+    {
+        std::cerr << "could not listen on 127.0.0.1:" << port << std::endl;
+        return 1;
+    }
+
+    std::signal(SIGINT, [](int) { quitRequested = true; });
+    std::signal(SIGTERM, [](int) { quitRequested = true; });
+
+    std::cerr << "WhisperFreeWinEngine listening on 127.0.0.1:" << port
+              << " (" << engines.description << ", " << juce::jmax(1, numJobs) << " jobs)" << std::endl;
+
+    while (!quitRequested)
+    {
+        juce::Thread::sleep(500);
+        daemon.reap();
+    }
+
+    std::cerr << "shutting down (" << daemon.getNumSessions() << " sessions)" << std::endl;
+    return 0;
+}
@@ -0,0 +1,103 @@
+// Source/EngineProtocol.h
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+/** Control messages between EngineClient (plugin) and WhisperFreeWinEngine (daemon).
+ *
+ *  Audio never goes over the socket: a job message announces numSamples and the
+ *  client then streams exactly that many samples through its SharedAudioRing.
+ *  Frames are delimited by juce::InterprocessConnection (magic + length prefix).
+ */
+namespace EngineProtocol
+{
+    static constexpr int defaultPort = 47291;
+    static constexpr juce::uint32 connectionMagic = 0x57464545; // "WFEE"
+
+    enum class Kind : juce::uint8
+    {
+        hello = 1,      // client -> daemon: text = ring file, text2 = client name
+        welcome,        // daemon -> client: ok, text = loaded models
+        job,            // client -> daemon: id, sampleRate, numSamples, translate
+        result,         // daemon -> client: id, ok, text = transcript, text2 = translation
+        log             // daemon -> client: text
+    };
+
+    struct Message
+    {
+        Kind kind = Kind::log;
+        juce::uint32 id = 0;
+        bool ok = false;
+        bool translate = false;
+        double sampleRate = 0.0;
+        int numSamples = 0;
+        juce::String text, text2;
+    };
+
+    // Every frame carries every field; the messages are tiny and this keeps decode trivial
+    inline juce::MemoryBlock encode(const Message& m)
+    {
+        juce::MemoryOutputStream out(64 + m.text.getNumBytesAsUTF8() + m.text2.getNumBytesAsUTF8());
+        out.writeByte((char)m.kind);
+        out.writeInt((int)m.id);
+        out.writeBool(m.ok);
+        out.writeBool(m.translate);
+        out.writeDouble(m.sampleRate);
+        out.writeInt(m.numSamples);
+        out.writeString(m.text);
+        out.writeString(m.text2);
+        return out.getMemoryBlock();
+    }
+
+    inline bool decode(const juce::MemoryBlock& block, Message& m)
+    {
+        constexpr size_t fixedBytes = 1 + 4 + 1 + 1 + 8 + 4;
+        if (block.getSize() < fixedBytes)
+            return false;
+
+        juce::MemoryInputStream in(block, false);
+        const auto kind = (juce::uint8)in.readByte();
+        if (kind < (juce::uint8)Kind::hello || kind > (juce::uint8)Kind::log)
+            return false;
+
+        m.kind = (Kind)kind;
+        m.id = (juce::uint32)in.readInt();
+        m.ok = in.readBool();
+        m.translate = in.readBool();
+        m.sampleRate = in.readDouble();
+        m.numSamples = in.readInt();
+        m.text = in.readString();
+        m.text2 = in.readString();
+        return true;
+    }
+
+    inline juce::MemoryBlock makeHello(const juce::File& ring, const juce::String& clientName)
+    {
+        Message m; m.kind = Kind::hello; m.text = ring.getFullPathName(); m.text2 = clientName;
+        return encode(m);
+    }
+
+    inline juce::MemoryBlock makeWelcome(bool ok, const juce::String& info)
+    {
+        Message m; m.kind = Kind::welcome; m.ok = ok; m.text = info;
+        return encode(m);
+    }
+
+    inline juce::MemoryBlock makeJob(juce::uint32 id, double sampleRate, int numSamples, bool translate)
+    {
+        Message m; m.kind = Kind::job; m.id = id; m.sampleRate = sampleRate; m.numSamples = numSamples; m.translate = translate;
+        return encode(m);
+    }
+
+    inline juce::MemoryBlock makeResult(juce::uint32 id, bool ok, const juce::String& transcript, const juce::String& translation)
+    {
+        Message m; m.kind = Kind::result; m.id = id; m.ok = ok; m.text = transcript; m.text2 = translation;
+        return encode(m);
+    }
+
+    inline juce::MemoryBlock makeLog(const juce::String& text)
+    {
+        Message m; m.kind = Kind::log; m.text = text;
+        return encode(m);
+    }
+}
@@ -0,0 +1,110 @@
+// Source/FlacCaptureSink.cpp
+#include "FlacCaptureSink.h"
+#include "AudioBlockOps.h"
+
+FlacCaptureSink::FlacCaptureSink(const Options& options, LogFn logFn)
+    : opts(options),
+    log(std::move(logFn))
+{
+    segmentLength = opts.segmentSeconds > 0.0 ? (juce::int64)(opts.segmentSeconds * opts.sampleRate) : 0;
+}
+
+FlacCaptureSink::~FlacCaptureSink()
+{
+    finish();
+}
+
+bool FlacCaptureSink::openSegment()
+{
+    opts.folder.createDirectory();
+
+    const auto name = opts.prefix + "-" + juce::Time::getCurrentTime().formatted("%Y%m%d-%H%M%S")
+        + "-" + juce::String(segments.size()).paddedLeft('0', 3);
+    const auto file = opts.folder.getNonexistentChildFile(name, ".flac", false);
+
+    std::unique_ptr<juce::FileOutputStream> fos(file.createOutputStream());
+    if (!fos || !fos->openedOk())
+    {
+        if (log) log("[FLAC] Could not create " + file.getFullPathName());
+        return false;
+    }
+
+    const int level = juce::jlimit(0, juce::jmax(0, flac.getQualityOptions().size() - 1), opts.compressionLevel);
+    writer.reset(flac.createWriterFor(fos.get(), opts.sampleRate, (unsigned int)opts.numChannels,
+        opts.bitsPerSample == 24 ? 24 : 16, {}, level));
+
+    if (!writer)
+    {
+        if (log) log("[FLAC] createWriterFor failed (" + juce::String(opts.sampleRate) + " Hz)");
+        fos.reset();
+        file.deleteFile();
+        return false;
+    }
+
+    fos.release(); // writer owns
+    segments.add(file);
+    samplesInSegment = 0;
+
+    if (log) log("[FLAC] Writing " + file.getFileName());
+    return true;
+}
+
+void FlacCaptureSink::closeSegment()
+{
+    if (writer)
+    {
+        writer->flush();
+        writer.reset(); // finalises the STREAMINFO block
+    }
+}
+
+bool FlacCaptureSink::write(const float* const* channels, int numSamples)
+{
+    if (finished)
+        return false;
+
+    if (scratch.getNumSamples() < numSamples)
+        scratch.setSize(opts.numChannels, numSamples, false, false, true);
+
+    for (int ch = 0; ch < opts.numChannels; ++ch)
+    {
+        juce::FloatVectorOperations::copy(scratch.getWritePointer(ch), channels[ch], numSamples);
+        AudioBlockOps::sanitise(scratch.getWritePointer(ch), numSamples);
+    }
+
+    int pos = 0;
+    while (pos < numSamples)
+    {
+        if (!writer && !openSegment())
+            return false;
+
+        int n = numSamples - pos;
+        if (segmentLength > 0)
+            n = (int)juce::jmin((juce::int64)n, segmentLength - samplesInSegment);
+
+        const float* ptrs[32] = {};
+        for (int ch = 0; ch < juce::jmin(32, opts.numChannels); ++ch)
+            ptrs[ch] = scratch.getReadPointer(ch, pos);
+
+        if (!writer->writeFromFloatArrays(ptrs, opts.numChannels, n))
+            return false;
+
+        pos += n;
+        samplesInSegment += n;
+
+        if (segmentLength > 0 && samplesInSegment >= segmentLength)
+            closeSegment();
+    }
+
+    return true;
+}
+
+bool FlacCaptureSink::finish()
+{
+    if (finished)
+        return true;
+
+    finished = true;
+    closeSegment();
+    return true;
+}
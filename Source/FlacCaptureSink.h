@@ -0,0 +1,58 @@
+// Source/FlacCaptureSink.h
+#pragma once
+
+#include <juce_audio_formats/juce_audio_formats.h>
+#include "WavStreamWriter.h"
+
+/** Archival FLAC sink with segment rotation.
+ *
+ *  Writes <folder>/<prefix>-<yyyymmdd-hhmmss>-<nnn>.flac and starts a new file every
+ *  segmentSeconds (0 = one file), so a crash loses at most one segment and archives
+ *  stay manageable. Meant to be driven by BackgroundAudioCapture or a pool job;
+ *  FLAC encoding never runs on the audio or ASR threads.
+ */
+class FlacCaptureSink : public AudioCaptureSink
+{
+public:
+    struct Options
+    {
+        juce::File folder;
+        juce::String prefix = "capture";
+        double sampleRate = 48000.0;
+        int numChannels = 1;
+        int bitsPerSample = 16;         // 16 or 24
+        int compressionLevel = 5;       // 0 (fastest) .. 8 (smallest)
+        double segmentSeconds = 1800.0;
+    };
+
+    using LogFn = std::function<void(const juce::String&)>;
+
+    explicit FlacCaptureSink(const Options& options, LogFn log = nullptr);
+    ~FlacCaptureSink() override;
+
+    int getNumChannels() const override { return opts.numChannels; }
+    double getSampleRate() const override { return opts.sampleRate; }
+
+    bool write(const float* const* channels, int numSamples) override;
+    bool finish() override;
+
+    const juce::Array<juce::File>& getSegments() const { return segments; }
+
+private:
+    bool openSegment();
+    void closeSegment();
+
+    const Options opts;
+    LogFn log;
+
+    juce::FlacAudioFormat flac;
+    std::unique_ptr<juce::AudioFormatWriter> writer;
+    juce::Array<juce::File> segments;
+    juce::int64 samplesInSegment = 0;
+    juce::int64 segmentLength = 0;      // 0 = unlimited
+    bool finished = false;
+
+    juce::AudioBuffer<float> scratch;   // sanitised copy of the incoming block
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FlacCaptureSink)
+};
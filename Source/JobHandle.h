@@ -0,0 +1,25 @@
+// Source/JobHandle.h
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+/** Cancellation flag shared by whoever queued a job and whoever runs it.
+ *
+ *  The owner calls cancel(); the engines poll isCancelled() at their break points
+ *  (whisper's abort and encoder-begin callbacks, each batched decoder step, between
+ *  ASR and MT) and give up with an empty result. Cancelling a finished job is harmless.
+ */
+class JobToken
+{
+public:
+    void cancel() noexcept { cancelled.store(true, std::memory_order_relaxed); }
+    bool isCancelled() const noexcept { return cancelled.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<bool> cancelled{ false };
+};
+
+using JobHandle = std::shared_ptr<JobToken>;
+
+inline JobHandle makeJobHandle() { return std::make_shared<JobToken>(); }
@@ -0,0 +1,129 @@
+// Source/MTProtocol.h
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+/** Messages exchanged between TranslationWorker and the MT worker process.
+ *
+ *  Framing (magic header + length prefix) is done by the JUCE coordinator/worker
+ *  pipe; each frame here is one message: a kind byte followed by little-endian
+ *  fields, strings as null-terminated UTF-8.
+ */
+namespace MTProtocol
+{
+    // Shared by both sides of juce::ChildProcessCoordinator / ChildProcessWorker
+    static constexpr const char* commandLineUID = "wfwmtworker";
+
+    // Passed instead of a model directory to run the worker as an echo stub
+    static constexpr const char* echoModel = "echo";
+
+    enum class Kind : juce::uint8
+    {
+        load = 1,       // coordinator -> worker: modelDir
+        translate,      // coordinator -> worker: id, text
+        ready,          // worker -> coordinator: ok, info
+        result,         // worker -> coordinator: id, ok, numTokens, text
+        log             // worker -> coordinator: text
+    };
+
+    struct Message
+    {
+        Kind kind = Kind::log;
+        juce::uint32 id = 0;
+        bool ok = false;
+        int numTokens = 0;
+        juce::String text;
+    };
+
+    inline juce::MemoryBlock encode(const Message& m)
+    {
+        juce::MemoryOutputStream out(64 + m.text.getNumBytesAsUTF8());
+        out.writeByte((char)m.kind);
+
+        switch (m.kind)
+        {
+            case Kind::translate:
+                out.writeInt((int)m.id);
+                break;
+            case Kind::ready:
+                out.writeBool(m.ok);
+                break;
+            case Kind::result:
+                out.writeInt((int)m.id);
+                out.writeBool(m.ok);
+                out.writeInt(m.numTokens);
+                break;
+            case Kind::load:
+            case Kind::log:
+                break;
+        }
+
+        out.writeString(m.text);
+        return out.getMemoryBlock();
+    }
+
+    inline bool decode(const juce::MemoryBlock& block, Message& m)
+    {
+        if (block.getSize() < 2)
+            return false;
+
+        juce::MemoryInputStream in(block, false);
+        const auto kind = (juce::uint8)in.readByte();
+        if (kind < (juce::uint8)Kind::load || kind > (juce::uint8)Kind::log)
+            return false;
+
+        m = {};
+        m.kind = (Kind)kind;
+
+        switch (m.kind)
+        {
+            case Kind::translate:
+                m.id = (juce::uint32)in.readInt();
+                break;
+            case Kind::ready:
+                m.ok = in.readBool();
+                break;
+            case Kind::result:
+                m.id = (juce::uint32)in.readInt();
+                m.ok = in.readBool();
+                m.numTokens = in.readInt();
+                break;
+            case Kind::load:
+            case Kind::log:
+                break;
+        }
+
+        m.text = in.readString();
+        return true;
+    }
+
+    inline juce::MemoryBlock makeLoad(const juce::String& modelDir)
+    {
+        Message m; m.kind = Kind::load; m.text = modelDir;
+        return encode(m);
+    }
+
+    inline juce::MemoryBlock makeTranslate(juce::uint32 id, const juce::String& text)
+    {
+        Message m; m.kind = Kind::translate; m.id = id; m.text = text;
+        return encode(m);
+    }
+
+    inline juce::MemoryBlock makeReady(bool ok, const juce::String& info)
+    {
+        Message m; m.kind = Kind::ready; m.ok = ok; m.text = info;
+        return encode(m);
+    }
+
+    inline juce::MemoryBlock makeResult(juce::uint32 id, bool ok, int numTokens, const juce::String& text)
+    {
+        Message m; m.kind = Kind::result; m.id = id; m.ok = ok; m.numTokens = numTokens; m.text = text;
+        return encode(m);
+    }
+
+    inline juce::MemoryBlock makeLog(const juce::String& text)
+    {
+        Message m; m.kind = Kind::log; m.text = text;
+        return encode(m);
+    }
+}
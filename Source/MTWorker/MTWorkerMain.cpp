@@ -0,0 +1,200 @@
+// Source/MTWorker/MTWorkerMain.cpp
+//
+// Out-of-process MT runtime for TranslationWorker. Launched by the plugin via
+// juce::ChildProcessCoordinator; not meant to be started by hand.
+//
+// Requests are gathered for up to batchWindowMs (or maxBatch requests) and run
+// through one marianTranslateBatch call. Loading MTProtocol::echoModel instead of
+// a model directory turns the worker into an echo stub for testing the IPC path.
+
+#include <juce_core/juce_core.h>
+#include <juce_events/juce_events.h>
+#include <cstdio>
+#include <deque>
+#include "../MTProtocol.h"
+#include "../marian_c_api.h"
+
+namespace
+{
+    constexpr int maxBatch = 16;
+    constexpr int batchWindowMs = 5;
+
+    class MTWorkerProcess : public juce::ChildProcessWorker,
+                            private juce::Thread
+    {
+    public:
+        MTWorkerProcess() : juce::Thread("MTWorkerBatcher") { startThread(); }
+
+        ~MTWorkerProcess() override
+        {
+            signalThreadShouldExit();
+            wakeUp.signal();
+            stopThread(10000);
+            translator.reset();
+        }
+
+        juce::WaitableEvent finished;
+
+        void handleMessageFromCoordinator(const juce::MemoryBlock& block) override
+        {
+            MTProtocol::Message m;
+            if (!MTProtocol::decode(block, m))
+                return;
+
+            if (m.kind != MTProtocol::Kind::load && m.kind != MTProtocol::Kind::translate)
+                return;
+
+            {
+                const juce::ScopedLock sl(queueLock);
+                queue.push_back(std::move(m));
+            }
+            wakeUp.signal();
+        }
+
+        void handleConnectionLost() override
+        {
+            finished.signal();
+        }
+
+    private:
+        void run() override
+        {
+            std::vector<MTProtocol::Message> batch;
+
+            while (!threadShouldExit())
+            {
+                wakeUp.wait(100);
+
+                // Short gather window so requests posted back-to-back share one batch
+                if (hasQueued())
+                    wait(batchWindowMs);
+
+                for (;;)
+                {
+                    batch.clear();
+                    MTProtocol::Message load;
+                    bool haveLoad = false;
+
+                    {
+                        const juce::ScopedLock sl(queueLock);
+                        while (!queue.empty() && (int)batch.size() < maxBatch)
+                        {
+                            if (queue.front().kind == MTProtocol::Kind::load)
+                            {
+                                // Keep ordering: translate what came before the load first
+                                if (batch.empty())
+                                {
+                                    load = std::move(queue.front());
+                                    queue.pop_front();
+                                    haveLoad = true;
+                                }
+                                break;
+                            }
+
+                            batch.push_back(std::move(queue.front()));
+                            queue.pop_front();
+                        }
+                    }
+
+                    if (haveLoad)
+                        loadModel(load.text);
+                    else if (!batch.empty())
+                        translateBatch(batch);
+                    else
+                        break;
+                }
+            }
+        }
+
+        bool hasQueued()
+        {
+            const juce::ScopedLock sl(queueLock);
+            return !queue.empty();
+        }
+
+        void log(const juce::String& s)
+        {
+            sendMessageToCoordinator(MTProtocol::makeLog(s));
+        }
+
+        void loadModel(const juce::String& modelDir)
+        {
+            translator.reset();
+            echo = modelDir == MTProtocol::echoModel;
+
+            if (echo)
+            {
+                sendMessageToCoordinator(MTProtocol::makeReady(true, "echo stub"));
+                return;
+            }
+
+            char errorBuf[512] = {};
+            auto* created = marianCreateTranslator(modelDir.toRawUTF8(), errorBuf, (int)sizeof(errorBuf));
+
+            if (created == nullptr)
+            {
+                sendMessageToCoordinator(MTProtocol::makeReady(false, juce::String(errorBuf)));
+                return;
+            }
+
+            translator.reset(created);
+            sendMessageToCoordinator(MTProtocol::makeReady(true, modelDir));
+        }
+
+        void translateBatch(const std::vector<MTProtocol::Message>& requests)
+        {
+            if (echo || translator == nullptr)
+            {
+                for (auto& r : requests)
+                    sendMessageToCoordinator(MTProtocol::makeResult(r.id, echo, 0, r.text));
+                return;
+            }
+
+            std::vector<std::string> src, dst;
+            std::vector<int> tokens;
+            src.reserve(requests.size());
+            for (auto& r : requests)
+                src.push_back(r.text.toStdString());
+
+            const bool ok = marianTranslateBatch(translator.get(), src, dst, [this](const juce::String& s) { log(s); }, &tokens);
+
+            for (size_t i = 0; i < requests.size(); ++i)
+            {
+                const bool itemOk = ok && i < dst.size() && !dst[i].empty();
+                sendMessageToCoordinator(MTProtocol::makeResult(requests[i].id, itemOk,
+                    itemOk ? tokens[i] : 0,
+                    itemOk ? juce::String::fromUTF8(dst[i].c_str()) : requests[i].text));
+            }
+        }
+
+        struct TranslatorDeleter { void operator()(MarianTranslator* t) const { marianDestroyTranslator(t); } };
+
+        juce::CriticalSection queueLock;
+        std::deque<MTProtocol::Message> queue;
+        juce::WaitableEvent wakeUp;
+
+        std::unique_ptr<MarianTranslator, TranslatorDeleter> translator;
+        bool echo = false;
+    };
+}
+
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInit;
+
+    juce::String commandLine;
+    for (int i = 1; i < argc; ++i)
+        commandLine << argv[i] << ' ';
+
+    MTWorkerProcess worker;
+
+    // Ping timeout: exit on our own if the host dies without closing the pipe
+    if (!worker.initialiseFromCommandLine(commandLine, MTProtocol::commandLineUID, 10000))
+    {
+        std::fprintf(stderr, "WhisperFreeWinMTWorker: launched by the WhisperFreeWin plugin only\n");
+        return 1;
+    }
+
+    worker.finished.wait();
+    return 0;
+}
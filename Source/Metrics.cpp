@@ -0,0 +1,255 @@
+// Source/Metrics.cpp
+#include "Metrics.h"
+
+// ==== Histogram ====
+
+int Metrics::Histogram::bucketIndex(juce::uint64 v) noexcept
+{
+    if (v < (juce::uint64)subBuckets)
+        return (int)v;
+
+    // position of the highest set bit
+    int msb = 0;
+    for (auto x = v; x > 1; x >>= 1)
+        ++msb;
+
+    if (msb > maxExponent)
+        return numBuckets - 1;
+
+    const int shift = msb - subBucketBits;
+    const int mantissa = (int)((v >> shift) & (juce::uint64)(subBuckets - 1));
+    return subBuckets + shift * subBuckets + mantissa;
+}
+
+juce::uint64 Metrics::Histogram::bucketLowerBound(int index) noexcept
+{
+    if (index < subBuckets)
+        return (juce::uint64)index;
+
+    const int shift = (index - subBuckets) / subBuckets;
+    const int mantissa = (index - subBuckets) % subBuckets;
+    return ((juce::uint64)(subBuckets + mantissa)) << shift;
+}
+
+juce::uint64 Metrics::Histogram::bucketWidth(int index) noexcept
+{
+    if (index < subBuckets)
+        return 1;
+
+    return (juce::uint64)1 << ((index - subBuckets) / subBuckets);
+}
+
+void Metrics::Histogram::record(juce::int64 micros) noexcept
+{
+    const auto v = (juce::uint64)juce::jmax((juce::int64)0, micros);
+    buckets[(size_t)bucketIndex(v)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add((juce::int64)v, std::memory_order_relaxed);
+
+    auto cur = maxValue.load(std::memory_order_relaxed);
+    while ((juce::int64)v > cur && !maxValue.compare_exchange_weak(cur, (juce::int64)v, std::memory_order_relaxed)) {}
+
+    cur = minValue.load(std::memory_order_relaxed);
+    while ((juce::int64)v < cur && !minValue.compare_exchange_weak(cur, (juce::int64)v, std::memory_order_relaxed)) {}
+}
+
+void Metrics::Histogram::reset() noexcept
+{
+    for (auto& b : buckets)
+        b.store(0, std::memory_order_relaxed);
+
+    count.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    minValue.store(std::numeric_limits<juce::int64>::max(), std::memory_order_relaxed);
+    maxValue.store(0, std::memory_order_relaxed);
+}
+
+Metrics::Histogram::Snapshot Metrics::Histogram::snapshot() const noexcept
+{
+    Snapshot s;
+
+    // Copy the buckets first; percentiles are computed from this copy so they are
+    // self-consistent even while other threads keep recording.
+    std::array<juce::uint64, numBuckets> copy;
+    juce::uint64 total = 0;
+    for (size_t i = 0; i < copy.size(); ++i)
+    {
+        copy[i] = buckets[i].load(std::memory_order_relaxed);
+        total += copy[i];
+    }
+
+    s.count = (juce::int64)total;
+    s.sumUs = sum.load(std::memory_order_relaxed);
+    s.maxUs = maxValue.load(std::memory_order_relaxed);
+    s.minUs = total > 0 ? minValue.load(std::memory_order_relaxed) : 0;
+
+    if (total == 0)
+        return s;
+
+    auto valueAt = [&](double q)
+        {
+            const auto target = (juce::uint64)std::ceil(q * (double)total);
+            juce::uint64 seen = 0;
+            for (int i = 0; i < numBuckets; ++i)
+            {
+                seen += copy[(size_t)i];
+                if (seen >= juce::jmax((juce::uint64)1, target))
+                {
+                    // midpoint of the bucket, clamped to the observed max
+                    const double mid = (double)bucketLowerBound(i) + (double)(bucketWidth(i) - 1) * 0.5;
+                    return juce::jmin(mid, (double)s.maxUs);
+                }
+            }
+            return (double)s.maxUs;
+        };
+
+    s.p50Us  = valueAt(0.50);
+    s.p90Us  = valueAt(0.90);
+    s.p99Us  = valueAt(0.99);
+    s.p999Us = valueAt(0.999);
+    return s;
+}
+
+// ==== Metrics ====
+
+Metrics& Metrics::get()
+{
+    static Metrics instance;
+    return instance;
+}
+
+Metrics::Snapshot Metrics::snapshot() const
+{
+    Snapshot s;
+    s.time = juce::Time::getCurrentTime();
+
+    for (size_t i = 0; i < histograms.size(); ++i)
+        s.stages[i] = histograms[i].snapshot();
+
+    for (size_t i = 0; i < counters.size(); ++i)
+        s.counters[i] = counters[i].load(std::memory_order_relaxed);
+
+    return s;
+}
+
+void Metrics::reset()
+{
+    for (auto& h : histograms)
+        h.reset();
+
+    for (auto& c : counters)
+        c.store(0, std::memory_order_relaxed);
+}
+
+const char* Metrics::getName(Stage s) noexcept
+{
+    switch (s)
+    {
+        case Stage::queueWait:      return "queue_wait";
+        case Stage::resample:       return "resample";
+        case Stage::mel:            return "mel";
+        case Stage::encode:         return "encode";
+        case Stage::decode:         return "decode";
+        case Stage::sentencePiece:  return "sentencepiece";
+        case Stage::ct2Decode:      return "ct2_decode";
+        case Stage::uiDelivery:     return "ui_delivery";
+        case Stage::numStages:      break;
+    }
+    return "unknown";
+}
+
+const char* Metrics::getName(Counter c) noexcept
+{
+    switch (c)
+    {
+        case Counter::jobsQueued:     return "jobs_queued";
+        case Counter::jobsCompleted:  return "jobs_completed";
+        case Counter::jobsFailed:     return "jobs_failed";
+        case Counter::jobsEmpty:      return "jobs_empty";
+        case Counter::drops:          return "drops";
+        case Counter::cancelled:      return "jobs_cancelled";
+        case Counter::overloadSteps:  return "overload_steps";
+        case Counter::fallbacksCut:   return "fallbacks_cut";
+        case Counter::cacheHits:      return "cache_hits";
+        case Counter::cacheMisses:    return "cache_misses";
+        case Counter::numCounters:    break;
+    }
+    return "unknown";
+}
+
+juce::var Metrics::toJson(const Snapshot& s)
+{
+    juce::DynamicObject::Ptr stages = new juce::DynamicObject();
+    for (size_t i = 0; i < s.stages.size(); ++i)
+    {
+        const auto& h = s.stages[i];
+        juce::DynamicObject::Ptr o = new juce::DynamicObject();
+        o->setProperty("count", h.count);
+        o->setProperty("sum_us", h.sumUs);
+        o->setProperty("min_us", h.minUs);
+        o->setProperty("max_us", h.maxUs);
+        o->setProperty("p50_us", h.p50Us);
+        o->setProperty("p90_us", h.p90Us);
+        o->setProperty("p99_us", h.p99Us);
+        o->setProperty("p999_us", h.p999Us);
+        stages->setProperty(getName((Stage)i), juce::var(o.get()));
+    }
+
+    juce::DynamicObject::Ptr counters = new juce::DynamicObject();
+    for (size_t i = 0; i < s.counters.size(); ++i)
+        counters->setProperty(getName((Counter)i), s.counters[i]);
+
+    juce::DynamicObject::Ptr root = new juce::DynamicObject();
+    root->setProperty("time", s.time.toISO8601(true));
+    root->setProperty("stages", juce::var(stages.get()));
+    root->setProperty("counters", juce::var(counters.get()));
+    return juce::var(root.get());
+}
+
+// ==== MetricsDumper ====
+
+void MetricsDumper::start(const juce::File& target, int intervalMs)
+{
+    stop();
+
+    file = target;
+    interval = juce::jmax(100, intervalMs);
+    startThread();
+}
+
+void MetricsDumper::stop()
+{
+    if (isThreadRunning())
+    {
+        signalThreadShouldExit();
+        notify();
+        stopThread(2000);
+    }
+}
+
+bool MetricsDumper::dumpTo(const juce::File& target)
+{
+    const auto text = juce::JSON::toString(Metrics::toJson(Metrics::get().snapshot()), false);
+
+    juce::TemporaryFile tmp(target);
+    if (!tmp.getFile().replaceWithText(text))
+        return false;
+
+    return tmp.overwriteTargetFileWithTemporary();
+}
+
+void MetricsDumper::run()
+{
+    while (!threadShouldExit())
+    {
+        wait(interval);
+
+        if (threadShouldExit())
+            break;
+
+        dumpTo(file);
+    }
+
+    // Final snapshot so short sessions still leave something behind
+    dumpTo(file);
+}
@@ -0,0 +1,151 @@
+// Source/Metrics.h
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+/** Process-wide latency histograms and counters for the ASR/MT pipeline.
+ *  Recording is lock-free and allocation-free, so it is safe from the worker
+ *  threads; snapshot() can be called from anywhere.
+ */
+class Metrics
+{
+public:
+    enum class Stage
+    {
+        queueWait,      // WhisperThread queue: enqueue -> dequeue
+        resample,       // resampleTo16k
+        mel,            // whisper log-mel (from whisper's own state timings)
+        encode,         // whisper encoder
+        decode,         // whisper decoder incl. prompt/batched calls
+        sentencePiece,  // SentencePiece encode + decode
+        ct2Decode,      // CTranslate2 translate_batch
+        uiDelivery,     // worker post -> UI sink invoked
+        numStages
+    };
+
+    enum class Counter
+    {
+        jobsQueued,
+        jobsCompleted,
+        jobsFailed,
+        jobsEmpty,      // ran without error but produced no text (silence, noise)
+        drops,          // work discarded before it ran (flushed/superseded/shed)
+        cancelled,      // jobs aborted through their JobHandle, queued or mid-run
+        overloadSteps,  // times an OverloadController escalated a degradation step
+        fallbacksCut,   // whisper windows that stopped temperature fallback at the decode budget
+        cacheHits,      // reused pooled decoder states, cached artifacts
+        cacheMisses,
+        numCounters
+    };
+
+    /** HDR-style histogram of microsecond values: 16 linear sub-buckets per
+     *  power of two (~6% worst-case relative error), all atomics.
+     */
+    class Histogram
+    {
+    public:
+        static constexpr int subBucketBits  = 4;
+        static constexpr int subBuckets     = 1 << subBucketBits;
+        static constexpr int maxExponent    = 40;  // ~12.7 days in microseconds
+        static constexpr int numBuckets     = subBuckets + (maxExponent - subBucketBits + 1) * subBuckets;
+
+        void record(juce::int64 micros) noexcept;
+        void reset() noexcept;
+
+        juce::int64 getCount() const noexcept { return count.load(std::memory_order_relaxed); }
+
+        struct Snapshot
+        {
+            juce::int64 count = 0, sumUs = 0, minUs = 0, maxUs = 0;
+            double p50Us = 0, p90Us = 0, p99Us = 0, p999Us = 0;
+        };
+
+        Snapshot snapshot() const noexcept;
+
+        static int bucketIndex(juce::uint64 v) noexcept;
+        static juce::uint64 bucketLowerBound(int index) noexcept;
+        static juce::uint64 bucketWidth(int index) noexcept;
+
+    private:
+        std::array<std::atomic<juce::uint64>, numBuckets> buckets{};
+        std::atomic<juce::int64> count{ 0 }, sum{ 0 };
+        std::atomic<juce::int64> minValue{ std::numeric_limits<juce::int64>::max() }, maxValue{ 0 };
+    };
+
+    struct Snapshot
+    {
+        juce::Time time;
+        std::array<Histogram::Snapshot, (size_t)Stage::numStages> stages;
+        std::array<juce::int64, (size_t)Counter::numCounters> counters{};
+    };
+
+    static Metrics& get();
+
+    void record(Stage s, double milliseconds) noexcept { recordMicros(s, (juce::int64)(milliseconds * 1000.0)); }
+    void recordMicros(Stage s, juce::int64 micros) noexcept { histograms[(size_t)s].record(micros); }
+    void increment(Counter c, juce::int64 n = 1) noexcept { counters[(size_t)c].fetch_add(n, std::memory_order_relaxed); }
+
+    // Counter for one finished ASR job: silence is an empty success, not a failure
+    static constexpr Counter jobOutcome(bool succeeded, bool hasText) noexcept
+    {
+        return !succeeded ? Counter::jobsFailed : hasText ? Counter::jobsCompleted : Counter::jobsEmpty;
+    }
+
+    Snapshot snapshot() const;
+    void reset();
+
+    static const char* getName(Stage s) noexcept;
+    static const char* getName(Counter c) noexcept;
+    static juce::var toJson(const Snapshot& s);
+
+    /** Records the lifetime of the scope into a stage. */
+    class ScopedTimer
+    {
+    public:
+        explicit ScopedTimer(Stage s) noexcept : stage(s), start(juce::Time::getHighResolutionTicks()) {}
+        ~ScopedTimer()
+        {
+            const auto ticks = juce::Time::getHighResolutionTicks() - start;
+            Metrics::get().recordMicros(stage, (juce::int64)(juce::Time::highResolutionTicksToSeconds(ticks) * 1.0e6));
+        }
+    private:
+        Stage stage;
+        juce::int64 start;
+        JUCE_DECLARE_NON_COPYABLE(ScopedTimer)
+    };
+
+private:
+    Metrics() = default;
+
+    std::array<Histogram, (size_t)Stage::numStages> histograms;
+    std::array<std::atomic<juce::int64>, (size_t)Counter::numCounters> counters{};
+
+    JUCE_DECLARE_NON_COPYABLE(Metrics)
+};
+
+/** Writes Metrics snapshots as JSON to a file every intervalMs.
+ *  The file is replaced atomically, so readers never see a partial dump.
+ */
+class MetricsDumper : private juce::Thread
+{
+public:
+    MetricsDumper() : juce::Thread("MetricsDumper") {}
+    ~MetricsDumper() override { stop(); }
+
+    void start(const juce::File& target, int intervalMs);
+    void stop();
+    bool isDumping() const { return isThreadRunning(); }
+
+    // One-off dump, e.g. on shutdown
+    static bool dumpTo(const juce::File& target);
+
+private:
+    void run() override;
+
+    juce::File file;
+    int interval = 5000;
+};
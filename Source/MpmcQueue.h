@@ -0,0 +1,121 @@
+// Source/MpmcQueue.h
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+/** Bounded lock-free multi-producer/multi-consumer queue (Vyukov's sequence ring).
+ *  Push and pop never block or allocate; a full queue makes tryPush() return false
+ *  and leaves the decision (drop, retry, coalesce) to the caller.
+ *  T must be default-constructible and move-assignable.
+ */
+template <typename T>
+class MpmcQueue
+{
+public:
+    explicit MpmcQueue(size_t minCapacity)
+        : mask(roundUpToPowerOfTwo(minCapacity < 2 ? 2 : minCapacity) - 1),
+          cells(new Cell[mask + 1])
+    {
+        for (size_t i = 0; i <= mask; ++i)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    bool tryPush(T&& value) noexcept { return emplace(std::move(value)); }
+    bool tryPush(const T& value)     { T copy(value); return emplace(std::move(copy)); }
+
+    bool tryPop(T& out) noexcept
+    {
+        auto pos = dequeuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            auto& cell = cells[pos & mask];
+            const auto seq = cell.sequence.load(std::memory_order_acquire);
+            const auto diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)(pos + 1);
+
+            if (diff == 0)
+            {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    out = std::move(cell.data);
+                    cell.data = T();
+                    cell.sequence.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // empty
+            }
+            else
+            {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    size_t capacity() const noexcept { return mask + 1; }
+
+    // Racy by nature; good enough for metering and overload decisions
+    size_t approximateSize() const noexcept
+    {
+        const auto e = enqueuePos.load(std::memory_order_relaxed);
+        const auto d = dequeuePos.load(std::memory_order_relaxed);
+        return e > d ? e - d : 0;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence{ 0 };
+        T data{};
+    };
+
+    bool emplace(T&& value) noexcept
+    {
+        auto pos = enqueuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            auto& cell = cells[pos & mask];
+            const auto seq = cell.sequence.load(std::memory_order_acquire);
+            const auto diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)pos;
+
+            if (diff == 0)
+            {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.data = std::move(value);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // full
+            }
+            else
+            {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    static size_t roundUpToPowerOfTwo(size_t n) noexcept
+    {
+        size_t p = 1;
+        while (p < n)
+            p <<= 1;
+        return p;
+    }
+
+    const size_t mask;
+    std::unique_ptr<Cell[]> cells;
+
+    alignas(64) std::atomic<size_t> enqueuePos{ 0 };
+    alignas(64) std::atomic<size_t> dequeuePos{ 0 };
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+};
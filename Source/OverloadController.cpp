@@ -0,0 +1,134 @@
+// Source/OverloadController.cpp
+#include "OverloadController.h"
+#include "Metrics.h"
+
+namespace
+{
+    const char* stepName(OverloadController::Step s)
+    {
+        switch (s)
+        {
+            case OverloadController::Step::shortenWindows: return "shortenWindows";
+            case OverloadController::Step::fastDecode:     return "fastDecode";
+            case OverloadController::Step::smallerModel:   return "smallerModel";
+            case OverloadController::Step::dropNonSpeech:  return "dropNonSpeech";
+        }
+        return "?";
+    }
+}
+
+void OverloadController::setPolicy(const Policy& p)
+{
+    std::lock_guard<std::mutex> lg(lock);
+    policy = p;
+    minSpeechRms = p.minSpeechRms;
+    smoothedRtf = smoothedAgeMs = 0.0;
+    jobsSinceChange = 0;
+    primed = false;
+    applyLevel(0);
+}
+
+OverloadController::Policy OverloadController::getPolicy() const
+{
+    std::lock_guard<std::mutex> lg(lock);
+    return policy;
+}
+
+void OverloadController::reset()
+{
+    setPolicy(getPolicy());
+}
+
+bool OverloadController::jobFinished(double audioSeconds, double queueAgeMs, double processingMs)
+{
+    if (audioSeconds <= 0.0)
+        return false;
+
+    std::lock_guard<std::mutex> lg(lock);
+
+    // Smoothed over the last few jobs; the first one seeds it
+    const double jobRtf = processingMs / (audioSeconds * 1000.0);
+    constexpr double alpha = 0.3;
+    smoothedRtf = primed ? smoothedRtf + alpha * (jobRtf - smoothedRtf) : jobRtf;
+    smoothedAgeMs = primed ? smoothedAgeMs + alpha * (queueAgeMs - smoothedAgeMs) : queueAgeMs;
+    primed = true;
+    rtf = smoothedRtf;
+
+    if (++jobsSinceChange < juce::jmax(1, policy.holdJobs))
+        return false;
+
+    const int current = level.load();
+    const bool overloaded = smoothedRtf > policy.escalateRtf || smoothedAgeMs > policy.maxQueueAgeMs;
+    const bool idle = smoothedRtf < policy.relaxRtf && smoothedAgeMs < policy.maxQueueAgeMs * 0.25;
+
+    if (overloaded && current < (int)policy.steps.size())
+    {
+        applyLevel(current + 1);
+        Metrics::get().increment(Metrics::Counter::overloadSteps);
+        return true;
+    }
+
+    if (idle && current > 0)
+    {
+        applyLevel(current - 1);
+        return true;
+    }
+
+    return false;
+}
+
+void OverloadController::applyLevel(int newLevel)
+{
+    unsigned mask = 0;
+    for (int i = 0; i < newLevel && i < (int)policy.steps.size(); ++i)
+        mask |= 1u << (unsigned)policy.steps[(size_t)i];
+
+    activeMask = mask;
+    level = newLevel;
+    jobsSinceChange = 0;
+}
+
+WhisperEngine::JobOptions OverloadController::getJobOptions() const noexcept
+{
+    WhisperEngine::JobOptions o;
+    o.trimAudioContext = isActive(Step::shortenWindows);
+    o.fastDecode = isActive(Step::fastDecode);
+    o.useFallbackModel = isActive(Step::smallerModel);
+    return o;
+}
+
+bool OverloadController::shouldTranscribe(const juce::AudioBuffer<float>& mono) const
+{
+    if (!isActive(Step::dropNonSpeech) || mono.getNumSamples() <= 0)
+        return true;
+
+    return mono.getRMSLevel(0, 0, mono.getNumSamples()) >= minSpeechRms.load();
+}
+
+juce::String OverloadController::describe() const
+{
+    juce::StringArray active;
+    for (auto s : { Step::shortenWindows, Step::fastDecode, Step::smallerModel, Step::dropNonSpeech })
+        if (isActive(s))
+            active.add(stepName(s));
+
+    return active.isEmpty() ? juce::String("normal") : active.joinIntoString("+");
+}
+
+OverloadController::Policy OverloadController::policyFromString(const juce::String& s)
+{
+    Policy p;
+    if (s.trim().isEmpty())
+        return p;
+
+    p.steps.clear();
+    for (auto token : juce::StringArray::fromTokens(s, ",", {}))
+    {
+        token = token.trim().toLowerCase();
+        if (token == "shorten")     p.steps.push_back(Step::shortenWindows);
+        else if (token == "fast")   p.steps.push_back(Step::fastDecode);
+        else if (token == "small")  p.steps.push_back(Step::smallerModel);
+        else if (token == "speech") p.steps.push_back(Step::dropNonSpeech);
+    }
+    return p;
+}
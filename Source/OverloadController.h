@@ -0,0 +1,84 @@
+// Source/OverloadController.h
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "WhisperEngine.h"
+
+/** Degrades ASR step by step while it can't keep up, and undoes it when it can.
+ *
+ *  Callers report every finished job: how much audio it held, how long it waited
+ *  in the queue and how long it took. From that the controller keeps a smoothed
+ *  real-time factor (processing time / audio time). Above escalateRtf, or with a
+ *  queue older than maxQueueAgeMs, it turns on the next step of the policy; below
+ *  relaxRtf with a short queue it turns the last one off again. At least holdJobs
+ *  jobs pass between changes, and the gap between the two thresholds keeps it
+ *  from flapping, since the degraded jobs themselves run faster.
+ */
+class OverloadController
+{
+public:
+    enum class Step
+    {
+        shortenWindows,     // shorter live segments, encoder context trimmed to the audio (live only)
+        fastDecode,         // best_of 1, no temperature fallback
+        smallerModel,       // the engine's fallback model, if loaded
+        dropNonSpeech       // skip live segments below minSpeechRms instead of transcribing them
+    };
+
+    struct Policy
+    {
+        std::vector<Step> steps{ Step::shortenWindows, Step::fastDecode, Step::smallerModel, Step::dropNonSpeech };
+        double escalateRtf   = 0.9;
+        double relaxRtf      = 0.5;
+        double maxQueueAgeMs = 3000.0;
+        int    holdJobs      = 3;
+        float  minSpeechRms  = 0.005f;  // about -46 dBFS
+    };
+
+    OverloadController() = default;
+
+    // Replaces the policy and returns to normal operation
+    void setPolicy(const Policy& p);
+    Policy getPolicy() const;
+
+    // Reports one finished job; true if the level changed as a result
+    bool jobFinished(double audioSeconds, double queueAgeMs, double processingMs);
+
+    void reset();
+
+    // Number of policy steps currently applied (0 = normal)
+    int getLevel() const noexcept { return level.load(); }
+    bool isActive(Step s) const noexcept { return (activeMask.load() & (1u << (unsigned)s)) != 0; }
+    double getRealTimeFactor() const noexcept { return rtf.load(); }
+
+    // Engine settings for the next job at the current level
+    WhisperEngine::JobOptions getJobOptions() const noexcept;
+
+    // False if the segment should be skipped at the current level
+    bool shouldTranscribe(const juce::AudioBuffer<float>& mono) const;
+
+    // "normal", or the active steps, e.g. "shortenWindows+fastDecode"
+    juce::String describe() const;
+
+    // Policy from a comma-separated step list ("shorten,fast,small,speech"); "off" = no steps
+    static Policy policyFromString(const juce::String& s);
+
+private:
+    void applyLevel(int newLevel);
+
+    mutable std::mutex lock;
+    Policy policy;
+    double smoothedRtf = 0.0, smoothedAgeMs = 0.0;   // guarded by lock
+    int jobsSinceChange = 0;
+    bool primed = false;
+
+    std::atomic<int> level{ 0 };
+    std::atomic<unsigned> activeMask{ 0 };
+    std::atomic<double> rtf{ 0.0 };
+    std::atomic<float> minSpeechRms{ 0.005f };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(OverloadController)
+};
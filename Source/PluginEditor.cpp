@@ -1,9 +1,19 @@
 // Source/PluginEditor.cpp
 #include "PluginEditor.h"
 
+static juce::File spillFileFor(const juce::String& kind)
+{
+    return juce::File::getSpecialLocation(juce::File::tempDirectory)
+        .getChildFile("WhisperFreeWin")
+        .getNonexistentChildFile(kind + "-" + juce::String(juce::Time::currentTimeMillis()), ".txt");
+}
+
 WhisperFreeWinAudioProcessorEditor::WhisperFreeWinAudioProcessorEditor(WhisperFreeWinAudioProcessor& p)
     : AudioProcessorEditor(&p),
     processor(p),
+    logBox(16 * TextLineStore::linesPerChunk, spillFileFor("log")),
+    transcriptBox(16 * TextLineStore::linesPerChunk, spillFileFor("transcript")),
+    translationBox(16 * TextLineStore::linesPerChunk, spillFileFor("translation")),
     progressBar(progressValue)
 {
     setSize(900, 500);
@@ -28,32 +38,26 @@ WhisperFreeWinAudioProcessorEditor::WhisperFreeWinAudioProcessorEditor(WhisperFr
             processor.setAutoTranslate(autoTranslateToggle.getToggleState());
         };
 
-    logBox.setMultiLine(true);
-    logBox.setReadOnly(true);
-    logBox.setScrollbarsShown(true);
     logBox.setFont(juce::Font(13.0f));
-    logBox.setColour(juce::TextEditor::backgroundColourId, juce::Colours::black);
-    logBox.setColour(juce::TextEditor::textColourId, juce::Colours::lawngreen);
+    logBox.setColour(VirtualTextView::backgroundColourId, juce::Colours::black);
+    logBox.setColour(VirtualTextView::textColourId, juce::Colours::lawngreen);
     addAndMakeVisible(logBox);
 
-    transcriptBox.setMultiLine(true);
-    transcriptBox.setReadOnly(true);
-    transcriptBox.setScrollbarsShown(true);
     transcriptBox.setFont(juce::Font(14.0f));
+    transcriptBox.setWrapColumn(60);
     addAndMakeVisible(transcriptBox);
 
-    translationBox.setMultiLine(true);
-    translationBox.setReadOnly(true);
-    translationBox.setScrollbarsShown(true);
     translationBox.setFont(juce::Font(14.0f));
+    translationBox.setWrapColumn(60);
     addAndMakeVisible(translationBox);
 
+    partialLine.setFont(juce::Font(14.0f, juce::Font::italic));
+    partialLine.setColour(juce::Label::textColourId, juce::Colours::lightgrey);
+    addAndMakeVisible(partialLine);
+
     addAndMakeVisible(progressBar);
 
-    processor.setLogSink([this](const juce::String& s) { appendLog(s); });
-    processor.setTranscriptSink([this](const juce::String& t) { setTranscript(t); });
-    processor.setTranslationSink([this](const juce::String& t) { setTranslation(t); });
-    processor.setProgressSink([this](double p) { setProgress(p); });
+    startTimerHz(30);
 }
 
 void WhisperFreeWinAudioProcessorEditor::paint(juce::Graphics& g)
@@ -82,7 +86,9 @@ void WhisperFreeWinAudioProcessorEditor::resized()
     logBox.setBounds(bottom);
 
     auto half = area;
-    transcriptBox.setBounds(half.removeFromLeft(half.getWidth() / 2).reduced(4));
+    auto left = half.removeFromLeft(half.getWidth() / 2);
+    partialLine.setBounds(left.removeFromBottom(22).reduced(4, 0));
+    transcriptBox.setBounds(left.reduced(4));
     translationBox.setBounds(half.reduced(4));
 }
 
@@ -122,7 +128,7 @@ void WhisperFreeWinAudioProcessorEditor::buttonClicked(juce::Button* b)
                 auto f = fc.getResult();
                 if (f.existsAsFile())
                 {
-                    processor.loadWhisperModel(f);
+                    processor.requestWhisperModelLoad(f);
                 }
             });
     }
@@ -135,30 +141,44 @@ void WhisperFreeWinAudioProcessorEditor::buttonClicked(juce::Button* b)
                 auto dir = fc.getResult();
                 if (dir.isDirectory())
                 {
-                    processor.loadMarianModel(dir);
+                    processor.requestMarianModelLoad(dir);
                 }
             });
     }
 }
 
-void WhisperFreeWinAudioProcessorEditor::appendLog(const juce::String& s)
+void WhisperFreeWinAudioProcessorEditor::timerCallback()
 {
-    logBox.moveCaretToEnd();
-    logBox.insertTextAtCaret(
-        "[" + juce::Time::getCurrentTime().formatted("%H:%M:%S") + "] " + s + "\n");
-}
+    WFW_TRACE_SCOPE("ui", "drainUiEvents");
 
-void WhisperFreeWinAudioProcessorEditor::setTranscript(const juce::String& s)
-{
-    transcriptBox.setText(s);
-}
+    const auto batch = processor.getUiEvents().drain();
 
-void WhisperFreeWinAudioProcessorEditor::setTranslation(const juce::String& s)
-{
-    translationBox.setText(s);
-}
+    if (batch.hasProgress)
+        progressValue = batch.progress;
 
-void WhisperFreeWinAudioProcessorEditor::setProgress(double p)
-{
-    progressValue = p;
+    // One append per view per frame however many lines arrived
+    if (batch.logText.isNotEmpty())
+        logBox.append(batch.logText);
+
+    if (batch.hasTranscript)
+        transcriptBox.append(batch.transcript);
+
+    if (batch.hasTranslation)
+        translationBox.append(batch.translation);
+
+    if (!batch.partials.empty())
+    {
+        for (const auto& [channel, text] : batch.partials)
+        {
+            if (text.isEmpty())
+                livePartials.erase(channel);
+            else
+                livePartials[channel] = text;
+        }
+
+        juce::StringArray lines;
+        for (const auto& p : livePartials)
+            lines.add(p.second);
+        partialLine.setText(lines.joinIntoString("  "), juce::dontSendNotification);
+    }
 }
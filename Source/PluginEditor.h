@@ -3,9 +3,11 @@
 
 #include <juce_gui_extra/juce_gui_extra.h>
 #include "PluginProcessor.h"
+#include "VirtualTextView.h"
 
 class WhisperFreeWinAudioProcessorEditor : public juce::AudioProcessorEditor,
-    public juce::Button::Listener
+    public juce::Button::Listener,
+    private juce::Timer
 {
 public:
     explicit WhisperFreeWinAudioProcessorEditor(WhisperFreeWinAudioProcessor&);
@@ -27,17 +29,20 @@ private:
 
     juce::ToggleButton autoTranslateToggle{ "Auto translate (de→en)" };
 
-    juce::TextEditor logBox;
-    juce::TextEditor transcriptBox;
-    juce::TextEditor translationBox;
+    // Bounded, append-only views; older lines spill to temp files
+    VirtualTextView logBox;
+    VirtualTextView transcriptBox;
+    VirtualTextView translationBox;
+
+    // Two-tier live mode: the newest partial per channel, until its final lands
+    juce::Label partialLine;
+    std::map<int, juce::String> livePartials;
 
     double progressValue = 0.0;
     juce::ProgressBar progressBar;
 
-    void appendLog(const juce::String& s);
-    void setTranscript(const juce::String& s);
-    void setTranslation(const juce::String& s);
-    void setProgress(double p);
+    // Drains the processor's UiEventQueue once per frame
+    void timerCallback() override;
     std::unique_ptr<juce::FileChooser> chooser;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WhisperFreeWinAudioProcessorEditor)
@@ -2,12 +2,149 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
+namespace
+{
+    // Archives one ingested buffer; tagged with its owner so the destructor can wait for it
+    class FlacIngestJob : public juce::ThreadPoolJob
+    {
+    public:
+        FlacIngestJob(const void* o, const FlacCaptureSink::Options& opts, const juce::AudioBuffer<float>& mono,
+            std::function<void(const juce::String&)> log)
+            : juce::ThreadPoolJob("FlacIngest"), owner(o), options(opts), audio(mono), logFn(std::move(log)) {}
+
+        JobStatus runJob() override
+        {
+            FlacCaptureSink sink(options, logFn);
+            const float* ch = audio.getReadPointer(0);
+            sink.write(&ch, audio.getNumSamples());
+            sink.finish();
+            return jobHasFinished;
+        }
+
+        const void* const owner;
+
+    private:
+        FlacCaptureSink::Options options;
+        juce::AudioBuffer<float> audio;
+        std::function<void(const juce::String&)> logFn;
+    };
+
+    struct IngestJobsOf : juce::ThreadPool::JobSelector
+    {
+        explicit IngestJobsOf(const void* o) : owner(o) {}
+        bool isJobSuitable(juce::ThreadPoolJob* job) override
+        {
+            auto* j = dynamic_cast<FlacIngestJob*>(job);
+            return j != nullptr && j->owner == owner;
+        }
+        const void* owner;
+    };
+}
+
 WhisperFreeWinAudioProcessor::WhisperFreeWinAudioProcessor()
     : AudioProcessor(BusesProperties()
         .withOutput("Output", juce::AudioChannelSet::stereo(), true))
 {
     formatManager.registerBasicFormats();
 
+   #if WFW_ENABLE_TRACE
+    Trace::installWhisperHooks();
+   #endif
+
+    // The worker lives for the whole session; model swaps happen underneath it
+    whisperThread = std::make_unique<WhisperThread>(
+        whisperEngine,
+        translationEngine,
+        [this](double p) { handleProgress(p); },
+        [this](const juce::String& s) { appendLog(s); },
+        [this](const juce::String& t) { handleTranscript(t); },
+        [this](const juce::String& t) { handleTranslation(t); }
+    );
+    whisperThread->startThread();
+
+    liveController.setLogCallback([this](const juce::String& s) { appendLog(s); });
+    liveController.setResultCallback([this](const TranslationController::Result& r)
+        {
+            const auto tag = "[ch" + juce::String(r.channel + 1) + "] ";
+
+            // Partials only ever occupy the channel's live line; its final clears it
+            if (!r.isFinal)
+            {
+                handlePartialTranscript(r.channel, tag + r.asr);
+                return;
+            }
+
+            handlePartialTranscript(r.channel, {});
+            if (r.asr.isEmpty())
+                return;
+
+            handleTranscript(tag + r.asr);
+            if (r.translated.isNotEmpty())
+                handleTranslation(tag + (r.whisperTranslation ? "(Whisper) " : "") + r.translated);
+        });
+    liveController.setTranslate(autoTranslate);
+
+    // WFW_TWO_TIER=1: instant partials from the fallback model, finals from the main one
+    liveController.setTwoTier(
+        juce::SystemStats::getEnvironmentVariable("WFW_TWO_TIER", "0").getIntValue() != 0);
+
+    // WFW_WHISPER_TRANSLATE=1: live segments fall back to Whisper's own English when Marian can't keep up
+    liveController.setWhisperTranslationFallback(
+        juce::SystemStats::getEnvironmentVariable("WFW_WHISPER_TRANSLATE", "0").getIntValue() != 0);
+
+    // Opt-in periodic metrics dump, e.g. WFW_METRICS_FILE=/tmp/wfw-metrics.json
+    const auto metricsPath = juce::SystemStats::getEnvironmentVariable("WFW_METRICS_FILE", {});
+    if (metricsPath.isNotEmpty() && juce::File::isAbsolutePath(metricsPath))
+        startMetricsDump(juce::File(metricsPath),
+            juce::SystemStats::getEnvironmentVariable("WFW_METRICS_INTERVAL_MS", "5000").getIntValue());
+
+    // WFW_WHISPER_QUANT=q5_1 loads Whisper models quantised (converted once, then cached)
+    whisperEngine.setQuantisation(WhisperEngine::quantisationFromName(
+        juce::SystemStats::getEnvironmentVariable("WFW_WHISPER_QUANT", {})));
+
+    // WFW_THREADPOOL=cpus=0-7,poll=1 pins the persistent ASR compute threads; "off" disables them
+    whisperEngine.setThreadPoolOptions(WhisperEngine::threadPoolOptionsFromString(
+        juce::SystemStats::getEnvironmentVariable("WFW_THREADPOOL", {})));
+
+    // WFW_MEMORY=huge=thp,numa=interleave places the ASR weights and KV caches (see MemoryPlacement)
+    whisperEngine.setMemoryPlacement(WhisperEngine::memoryPlacementFromString(
+        juce::SystemStats::getEnvironmentVariable("WFW_MEMORY", {})));
+
+    // WFW_BATCHED_DECODE=1: live channels decode in one batched graph per token step
+    whisperEngine.setBatchedDecoding(
+        juce::SystemStats::getEnvironmentVariable("WFW_BATCHED_DECODE", "0").getIntValue() != 0);
+
+    // WFW_ENCODE_BATCH=4: up to four channels' windows share one encoder graph (15 ms deadline)
+    whisperEngine.setBatchedEncoding(
+        juce::SystemStats::getEnvironmentVariable("WFW_ENCODE_BATCH", "1").getIntValue());
+
+    // WFW_DECODING=beam=5,fallbacks=2,budget=1500: decoding strategy and per-job budget
+    whisperEngine.setDecodingOptions(WhisperEngine::decodingOptionsFromString(
+        juce::SystemStats::getEnvironmentVariable("WFW_DECODING", {})));
+
+    // WFW_OVERLOAD_POLICY=fast,small picks (and orders) the steps taken while ASR falls
+    // behind real time; "off" disables it. Default: shorten,fast,small,speech
+    const auto overloadPolicy = OverloadController::policyFromString(
+        juce::SystemStats::getEnvironmentVariable("WFW_OVERLOAD_POLICY", {}));
+    liveController.getOverloadController().setPolicy(overloadPolicy);
+    whisperThread->getOverloadController().setPolicy(overloadPolicy);
+
+    // WFW_FALLBACK_MODEL=/models/ggml-tiny.bin is the "small" step's model, and with
+    // WFW_SPECULATIVE=4 also drafts four tokens per main-model decoder pass
+    whisperEngine.setSpeculativeDecoding(
+        juce::SystemStats::getEnvironmentVariable("WFW_SPECULATIVE", "0").getIntValue());
+    const auto fallbackModel = juce::SystemStats::getEnvironmentVariable("WFW_FALLBACK_MODEL", {});
+    if (fallbackModel.isNotEmpty() && juce::File::isAbsolutePath(fallbackModel))
+        modelLoader.addJob([this, file = juce::File(fallbackModel)]
+            {
+                whisperEngine.loadFallbackModel(file, [this](const juce::String& s) { appendLog(s); });
+            });
+
+    // WFW_ENGINE_PORT=47291 runs this instance as a client of a shared engine daemon
+    const auto enginePort = juce::SystemStats::getEnvironmentVariable("WFW_ENGINE_PORT", {});
+    if (enginePort.isNotEmpty())
+        connectToEngineService(enginePort.getIntValue());
+
     // Optional: auto-init Marian with your fixed model path.
     // juce::String err;
     // auto modelDir = juce::File("D:/Models/opus-mt-de-en");
@@ -22,19 +159,50 @@ WhisperFreeWinAudioProcessor::~WhisperFreeWinAudioProcessor()
     transport.setSource(nullptr);
     readerSource.reset();
 
+    metricsDumper.stop();
+    liveController.stop();
+    disconnectEngineService();
+    stopRecording();
+    stopArchive();
+
+    IngestJobsOf ingestJobs(this);
+    AudioBlockOps::getWorkerPool().removeAllJobs(false, 30000, &ingestJobs);
+
+   #if WFW_ENABLE_TRACE
+    // WFW_TRACE_FILE=/tmp/wfw-trace.json leaves a timeline of the whole session behind
+    const auto tracePath = juce::SystemStats::getEnvironmentVariable("WFW_TRACE_FILE", {});
+    if (tracePath.isNotEmpty() && juce::File::isAbsolutePath(tracePath))
+        exportTrace(juce::File(tracePath));
+   #endif
+
+    // Let any in-flight model load finish before the engines go away
+    modelLoader.removeAllJobs(true, 30000);
+
     if (whisperThread)
     {
         whisperThread->signalThreadShouldExit();
-        whisperThread->flushQueue();
+        whisperThread->cancelAll();
         whisperThread->stopThread(3000);
         whisperThread.reset();
     }
+
+    // Its log callback posts to uiEvents, which goes before it does
+    translationEngine.setWorker(nullptr);
+    mtWorker.stopWorker();
 }
 
 void WhisperFreeWinAudioProcessor::prepareToPlay(double sampleRate, int samplesPerBlock)
 {
-    juce::ignoreUnused(sampleRate);
+    // processBlock's first traced scope must not allocate its ring buffer
+    WFW_TRACE_RESERVE_THREAD("Audio");
+
     transport.prepareToPlay(samplesPerBlock, getSampleRate());
+
+    const bool wasLive = liveController.isRunning();
+    liveController.stop();
+    liveController.prepare(sampleRate, juce::jmax(1, getTotalNumOutputChannels()), samplesPerBlock);
+    if (wasLive)
+        liveController.start();
 }
 
 void WhisperFreeWinAudioProcessor::releaseResources()
@@ -53,9 +221,23 @@ void WhisperFreeWinAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer
 {
     juce::ignoreUnused(midi);
 
+    WFW_TRACE_THREAD_NAME("Audio");
+    WFW_TRACE_SCOPE("audio", "processBlock");
+
     buffer.clear();
     juce::AudioSourceChannelInfo info(&buffer, 0, buffer.getNumSamples());
     transport.getNextAudioBlock(info);
+
+    liveController.pushAudio(buffer);
+
+    const juce::SpinLock::ScopedTryLockType sl(captureLock);
+    if (sl.isLocked())
+    {
+        if (capture != nullptr)
+            capture->push(buffer, 0, buffer.getNumSamples());
+        if (archive != nullptr)
+            archive->push(buffer, 0, buffer.getNumSamples());
+    }
 }
 
 juce::AudioProcessorEditor* WhisperFreeWinAudioProcessor::createEditor()
@@ -65,42 +247,94 @@ juce::AudioProcessorEditor* WhisperFreeWinAudioProcessor::createEditor()
 
 // ==== App logic ====
 
-bool WhisperFreeWinAudioProcessor::loadWhisperModel(const juce::File& modelFile)
+bool WhisperFreeWinAudioProcessor::requestWhisperModelLoad(const juce::File& modelFile, std::function<void(bool)> onDone)
 {
-    const bool ok = whisperEngine.loadModel(modelFile,
-        [this](const juce::String& s) { appendLog(s); });
+    if (!modelFile.existsAsFile())
+    {
+        appendLog("[Whisper] Model not found: " + modelFile.getFullPathName());
+        return false;
+    }
 
-    if (ok && !whisperThread)
+    // Load off the UI thread; the engine swaps the model in when it's ready and
+    // jobs already queued on WhisperThread keep running meanwhile.
+    appendLog("[Whisper] Loading model in background: " + modelFile.getFileName());
+    modelLoader.addJob([this, modelFile, onDone]
+        {
+            const bool ok = whisperEngine.loadModel(modelFile,
+                [this](const juce::String& s) { appendLog(s); });
+            if (onDone)
+                onDone(ok);
+        });
+
+    return true;
+}
+
+bool WhisperFreeWinAudioProcessor::requestMarianModelLoad(const juce::File& folder, std::function<void(bool)> onDone)
+{
+    if (!folder.isDirectory())
     {
-        whisperThread = std::make_unique<WhisperThread>(
-            whisperEngine,
-            translationEngine,
-            [this](double p) { handleProgress(p); },
-            [this](const juce::String& s) { appendLog(s); },
-            [this](const juce::String& t) { handleTranscript(t); },
-            [this](const juce::String& t) { handleTranslation(t); }
-        );
-        whisperThread->setTranslatorLoaded(marianLoaded);
-        whisperThread->startThread();
+        appendLog("[MT] Model directory does not exist: " + folder.getFullPathName());
+        return false;
     }
 
-    return ok;
+    appendLog("[MT] Loading Marian model in background: " + folder.getFullPathName());
+    modelLoader.addJob([this, folder, onDone]
+        {
+            // Out of process first, so an MT crash costs a worker respawn rather than the host
+            bool ok = startMtWorker(folder);
+
+            juce::String err;
+            if (!ok)
+                ok = translationEngine.initialise(folder, err);
+
+            if (err.isNotEmpty())
+                appendLog("[MT] " + err);
+            else if (!translationEngine.isUsingWorker())
+                appendLog("[MT] Marian model loaded in-process from: " + folder.getFullPathName());
+
+            // A failed swap leaves the previous model in place
+            marianLoaded = ok || marianLoaded;
+            if (whisperThread)
+                whisperThread->setTranslatorLoaded(marianLoaded);
+            if (onDone)
+                onDone(ok);
+        });
+
+    return true;
 }
 
-bool WhisperFreeWinAudioProcessor::loadMarianModel(const juce::File& folder)
+bool WhisperFreeWinAudioProcessor::startMtWorker(const juce::File& folder)
 {
-    juce::String err;
-    marianLoaded = translationEngine.initialise(folder, err);
+    // WFW_MT_WORKER=<path> picks the worker executable; "off" keeps MT in-process
+    const auto setting = juce::SystemStats::getEnvironmentVariable("WFW_MT_WORKER", {});
+    if (setting.equalsIgnoreCase("off"))
+        return false;
 
-    if (err.isNotEmpty())
-        appendLog("[MT] " + err);
-    else
-        appendLog("[MT] Marian model loaded from: " + folder.getFullPathName());
+   #if JUCE_WINDOWS
+    const juce::String exeName("WhisperFreeWinMTWorker.exe");
+   #else
+    const juce::String exeName("WhisperFreeWinMTWorker");
+   #endif
+    const auto exe = setting.isNotEmpty() ? juce::File(setting)
+        : juce::File::getSpecialLocation(juce::File::currentExecutableFile).getSiblingFile(exeName);
 
-    if (whisperThread)
-        whisperThread->setTranslatorLoaded(marianLoaded);
+    translationEngine.setWorker(nullptr);
+    if (!mtWorker.startWorker(exe, folder.getFullPathName()))
+    {
+        appendLog("[MT] Worker unavailable, running Marian in-process");
+        return false;
+    }
 
-    return marianLoaded;
+    if (!mtWorker.waitForModel(120000))
+    {
+        appendLog("[MT] Worker could not load the model, running Marian in-process");
+        mtWorker.stopWorker();
+        return false;
+    }
+
+    translationEngine.setWorker(&mtWorker);
+    appendLog("[MT] Marian model loaded in worker process from: " + folder.getFullPathName());
+    return true;
 }
 
 bool WhisperFreeWinAudioProcessor::loadWavFile(const juce::File& file)
@@ -125,6 +359,10 @@ bool WhisperFreeWinAudioProcessor::loadWavFile(const juce::File& file)
         return false;
     }
 
+    // Whatever is still transcribing the previous file is no longer wanted
+    if (whisperThread)
+        whisperThread->cancelAll();
+
     loadedSampleRate = fileRate;
     loadedMono.setSize(1, (int)total);
     loadedMono.clear();
@@ -150,7 +388,9 @@ void WhisperFreeWinAudioProcessor::stopPlayback()
 
 bool WhisperFreeWinAudioProcessor::sendLoadedBufferToWhisper()
 {
-    if (!whisperEngine.isReady())
+    const bool remote = isUsingEngineService();
+
+    if (!remote && !whisperEngine.isReady())
     {
         appendLog("Load Whisper model first.");
         return false;
@@ -162,61 +402,223 @@ bool WhisperFreeWinAudioProcessor::sendLoadedBufferToWhisper()
         return false;
     }
 
-    if (!whisperThread)
+    if (!remote && !whisperThread)
     {
         appendLog("Internal error: WhisperThread not running.");
         return false;
     }
 
     appendLog("Sending buffer to Whisper (autoTranslate=" +
-        juce::String(autoTranslate ? "true" : "false") + ")");
+        juce::String(autoTranslate ? "true" : "false") + (remote ? ", engine service)" : ")"));
+
+    if (remote)
+    {
+        engineClient->submit(loadedMono, loadedSampleRate, autoTranslate,
+            [this](bool ok, const juce::String& transcript, const juce::String& translation)
+            {
+                if (!ok)
+                {
+                    appendLog("[Engine] Job failed: " + transcript);
+                    return;
+                }
+
+                handleTranscript(transcript);
+                if (translation.isNotEmpty())
+                    handleTranslation(translation);
+            });
+    }
+    else
+    {
+        // The loaded file replaces whatever was sent before it
+        if (whisperThread->sendBufferNow(loadedMono, loadedSampleRate, autoTranslate, true) == nullptr)
+            return false;
+    }
+
+    // Archive what was ingested, encoded on the pool rather than the worker
+    if (archiveOptions.folder != juce::File())
+    {
+        auto opts = archiveOptions;
+        opts.prefix = "ingest";
+        opts.sampleRate = loadedSampleRate;
+        opts.numChannels = 1;
+
+        AudioBlockOps::getWorkerPool().addJob(new FlacIngestJob(this, opts, loadedMono,
+            [this](const juce::String& s) { appendLog(s); }), true);
+    }
 
-    whisperThread->sendBufferNow(loadedMono, loadedSampleRate, autoTranslate);
     return true;
 }
 
-void WhisperFreeWinAudioProcessor::appendLog(const juce::String& s)
+bool WhisperFreeWinAudioProcessor::startRecording(const juce::File& wavFile)
 {
-    if (logSink)
+    stopRecording();
+
+    const double sr = getSampleRate() > 0.0 ? getSampleRate() : 48000.0;
+    auto writer = WavStreamWriter::toFile(wavFile, sr, 1, 16);
+    if (!writer)
     {
-        juce::MessageManager::callAsync([sink = logSink, msg = s]
-            {
-                sink(msg);
-            });
+        appendLog("[WAV] Could not open " + wavFile.getFullPathName());
+        return false;
+    }
+
+    auto c = std::make_unique<BackgroundAudioCapture>(std::move(writer));
+    {
+        const juce::SpinLock::ScopedLockType sl(captureLock);
+        capture = std::move(c);
+    }
+
+    appendLog("[WAV] Recording to " + wavFile.getFullPathName());
+    return true;
+}
+
+void WhisperFreeWinAudioProcessor::stopRecording()
+{
+    std::unique_ptr<BackgroundAudioCapture> c;
+    {
+        const juce::SpinLock::ScopedLockType sl(captureLock);
+        c = std::move(capture);
     }
+
+    if (c == nullptr)
+        return;
+
+    c->stop();
+    appendLog("[WAV] Recording stopped (" + juce::String(c->getNumCaptured()) + " samples, "
+        + juce::String(c->getNumDropped()) + " dropped)");
 }
 
-void WhisperFreeWinAudioProcessor::handleTranscript(const juce::String& t)
+bool WhisperFreeWinAudioProcessor::startArchive(const juce::File& folder, int compressionLevel, double segmentSeconds)
 {
-    if (transcriptSink)
+    stopArchive();
+
+    if (!folder.createDirectory())
     {
-        juce::MessageManager::callAsync([sink = transcriptSink, text = t]
-            {
-                sink(text);
-            });
+        appendLog("[FLAC] Could not create " + folder.getFullPathName());
+        return false;
     }
+
+    FlacCaptureSink::Options opts;
+    opts.folder = folder;
+    opts.prefix = "output";
+    opts.sampleRate = getSampleRate() > 0.0 ? getSampleRate() : 48000.0;
+    opts.numChannels = juce::jmax(1, getTotalNumOutputChannels());
+    opts.compressionLevel = compressionLevel;
+    opts.segmentSeconds = segmentSeconds;
+
+    auto a = std::make_unique<BackgroundAudioCapture>(
+        std::make_unique<FlacCaptureSink>(opts, [this](const juce::String& s) { appendLog(s); }));
+    {
+        const juce::SpinLock::ScopedLockType sl(captureLock);
+        archive = std::move(a);
+        archiveOptions = opts;
+    }
+
+    appendLog("[FLAC] Archiving to " + folder.getFullPathName() + " (level " + juce::String(compressionLevel) + ")");
+    return true;
 }
 
-void WhisperFreeWinAudioProcessor::handleTranslation(const juce::String& t)
+void WhisperFreeWinAudioProcessor::stopArchive()
 {
-    if (translationSink)
+    std::unique_ptr<BackgroundAudioCapture> a;
     {
-        juce::MessageManager::callAsync([sink = translationSink, text = t]
-            {
-                sink(text);
-            });
+        const juce::SpinLock::ScopedLockType sl(captureLock);
+        a = std::move(archive);
+        archiveOptions.folder = juce::File();
     }
+
+    if (a == nullptr)
+        return;
+
+    a->stop();
+    if (a->getNumDropped() > 0)
+        appendLog("[FLAC] Archive dropped " + juce::String(a->getNumDropped()) + " samples (worker behind)");
 }
 
-void WhisperFreeWinAudioProcessor::handleProgress(double p)
+void WhisperFreeWinAudioProcessor::setLiveTranscription(bool shouldRun)
 {
-    if (progressSink)
+    if (!shouldRun)
     {
-        juce::MessageManager::callAsync([sink = progressSink, value = p]
-            {
-                sink(value);
-            });
+        liveController.stop();
+        return;
     }
+
+    if (!whisperEngine.isReady() && !isUsingEngineService())
+    {
+        appendLog("Load Whisper model first.");
+        return;
+    }
+
+    if (liveController.getNumChannels() == 0)
+        liveController.prepare(getSampleRate() > 0.0 ? getSampleRate() : 48000.0,
+            juce::jmax(1, getTotalNumOutputChannels()), juce::jmax(512, getBlockSize()));
+
+    liveController.start();
+    appendLog("[ASR] Live transcription on " + juce::String(liveController.getNumChannels()) + " channel(s)");
+}
+
+bool WhisperFreeWinAudioProcessor::connectToEngineService(int port)
+{
+    disconnectEngineService();
+
+    auto client = std::make_shared<EngineClient>([this](const juce::String& s) { appendLog(s); });
+    if (!client->connect(port))
+    {
+        appendLog("[Engine] Using in-process engines");
+        return false;
+    }
+
+    engineClient = std::move(client);
+    liveController.setEngineClient(engineClient);
+    return true;
+}
+
+void WhisperFreeWinAudioProcessor::disconnectEngineService()
+{
+    // Pending jobs fail through their callbacks, which only post to uiEvents. A live
+    // segment still waiting on the daemon holds its own reference until it fails too.
+    liveController.setEngineClient(nullptr);
+    engineClient.reset();
+}
+
+void WhisperFreeWinAudioProcessor::startMetricsDump(const juce::File& target, int intervalMs)
+{
+    metricsDumper.start(target, intervalMs);
+    appendLog("[Metrics] Dumping to " + target.getFullPathName() + " every " + juce::String(intervalMs) + " ms");
+}
+
+bool WhisperFreeWinAudioProcessor::exportTrace(const juce::File& target)
+{
+   #if WFW_ENABLE_TRACE
+    return Trace::exportChromeJson(target);
+   #else
+    juce::ignoreUnused(target);
+    return false;
+   #endif
+}
+
+void WhisperFreeWinAudioProcessor::appendLog(const juce::String& s)
+{
+    uiEvents.postLog(s);
+}
+
+void WhisperFreeWinAudioProcessor::handleTranscript(const juce::String& t)
+{
+    uiEvents.postTranscript(t);
+}
+
+void WhisperFreeWinAudioProcessor::handlePartialTranscript(int channel, const juce::String& t)
+{
+    uiEvents.postPartial(channel, t);
+}
+
+void WhisperFreeWinAudioProcessor::handleTranslation(const juce::String& t)
+{
+    uiEvents.postTranslation(t);
+}
+
+void WhisperFreeWinAudioProcessor::handleProgress(double p)
+{
+    uiEvents.postProgress(p);
 }
 
 // Required factory for JUCE plugin wrappers
@@ -4,7 +4,15 @@
 #include <juce_audio_processors/juce_audio_processors.h>
 #include "WhisperEngine.h"
 #include "TranslationEngine.h"
+#include "TranslationWorker.h"
 #include "WhisperThread.h"
+#include "TranslationController.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "UiEventQueue.h"
+#include "BackgroundAudioCapture.h"
+#include "FlacCaptureSink.h"
+#include "EngineClient.h"
 #include <juce_audio_devices/sources/juce_AudioTransportSource.h>
 
 class WhisperFreeWinAudioProcessor : public juce::AudioProcessor
@@ -35,29 +43,60 @@ public:
     void getStateInformation(juce::MemoryBlock&) override {}
     void setStateInformation(const void*, int) override {}
 
-    // UI sinks
-    void setLogSink(std::function<void(const juce::String&)> s) { logSink = std::move(s); }
-    void setTranscriptSink(std::function<void(const juce::String&)> s) { transcriptSink = std::move(s); }
-    void setTranslationSink(std::function<void(const juce::String&)> s) { translationSink = std::move(s); }
-    void setProgressSink(std::function<void(double)> s) { progressSink = std::move(s); }
+    // Worker output for the editor, drained on its timer
+    UiEventQueue& getUiEvents() { return uiEvents; }
 
     // Actions from UI
     bool loadWavFile(const juce::File& file);
     void startPlayback();
     void stopPlayback();
 
-    bool loadWhisperModel(const juce::File& modelFile);
-    bool loadMarianModel(const juce::File& folder);
+    // Both loads run in the background and swap the model in without stopping the worker.
+    // The return value only says whether the load was queued; the outcome goes to the log
+    // and to onDone (called on the loader thread) once the model is in place or has failed.
+    bool requestWhisperModelLoad(const juce::File& modelFile, std::function<void(bool)> onDone = nullptr);
+    bool requestMarianModelLoad(const juce::File& folder, std::function<void(bool)> onDone = nullptr);
     bool sendLoadedBufferToWhisper();
 
-    void setAutoTranslate(bool b) { autoTranslate = b; }
+    // Streams the processed output to a WAV file in the background
+    bool startRecording(const juce::File& wavFile);
+    void stopRecording();
+
+    // Compressed archive of the output plus every buffer sent to Whisper,
+    // rotated into segmentSeconds-long files under folder
+    bool startArchive(const juce::File& folder, int compressionLevel = 5, double segmentSeconds = 1800.0);
+    void stopArchive();
+
+    void setAutoTranslate(bool b) { autoTranslate = b; liveController.setTranslate(b); }
+
+    // Live transcription of the output, one independent stream per channel
+    void setLiveTranscription(bool shouldRun);
+    bool isLiveTranscriptionRunning() const { return liveController.isRunning(); }
+
+    // Client mode: send jobs to the shared WhisperFreeWinEngine daemon instead of the
+    // in-process engines. Falls back to local engines whenever it isn't connected.
+    bool connectToEngineService(int port = EngineProtocol::defaultPort);
+    void disconnectEngineService();
+    bool isUsingEngineService() const { return engineClient != nullptr && engineClient->isConnected(); }
+
+    // Structured per-stage latency/counter snapshot (process-wide)
+    Metrics::Snapshot getMetricsSnapshot() const { return Metrics::get().snapshot(); }
+    void startMetricsDump(const juce::File& target, int intervalMs);
+    void stopMetricsDump() { metricsDumper.stop(); }
+
+    // Chrome trace JSON of the recent timeline; false if tracing is compiled out
+    bool exportTrace(const juce::File& target);
 
 private:
     void appendLog(const juce::String& s);
     void handleTranscript(const juce::String& t);
+    void handlePartialTranscript(int channel, const juce::String& t);   // empty clears it
     void handleTranslation(const juce::String& t);
     void handleProgress(double p);
 
+    // Starts the MT worker on folder and routes translation through it; false = stay in-process
+    bool startMtWorker(const juce::File& folder);
+
     juce::AudioFormatManager formatManager;
     std::unique_ptr<juce::AudioFormatReaderSource> readerSource;
     juce::AudioTransportSource transport;
@@ -66,16 +105,25 @@ private:
     double loadedSampleRate = 48000.0;
 
     WhisperEngine      whisperEngine;
+    TranslationWorker  mtWorker{ [this](const juce::String& s) { appendLog(s); } };   // out-of-process MT; must outlive translationEngine's use of it
     TranslationEngine  translationEngine;
     std::unique_ptr<WhisperThread> whisperThread;
+    TranslationController liveController{ whisperEngine, translationEngine };
+    juce::ThreadPool   modelLoader{ 1 };
+    MetricsDumper      metricsDumper;
+
+    UiEventQueue uiEvents;
+
+    // Swapped under the lock; processBlock only try-locks and skips a block if busy
+    juce::SpinLock captureLock;
+    std::unique_ptr<BackgroundAudioCapture> capture;
+    std::unique_ptr<BackgroundAudioCapture> archive;
+    FlacCaptureSink::Options archiveOptions;    // folder is empty while not archiving
 
-    std::function<void(const juce::String&)> logSink;
-    std::function<void(const juce::String&)> transcriptSink;
-    std::function<void(const juce::String&)> translationSink;
-    std::function<void(double)>              progressSink;
+    std::shared_ptr<EngineClient> engineClient;   // shared with liveController's jobs
 
     bool autoTranslate = false;
-    bool marianLoaded = false;
+    std::atomic<bool> marianLoaded{ false };
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WhisperFreeWinAudioProcessor)
 };
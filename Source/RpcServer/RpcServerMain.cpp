@@ -0,0 +1,40 @@
+// Source/RpcServer/RpcServerMain.cpp
+//
+// ggml-rpc compute server for WhisperEngine::setRpcEndpoints(). Run it on the machine
+// that should do the heavy encoding:
+//
+//   WhisperFreeWinRpcServer [--host 0.0.0.0] [--port 50052] [--threads N]
+//
+// ggml-rpc has no authentication; only expose it on a trusted LAN.
+
+#include <juce_core/juce_core.h>
+#include <iostream>
+#include "../third_party/whisper-ext.h"
+
+int main(int argc, char* argv[])
+{
+    juce::StringArray args;
+    for (int i = 1; i < argc; ++i)
+        args.add(juce::String::fromUTF8(argv[i]));
+
+    auto argValue = [&args](const juce::String& name, const juce::String& fallback)
+        {
+            const int i = args.indexOf(name);
+            return (i >= 0 && i + 1 < args.size()) ? args[i + 1] : fallback;
+        };
+
+    const auto host = argValue("--host", "127.0.0.1");
+    const int port = argValue("--port", "50052").getIntValue();
+    const int threads = argValue("--threads", juce::String(juce::SystemStats::getNumPhysicalCpus())).getIntValue();
+
+    if (port <= 0 || args.contains("--help"))
+    {
+        std::cerr << "usage: WhisperFreeWinRpcServer [--host 0.0.0.0] [--port 50052] [--threads N]" << std::endl;
+        return 2;
+    }
+
+    const auto endpoint = host + ":" + juce::String(port);
+    std::cerr << "serving ggml CPU backend on " << endpoint << " (" << threads << " threads)" << std::endl;
+
+    return whisper_ext_rpc_serve(endpoint.toRawUTF8(), threads);
+}
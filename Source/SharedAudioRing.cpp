@@ -0,0 +1,146 @@
+// Source/SharedAudioRing.cpp
+#include "SharedAudioRing.h"
+#include <cstring>
+#include <limits>
+#include <new>
+
+SharedAudioRing::SharedAudioRing(const juce::File& f, std::unique_ptr<juce::MemoryMappedFile> m, bool owner)
+    : file(f),
+    mapping(std::move(m)),
+    ownsFile(owner)
+{
+    header = static_cast<Header*>(mapping->getData());
+    data = reinterpret_cast<float*>(static_cast<char*>(mapping->getData()) + dataOffset);
+    capacity = (int)header->capacity;
+}
+
+SharedAudioRing::~SharedAudioRing()
+{
+    mapping.reset();
+
+    if (ownsFile)
+        file.deleteFile();
+}
+
+std::unique_ptr<SharedAudioRing> SharedAudioRing::create(const juce::File& f, int capacitySamples)
+{
+    if (capacitySamples <= 0)
+        return {};
+
+    const size_t bytes = dataOffset + (size_t)capacitySamples * sizeof(float);
+
+    f.getParentDirectory().createDirectory();
+    {
+        juce::MemoryBlock zeros(bytes, true);
+        if (!f.replaceWithData(zeros.getData(), zeros.getSize()))
+            return {};
+    }
+
+    auto m = std::make_unique<juce::MemoryMappedFile>(f, juce::MemoryMappedFile::readWrite, false);
+    if (m->getData() == nullptr || m->getSize() < bytes)
+    {
+        f.deleteFile();
+        return {};
+    }
+
+    auto* h = new (m->getData()) Header();
+    h->magic = magicValue;
+    h->version = 1;
+    h->capacity = (juce::uint32)capacitySamples;
+    h->writePos.store(0);
+    h->readPos.store(0);
+
+    return std::unique_ptr<SharedAudioRing>(new SharedAudioRing(f, std::move(m), true));
+}
+
+juce::File SharedAudioRing::getTemporaryFolder()
+{
+    // /dev/shm keeps the pages out of the page-cache writeback path on Linux
+    juce::File folder("/dev/shm");
+    if (!folder.isDirectory())
+        folder = juce::File::getSpecialLocation(juce::File::tempDirectory).getChildFile("WhisperFreeWin");
+    return folder;
+}
+
+std::unique_ptr<SharedAudioRing> SharedAudioRing::createTemporary(int capacitySamples)
+{
+    const auto name = "wfw-ring-" + juce::String(juce::Time::currentTimeMillis())
+        + "-" + juce::String::toHexString(juce::Random::getSystemRandom().nextInt());
+
+    return create(getTemporaryFolder().getChildFile(name), capacitySamples);
+}
+
+std::unique_ptr<SharedAudioRing> SharedAudioRing::openTemporary(const juce::File& f)
+{
+    // juce::File normalises the path, so ".." can't step out of the folder
+    if (f.getParentDirectory() != getTemporaryFolder()
+        || !f.getFileName().startsWith("wfw-ring-")
+        || f.isSymbolicLink() || !f.existsAsFile())
+        return {};
+
+    return open(f);
+}
+
+std::unique_ptr<SharedAudioRing> SharedAudioRing::open(const juce::File& f)
+{
+    auto m = std::make_unique<juce::MemoryMappedFile>(f, juce::MemoryMappedFile::readWrite, false);
+    if (m->getData() == nullptr || m->getSize() < dataOffset)
+        return {};
+
+    auto* h = static_cast<const Header*>(m->getData());
+    if (h->magic != magicValue || h->version != 1
+        || h->capacity == 0 || h->capacity > (juce::uint32)std::numeric_limits<int>::max()
+        || m->getSize() < dataOffset + (size_t)h->capacity * sizeof(float))
+        return {};
+
+    return std::unique_ptr<SharedAudioRing>(new SharedAudioRing(f, std::move(m), false));
+}
+
+int SharedAudioRing::getNumReady() const noexcept
+{
+    const auto w = header->writePos.load(std::memory_order_acquire);
+    const auto r = header->readPos.load(std::memory_order_acquire);
+    if (w < r)
+        return 0;
+    return (int)juce::jmin<juce::uint64>(w - r, (juce::uint64)capacity);
+}
+
+int SharedAudioRing::write(const float* src, int numSamples) noexcept
+{
+    const auto w = header->writePos.load(std::memory_order_relaxed);
+    const auto r = header->readPos.load(std::memory_order_acquire);
+    if (w < r || w - r > (juce::uint64)capacity)
+        return invalidHeader;
+
+    const int n = juce::jmin(juce::jlimit(0, capacity, numSamples), capacity - (int)(w - r));
+    if (n <= 0)
+        return 0;
+
+    const int start = (int)(w % (juce::uint64)capacity);
+    const int first = juce::jmin(n, capacity - start);
+    std::memcpy(data + start, src, (size_t)first * sizeof(float));
+    std::memcpy(data, src + first, (size_t)(n - first) * sizeof(float));
+
+    header->writePos.store(w + (juce::uint64)n, std::memory_order_release);
+    return n;
+}
+
+int SharedAudioRing::read(float* dst, int numSamples) noexcept
+{
+    const auto r = header->readPos.load(std::memory_order_relaxed);
+    const auto w = header->writePos.load(std::memory_order_acquire);
+    if (w < r || w - r > (juce::uint64)capacity)
+        return invalidHeader;
+
+    const int n = juce::jmin(juce::jlimit(0, capacity, numSamples), (int)(w - r));
+    if (n <= 0)
+        return 0;
+
+    const int start = (int)(r % (juce::uint64)capacity);
+    const int first = juce::jmin(n, capacity - start);
+    std::memcpy(dst, data + start, (size_t)first * sizeof(float));
+    std::memcpy(dst + first, data, (size_t)(n - first) * sizeof(float));
+
+    header->readPos.store(r + (juce::uint64)n, std::memory_order_release);
+    return n;
+}
@@ -0,0 +1,77 @@
+// Source/SharedAudioRing.h
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <atomic>
+
+/** Single-producer/single-consumer float ring in a memory-mapped file.
+ *
+ *  Both processes map the same file, so samples cross the process boundary
+ *  without a copy through a socket. Positions are free-running 64-bit counters
+ *  in the shared header; the producer only moves writePos, the consumer readPos.
+ *  write()/read() never block or allocate, so the producer may be an audio thread.
+ *
+ *  The other side can scribble over the header, so neither call trusts it: positions
+ *  that can't be valid (readPos past writePos, or further apart than the capacity)
+ *  make them return invalidHeader instead of touching the data.
+ */
+class SharedAudioRing
+{
+public:
+    ~SharedAudioRing();
+
+    /** Creates (or truncates) the backing file and maps it; the file is deleted
+     *  again when this ring is destroyed.
+     */
+    static std::unique_ptr<SharedAudioRing> create(const juce::File& file, int capacitySamples);
+
+    /** Creates the backing file under a RAM-backed folder where there is one. */
+    static std::unique_ptr<SharedAudioRing> createTemporary(int capacitySamples);
+
+    /** Maps a ring created by another process; nullptr if it isn't one. */
+    static std::unique_ptr<SharedAudioRing> open(const juce::File& file);
+
+    /** open(), but only for a file createTemporary() could have made: a regular file named
+     *  wfw-ring-* directly inside the temporary ring folder. For paths sent by a peer.
+     */
+    static std::unique_ptr<SharedAudioRing> openTemporary(const juce::File& file);
+
+    static constexpr int invalidHeader = -1;
+
+    int write(const float* src, int numSamples) noexcept;   // returns samples accepted, or invalidHeader
+    int read(float* dst, int numSamples) noexcept;          // returns samples copied, or invalidHeader
+
+    int getNumReady() const noexcept;
+    int getFreeSpace() const noexcept { return capacity - getNumReady(); }
+    int getCapacity() const noexcept { return capacity; }
+    const juce::File& getFile() const noexcept { return file; }
+
+private:
+    struct Header
+    {
+        juce::uint32 magic;
+        juce::uint32 version;
+        juce::uint32 capacity;
+        juce::uint32 reserved;
+        alignas(64) std::atomic<juce::uint64> writePos;
+        alignas(64) std::atomic<juce::uint64> readPos;
+    };
+
+    static_assert(std::atomic<juce::uint64>::is_always_lock_free, "ring positions must be address-free");
+
+    static constexpr juce::uint32 magicValue = 0x57465241; // "WFRA"
+    static constexpr size_t dataOffset = (sizeof(Header) + 63) & ~(size_t)63;
+
+    SharedAudioRing(const juce::File&, std::unique_ptr<juce::MemoryMappedFile>, bool owner);
+
+    static juce::File getTemporaryFolder();
+
+    juce::File file;
+    std::unique_ptr<juce::MemoryMappedFile> mapping;
+    Header* header = nullptr;
+    float* data = nullptr;
+    int capacity = 0;
+    bool ownsFile = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SharedAudioRing)
+};
@@ -0,0 +1,70 @@
+// Source/Tests/EngineProtocolTests.cpp
+#include <juce_core/juce_core.h>
+#include "../EngineProtocol.h"
+
+class EngineProtocolTests : public juce::UnitTest
+{
+public:
+    EngineProtocolTests() : juce::UnitTest("EngineProtocol", "WhisperFreeWin") {}
+
+    void runTest() override
+    {
+        using namespace EngineProtocol;
+
+        const juce::String transcript(juce::CharPointer_UTF8("caf\xc3\xa9 \xe6\x97\xa5\xe6\x9c\xac"));
+
+        beginTest("Each message kind round-trips");
+        {
+            Message m;
+
+            const auto ring = juce::File::getSpecialLocation(juce::File::tempDirectory).getChildFile("wfw-ring-1");
+            expect(decode(makeHello(ring, "Host 1"), m));
+            expect(m.kind == Kind::hello);
+            expectEquals(m.text, ring.getFullPathName());
+            expectEquals(m.text2, juce::String("Host 1"));
+
+            expect(decode(makeWelcome(true, "ggml-base.en"), m));
+            expect(m.kind == Kind::welcome && m.ok);
+            expectEquals(m.text, juce::String("ggml-base.en"));
+
+            expect(decode(makeJob(0xfffffffeu, 44100.0, 123456, true), m));
+            expect(m.kind == Kind::job && m.translate);
+            expect(m.id == 0xfffffffeu);
+            expectEquals(m.sampleRate, 44100.0);
+            expectEquals(m.numSamples, 123456);
+
+            expect(decode(makeResult(9, true, transcript, "coffee"), m));
+            expect(m.kind == Kind::result && m.ok);
+            expect(m.id == 9u);
+            expectEquals(m.text, transcript);
+            expectEquals(m.text2, juce::String("coffee"));
+
+            expect(decode(makeResult(10, false, {}, {}), m));
+            expect(!m.ok && m.text.isEmpty() && m.text2.isEmpty());
+
+            expect(decode(makeLog("[Engine] ready"), m));
+            expect(m.kind == Kind::log);
+            expectEquals(m.text, juce::String("[Engine] ready"));
+            expect(m.id == 0u && !m.translate);
+        }
+
+        beginTest("Malformed frames are rejected");
+        {
+            Message m;
+            expect(!decode({}, m));
+
+            const auto valid = makeJob(1, 16000.0, 10, false);
+            juce::MemoryBlock truncated(valid.getData(), 1 + 4 + 1 + 1 + 8 + 3);
+            expect(!decode(truncated, m), "shorter than the fixed fields");
+
+            for (juce::uint8 kind : { (juce::uint8)0, (juce::uint8)6, (juce::uint8)0xff })
+            {
+                juce::MemoryBlock bad(valid);
+                static_cast<juce::uint8*>(bad.getData())[0] = kind;
+                expect(!decode(bad, m), "kind " + juce::String(kind));
+            }
+        }
+    }
+};
+
+static EngineProtocolTests engineProtocolTests;
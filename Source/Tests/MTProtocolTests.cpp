@@ -0,0 +1,75 @@
+// Source/Tests/MTProtocolTests.cpp
+#include <juce_core/juce_core.h>
+#include "../MTProtocol.h"
+
+class MTProtocolTests : public juce::UnitTest
+{
+public:
+    MTProtocolTests() : juce::UnitTest("MTProtocol", "WhisperFreeWin") {}
+
+    void runTest() override
+    {
+        using namespace MTProtocol;
+
+        const juce::String unicode(juce::CharPointer_UTF8("Gr\xc3\xbc\xc3\x9f" "e \xe6\x97\xa5\xe6\x9c\xac"));
+
+        beginTest("Each message kind round-trips");
+        {
+            Message m;
+
+            expect(decode(makeLoad("/models/opus-mt-en-de"), m));
+            expect(m.kind == Kind::load);
+            expectEquals(m.text, juce::String("/models/opus-mt-en-de"));
+
+            expect(decode(makeTranslate(0xfffffff0u, unicode), m));
+            expect(m.kind == Kind::translate);
+            expect(m.id == 0xfffffff0u);
+            expectEquals(m.text, unicode);
+
+            expect(decode(makeReady(true, "cpu, 4 threads"), m));
+            expect(m.kind == Kind::ready && m.ok);
+            expectEquals(m.text, juce::String("cpu, 4 threads"));
+
+            expect(decode(makeReady(false, {}), m));
+            expect(m.kind == Kind::ready && !m.ok && m.text.isEmpty());
+
+            expect(decode(makeResult(42, true, 17, unicode), m));
+            expect(m.kind == Kind::result && m.ok);
+            expect(m.id == 42u);
+            expectEquals(m.numTokens, 17);
+            expectEquals(m.text, unicode);
+
+            expect(decode(makeLog("[MT] hello"), m));
+            expect(m.kind == Kind::log);
+            expectEquals(m.text, juce::String("[MT] hello"));
+        }
+
+        beginTest("Decoding resets fields the message doesn't carry");
+        {
+            Message m;
+            expect(decode(makeResult(7, true, 3, "x"), m));
+            expect(decode(makeLog("y"), m));
+            expect(m.id == 0u && !m.ok);
+            expectEquals(m.numTokens, 0);
+        }
+
+        beginTest("Malformed frames are rejected");
+        {
+            Message m;
+            expect(!decode({}, m));
+
+            juce::MemoryBlock one;
+            one.append("\x01", 1);
+            expect(!decode(one, m));
+
+            for (juce::uint8 kind : { (juce::uint8)0, (juce::uint8)6, (juce::uint8)0xff })
+            {
+                juce::MemoryBlock bad(makeLog("text"));
+                static_cast<juce::uint8*>(bad.getData())[0] = kind;
+                expect(!decode(bad, m), "kind " + juce::String(kind));
+            }
+        }
+    }
+};
+
+static MTProtocolTests mtProtocolTests;
@@ -0,0 +1,89 @@
+// Source/Tests/MetricsTests.cpp
+#include <juce_core/juce_core.h>
+#include "../Metrics.h"
+
+class MetricsTests : public juce::UnitTest
+{
+public:
+    MetricsTests() : juce::UnitTest("Metrics", "WhisperFreeWin") {}
+
+    void runTest() override
+    {
+        using H = Metrics::Histogram;
+
+        beginTest("Buckets cover every value exactly once");
+        {
+            for (juce::uint64 v : { 0ull, 1ull, 15ull, 16ull, 17ull, 31ull, 32ull, 1000ull, 123456789ull, (1ull << 40) - 1 })
+            {
+                const int i = H::bucketIndex(v);
+                expect(i >= 0 && i < H::numBuckets);
+                expect(H::bucketLowerBound(i) <= v && v < H::bucketLowerBound(i) + H::bucketWidth(i), "value " + juce::String((juce::int64)v));
+            }
+
+            for (int i = 1; i < H::numBuckets; ++i)
+                expectEquals((juce::int64)H::bucketLowerBound(i), (juce::int64)(H::bucketLowerBound(i - 1) + H::bucketWidth(i - 1)));
+
+            expectEquals(H::bucketIndex(~0ull), H::numBuckets - 1);
+        }
+
+        beginTest("Small values are exact");
+        {
+            H h;
+            for (int i = 0; i < 10; ++i)
+                h.record(7);
+
+            const auto s = h.snapshot();
+            expectEquals(s.count, (juce::int64)10);
+            expectEquals(s.sumUs, (juce::int64)70);
+            expectEquals(s.minUs, (juce::int64)7);
+            expectEquals(s.maxUs, (juce::int64)7);
+            expectEquals(s.p50Us, 7.0);
+            expectEquals(s.p999Us, 7.0);
+        }
+
+        beginTest("Quantiles are within the bucket error");
+        {
+            H h;
+            for (int v = 1; v <= 10000; ++v)
+                h.record(v);
+
+            const auto s = h.snapshot();
+            expectEquals(s.count, (juce::int64)10000);
+            expectEquals(s.minUs, (juce::int64)1);
+            expectEquals(s.maxUs, (juce::int64)10000);
+
+            // 16 sub-buckets per power of two: within 1/16 of the true value
+            expectWithinAbsoluteError(s.p50Us, 5000.0, 5000.0 / 16.0);
+            expectWithinAbsoluteError(s.p90Us, 9000.0, 9000.0 / 16.0);
+            expectWithinAbsoluteError(s.p99Us, 9900.0, 9900.0 / 16.0);
+            expect(s.p999Us <= 10000.0);
+        }
+
+        beginTest("Negative values count as zero; reset empties");
+        {
+            H h;
+            h.record(-5);
+            expectEquals(h.snapshot().maxUs, (juce::int64)0);
+
+            h.reset();
+            const auto s = h.snapshot();
+            expectEquals(s.count, (juce::int64)0);
+            expectEquals(s.minUs, (juce::int64)0);
+            expectEquals(s.p50Us, 0.0);
+        }
+
+        beginTest("Counters and job outcomes");
+        {
+            auto& m = Metrics::get();
+            const auto before = m.snapshot().counters[(size_t)Metrics::Counter::cacheHits];
+            m.increment(Metrics::Counter::cacheHits, 3);
+            expectEquals(m.snapshot().counters[(size_t)Metrics::Counter::cacheHits], before + 3);
+
+            expect(Metrics::jobOutcome(false, true) == Metrics::Counter::jobsFailed);
+            expect(Metrics::jobOutcome(true, false) == Metrics::Counter::jobsEmpty);
+            expect(Metrics::jobOutcome(true, true) == Metrics::Counter::jobsCompleted);
+        }
+    }
+};
+
+static MetricsTests metricsTests;
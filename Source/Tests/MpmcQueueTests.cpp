@@ -0,0 +1,101 @@
+// Source/Tests/MpmcQueueTests.cpp
+#include <juce_core/juce_core.h>
+#include <thread>
+#include <vector>
+#include "../MpmcQueue.h"
+
+class MpmcQueueTests : public juce::UnitTest
+{
+public:
+    MpmcQueueTests() : juce::UnitTest("MpmcQueue", "WhisperFreeWin") {}
+
+    void runTest() override
+    {
+        beginTest("Capacity rounds up to a power of two");
+        {
+            expectEquals((int)MpmcQueue<int>(0).capacity(), 2);
+            expectEquals((int)MpmcQueue<int>(2).capacity(), 2);
+            expectEquals((int)MpmcQueue<int>(5).capacity(), 8);
+            expectEquals((int)MpmcQueue<int>(4096).capacity(), 4096);
+        }
+
+        beginTest("FIFO order, full and empty");
+        {
+            MpmcQueue<int> q(4);
+            int out = -1;
+            expect(!q.tryPop(out));
+
+            for (int i = 0; i < 4; ++i)
+                expect(q.tryPush(i));
+
+            expect(!q.tryPush(99), "push into a full queue must fail");
+            expectEquals((int)q.approximateSize(), 4);
+
+            for (int i = 0; i < 4; ++i)
+            {
+                expect(q.tryPop(out));
+                expectEquals(out, i);
+            }
+
+            expect(!q.tryPop(out));
+            expectEquals((int)q.approximateSize(), 0);
+        }
+
+        beginTest("Wraps around many times");
+        {
+            MpmcQueue<juce::String> q(4);
+            juce::String out;
+            for (int i = 0; i < 1000; ++i)
+            {
+                expect(q.tryPush(juce::String(i)));
+                expect(q.tryPush(juce::String(-i)));
+                expect(q.tryPop(out));
+                expectEquals(out, juce::String(i));
+                expect(q.tryPop(out));
+                expectEquals(out, juce::String(-i));
+            }
+        }
+
+        beginTest("Concurrent producers keep per-producer order");
+        {
+            constexpr int numProducers = 4, perProducer = 20000;
+            MpmcQueue<int> q(256);
+
+            std::vector<std::thread> producers;
+            for (int p = 0; p < numProducers; ++p)
+                producers.emplace_back([&q, p]
+                    {
+                        for (int i = 0; i < perProducer; ++i)
+                            while (!q.tryPush(p * perProducer + i))
+                                std::this_thread::yield();
+                    });
+
+            std::vector<int> next(numProducers, 0);
+            int received = 0, outOfOrder = 0;
+            while (received < numProducers * perProducer)
+            {
+                int v;
+                if (!q.tryPop(v))
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                const int p = v / perProducer;
+                if (v % perProducer != next[(size_t)p])
+                    ++outOfOrder;
+                next[(size_t)p] = v % perProducer + 1;
+                ++received;
+            }
+
+            for (auto& t : producers)
+                t.join();
+
+            expectEquals(outOfOrder, 0);
+            for (int p = 0; p < numProducers; ++p)
+                expectEquals(next[(size_t)p], perProducer);
+        }
+    }
+};
+
+static MpmcQueueTests mpmcQueueTests;
@@ -0,0 +1,156 @@
+// Source/Tests/OverloadControllerTests.cpp
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "../OverloadController.h"
+#include "../Metrics.h"
+
+class OverloadControllerTests : public juce::UnitTest
+{
+public:
+    OverloadControllerTests() : juce::UnitTest("OverloadController", "WhisperFreeWin") {}
+
+    void runTest() override
+    {
+        using Step = OverloadController::Step;
+
+        // One second of audio per job; rtf is processing time / audio time
+        auto job = [](OverloadController& c, double rtf, double queueAgeMs = 0.0)
+            {
+                return c.jobFinished(1.0, queueAgeMs, rtf * 1000.0);
+            };
+
+        beginTest("Starts normal");
+        {
+            OverloadController c;
+            expectEquals(c.getLevel(), 0);
+            expectEquals(c.describe(), juce::String("normal"));
+            expect(!c.getJobOptions().fastDecode && !c.getJobOptions().trimAudioContext && !c.getJobOptions().useFallbackModel);
+            expect(!c.jobFinished(0.0, 0.0, 5000.0), "jobs without audio are ignored");
+            expectEquals(c.getRealTimeFactor(), 0.0);
+        }
+
+        beginTest("Escalates one step per holdJobs while overloaded, up to the last step");
+        {
+            OverloadController c;
+            const auto stepsBefore = Metrics::get().snapshot().counters[(size_t)Metrics::Counter::overloadSteps];
+
+            expect(!job(c, 2.0));
+            expect(!job(c, 2.0));
+            expect(job(c, 2.0));
+            expectEquals(c.getLevel(), 1);
+            expect(c.isActive(Step::shortenWindows) && !c.isActive(Step::fastDecode));
+            expect(c.getJobOptions().trimAudioContext);
+            expectWithinAbsoluteError(c.getRealTimeFactor(), 2.0, 1.0e-9);
+
+            for (int i = 0; i < 9; ++i)
+                job(c, 2.0);
+
+            expectEquals(c.getLevel(), 4);
+            expectEquals(c.describe(), juce::String("shortenWindows+fastDecode+smallerModel+dropNonSpeech"));
+            const auto o = c.getJobOptions();
+            expect(o.trimAudioContext && o.fastDecode && o.useFallbackModel);
+
+            for (int i = 0; i < 6; ++i)
+                expect(!job(c, 2.0), "no step beyond the policy");
+
+            expectEquals(Metrics::get().snapshot().counters[(size_t)Metrics::Counter::overloadSteps] - stepsBefore, (juce::int64)4);
+        }
+
+        beginTest("Holds between the thresholds, then relaxes in reverse order");
+        {
+            // Just over escalateRtf, so the smoothed value drops below it before the next hold ends
+            OverloadController c;
+            for (int i = 0; i < 6; ++i)
+                job(c, 1.0);
+            expectEquals(c.getLevel(), 2);
+
+            for (int i = 0; i < 40; ++i)
+                job(c, 0.7);
+            expectEquals(c.getLevel(), 2);
+            expect(c.getRealTimeFactor() > 0.5 && c.getRealTimeFactor() < 0.9);
+
+            int jobsSinceChange = 0, minGap = 1000;
+            bool relaxed = false;
+            while (c.getLevel() > 0 && jobsSinceChange < 100)
+            {
+                ++jobsSinceChange;
+                if (job(c, 0.1))
+                {
+                    if (relaxed)
+                        minGap = juce::jmin(minGap, jobsSinceChange);
+                    relaxed = true;
+                    jobsSinceChange = 0;
+
+                    if (c.getLevel() == 1)
+                        expect(c.isActive(Step::shortenWindows) && !c.isActive(Step::fastDecode));
+                }
+            }
+
+            expectEquals(c.getLevel(), 0);
+            expect(minGap >= 3, "at least holdJobs jobs between changes");
+            expectEquals(c.describe(), juce::String("normal"));
+        }
+
+        beginTest("An old queue escalates even when jobs are fast");
+        {
+            OverloadController c;
+            for (int i = 0; i < 3; ++i)
+                job(c, 0.1, 5000.0);
+            expectEquals(c.getLevel(), 1);
+
+            // Fast again, but the queue is still too old to relax
+            for (int i = 0; i < 3; ++i)
+                job(c, 0.1, 1000.0);
+            expectEquals(c.getLevel(), 1);
+        }
+
+        beginTest("Custom policies and dropNonSpeech");
+        {
+            OverloadController c;
+            auto p = OverloadController::policyFromString(" Fast, speech ,bogus");
+            expectEquals((int)p.steps.size(), 2);
+            p.holdJobs = 1;
+            c.setPolicy(p);
+
+            expect(job(c, 2.0));
+            expect(c.isActive(Step::fastDecode) && !c.isActive(Step::shortenWindows));
+            expect(c.getJobOptions().fastDecode && !c.getJobOptions().trimAudioContext);
+
+            juce::AudioBuffer<float> quiet(1, 1600), loud(1, 1600);
+            quiet.clear();
+            loud.clear();
+            for (int i = 0; i < loud.getNumSamples(); ++i)
+                loud.setSample(0, i, (i & 1) ? 0.2f : -0.2f);
+
+            expect(c.shouldTranscribe(quiet), "silence is transcribed until dropNonSpeech is on");
+
+            expect(job(c, 2.0));
+            expect(c.isActive(Step::dropNonSpeech));
+            expect(!c.shouldTranscribe(quiet));
+            expect(c.shouldTranscribe(loud));
+            expectEquals(c.describe(), juce::String("fastDecode+dropNonSpeech"));
+
+            c.reset();
+            expectEquals(c.getLevel(), 0);
+            expectEquals((int)c.getPolicy().steps.size(), 2);
+            expect(c.shouldTranscribe(quiet));
+        }
+
+        beginTest("Policy strings");
+        {
+            expectEquals((int)OverloadController::policyFromString({}).steps.size(), 4);
+            expect(OverloadController::policyFromString("off").steps.empty());
+
+            const auto p = OverloadController::policyFromString("small,shorten");
+            expect(p.steps.size() == 2 && p.steps[0] == Step::smallerModel && p.steps[1] == Step::shortenWindows);
+
+            OverloadController c;
+            c.setPolicy(OverloadController::policyFromString("off"));
+            for (int i = 0; i < 10; ++i)
+                expect(!job(c, 5.0));
+            expectEquals(c.getLevel(), 0);
+        }
+    }
+};
+
+static OverloadControllerTests overloadControllerTests;
@@ -0,0 +1,193 @@
+// Source/Tests/SharedAudioRingTests.cpp
+#include <juce_core/juce_core.h>
+#include <cstring>
+#include <vector>
+#include "../SharedAudioRing.h"
+
+class SharedAudioRingTests : public juce::UnitTest
+{
+public:
+    SharedAudioRingTests() : juce::UnitTest("SharedAudioRing", "WhisperFreeWin") {}
+
+    void runTest() override
+    {
+        const auto folder = juce::File::getSpecialLocation(juce::File::tempDirectory).getChildFile("WhisperFreeWinTests");
+        folder.createDirectory();
+
+        beginTest("Producer and consumer mappings wrap around in order");
+        {
+            const auto file = folder.getNonexistentChildFile("ring", ".bin");
+            auto producer = SharedAudioRing::create(file, 1000);
+            expect(producer != nullptr);
+            if (producer == nullptr)
+                return;
+
+            auto consumer = SharedAudioRing::open(file);
+            expect(consumer != nullptr);
+            if (consumer == nullptr)
+                return;
+
+            expectEquals(consumer->getCapacity(), 1000);
+            expectEquals(consumer->getNumReady(), 0);
+
+            std::vector<float> src(700), dst(700);
+            float next = 0.0f, expected = 0.0f;
+            int wrong = 0;
+
+            for (int round = 0; round < 10; ++round)
+            {
+                for (auto& s : src)
+                    s = next++;
+
+                expectEquals(producer->write(src.data(), 700), 700);
+                expectEquals(consumer->getNumReady(), 700);
+                expectEquals(producer->getFreeSpace(), 300);
+
+                // Split the read so both the wrapping and non-wrapping copies run
+                expectEquals(consumer->read(dst.data(), 250), 250);
+                expectEquals(consumer->read(dst.data() + 250, 1000), 450);
+                expectEquals(consumer->read(dst.data(), 10), 0);
+
+                for (auto s : dst)
+                    if (s != expected++)
+                        ++wrong;
+            }
+
+            expectEquals(wrong, 0);
+        }
+
+        beginTest("A full ring accepts only what fits");
+        {
+            auto ring = SharedAudioRing::create(folder.getNonexistentChildFile("ring", ".bin"), 64);
+            expect(ring != nullptr);
+            if (ring == nullptr)
+                return;
+
+            std::vector<float> buf(100, 1.0f);
+            expectEquals(ring->write(buf.data(), 100), 64);
+            expectEquals(ring->write(buf.data(), 1), 0);
+            expectEquals(ring->read(buf.data(), 16), 16);
+            expectEquals(ring->write(buf.data(), 100), 16);
+            expectEquals(ring->write(buf.data(), -5), 0);
+        }
+
+        beginTest("open() rejects files that aren't rings");
+        {
+            const auto file = folder.getNonexistentChildFile("ring", ".bin");
+            auto ring = SharedAudioRing::create(file, 256);
+            expect(ring != nullptr);
+            if (ring == nullptr)
+                return;
+
+            juce::MemoryBlock valid;
+            expect(file.loadFileAsData(valid));
+
+            auto tryOpen = [&](const juce::MemoryBlock& contents)
+                {
+                    const auto other = folder.getNonexistentChildFile("bad", ".bin");
+                    other.replaceWithData(contents.getData(), contents.getSize());
+                    const bool opened = SharedAudioRing::open(other) != nullptr;
+                    other.deleteFile();
+                    return opened;
+                };
+
+            expect(tryOpen(valid), "an intact copy opens");
+
+            auto patched = [&](size_t offset, juce::uint32 value)
+                {
+                    juce::MemoryBlock mb(valid);
+                    mb.copyFrom(&value, (int)offset, sizeof(value));
+                    return mb;
+                };
+
+            expect(!tryOpen(patched(0, 0x12345678)), "bad magic");
+            expect(!tryOpen(patched(4, 2)), "unknown version");
+            expect(!tryOpen(patched(8, 0)), "zero capacity");
+            expect(!tryOpen(patched(8, 257)), "capacity larger than the file");
+            expect(!tryOpen(patched(8, 0x80000000u)), "capacity beyond int");
+
+            juce::MemoryBlock truncated(valid.getData(), valid.getSize() - sizeof(float));
+            expect(!tryOpen(truncated), "data area too short");
+            expect(!tryOpen(juce::MemoryBlock(8, true)), "shorter than the header");
+            expect(SharedAudioRing::open(folder.getChildFile("does-not-exist.bin")) == nullptr);
+        }
+
+        beginTest("Corrupt positions are reported, not followed");
+        {
+            const auto file = folder.getNonexistentChildFile("ring", ".bin");
+            auto ring = SharedAudioRing::create(file, 128);
+            expect(ring != nullptr);
+            if (ring == nullptr)
+                return;
+
+            // The peer's view of the header: writePos and readPos on their own cache lines
+            juce::MemoryMappedFile peer(file, juce::MemoryMappedFile::readWrite, false);
+            expect(peer.getData() != nullptr);
+            if (peer.getData() == nullptr)
+                return;
+
+            auto* base = static_cast<char*>(peer.getData());
+            auto setPositions = [base](juce::uint64 w, juce::uint64 r)
+                {
+                    std::memcpy(base + 64, &w, sizeof(w));
+                    std::memcpy(base + 128, &r, sizeof(r));
+                };
+
+            std::vector<float> buf(16, 0.5f);
+
+            setPositions(10, 11);   // reader ahead of writer
+            expectEquals(ring->write(buf.data(), 16), SharedAudioRing::invalidHeader);
+            expectEquals(ring->read(buf.data(), 16), SharedAudioRing::invalidHeader);
+            expectEquals(ring->getNumReady(), 0);
+
+            setPositions(1000, 1000 - 129);   // more ready than the capacity
+            expectEquals(ring->write(buf.data(), 16), SharedAudioRing::invalidHeader);
+            expectEquals(ring->read(buf.data(), 16), SharedAudioRing::invalidHeader);
+
+            // Huge but consistent counters are fine; positions are free-running
+            setPositions(~(juce::uint64)0 - 200, ~(juce::uint64)0 - 200);
+            expectEquals(ring->write(buf.data(), 16), 16);
+            expectEquals(ring->read(buf.data(), 16), 16);
+        }
+
+        beginTest("Only the creator deletes the file");
+        {
+            const auto file = folder.getNonexistentChildFile("ring", ".bin");
+            auto ring = SharedAudioRing::create(file, 32);
+            expect(ring != nullptr);
+
+            SharedAudioRing::open(file).reset();
+            expect(file.existsAsFile());
+
+            ring.reset();
+            expect(!file.exists());
+        }
+
+        beginTest("openTemporary() only accepts files createTemporary() could make");
+        {
+            auto ring = SharedAudioRing::createTemporary(32);
+            expect(ring != nullptr);
+            if (ring == nullptr)
+                return;
+
+            expect(SharedAudioRing::openTemporary(ring->getFile()) != nullptr);
+
+            // A valid ring, but outside the temporary folder
+            auto elsewhere = SharedAudioRing::create(folder.getChildFile("wfw-ring-elsewhere"), 32);
+            expect(elsewhere != nullptr);
+            expect(SharedAudioRing::openTemporary(elsewhere->getFile()) == nullptr);
+
+            // Right folder, wrong name
+            const auto renamed = ring->getFile().getSiblingFile("not-a-ring-" + ring->getFile().getFileName());
+            expect(ring->getFile().copyFileTo(renamed));
+            expect(SharedAudioRing::openTemporary(renamed) == nullptr);
+            renamed.deleteFile();
+
+            expect(SharedAudioRing::openTemporary(ring->getFile().getSiblingFile("wfw-ring-missing")) == nullptr);
+        }
+
+        folder.deleteRecursively();
+    }
+};
+
+static SharedAudioRingTests sharedAudioRingTests;
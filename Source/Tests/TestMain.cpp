@@ -0,0 +1,53 @@
+// Source/Tests/TestMain.cpp
+//
+// Unit tests for the parts of the pipeline that run without a model: queues, rings,
+// stores, writers, wire protocols and controllers. Each *Tests.cpp registers its
+// juce::UnitTest statically under the "WhisperFreeWin" category.
+//
+//   WhisperFreeWinTests [--test "Test name"] [--seed N]
+//
+// Exits non-zero if any expectation failed.
+
+#include <juce_core/juce_core.h>
+#include <juce_events/juce_events.h>
+#include <iostream>
+
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInit;
+
+    juce::StringArray args;
+    for (int i = 1; i < argc; ++i)
+        args.add(juce::String::fromUTF8(argv[i]));
+
+    auto argValue = [&args](const juce::String& key)
+        {
+            const int i = args.indexOf(key);
+            return i >= 0 && i + 1 < args.size() ? args[i + 1] : juce::String();
+        };
+
+    const auto seedArg = argValue("--seed");
+    const juce::int64 seed = seedArg.isNotEmpty() ? seedArg.getLargeIntValue() : juce::Random::getSystemRandom().nextInt64();
+
+    juce::UnitTestRunner runner;
+    runner.setAssertOnFailure(false);
+
+    juce::Array<juce::UnitTest*> tests;
+    const auto only = argValue("--test");
+    for (auto* t : juce::UnitTest::getTestsInCategory("WhisperFreeWin"))
+        if (only.isEmpty() || t->getName() == only)
+            tests.add(t);
+
+    runner.runTests(tests, seed);
+
+    int failures = 0, passes = 0;
+    for (int i = 0; i < runner.getNumResults(); ++i)
+    {
+        failures += runner.getResult(i)->failures;
+        passes += runner.getResult(i)->passes;
+    }
+
+    std::cerr << runner.getNumResults() << " test groups, " << passes << " passed, " << failures
+              << " failed (seed " << seed << ")" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
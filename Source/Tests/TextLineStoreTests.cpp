@@ -0,0 +1,86 @@
+// Source/Tests/TextLineStoreTests.cpp
+#include <juce_core/juce_core.h>
+#include "../TextLineStore.h"
+
+class TextLineStoreTests : public juce::UnitTest
+{
+public:
+    TextLineStoreTests() : juce::UnitTest("TextLineStore", "WhisperFreeWin") {}
+
+    void runTest() override
+    {
+        constexpr int chunk = TextLineStore::linesPerChunk;
+        auto lineText = [](juce::int64 i) { return "line " + juce::String(i) + (i % 7 == 0 ? juce::String(juce::CharPointer_UTF8("  caf\xc3\xa9")) : juce::String()); };
+
+        beginTest("Lines stay in memory below the limit");
+        {
+            TextLineStore store(2 * chunk);
+            for (int i = 0; i < 2 * chunk; ++i)
+                store.append(lineText(i));
+
+            expectEquals(store.getNumLines(), (juce::int64)(2 * chunk));
+            expectEquals(store.getFirstLineIndex(), (juce::int64)0);
+            expectEquals(store.getNumSpilledLines(), (juce::int64)0);
+            expectEquals(store.getLine(0), lineText(0));
+            expectEquals(store.getLine(2 * chunk - 1), lineText(2 * chunk - 1));
+            expect(store.getLine(2 * chunk).isEmpty());
+            expect(store.getLine(-1).isEmpty());
+        }
+
+        beginTest("Evicted chunks spill and reload");
+        {
+            const auto file = juce::File::getSpecialLocation(juce::File::tempDirectory)
+                                  .getNonexistentChildFile("WhisperFreeWinTests-spill", ".txt");
+            {
+                TextLineStore store(2 * chunk, file);
+                const juce::int64 total = 5 * chunk + 123;
+                for (juce::int64 i = 0; i < total; ++i)
+                    store.append(lineText(i));
+
+                expectEquals(store.getNumLines(), total);
+                expectEquals(store.getFirstLineIndex(), (juce::int64)0);
+                expect(store.getNumSpilledLines() > 0);
+                expectEquals(store.getNumSpilledLines() % chunk, (juce::int64)0);
+                expect(file.existsAsFile());
+
+                int wrong = 0;
+                for (juce::int64 i = 0; i < total; ++i)
+                    if (store.getLine(i) != lineText(i))
+                        ++wrong;
+                expectEquals(wrong, 0);
+
+                // Jumping between spilled chunks and memory, in both directions
+                for (juce::int64 i : { total - 1, (juce::int64)0, (juce::int64)(2 * chunk + 5), (juce::int64)(chunk - 1), total - chunk })
+                    expectEquals(store.getLine(i), lineText(i));
+
+                store.clear();
+                expectEquals(store.getNumLines(), (juce::int64)0);
+                expect(!file.exists(), "clear() removes the spill file");
+
+                for (int i = 0; i < 3 * chunk; ++i)
+                    store.append(lineText(i));
+                expectEquals(store.getLine(0), lineText(0));
+            }
+
+            expect(!file.exists(), "the destructor removes the spill file");
+        }
+
+        beginTest("Without a spill file old chunks are dropped");
+        {
+            TextLineStore store(2 * chunk);
+            const juce::int64 total = 4 * chunk + 10;
+            for (juce::int64 i = 0; i < total; ++i)
+                store.append(lineText(i));
+
+            expectEquals(store.getNumLines(), total);
+            expect(store.getFirstLineIndex() > 0);
+            expectEquals(store.getFirstLineIndex() % chunk, (juce::int64)0);
+            expectEquals(store.getNumSpilledLines(), (juce::int64)0);
+            expect(store.getLine(0).isEmpty());
+            expectEquals(store.getLine(store.getFirstLineIndex()), lineText(store.getFirstLineIndex()));
+            expectEquals(store.getLine(total - 1), lineText(total - 1));
+        }
+    }
+};
+
+static TextLineStoreTests textLineStoreTests;
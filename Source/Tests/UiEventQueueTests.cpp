@@ -0,0 +1,110 @@
+// Source/Tests/UiEventQueueTests.cpp
+#include <juce_core/juce_core.h>
+#include "../UiEventQueue.h"
+
+class UiEventQueueTests : public juce::UnitTest
+{
+public:
+    UiEventQueueTests() : juce::UnitTest("UiEventQueue", "WhisperFreeWin") {}
+
+    void runTest() override
+    {
+        auto drops = [] { return Metrics::get().snapshot().counters[(size_t)Metrics::Counter::drops]; };
+
+        beginTest("Results keep their order within a drain");
+        {
+            UiEventQueue q(16);
+            q.postTranscript("one");
+            q.postTranslation("eins");
+            q.postTranscript("two");
+            q.postLog("hello");
+
+            const auto b = q.drain();
+            expectEquals(b.numEvents, 4);
+            expect(b.hasTranscript && b.hasTranslation);
+            expectEquals(b.transcript, juce::String("one\ntwo\n"));
+            expectEquals(b.translation, juce::String("eins\n"));
+            expect(b.logText.endsWith("] hello\n"));
+            expect(!b.hasProgress);
+
+            expectEquals(q.drain().numEvents, 0);
+        }
+
+        beginTest("Drain is bounded by maxEvents");
+        {
+            UiEventQueue q(16);
+            for (int i = 0; i < 10; ++i)
+                q.postTranscript(juce::String(i));
+
+            expectEquals(q.drain(3).transcript, juce::String("0\n1\n2\n"));
+            const auto rest = q.drain();
+            expectEquals(rest.numEvents, 7);
+            expect(rest.transcript.startsWith("3\n"));
+        }
+
+        beginTest("Full ring sheds log lines and reports the count");
+        {
+            UiEventQueue q(4);
+            const auto before = drops();
+
+            for (int i = 0; i < 10; ++i)
+                q.postLog("line " + juce::String(i));
+
+            expectEquals(drops() - before, (juce::int64)6);
+
+            const auto b = q.drain();
+            expectEquals(b.numEvents, 4);
+            expect(b.logText.startsWith("[UI] 6 log lines dropped"));
+            expect(b.logText.contains("line 3") && !b.logText.contains("line 4"));
+
+            expect(!q.drain().logText.contains("dropped"), "the drop count is reported once");
+        }
+
+        beginTest("Full ring evicts the oldest entry for a result");
+        {
+            UiEventQueue q(4);
+            const auto before = drops();
+
+            for (int i = 0; i < 4; ++i)
+                q.postLog("line " + juce::String(i));
+            q.postTranscript("latest");
+
+            expectEquals(drops() - before, (juce::int64)1);
+
+            const auto b = q.drain();
+            expectEquals(b.transcript, juce::String("latest\n"));
+            expect(b.logText.startsWith("[UI] 1 log lines dropped"));
+            expect(!b.logText.contains("line 0") && b.logText.contains("line 1"));
+        }
+
+        beginTest("Partials keep the newest per key");
+        {
+            UiEventQueue q(16);
+            q.postPartial(0, "hel");
+            q.postPartial(1, "bon");
+            q.postPartial(0, "hello");
+            q.postPartial(1, "");
+
+            const auto b = q.drain();
+            expectEquals((int)b.partials.size(), 2);
+            expectEquals(b.partials.at(0), juce::String("hello"));
+            expect(b.partials.at(1).isEmpty());
+            expect(!b.hasTranscript);
+        }
+
+        beginTest("Progress is coalesced");
+        {
+            UiEventQueue q(4);
+            q.postProgress(0.25);
+            q.postProgress(0.75);
+
+            const auto b = q.drain();
+            expect(b.hasProgress);
+            expectEquals(b.progress, 0.75);
+            expectEquals(b.numEvents, 0);
+            expect(!q.drain().hasProgress);
+        }
+    }
+};
+
+static UiEventQueueTests uiEventQueueTests;
@@ -0,0 +1,159 @@
+// Source/Tests/WavStreamWriterTests.cpp
+#include <juce_core/juce_core.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <cmath>
+#include <limits>
+#include "../WavStreamWriter.h"
+
+class WavStreamWriterTests : public juce::UnitTest
+{
+public:
+    WavStreamWriterTests() : juce::UnitTest("WavStreamWriter", "WhisperFreeWin") {}
+
+    void runTest() override
+    {
+        beginTest("finish() patches the RIFF and data sizes");
+        {
+            // Expected length deliberately wrong; more than one scratch block per write
+            const int numSamples = 20000;
+            juce::AudioBuffer<float> audio(2, numSamples);
+            fillSine(audio);
+
+            juce::MemoryBlock mb;
+            auto w = WavStreamWriter::toMemory(mb, 16000.0, 2, 16, 5000);
+            expect(w != nullptr);
+
+            expect(w->write(audio.getArrayOfReadPointers(), 12345));
+            expect(w->write(audio.getArrayOfReadPointers(), 0));
+
+            const float* tail[] = { audio.getReadPointer(0, 12345), audio.getReadPointer(1, 12345) };
+            expect(w->write(tail, numSamples - 12345));
+            expectEquals(w->getNumSamplesWritten(), (juce::int64)numSamples);
+
+            expect(w->finish());
+            expect(!w->write(audio.getArrayOfReadPointers(), 1), "writes after finish() fail");
+            expect(w->finish(), "finish() is idempotent");
+
+            const int dataBytes = numSamples * 2 * 2;
+            expectEquals((int)mb.getSize(), 44 + dataBytes);
+            expectHeader(mb, 2, 16000, 16, dataBytes);
+
+            const auto back = readBack(mb);
+            expectEquals(back.getNumChannels(), 2);
+            expectEquals(back.getNumSamples(), numSamples);
+            expectMatches(audio, back, 1.0f / 16384.0f);
+        }
+
+        beginTest("Header is valid when nothing is written");
+        {
+            juce::MemoryBlock mb;
+            {
+                auto w = WavStreamWriter::toMemory(mb, 48000.0, 1, 16, 48000);
+                expect(w != nullptr);
+            }   // destructor finalises
+
+            expectEquals((int)mb.getSize(), 44);
+            expectHeader(mb, 1, 48000, 16, 0);
+        }
+
+        beginTest("24-bit and float files round-trip; non-finite samples are zeroed");
+        {
+            for (int bits : { 24, 32 })
+            {
+                const auto file = juce::File::getSpecialLocation(juce::File::tempDirectory)
+                                      .getNonexistentChildFile("WhisperFreeWinTests", ".wav");
+
+                juce::AudioBuffer<float> audio(1, 1000);
+                fillSine(audio);
+                audio.setSample(0, 10, std::numeric_limits<float>::quiet_NaN());
+                audio.setSample(0, 20, std::numeric_limits<float>::infinity());
+
+                {
+                    auto w = WavStreamWriter::toFile(file, 44100.0, 1, bits);
+                    expect(w != nullptr);
+                    expect(w->write(audio.getArrayOfReadPointers(), audio.getNumSamples()));
+                    expect(w->finish());
+                    expectEquals(w->getNumSanitised(), 2);
+                }
+
+                juce::MemoryBlock mb;
+                expect(file.loadFileAsData(mb));
+                file.deleteFile();
+
+                const int dataBytes = 1000 * bits / 8;
+                expectEquals((int)mb.getSize(), 44 + dataBytes);
+                expectHeader(mb, 1, 44100, bits, dataBytes);
+
+                audio.setSample(0, 10, 0.0f);
+                audio.setSample(0, 20, 0.0f);
+                expectMatches(audio, readBack(mb), bits == 32 ? 0.0f : 1.0f / 4000000.0f);
+            }
+        }
+    }
+
+private:
+    static void fillSine(juce::AudioBuffer<float>& b)
+    {
+        for (int ch = 0; ch < b.getNumChannels(); ++ch)
+            for (int i = 0; i < b.getNumSamples(); ++i)
+                b.setSample(ch, i, 0.5f * std::sin(0.01f * (float)i * (float)(ch + 1)));
+    }
+
+    void expectHeader(const juce::MemoryBlock& mb, int channels, int sampleRate, int bits, int dataBytes)
+    {
+        if (mb.getSize() < 44)
+        {
+            expect(false, "header too short");
+            return;
+        }
+
+        const auto* p = static_cast<const char*>(mb.getData());
+        auto u32 = [p](int offset) { return (int)juce::ByteOrder::littleEndianInt(p + offset); };
+        auto u16 = [p](int offset) { return (int)juce::ByteOrder::littleEndianShort(p + offset); };
+
+        expect(juce::String(p, 4) == "RIFF" && juce::String(p + 8, 4) == "WAVE");
+        expectEquals(u32(4), 36 + dataBytes);
+        expect(juce::String(p + 12, 4) == "fmt ");
+        expectEquals(u32(16), 16);
+        expectEquals(u16(20), bits == 32 ? 3 : 1);
+        expectEquals(u16(22), channels);
+        expectEquals(u32(24), sampleRate);
+        expectEquals(u32(28), sampleRate * channels * bits / 8);
+        expectEquals(u16(32), channels * bits / 8);
+        expectEquals(u16(34), bits);
+        expect(juce::String(p + 36, 4) == "data");
+        expectEquals(u32(40), dataBytes);
+    }
+
+    juce::AudioBuffer<float> readBack(const juce::MemoryBlock& mb)
+    {
+        juce::WavAudioFormat wav;
+        std::unique_ptr<juce::AudioFormatReader> reader(
+            wav.createReaderFor(new juce::MemoryInputStream(mb, false), true));
+
+        juce::AudioBuffer<float> b;
+        expect(reader != nullptr, "WavAudioFormat can't parse the output");
+        if (reader == nullptr)
+            return b;
+
+        b.setSize((int)reader->numChannels, (int)reader->lengthInSamples);
+        reader->read(&b, 0, b.getNumSamples(), 0, true, true);
+        return b;
+    }
+
+    void expectMatches(const juce::AudioBuffer<float>& expected, const juce::AudioBuffer<float>& actual, float tolerance)
+    {
+        expectEquals(actual.getNumSamples(), expected.getNumSamples());
+        if (actual.getNumSamples() != expected.getNumSamples() || actual.getNumChannels() != expected.getNumChannels())
+            return;
+
+        float worst = 0.0f;
+        for (int ch = 0; ch < expected.getNumChannels(); ++ch)
+            for (int i = 0; i < expected.getNumSamples(); ++i)
+                worst = juce::jmax(worst, std::abs(expected.getSample(ch, i) - actual.getSample(ch, i)));
+
+        expect(worst <= tolerance, "max error " + juce::String(worst));
+    }
+};
+
+static WavStreamWriterTests wavStreamWriterTests;
@@ -0,0 +1,138 @@
+// Source/TextLineStore.cpp
+#include "TextLineStore.h"
+
+TextLineStore::TextLineStore(int maxLinesInMemory, const juce::File& file)
+    : maxLines(juce::jmax(2 * linesPerChunk, maxLinesInMemory)),
+    spillFile(file)
+{
+}
+
+TextLineStore::~TextLineStore()
+{
+    spillOut.reset();
+
+    // The spill file only backs this view's scrollback
+    if (spillFile != juce::File())
+        spillFile.deleteFile();
+}
+
+void TextLineStore::append(const juce::String& line)
+{
+    if (chunks.empty() || (int)chunks.back().size() >= linesPerChunk)
+    {
+        chunks.emplace_back();
+        chunks.back().reserve((size_t)linesPerChunk);
+    }
+
+    chunks.back().push_back(line);
+    ++linesInMemory;
+
+    if (linesInMemory > maxLines)
+        evictOldestChunk();
+}
+
+void TextLineStore::clear()
+{
+    chunks.clear();
+    spilled.clear();
+    spillOut.reset();
+
+    if (spillFile != juce::File())
+        spillFile.deleteFile();
+
+    firstLine = spilledLines = linesInMemory = 0;
+    cachedChunk = (size_t)-1;
+    cachedLines.clear();
+}
+
+void TextLineStore::evictOldestChunk()
+{
+    auto& oldest = chunks.front();
+    const auto n = (juce::int64)oldest.size();
+
+    if (spillFile != juce::File())
+    {
+        if (!spillOut)
+        {
+            spillFile.getParentDirectory().createDirectory();
+            spillFile.deleteFile();
+            spillOut = spillFile.createOutputStream();
+        }
+
+        if (spillOut && spillOut->openedOk())
+        {
+            SpilledChunk c;
+            c.fileOffset = spillOut->getPosition();
+
+            for (const auto& l : oldest)
+            {
+                spillOut->writeText(l, false, false, nullptr);
+                spillOut->writeByte('\n');
+            }
+            spillOut->flush();
+
+            c.numBytes = spillOut->getPosition() - c.fileOffset;
+            spilled.push_back(c);
+            spilledLines += n;
+        }
+        else
+        {
+            // Can't spill any more; forget the on-disk part too so indices stay contiguous
+            firstLine += spilledLines + n;
+            spilledLines = 0;
+            spilled.clear();
+            cachedChunk = (size_t)-1;
+        }
+    }
+    else
+    {
+        firstLine += n;
+    }
+
+    linesInMemory -= n;
+    chunks.pop_front();
+}
+
+const juce::StringArray& TextLineStore::loadSpilledChunk(size_t chunk) const
+{
+    if (cachedChunk == chunk)
+        return cachedLines;
+
+    cachedChunk = chunk;
+    cachedLines.clear();
+
+    juce::FileInputStream in(spillFile);
+    if (in.openedOk() && in.setPosition(spilled[chunk].fileOffset))
+    {
+        juce::MemoryBlock mb;
+        in.readIntoMemoryBlock(mb, (ssize_t)spilled[chunk].numBytes);
+        cachedLines.addLines(mb.toString());
+    }
+
+    return cachedLines;
+}
+
+juce::String TextLineStore::getLine(juce::int64 index) const
+{
+    if (index < firstLine || index >= getNumLines())
+        return {};
+
+    auto i = index - firstLine;
+
+    if (i < spilledLines)
+    {
+        // Spilled chunks are always full, so the chunk is a division away
+        const auto chunk = (size_t)(i / linesPerChunk);
+        const auto& lines = loadSpilledChunk(chunk);
+        return lines[(int)(i % linesPerChunk)];
+    }
+
+    i -= spilledLines;
+
+    // Only the newest in-memory chunk can be partial
+    const auto chunk = (size_t)(i / linesPerChunk);
+    if (chunk >= chunks.size())
+        return {};
+
+    return chunks[chunk][(size_t)(i % linesPerChunk)];
+}
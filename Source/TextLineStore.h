@@ -0,0 +1,63 @@
+// Source/TextLineStore.h
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <deque>
+#include <memory>
+#include <vector>
+
+/** Append-only line storage for long-running views.
+ *
+ *  Lines live in fixed-size chunks. Once more than maxLinesInMemory are held, the
+ *  oldest full chunk is either written to a spill file (and read back on demand
+ *  when scrolled into view) or dropped. Appending is O(1) and memory stays bounded
+ *  however long the session runs.
+ */
+class TextLineStore
+{
+public:
+    static constexpr int linesPerChunk = 1024;
+
+    /** spillFile: where evicted chunks go; a default File drops them instead. */
+    explicit TextLineStore(int maxLinesInMemory = 64 * linesPerChunk, const juce::File& spillFile = {});
+    ~TextLineStore();
+
+    void append(const juce::String& line);
+    void clear();
+
+    // Index range currently addressable: [getFirstLineIndex(), getNumLines())
+    juce::int64 getNumLines() const { return firstLine + spilledLines + linesInMemory; }
+    juce::int64 getFirstLineIndex() const { return firstLine; }
+
+    // Empty string for dropped or unreadable lines
+    juce::String getLine(juce::int64 index) const;
+
+    juce::int64 getNumSpilledLines() const { return spilledLines; }
+    const juce::File& getSpillFile() const { return spillFile; }
+
+private:
+    struct SpilledChunk
+    {
+        juce::int64 fileOffset = 0;
+        juce::int64 numBytes = 0;
+    };
+
+    void evictOldestChunk();
+    const juce::StringArray& loadSpilledChunk(size_t chunk) const;
+
+    const int maxLines;
+    const juce::File spillFile;
+    std::unique_ptr<juce::FileOutputStream> spillOut;
+
+    std::deque<std::vector<juce::String>> chunks;   // in memory, oldest first
+    std::vector<SpilledChunk> spilled;               // on disk, oldest first
+    juce::int64 firstLine = 0;                       // lines dropped for good
+    juce::int64 spilledLines = 0;
+    juce::int64 linesInMemory = 0;
+
+    // Scrolling back through spilled history reads one chunk at a time
+    mutable size_t cachedChunk = (size_t)-1;
+    mutable juce::StringArray cachedLines;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TextLineStore)
+};
@@ -0,0 +1,247 @@
+// Source/Trace.cpp
+#include "Trace.h"
+#include <juce_events/juce_events.h>
+#include "third_party/whisper-ext.h"
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Trace
+{
+    namespace
+    {
+        struct Event
+        {
+            const char* category;
+            const char* name;
+            juce::int64 tsUs;
+            juce::int64 durUs;
+            juce::uint64 id;
+            char phase;          // 'X' complete, 'B'/'E' begin/end, 'b'/'e' async
+        };
+
+        /** Written only by its owning thread; readers validate against `written`
+         *  afterwards and drop anything that may have been overwritten meanwhile.
+         */
+        struct ThreadBuffer
+        {
+            std::vector<Event> events = std::vector<Event>((size_t)eventsPerThread);
+            std::atomic<juce::uint64> written{ 0 };
+            std::atomic<juce::uint64> clearedAt{ 0 };
+            std::atomic<const char*> label{ nullptr };
+            juce::String threadName;
+            int tid = 0;
+        };
+
+        struct Registry
+        {
+            std::mutex lock;
+            std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+            std::atomic<ThreadBuffer*> reserved{ nullptr };     // see reserveThread()
+            std::atomic<bool> recording{ WFW_ENABLE_TRACE != 0 };
+            const juce::int64 epochTicks = juce::Time::getHighResolutionTicks();
+        };
+
+        Registry& registry()
+        {
+            static Registry r;
+            return r;
+        }
+
+        thread_local ThreadBuffer* local = nullptr;
+
+        // Buffers are never freed, so events from finished threads stay exportable
+        ThreadBuffer& localBuffer()
+        {
+            if (local == nullptr)
+            {
+                auto b = std::make_unique<ThreadBuffer>();
+
+                if (auto* t = juce::Thread::getCurrentThread())
+                    b->threadName = t->getThreadName();
+                else if (juce::MessageManager::getInstanceWithoutCreating() != nullptr
+                         && juce::MessageManager::getInstanceWithoutCreating()->isThisTheMessageThread())
+                    b->threadName = "Message";
+
+                auto& r = registry();
+                std::lock_guard<std::mutex> sl(r.lock);
+                b->tid = (int)r.buffers.size() + 1;
+                if (b->threadName.isEmpty())
+                    b->threadName = "Thread " + juce::String(b->tid);
+
+                local = b.get();
+                r.buffers.push_back(std::move(b));
+            }
+            return *local;
+        }
+
+        void push(char phase, const char* category, const char* name, juce::int64 ts, juce::int64 dur, juce::uint64 id) noexcept
+        {
+            if (!registry().recording.load(std::memory_order_relaxed))
+                return;
+
+            auto& b = localBuffer();
+            const auto n = b.written.load(std::memory_order_relaxed);
+            auto& e = b.events[(size_t)(n % (juce::uint64)eventsPerThread)];
+            e.category = category;
+            e.name = name;
+            e.tsUs = ts;
+            e.durUs = dur;
+            e.id = id;
+            e.phase = phase;
+            b.written.store(n + 1, std::memory_order_release);
+        }
+
+        void writeEscaped(juce::MemoryOutputStream& out, const juce::String& s)
+        {
+            out << '"' << s.replace("\\", "\\\\").replace("\"", "\\\"") << '"';
+        }
+    }
+
+    juce::int64 nowMicros() noexcept
+    {
+        const auto ticks = juce::Time::getHighResolutionTicks() - registry().epochTicks;
+        return (juce::int64)(juce::Time::highResolutionTicksToSeconds(ticks) * 1.0e6);
+    }
+
+    void setRecording(bool shouldRecord) noexcept { registry().recording = shouldRecord; }
+    bool isRecording() noexcept                   { return registry().recording; }
+
+    void begin(const char* category, const char* name) noexcept { push('B', category, name, nowMicros(), 0, 0); }
+    void end(const char* category, const char* name) noexcept   { push('E', category, name, nowMicros(), 0, 0); }
+
+    void complete(const char* category, const char* name, juce::int64 startUs) noexcept
+    {
+        push('X', category, name, startUs, nowMicros() - startUs, 0);
+    }
+
+    void asyncBegin(const char* category, const char* name, juce::uint64 id) noexcept { push('b', category, name, nowMicros(), 0, id); }
+    void asyncEnd(const char* category, const char* name, juce::uint64 id) noexcept   { push('e', category, name, nowMicros(), 0, id); }
+
+    void nameThisThread(const char* name) noexcept
+    {
+        if (local == nullptr)
+        {
+            auto& r = registry();
+            auto* b = r.reserved.load(std::memory_order_acquire);
+            const char* reservedName = b != nullptr ? b->label.load(std::memory_order_relaxed) : nullptr;
+            if (reservedName != nullptr && std::strcmp(reservedName, name) == 0
+                && r.reserved.compare_exchange_strong(b, nullptr, std::memory_order_acq_rel))
+                local = b;
+        }
+
+        localBuffer().label.store(name, std::memory_order_relaxed);
+    }
+
+    void reserveThread(const char* name)
+    {
+        auto& r = registry();
+        if (r.reserved.load(std::memory_order_acquire) != nullptr)
+            return;
+
+        auto b = std::make_unique<ThreadBuffer>();
+        b->label.store(name, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> sl(r.lock);
+        b->tid = (int)r.buffers.size() + 1;
+        b->threadName = name;
+
+        auto* parked = b.get();
+        r.buffers.push_back(std::move(b));
+        r.reserved.store(parked, std::memory_order_release);
+    }
+
+    void installWhisperHooks()
+    {
+        whisper_ext_set_trace_callback([](const char* name, int isBegin, void*)
+            {
+                if (isBegin)
+                    begin("whisper", name);
+                else
+                    end("whisper", name);
+            }, nullptr);
+    }
+
+    juce::String exportChromeJson()
+    {
+        auto& r = registry();
+        std::lock_guard<std::mutex> sl(r.lock);
+
+        juce::MemoryOutputStream out;
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+
+        auto separator = [&]
+            {
+                if (!first)
+                    out << ",\n";
+                first = false;
+            };
+
+        const auto pid = (int)juce::Process::getCurrentProcessId();
+
+        for (auto& b : r.buffers)
+        {
+            const auto upTo = b->written.load(std::memory_order_acquire);
+            const auto cap = (juce::uint64)eventsPerThread;
+            const auto startIdx = juce::jmax(upTo > cap ? upTo - cap : 0, juce::jmin(upTo, b->clearedAt.load()));
+
+            std::vector<Event> copy;
+            copy.reserve((size_t)(upTo - startIdx));
+            for (auto i = startIdx; i < upTo; ++i)
+                copy.push_back(b->events[(size_t)(i % cap)]);
+
+            // The owner may have lapped us while copying; drop the overwritten head
+            const auto after = b->written.load(std::memory_order_acquire);
+            const auto firstValid = after > cap ? after - cap : 0;
+            const auto skip = (size_t)juce::jmin((juce::uint64)copy.size(), firstValid > startIdx ? firstValid - startIdx : 0);
+
+            const char* label = b->label.load(std::memory_order_relaxed);
+            separator();
+            out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << pid << ",\"tid\":" << b->tid << ",\"args\":{\"name\":";
+            writeEscaped(out, label != nullptr ? juce::String(label) : b->threadName);
+            out << "}}";
+
+            for (size_t i = skip; i < copy.size(); ++i)
+            {
+                const auto& e = copy[i];
+                separator();
+                out << "{\"ph\":\"" << juce::String::charToString(e.phase) << "\",\"cat\":";
+                writeEscaped(out, e.category);
+                out << ",\"name\":";
+                writeEscaped(out, e.name);
+                out << ",\"pid\":" << pid << ",\"tid\":" << b->tid << ",\"ts\":" << e.tsUs;
+
+                if (e.phase == 'X')
+                    out << ",\"dur\":" << e.durUs;
+                else if (e.phase == 'b' || e.phase == 'e')
+                    out << ",\"id\":\"0x" << juce::String::toHexString((juce::int64)e.id) << "\"";
+
+                out << "}";
+            }
+        }
+
+        out << "]}";
+        return out.toString();
+    }
+
+    bool exportChromeJson(const juce::File& target)
+    {
+        juce::TemporaryFile tmp(target);
+        if (!tmp.getFile().replaceWithText(exportChromeJson()))
+            return false;
+
+        return tmp.overwriteTargetFileWithTemporary();
+    }
+
+    void clear()
+    {
+        // Only moves the read window; owners keep writing from where they are
+        auto& r = registry();
+        std::lock_guard<std::mutex> sl(r.lock);
+        for (auto& b : r.buffers)
+            b->clearedAt.store(b->written.load(std::memory_order_acquire));
+    }
+}
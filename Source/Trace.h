@@ -0,0 +1,80 @@
+// Source/Trace.h
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+/** Timeline tracing across the audio, worker, ASR/MT and message threads.
+ *
+ *  Events go into a fixed-size ring buffer owned by the recording thread, so
+ *  the hot path is a clock read plus a few stores with no locks. exportChromeJson()
+ *  merges all buffers into the Chrome trace format (chrome://tracing, ui.perfetto.dev).
+ *
+ *  Compiled out unless WFW_ENABLE_TRACE=1 (CMake option WFW_ENABLE_TRACE); the
+ *  macros below then expand to nothing. Names and categories must be string
+ *  literals, the buffers only keep the pointers.
+ */
+#ifndef WFW_ENABLE_TRACE
+ #define WFW_ENABLE_TRACE 0
+#endif
+
+namespace Trace
+{
+    static constexpr int eventsPerThread = 16384;
+
+    // Recording can be paused at runtime; starts enabled when compiled in
+    void setRecording(bool shouldRecord) noexcept;
+    bool isRecording() noexcept;
+
+    void begin(const char* category, const char* name) noexcept;
+    void end(const char* category, const char* name) noexcept;
+    void complete(const char* category, const char* name, juce::int64 startUs) noexcept;
+
+    // Async spans may begin and end on different threads (e.g. queued jobs)
+    void asyncBegin(const char* category, const char* name, juce::uint64 id) noexcept;
+    void asyncEnd(const char* category, const char* name, juce::uint64 id) noexcept;
+
+    // Label for threads JUCE doesn't know about (the host's audio thread)
+    void nameThisThread(const char* name) noexcept;
+
+    // Sets up a buffer ahead of time, from any thread (prepareToPlay); the first thread to
+    // call nameThisThread() with the same name adopts it, so that thread never allocates
+    // or takes the registry lock when it first traces. One reservation is kept at a time.
+    void reserveThread(const char* name);
+
+    juce::int64 nowMicros() noexcept;
+
+    /** Forwards whisper.cpp's phase and ggml graph-compute markers into the trace. */
+    void installWhisperHooks();
+
+    // Chrome trace JSON ({"traceEvents": [...]}) of everything still in the buffers
+    juce::String exportChromeJson();
+    bool exportChromeJson(const juce::File& target);
+    void clear();
+
+    class Scope
+    {
+    public:
+        Scope(const char* c, const char* n) noexcept : category(c), name(n), start(nowMicros()) {}
+        ~Scope() { complete(category, name, start); }
+
+    private:
+        const char* category;
+        const char* name;
+        juce::int64 start;
+        JUCE_DECLARE_NON_COPYABLE(Scope)
+    };
+}
+
+#if WFW_ENABLE_TRACE
+ #define WFW_TRACE_SCOPE(category, name)          Trace::Scope JUCE_JOIN_MACRO(wfwTraceScope_, __LINE__) (category, name)
+ #define WFW_TRACE_ASYNC_BEGIN(category, name, id) Trace::asyncBegin(category, name, id)
+ #define WFW_TRACE_ASYNC_END(category, name, id)   Trace::asyncEnd(category, name, id)
+ #define WFW_TRACE_THREAD_NAME(name)               Trace::nameThisThread(name)
+ #define WFW_TRACE_RESERVE_THREAD(name)            Trace::reserveThread(name)
+#else
+ #define WFW_TRACE_SCOPE(category, name)
+ #define WFW_TRACE_ASYNC_BEGIN(category, name, id)
+ #define WFW_TRACE_ASYNC_END(category, name, id)
+ #define WFW_TRACE_THREAD_NAME(name)
+ #define WFW_TRACE_RESERVE_THREAD(name)
+#endif
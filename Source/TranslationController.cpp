@@ -1,11 +1,49 @@
+// Source/TranslationController.cpp
 #include "TranslationController.h"
+#include "EngineClient.h"
+#include "Metrics.h"
+#include "Trace.h"
 
-TranslationController::TranslationController()
+struct TranslationController::Channel
 {
-    whisper.setResultCallback([this](const juce::String& text)
+    Channel(int fifoSize, int segmentSize)
+        : fifo(fifoSize)
     {
-        asrResultHandler(text);
-    });
+        ring.setSize(1, fifoSize);
+        segment.setSize(1, segmentSize);
+    }
+
+    juce::AbstractFifo fifo;            // audio thread -> collector
+    juce::AudioBuffer<float> ring;
+    juce::AudioBuffer<float> segment;   // collector only
+    int segmentFill = 0;
+
+    std::atomic<bool> busy{ false };    // a segment of this channel is being transcribed
+    JobHandle inFlight;                 // collector only, like the two flags below
+    bool mayCancel = false;             // inFlight may still be superseded
+    bool cancelledLast = false;         // the previous segment was superseded
+
+    // Two-tier partials
+    int lastPartialFill = 0;            // collector only
+    JobHandle partialJob;               // collector only
+    std::atomic<bool> partialBusy{ false };
+    std::atomic<juce::uint64> finalFrom{ 0 };   // partials below this sequence are stale
+    juce::CriticalSection deliverLock;  // a partial's staleness check and delivery vs. any final
+    juce::uint64 nextSequence = 0;
+    std::atomic<juce::int64> dropped{ 0 };
+
+    std::atomic<int> mtPending{ 0 };    // results of this channel in translateQueue or being translated
+    juce::WaitableEvent mtDrained;      // mtPending reached 0
+
+    juce::CriticalSection textLock;
+    juce::String lastASR, lastTranslation;
+};
+
+TranslationController::TranslationController(WhisperEngine& asrEngine, TranslationEngine& mtEngine, int numAsrWorkers)
+    : whisper(asrEngine),
+    translator(mtEngine),
+    asrPool(juce::jmax(1, numAsrWorkers))
+{
 }
 
 TranslationController::~TranslationController()
@@ -13,105 +51,452 @@ TranslationController::~TranslationController()
     stop();
 }
 
-void TranslationController::prepare(double sampleRate, int numChannels, int blockSize)
+void TranslationController::prepare(double sampleRate, int numChannels, int blockSize, double segmentSeconds)
 {
-    whisper.prepare(sampleRate, numChannels, blockSize);
-}
+    jassert(!running.load());
 
-bool TranslationController::loadWhisperModel(const juce::File& modelFile)
-{
-    return whisper.loadModel(modelFile, [this](const juce::String& msg)
-    {
-        if (logCallback) logCallback(msg);
-    });
-}
+    inputRate = sampleRate > 0.0 ? sampleRate : 48000.0;
+    segmentSamples = juce::jmax(blockSize, (int)(segmentSeconds * inputRate));
 
-bool TranslationController::loadMarianModel(const juce::File& modelDir)
-{
-    return marian.loadModel(modelDir, [this](const juce::String& msg)
-    {
-        if (logCallback) logCallback(msg);
-    });
+    // Two segments of slack: one being filled, one waiting while the previous is transcribed
+    const int fifoSize = juce::jmax(blockSize * 4, segmentSamples * 2);
+
+    channels.clear();
+    for (int ch = 0; ch < juce::jmax(1, numChannels); ++ch)
+        channels.push_back(std::make_unique<Channel>(fifoSize, segmentSamples));
 }
 
 void TranslationController::start()
 {
-    if (isRunning.load())
+    if (channels.empty() || running.exchange(true))
         return;
 
-    isRunning.store(true);
-    whisper.startTranscription();
+    overload.reset();
+
+    if (twoTier.load() && !whisper.hasFallbackModel() && logCallback)
+        logCallback("[ASR] Two-tier mode without a fallback model; partials use the main model");
 
+    collectorThread = std::thread([this] { collectorLoop(); });
     translationThread = std::thread([this] { translationLoop(); });
 }
 
 void TranslationController::stop()
 {
-    if (! isRunning.load())
+    if (!running.exchange(false))
         return;
 
-    whisper.stop();
+    collectorWake.signal();
+    translationWake.signal();
 
-    isRunning.store(false);
-    queueCv.notify_all();
+    if (collectorThread.joinable())
+        collectorThread.join();
+
+    // Nobody will see these results; let the workers bail out at the next graph
+    for (auto& c : channels)
+    {
+        if (c->inFlight != nullptr)
+            c->inFlight->cancel();
+        if (c->partialJob != nullptr)
+            c->partialJob->cancel();
+    }
+
+    partialPool.removeAllJobs(true, 30000);
+    asrPool.removeAllJobs(true, 30000);
 
     if (translationThread.joinable())
         translationThread.join();
-}
 
-void TranslationController::pushAudio(const juce::AudioBuffer<float>& buffer)
-{
-    whisper.pushAudioBlock(buffer);
+    Result leftover;
+    while (translateQueue.tryPop(leftover))
+        Metrics::get().increment(Metrics::Counter::drops);
+
+    for (auto& c : channels)
+    {
+        c->fifo.reset();
+        c->segmentFill = 0;
+        c->busy = false;
+        c->inFlight.reset();
+        c->mayCancel = c->cancelledLast = false;
+        c->partialJob.reset();
+        c->partialBusy = false;
+        c->lastPartialFill = 0;
+        c->mtPending = 0;
+    }
 }
 
-void TranslationController::asrResultHandler(const juce::String& text)
+void TranslationController::pushAudio(const juce::AudioBuffer<float>& buffer) noexcept
 {
+    if (!running.load(std::memory_order_relaxed))
+        return;
+
+    const int numSamples = buffer.getNumSamples();
+    const int numChannels = juce::jmin(buffer.getNumChannels(), (int)channels.size());
+
+    for (int ch = 0; ch < numChannels; ++ch)
     {
-        std::lock_guard<std::mutex> lg(textMutex);
-        lastASR = text;
+        auto& c = *channels[(size_t)ch];
+
+        const int accepted = juce::jmin(numSamples, c.fifo.getFreeSpace());
+        int start1, size1, start2, size2;
+        c.fifo.prepareToWrite(accepted, start1, size1, start2, size2);
+
+        const float* src = buffer.getReadPointer(ch);
+        if (size1 > 0) juce::FloatVectorOperations::copy(c.ring.getWritePointer(0, start1), src, size1);
+        if (size2 > 0) juce::FloatVectorOperations::copy(c.ring.getWritePointer(0, start2), src + size1, size2);
+        c.fifo.finishedWrite(size1 + size2);
+
+        if (accepted < numSamples)
+            c.dropped.fetch_add(numSamples - accepted, std::memory_order_relaxed);
     }
+}
+
+void TranslationController::collectorLoop()
+{
+    WFW_TRACE_THREAD_NAME("TranslationController");
 
+    while (running.load())
     {
-        std::lock_guard<std::mutex> ql(queueMutex);
-        translateQueue.push(text);
+        collectorWake.wait(20);
+
+        // Overloaded: shorter segments, so each result waits for less audio
+        const int target = overload.isActive(OverloadController::Step::shortenWindows)
+            ? juce::jmax(1, segmentSamples / 2) : segmentSamples;
+
+        for (int ch = 0; ch < (int)channels.size(); ++ch)
+        {
+            auto& c = *channels[(size_t)ch];
+
+            // A busy channel keeps its full segment; the FIFO absorbs (or drops) the rest
+            if (c.segmentFill >= target && c.busy.load())
+            {
+                if (supersede.load() && c.mayCancel && c.fifo.getNumReady() >= target)
+                {
+                    c.inFlight->cancel();
+                    c.mayCancel = false;
+                    c.cancelledLast = true;
+                    if (logCallback) logCallback("[ASR] Channel " + juce::String(ch)
+                        + " is two segments behind; superseding the one in flight");
+                }
+                continue;
+            }
+
+            const int wanted = juce::jmin(c.fifo.getNumReady(), target - c.segmentFill);
+            if (wanted > 0)
+            {
+                int start1, size1, start2, size2;
+                c.fifo.prepareToRead(wanted, start1, size1, start2, size2);
+
+                float* dst = c.segment.getWritePointer(0, c.segmentFill);
+                if (size1 > 0) juce::FloatVectorOperations::copy(dst, c.ring.getReadPointer(0, start1), size1);
+                if (size2 > 0) juce::FloatVectorOperations::copy(dst + size1, c.ring.getReadPointer(0, start2), size2);
+                c.fifo.finishedRead(size1 + size2);
+                c.segmentFill += size1 + size2;
+            }
+
+            if (!c.busy.load() && (c.segmentFill >= target || (wanted > 0 && endsInPause(c))))
+            {
+                submitSegment(ch);
+                continue;
+            }
+
+            // Partial hypothesis over what this segment has so far, on the small model
+            if (twoTier.load() && !c.partialBusy.load()
+                && c.segmentFill - c.lastPartialFill >= (int)(partialHopMs.load() * inputRate / 1000.0))
+                submitPartial(ch);
+        }
     }
-    queueCv.notify_one();
 }
 
-void TranslationController::translationLoop()
+void TranslationController::submitSegment(int channelIndex)
 {
-    while (isRunning.load())
+    auto& c = *channels[(size_t)channelIndex];
+
+    juce::AudioBuffer<float> audio(1, c.segmentFill);
+    audio.copyFrom(0, 0, c.segment, 0, 0, c.segmentFill);
+    c.segmentFill = 0;
+
+    // The final is on its way (or the segment is dropped); a partial still running is moot
+    c.lastPartialFill = 0;
+    if (c.partialJob != nullptr)
+        c.partialJob->cancel();
+
+    // Silent channel (the other speaker is talking): don't spend a decoder on it
+    if (audio.getRMSLevel(0, 0, audio.getNumSamples()) < 1.0e-4f)
     {
-        juce::String textToTranslate;
+        finishWithoutText(channelIndex);
+        return;
+    }
 
+    // Last overload step: only segments that plausibly hold speech get a decoder
+    if (!overload.shouldTranscribe(audio))
+    {
+        Metrics::get().increment(Metrics::Counter::drops);
+        finishWithoutText(channelIndex);
+        return;
+    }
+
+    const auto sequence = c.nextSequence++;
+    c.finalFrom = sequence + 1;
+    c.busy = true;
+    c.inFlight = makeJobHandle();
+    c.mayCancel = !c.cancelledLast;
+    c.cancelledLast = false;
+    Metrics::get().increment(Metrics::Counter::jobsQueued);
+
+    asrPool.addJob([this, channelIndex, sequence, audio = std::move(audio), job = c.inFlight,
+                    submittedMs = juce::Time::getMillisecondCounterHiRes()]
         {
-            std::unique_lock<std::mutex> lk(queueMutex);
-            queueCv.wait(lk, [this]
+            auto& ch = *channels[(size_t)channelIndex];
+            WFW_TRACE_SCOPE("queue", "channelSegment");
+
+            const double startMs = juce::Time::getMillisecondCounterHiRes();
+            const auto options = overload.getJobOptions();
+
+            // Client mode: the daemon's models, transcript and translation in one round trip
+            auto service = std::atomic_load(&engineClient);
+            const bool remote = service != nullptr && service->isConnected();
+
+            // Marian missing or falling behind: let Whisper translate on the encoding it already has
+            const bool wantTranslation = translate.load();
+            const bool marianAvailable = translator.isReady()
+                && translateQueue.approximateSize() < translateQueue.capacity() / 2;
+            const bool useWhisper = !remote && wantTranslation && !marianAvailable && whisperFallback.load();
+
+            WhisperEngine::JobStats stats;
+            juce::String text, english;
+            if (remote)
+            {
+                WFW_TRACE_SCOPE("asr", "engineService");
+                stats.succeeded = service->transcribeSync(audio, inputRate, wantTranslation, text, english);
+                text = text.trim();
+                english = english.trim();
+            }
+            else if (useWhisper)
+            {
+                auto dual = whisper.transcribeAndTranslate(audio, inputRate, nullptr, logCallback, &stats, job.get(), &options);
+                text = dual.transcript.trim();
+                english = dual.english.trim();
+            }
+            else
             {
-                return ! translateQueue.empty() || ! isRunning.load();
-            });
+                text = whisper.transcribe(audio, inputRate, nullptr, logCallback, &stats, job.get(), &options).trim();
+            }
 
-            if (! isRunning.load())
-                break;
+            // Superseded: its text is stale even if it finished first
+            if (job->isCancelled())
+            {
+                text.clear();
+            }
+            else
+            {
+                Metrics::get().increment(Metrics::jobOutcome(stats.succeeded, text.isNotEmpty()));
+
+                const double endMs = juce::Time::getMillisecondCounterHiRes();
+                if (overload.jobFinished(audio.getNumSamples() / inputRate, startMs - submittedMs, endMs - startMs)
+                    && logCallback)
+                {
+                    logCallback("[ASR] Overload level " + juce::String(overload.getLevel()) + ": "
+                        + overload.describe() + " (RTF " + juce::String(overload.getRealTimeFactor(), 2) + ")");
+                }
+            }
 
-            if (! translateQueue.empty())
+            if (text.isNotEmpty())
             {
-                textToTranslate = translateQueue.front();
-                translateQueue.pop();
+                {
+                    const juce::ScopedLock sl(ch.textLock);
+                    ch.lastASR = text;
+                }
+
+                Result r;
+                r.channel = channelIndex;
+                r.sequence = sequence;
+                r.asr = text;
+
+                if (useWhisper || (remote && english.isNotEmpty()))
+                {
+                    r.translated = english;
+                    r.whisperTranslation = useWhisper;
+
+                    const juce::ScopedLock sl(ch.textLock);
+                    ch.lastTranslation = english;
+                }
+
+                if (wantTranslation && translator.isReady() && !useWhisper && !remote)
+                {
+                    ++ch.mtPending;
+                    if (translateQueue.tryPush(std::move(r)))
+                        translationWake.signal();
+                    else
+                    {
+                        --ch.mtPending;
+                        Metrics::get().increment(Metrics::Counter::drops);
+                        if (logCallback) logCallback("[MT] Translation queue full; channel "
+                            + juce::String(channelIndex) + " segment delivered untranslated");
+                        deliverInOrder(ch, Result{ channelIndex, sequence, text, {} });
+                    }
+                }
+                else
+                {
+                    deliverInOrder(ch, std::move(r));
+                }
             }
-        }
+            else if (twoTier.load())
+            {
+                // Cancelled or nothing heard: still take this segment's partial off the screen
+                deliverInOrder(ch, Result{ channelIndex, sequence, {}, {} });
+            }
+
+            ch.busy = false;
+            collectorWake.signal();
+        });
+}
+
+void TranslationController::finishWithoutText(int channelIndex)
+{
+    if (!twoTier.load())
+        return;
+
+    // An empty final: partials still running for this segment go stale, the shown one is cleared
+    auto& c = *channels[(size_t)channelIndex];
+    const auto sequence = c.nextSequence++;
+    c.finalFrom = sequence + 1;
+    deliver(Result{ channelIndex, sequence, {}, {} });
+}
+
+bool TranslationController::endsInPause(const Channel& c) const
+{
+    // Only in two-tier mode, and only once there is an utterance worth finalising
+    const int pause = (int)(0.3 * inputRate);
+    if (!twoTier.load() || c.segmentFill < (int)inputRate + pause)
+        return false;
+
+    const float whole = c.segment.getRMSLevel(0, 0, c.segmentFill);
+    const float tail = c.segment.getRMSLevel(0, c.segmentFill - pause, pause);
+    return whole >= 1.0e-4f && tail < 0.15f * whole;
+}
+
+void TranslationController::submitPartial(int channelIndex)
+{
+    auto& c = *channels[(size_t)channelIndex];
+    c.lastPartialFill = c.segmentFill;
+
+    // Client mode without local weights: nothing here to draft a partial with
+    if (!whisper.hasFallbackModel() && !whisper.isReady())
+        return;
+
+    if (c.segment.getRMSLevel(0, 0, c.segmentFill) < 1.0e-4f)
+        return;
+
+    juce::AudioBuffer<float> audio(1, c.segmentFill);
+    audio.copyFrom(0, 0, c.segment, 0, 0, c.segmentFill);
+
+    const auto sequence = c.nextSequence;
+    c.partialJob = makeJobHandle();
+    c.partialBusy = true;
+
+    partialPool.addJob([this, channelIndex, sequence, audio = std::move(audio), job = c.partialJob]
+        {
+            auto& ch = *channels[(size_t)channelIndex];
+            WFW_TRACE_SCOPE("queue", "channelPartial");
+
+            // Latency over accuracy: the final re-does this on the main model anyway
+            WhisperEngine::JobOptions options;
+            options.useFallbackModel = true;
+            options.fastDecode = true;
+            options.trimAudioContext = true;
 
-        if (textToTranslate.isEmpty())
+            const auto text = whisper.transcribe(audio, inputRate, nullptr, nullptr, nullptr, job.get(), &options).trim();
+
+            if (text.isNotEmpty() && !job->isCancelled() && ch.finalFrom.load() <= sequence)
+            {
+                Result r;
+                r.channel = channelIndex;
+                r.sequence = sequence;
+                r.asr = text;
+                r.isFinal = false;
+                deliver(std::move(r));
+            }
+
+            ch.partialBusy = false;
+            collectorWake.signal();
+        });
+}
+
+void TranslationController::translationLoop()
+{
+    WFW_TRACE_THREAD_NAME("TranslationController MT");
+
+    while (running.load())
+    {
+        Result r;
+        if (!translateQueue.tryPop(r))
+        {
+            translationWake.wait(50);
             continue;
+        }
 
-        auto translated = marian.translate(textToTranslate);
+        WFW_TRACE_SCOPE("mt", "translate");
+        r.translated = translator.translate(r.asr, logCallback);
 
+        auto& c = *channels[(size_t)r.channel];
         {
-            std::lock_guard<std::mutex> lg(textMutex);
-            lastTranslation = translated;
+            const juce::ScopedLock sl(c.textLock);
+            c.lastTranslation = r.translated;
         }
 
-        if (uiCallback)
-            uiCallback(textToTranslate, translated);
+        deliver(std::move(r));
+
+        if (--c.mtPending == 0)
+            c.mtDrained.signal();
     }
 }
+
+void TranslationController::deliver(Result&& r)
+{
+    // finalFrom moves before a segment's final is delivered, so under this lock a partial
+    // either lands before that final or sees it is stale; it can never land after
+    auto& c = *channels[(size_t)r.channel];
+    const juce::ScopedLock sl(c.deliverLock);
+
+    if (!r.isFinal && c.finalFrom.load() > r.sequence)
+        return;
+
+    if (resultCallback)
+        resultCallback(r);
+}
+
+void TranslationController::deliverInOrder(Channel& c, Result&& r)
+{
+    // A final that skips Marian must not overtake this channel's earlier ones still queued
+    // for it. The channel is busy meanwhile, so at most one segment waits here.
+    while (c.mtPending.load() > 0 && running.load())
+        c.mtDrained.wait(50);
+
+    deliver(std::move(r));
+}
+
+juce::String TranslationController::getLastASR(int channel) const
+{
+    if (!juce::isPositiveAndBelow(channel, (int)channels.size()))
+        return {};
+
+    auto& c = *channels[(size_t)channel];
+    const juce::ScopedLock sl(c.textLock);
+    return c.lastASR;
+}
+
+juce::String TranslationController::getLastTranslation(int channel) const
+{
+    if (!juce::isPositiveAndBelow(channel, (int)channels.size()))
+        return {};
+
+    auto& c = *channels[(size_t)channel];
+    const juce::ScopedLock sl(c.textLock);
+    return c.lastTranslation;
+}
+
+juce::int64 TranslationController::getNumDropped(int channel) const
+{
+    return juce::isPositiveAndBelow(channel, (int)channels.size())
+        ? channels[(size_t)channel]->dropped.load() : 0;
+}
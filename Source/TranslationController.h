@@ -1,58 +1,143 @@
+// Source/TranslationController.h
 #pragma once
 
 #include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
 #include <functional>
 #include <atomic>
 #include <memory>
 #include <thread>
-#include <queue>
-#include <mutex>
-#include <condition_variable>
+#include <vector>
 #include "WhisperEngine.h"
-#include "MarianEngine.h"
+#include "TranslationEngine.h"
+#include "MpmcQueue.h"
+#include "OverloadController.h"
 
+class EngineClient;
+
+/** Real-time multi-channel ASR + MT core.
+ *
+ *  Every input channel (one speaker per channel in interview recordings) has its
+ *  own FIFO and segmenter. Segments from different channels are transcribed in
+ *  parallel on a shared pool against the same engines; within a channel at most
+ *  one segment is in flight, so results per channel arrive in order. Transcripts
+ *  go to the translator through a bounded lock-free queue.
+ *
+ *  The engines are owned (and loaded) by the caller and must outlive the controller.
+ */
 class TranslationController
 {
 public:
-    using LogCallback = std::function<void(const juce::String&)>;
-    using UiCallback  = std::function<void(const juce::String& asr, const juce::String& translated)>;
+    struct Result
+    {
+        int channel = 0;
+        juce::uint64 sequence = 0;      // per-channel segment number
+        juce::String asr, translated;   // translated is empty without a translator
+        bool whisperTranslation = false;  // translated came from Whisper's own X->English task
+        bool isFinal = true;            // false: a partial hypothesis the final of this sequence replaces
+                                        // (a final with empty asr: no text, only clears the partial)
+    };
 
-    TranslationController();
-    ~TranslationController();
+    using LogCallback    = std::function<void(const juce::String&)>;
+    using ResultCallback = std::function<void(const Result&)>;
 
-    void prepare(double sampleRate, int numChannels, int blockSize);
+    TranslationController(WhisperEngine& asrEngine, TranslationEngine& mtEngine, int numAsrWorkers = 2);
+    ~TranslationController();
 
-    bool loadWhisperModel(const juce::File& modelFile);
-    bool loadMarianModel(const juce::File& modelDir);
+    /** Allocates per-channel state. Call while stopped (e.g. from prepareToPlay). */
+    void prepare(double sampleRate, int numChannels, int blockSize, double segmentSeconds = 5.0);
 
     void start();
     void stop();
+    bool isRunning() const noexcept { return running.load(); }
+
+    /** Realtime-safe: copies each channel into its own FIFO. Channels beyond
+     *  the prepared count are ignored; overflow is dropped and counted.
+     */
+    void pushAudio(const juce::AudioBuffer<float>& buffer) noexcept;
+
+    void setLogCallback(LogCallback cb) { logCallback = std::move(cb); }
+    void setResultCallback(ResultCallback cb) { resultCallback = std::move(cb); }
+    void setTranslate(bool b) noexcept { translate = b; }
+
+    /** When the translator has no model or its queue is more than half full, transcribe
+     *  with WhisperEngine::transcribeAndTranslate() and deliver Whisper's English instead
+     *  (one encoder pass for both). Only useful when English is the target language.
+     */
+    void setWhisperTranslationFallback(bool b) noexcept { whisperFallback = b; }
 
-    void pushAudio(const juce::AudioBuffer<float>& buffer);
+    /** Client mode: while client is connected, finals are transcribed (and translated, with
+     *  the daemon's Marian) by the shared engine daemon instead of the local engines, which
+     *  take over again whenever it isn't. Partials stay local and need a local model.
+     *  nullptr = local engines only.
+     */
+    void setEngineClient(std::shared_ptr<EngineClient> client) { std::atomic_store(&engineClient, std::move(client)); }
 
-    void setUiCallback(UiCallback cb) { uiCallback = std::move(cb); }
+    /** When a channel's in-flight segment falls two windows behind (the next segment is
+     *  waiting and the FIFO holds another), cancel it so the worker moves on to current
+     *  audio. Never twice in a row, so a machine slower than real time still delivers.
+     *  On by default.
+     */
+    void setSupersedeStaleSegments(bool b) noexcept { supersede = b; }
 
-    juce::String getLastASR() const { return lastASR; }
-    juce::String getLastTranslation() const { return lastTranslation; }
+    /** Tracks the real-time factor of finished segments and degrades step by step while
+     *  ASR falls behind: half-length segments, cheaper decoding, the fallback model, then
+     *  dropping quiet segments. Configure its policy before start().
+     */
+    OverloadController& getOverloadController() noexcept { return overload; }
+
+    /** Two-tier mode: while a segment fills, the engine's fallback model transcribes what has
+     *  arrived so far every partialHopSeconds and delivers it as a partial Result (untranslated,
+     *  isFinal false). Segments also end early at a pause, and the main model's final Result
+     *  for the segment replaces its partials; a segment that yields no text (silent, dropped,
+     *  cancelled or empty) gets a final with empty asr instead. Needs
+     *  WhisperEngine::loadFallbackModel().
+     */
+    void setTwoTier(bool enabled, double partialHopSeconds = 0.5) noexcept
+    {
+        partialHopMs = juce::jmax(100.0, partialHopSeconds * 1000.0);
+        twoTier = enabled;
+    }
+    bool isTwoTier() const noexcept { return twoTier.load(); }
+
+    int getNumChannels() const noexcept { return (int)channels.size(); }
+    juce::String getLastASR(int channel) const;
+    juce::String getLastTranslation(int channel) const;
+    juce::int64 getNumDropped(int channel) const;
 
 private:
-    void asrResultHandler(const juce::String& text);
+    struct Channel;
+
+    void collectorLoop();
     void translationLoop();
+    void submitSegment(int channelIndex);
+    void submitPartial(int channelIndex);
+    void finishWithoutText(int channelIndex);
+    bool endsInPause(const Channel& c) const;
+    void deliver(Result&& r);
+    void deliverInOrder(Channel& c, Result&& r);
 
-    WhisperEngine whisper;
-    MarianEngine marian;
+    WhisperEngine& whisper;
+    TranslationEngine& translator;
+    std::shared_ptr<EngineClient> engineClient;     // atomic_load/atomic_store only
 
     LogCallback logCallback;
-    UiCallback uiCallback;
+    ResultCallback resultCallback;
+
+    double inputRate = 48000.0;
+    int segmentSamples = 0;
+    std::vector<std::unique_ptr<Channel>> channels;
+
+    juce::ThreadPool asrPool;
+    juce::ThreadPool partialPool{ 1 };   // small model only; never waits behind a final
+    std::thread collectorThread, translationThread;
+    juce::WaitableEvent collectorWake, translationWake;
 
-    std::thread translationThread;
-    std::atomic<bool> isRunning { false };
+    MpmcQueue<Result> translateQueue{ 256 };
+    OverloadController overload;
 
-    mutable std::mutex textMutex;
-    juce::String lastASR, lastTranslation;
+    std::atomic<bool> running{ false }, translate{ true }, whisperFallback{ false }, supersede{ true }, twoTier{ false };
+    std::atomic<double> partialHopMs{ 500.0 };
 
-    // Queue for texts to translate
-    std::mutex queueMutex;
-    std::condition_variable queueCv;
-    std::queue<juce::String> translateQueue;
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TranslationController)
 };
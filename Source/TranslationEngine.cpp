@@ -1,15 +1,12 @@
 // Source/TranslationEngine.cpp
 #include "TranslationEngine.h"
+#include "TranslationWorker.h"
 
 TranslationEngine::TranslationEngine() = default;
 
 TranslationEngine::~TranslationEngine()
 {
-    if (translator != nullptr)
-    {
-        marianDestroyTranslator(translator);
-        translator = nullptr;
-    }
+    std::atomic_store(&translator, std::shared_ptr<MarianTranslator>());
 }
 
 bool TranslationEngine::initialise(const juce::File& modelDir, juce::String& errorMessage)
@@ -21,34 +18,59 @@ bool TranslationEngine::initialise(const juce::File& modelDir, juce::String& err
     }
 
     char errorBuf[512] = {};
-    translator = marianCreateTranslator(modelDir.getFullPathName().toRawUTF8(),
+    auto* created = marianCreateTranslator(modelDir.getFullPathName().toRawUTF8(),
         errorBuf,
         (int)sizeof(errorBuf));
 
-    if (translator == nullptr)
+    if (created == nullptr)
     {
         errorMessage = "Marian initialisation failed: " + juce::String(errorBuf);
         return false;
     }
 
+    std::atomic_store(&translator, std::shared_ptr<MarianTranslator>(created, marianDestroyTranslator));
+
     errorMessage.clear();
     return true;
 }
 
-juce::String TranslationEngine::translate(const juce::String& input, std::function<void(const juce::String&)> logCb)
+bool TranslationEngine::isUsingWorker() const noexcept
+{
+    auto* w = worker.load();
+    return w != nullptr && w->isRunning();
+}
+
+juce::String TranslationEngine::translate(const juce::String& input, std::function<void(const juce::String&)> logCb,
+    int* numOutputTokens, const JobToken* cancel)
 {
-    if (translator == nullptr)
+    if (cancel != nullptr && cancel->isCancelled())
+        return {};
+
+    if (auto* w = worker.load(); w != nullptr && w->isRunning())
+    {
+        juce::String result;
+        if (w->translateSync(input, result, 30000, numOutputTokens) && result.isNotEmpty())
+            return result;
+
+        if (logCb)
+            logCb("[MT] Worker translation failed" + juce::String(std::atomic_load(&translator) != nullptr ? ", using in-process model" : ""));
+    }
+
+    // Hold the model for this call so a concurrent swap can't free it underneath us
+    const auto current = std::atomic_load(&translator);
+    if (current == nullptr)
         return input;
 
     constexpr int kMaxOut = 8192;
     char outBuf[kMaxOut] = {};
 
     const juce::String inUtf8 = input;
-    const bool ok = marianTranslate(translator,
+    const bool ok = marianTranslate(current.get(),
         inUtf8.toRawUTF8(),
         outBuf,
         kMaxOut,
-        logCb);
+        logCb,
+        numOutputTokens);
 
     if (!ok || outBuf[0] == '\0')
         return input;
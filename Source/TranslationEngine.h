@@ -2,7 +2,12 @@
 #pragma once
 
 #include <juce_core/juce_core.h>
+#include <atomic>
+#include <memory>
 #include "marian_c_api.h"
+#include "JobHandle.h"
+
+class TranslationWorker;
 
 class TranslationEngine
 {
@@ -10,12 +15,25 @@ public:
     TranslationEngine();
     ~TranslationEngine();
 
+    // Sends translate() to an out-of-process worker while it runs (requests made during a
+    // respawn wait for it); the in-process model, if any, covers requests the worker fails.
+    // nullptr goes back to in-process only. The worker must outlive its use here.
+    void setWorker(TranslationWorker* w) noexcept { worker.store(w); }
+    bool isUsingWorker() const noexcept;
+
+    // Loads a new model and swaps it in atomically. Translations already running
+    // finish on the previous model, which is destroyed once the last of them returns.
     bool initialise(const juce::File& modelDir, juce::String& errorMessage);
-    bool isReady() const noexcept { return translator != nullptr; }
+    bool isReady() const noexcept { return isUsingWorker() || std::atomic_load(&translator) != nullptr; }
 
+    // Returns input unchanged on failure, or empty if cancel was set before the call
+    // reached the model.
     juce::String translate(const juce::String& input,
-        std::function<void(const juce::String&)> logCb);
+        std::function<void(const juce::String&)> logCb,
+        int* numOutputTokens = nullptr,
+        const JobToken* cancel = nullptr);
 
 private:
-    MarianTranslator* translator = nullptr;
+    std::shared_ptr<MarianTranslator> translator;
+    std::atomic<TranslationWorker*> worker{ nullptr };
 };
@@ -1,6 +1,10 @@
+// Source/TranslationWorker.cpp
 #include "TranslationWorker.h"
+#include "Trace.h"
 
-TranslationWorker::TranslationWorker()
+TranslationWorker::TranslationWorker(LogFn logCallback)
+    : juce::Thread("MTWorkerWatchdog"),
+    logCb(std::move(logCallback))
 {
 }
 
@@ -9,108 +13,267 @@ TranslationWorker::~TranslationWorker()
     stopWorker();
 }
 
-bool TranslationWorker::startWorker(const juce::File& pythonExe,
-                                    const juce::File& scriptFile,
-                                    std::function<void(const juce::String&)> logCallback)
+bool TranslationWorker::startWorker(const juce::File& workerExe,
+                                    const juce::String& modelDir)
 {
-    logCb = logCallback;
+    stopWorker();
+
+    exe = workerExe;
+    model = modelDir;
 
-    if (!pythonExe.existsAsFile())
+    if (!exe.existsAsFile())
     {
-        if (logCb) logCb("[TranslationWorker] Python executable not found: " + pythonExe.getFullPathName());
+        if (logCb) logCb("[TranslationWorker] Worker executable not found: " + exe.getFullPathName());
         return false;
     }
 
-    if (!scriptFile.existsAsFile())
+    running = true;
+
+    if (!launch())
     {
-        if (logCb) logCb("[TranslationWorker] translation_worker.py not found: " + scriptFile.getFullPathName());
+        running = false;
+        if (logCb) logCb("[TranslationWorker] Failed to start worker process.");
         return false;
     }
 
-    stopWorker();
+    startThread();
 
-    process = std::make_unique<juce::ChildProcess>();
+    if (logCb) logCb("[TranslationWorker] Worker started (" + model + ")");
+    return true;
+}
 
-    juce::StringArray args;
-    args.add(pythonExe.getFullPathName());
-    args.add(scriptFile.getFullPathName());
+void TranslationWorker::stopWorker()
+{
+    if (!running.exchange(false))
+        return;
 
-    if (!process->start(args))
-    {
-        if (logCb) logCb("[TranslationWorker] Failed to start Python worker.");
-        process = nullptr;
+    if (logCb) logCb("[TranslationWorker] Stopping worker...");
+
+    signalThreadShouldExit();
+    connectionLost.signal();
+    notify();
+    stopThread(15000); // may be inside a launch (10 s connect timeout)
+
+    killWorkerProcess();
+    connected = false;
+    modelReady = false;
+    modelReported.signal();
+
+    failAll("worker stopped");
+}
+
+bool TranslationWorker::launch()
+{
+    if (!launchWorkerProcess(exe, MTProtocol::commandLineUID, 10000, 0))
         return false;
+
+    connected = true;
+    modelReady = false;
+    modelReported.reset();
+    sendMessageToWorker(MTProtocol::makeLoad(model));
+
+    // Re-send whatever was in flight when the previous process went away
+    std::vector<Pending> failed;
+    {
+        const juce::ScopedLock sl(pendingLock);
+
+        for (auto it = pending.begin(); it != pending.end();)
+        {
+            if (it->second.attempts >= maxAttempts)
+            {
+                failed.push_back(std::move(it->second));
+                it = pending.erase(it);
+                continue;
+            }
+
+            ++it->second.attempts;
+            sendMessageToWorker(MTProtocol::makeTranslate(it->first, it->second.text));
+            ++it;
+        }
     }
 
-    workerRunning = true;
-    startTimer(50);  // poll stdout every 50ms
+    for (auto& p : failed)
+        if (p.onResult) p.onResult(false, "worker crashed twice on this request", 0);
 
-    if (logCb) logCb("[TranslationWorker] Worker started.");
     return true;
 }
 
-void TranslationWorker::stopWorker()
+void TranslationWorker::run()
 {
-    if (process != nullptr)
+    int backoffMs = 250;
+
+    while (!threadShouldExit())
     {
-        if (logCb) logCb("[TranslationWorker] Stopping worker...");
-        workerRunning = false;
-        stopTimer();
-        process->kill();
-        process = nullptr;
+        if (!connectionLost.wait(500))
+            continue;
+
+        while (!threadShouldExit() && running && !connected)
+        {
+            wait(backoffMs);
+            if (threadShouldExit())
+                break;
+
+            killWorkerProcess();
+
+            if (launch())
+            {
+                ++respawns;
+                backoffMs = 250;
+                if (logCb) logCb("[TranslationWorker] Worker respawned (#" + juce::String(respawns.load()) + ")");
+            }
+            else
+            {
+                backoffMs = juce::jmin(backoffMs * 2, 5000);
+                if (logCb) logCb("[TranslationWorker] Respawn failed, retrying in " + juce::String(backoffMs) + " ms");
+            }
+        }
     }
 }
 
-void TranslationWorker::translate(const juce::String& text,
-                                  std::function<void(const juce::String&)> onResult)
+void TranslationWorker::handleConnectionLost()
 {
-    if (!workerRunning || process == nullptr)
+    connected = false;
+    modelReady = false;
+
+    if (running)
     {
-        if (logCb) logCb("[TranslationWorker] translate(): worker is not running.");
+        if (logCb) logCb("[TranslationWorker] Worker died.");
+        connectionLost.signal();
+    }
+}
+
+void TranslationWorker::handleMessageFromWorker(const juce::MemoryBlock& block)
+{
+    MTProtocol::Message m;
+    if (!MTProtocol::decode(block, m))
+    {
+        if (logCb) logCb("[TranslationWorker] Malformed frame (" + juce::String((int)block.getSize()) + " bytes)");
         return;
     }
 
-    onResultCb = onResult;
+    switch (m.kind)
+    {
+        case MTProtocol::Kind::ready:
+            modelReady = m.ok;
+            modelReported.signal();
+            if (logCb) logCb(m.ok ? "[TranslationWorker] Model ready: " + m.text
+                                  : "[TranslationWorker] Model load failed: " + m.text);
+            break;
 
-    juce::DynamicObject::Ptr obj = new juce::DynamicObject();
-    obj->setProperty("text", text);
+        case MTProtocol::Kind::result:
+        {
+            Pending p;
+            {
+                const juce::ScopedLock sl(pendingLock);
+                auto it = pending.find(m.id);
+                if (it == pending.end())
+                    return; // failed or stopped meanwhile
 
-    juce::var json(juce::var(obj.get()));
-    juce::String line = juce::JSON::toString(json) + "\n";
+                p = std::move(it->second);
+                pending.erase(it);
+            }
 
-    /*if (!process->writeToProcessInput(line))
-    {
-        if (logCb) logCb("[TranslationWorker] Failed to write to python stdin");
-    }*/
+            WFW_TRACE_ASYNC_END("mt", "remote", m.id);
+            if (p.onResult) p.onResult(m.ok, m.text, m.numTokens);
+            break;
+        }
+
+        case MTProtocol::Kind::log:
+            if (logCb) logCb("[MTWorker] " + m.text);
+            break;
+
+        case MTProtocol::Kind::load:
+        case MTProtocol::Kind::translate:
+            break;
+    }
 }
 
-void TranslationWorker::timerCallback()
+juce::uint32 TranslationWorker::translate(const juce::String& text, ResultFn onResult)
 {
-    if (!workerRunning || process == nullptr)
-        return;
+    if (!running)
+    {
+        if (logCb) logCb("[TranslationWorker] translate(): worker is not running.");
+        return 0;
+    }
+
+    const juce::ScopedLock sl(pendingLock);
+
+    const auto id = nextId++;
+    if (nextId == 0)
+        nextId = 1;
+
+    auto& p = pending[id];
+    p.text = text;
+    p.onResult = std::move(onResult);
 
-    juce::String output = process->readAllProcessOutput().trim();
+    WFW_TRACE_ASYNC_BEGIN("mt", "remote", id);
 
-    if (output.isNotEmpty())
+    // While disconnected the request waits here; launch() sends it after the respawn
+    if (connected && sendMessageToWorker(MTProtocol::makeTranslate(id, text)))
+        p.attempts = 1;
+
+    return id;
+}
+
+bool TranslationWorker::waitForModel(int timeoutMs)
+{
+    return running && modelReported.wait(timeoutMs) && modelReady;
+}
+
+bool TranslationWorker::translateSync(const juce::String& text, juce::String& result, int timeoutMs,
+                                      int* numOutputTokens)
+{
+    struct State
     {
-        if (logCb) logCb("[TranslationWorker] >>> " + output);
+        juce::WaitableEvent done;
+        bool ok = false;
+        juce::String text;
+        int numTokens = 0;
+    };
+
+    auto state = std::make_shared<State>();
 
-        juce::var parsed = juce::JSON::parse(output);
-        if (auto* obj = parsed.getDynamicObject())
+    const auto id = translate(text, [state](bool ok, const juce::String& t, int numTokens)
         {
-            juce::String translated = obj->getProperty("translated").toString();
-            if (translated.isNotEmpty() && onResultCb)
-            {
-                onResultCb(translated);
-            }
-        }
+            state->ok = ok;
+            state->text = t;
+            state->numTokens = numTokens;
+            state->done.signal();
+        });
+
+    if (id == 0)
+        return false;
+
+    if (!state->done.wait(timeoutMs))
+    {
+        const juce::ScopedLock sl(pendingLock);
+        pending.erase(id);
+        return false;
     }
 
-    // Also detect worker death
-    if (!process->isRunning())
+    result = state->text;
+    if (numOutputTokens != nullptr)
+        *numOutputTokens = state->numTokens;
+    return state->ok;
+}
+
+int TranslationWorker::getNumInFlight() const
+{
+    const juce::ScopedLock sl(pendingLock);
+    return (int)pending.size();
+}
+
+void TranslationWorker::failAll(const juce::String& reason)
+{
+    std::map<juce::uint32, Pending> failed;
     {
-        workerRunning = false;
-        stopTimer();
-        if (logCb) logCb("[TranslationWorker] Worker died.");
+        const juce::ScopedLock sl(pendingLock);
+        failed.swap(pending);
+    }
+
+    for (auto& [id, p] : failed)
+    {
+        juce::ignoreUnused(id);
+        if (p.onResult) p.onResult(false, reason, 0);
     }
 }
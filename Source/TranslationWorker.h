@@ -1,32 +1,86 @@
+// Source/TranslationWorker.h
 #pragma once
 #include <juce_core/juce_core.h>
 #include <juce_events/juce_events.h>
-#include <juce_audio_basics/juce_audio_basics.h>
+#include <map>
+#include "MTProtocol.h"
 
-class TranslationWorker : private juce::Timer
+/** Out-of-process translation backend.
+ *
+ *  Runs the MT runtime in WhisperFreeWinMTWorker so a crash there can't take the
+ *  host down. Requests carry ids and any number may be in flight; the worker
+ *  batches them. If the worker dies it is respawned (with backoff), the model is
+ *  reloaded and outstanding requests are re-sent once before being failed.
+ *
+ *  Result callbacks run on the IPC thread, never the message thread.
+ */
+class TranslationWorker : private juce::ChildProcessCoordinator,
+                          private juce::Thread
 {
 public:
-    TranslationWorker();
+    using LogFn = std::function<void(const juce::String&)>;
+    using ResultFn = std::function<void(bool ok, const juce::String& text, int numTokens)>;
+
+    // logCallback is fixed for the worker's lifetime: translate() may be logging through it
+    // from any thread while the process is restarted underneath
+    explicit TranslationWorker(LogFn logCallback = nullptr);
     ~TranslationWorker() override;
 
-    // Launch Python worker
-    bool startWorker(const juce::File& pythonExe,
-                     const juce::File& scriptFile,
-                     std::function<void(const juce::String&)> logCallback);
+    // Launches the worker and loads modelDir (or MTProtocol::echoModel for the stub)
+    bool startWorker(const juce::File& workerExe,
+                     const juce::String& modelDir);
 
-    // Stop the worker process
+    // Stops the worker process; outstanding requests fail
     void stopWorker();
 
-    // Send text to translate (non-blocking)
-    void translate(const juce::String& text,
-                   std::function<void(const juce::String&)> onResult);
+    bool isRunning() const noexcept { return running.load(); }
+    bool isModelLoaded() const noexcept { return modelReady.load(); }
+
+    // Blocks until the worker reports its model load; true if it loaded
+    bool waitForModel(int timeoutMs);
+
+    // Queues text for translation (non-blocking). Returns the request id, 0 if not running.
+    juce::uint32 translate(const juce::String& text, ResultFn onResult);
+
+    // Blocking helper on top of translate(); returns false on failure or timeout
+    bool translateSync(const juce::String& text, juce::String& result, int timeoutMs = 10000,
+                       int* numOutputTokens = nullptr);
+
+    int getNumInFlight() const;
+    int getNumRespawns() const noexcept { return respawns.load(); }
 
 private:
-    void timerCallback() override;   // Polls python output
+    struct Pending
+    {
+        juce::String text;
+        ResultFn onResult;
+        int attempts = 0;
+    };
+
+    static constexpr int maxAttempts = 2;
+
+    // ChildProcessCoordinator
+    void handleMessageFromWorker(const juce::MemoryBlock&) override;
+    void handleConnectionLost() override;
+
+    // Watchdog: respawns the worker after a lost connection
+    void run() override;
+
+    bool launch();
+    void failAll(const juce::String& reason);
+
+    juce::File exe;
+    juce::String model;
+    const LogFn logCb;
+
+    mutable juce::CriticalSection pendingLock;
+    std::map<juce::uint32, Pending> pending;
+    juce::uint32 nextId = 1;
 
-    std::unique_ptr<juce::ChildProcess> process;
-    std::function<void(const juce::String&)> onResultCb;
-    std::function<void(const juce::String&)> logCb;
+    std::atomic<bool> running{ false }, connected{ false }, modelReady{ false };
+    std::atomic<int> respawns{ 0 };
+    juce::WaitableEvent connectionLost;
+    juce::WaitableEvent modelReported{ true };  // manual reset: set by each ready message
 
-    bool workerRunning = false;
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TranslationWorker)
 };
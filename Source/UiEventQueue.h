@@ -0,0 +1,153 @@
+// Source/UiEventQueue.h
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include <map>
+#include "MpmcQueue.h"
+#include "Metrics.h"
+
+/** Worker -> UI hand-off. Any thread may post; the editor drains it on a timer.
+ *
+ *  Log lines, transcripts and translations go through a bounded lock-free ring;
+ *  progress is a single coalesced value. Partial transcripts are keyed (per live
+ *  channel) and a drain keeps only the newest per key, since each one replaces
+ *  the last. Nothing here touches the message queue,
+ *  so a chatty worker can't flood the host GUI, and posting never blocks.
+ */
+class UiEventQueue
+{
+public:
+    enum class Type
+    {
+        log,
+        transcript,
+        translation,
+        partial
+    };
+
+    struct Event
+    {
+        Type type = Type::log;
+        juce::String text;
+        int key = 0;                    // partial: which live line it replaces
+        juce::int64 wallTimeMs = 0;     // for the log timestamp
+        double postedMs = 0.0;          // hi-res, for the ui_delivery metric
+    };
+
+    /** What one drain produced, batched so each view gets at most one append per frame. */
+    struct Batch
+    {
+        juce::String logText;           // all new log lines, already timestamped
+        juce::String transcript;        // new results, one per line
+        juce::String translation;
+        std::map<int, juce::String> partials;   // newest per key; empty text clears the line
+        bool hasTranscript = false, hasTranslation = false;
+        bool hasProgress = false;
+        double progress = 0.0;
+        int numEvents = 0;
+    };
+
+    explicit UiEventQueue(size_t capacity = 4096) : ring(capacity) {}
+
+    void postLog(const juce::String& s)           { post(Type::log, s); }
+    void postTranscript(const juce::String& s)    { post(Type::transcript, s); }
+    void postTranslation(const juce::String& s)   { post(Type::translation, s); }
+    void postPartial(int key, const juce::String& s) { post(Type::partial, s, key); }
+
+    void postProgress(double p) noexcept
+    {
+        progress.store(p, std::memory_order_relaxed);
+        progressDirty.store(true, std::memory_order_release);
+    }
+
+    /** Pops up to maxEvents so one frame's UI work stays bounded even after a burst. */
+    Batch drain(int maxEvents = 1024)
+    {
+        Batch b;
+        const double now = juce::Time::getMillisecondCounterHiRes();
+
+        if (progressDirty.exchange(false, std::memory_order_acquire))
+        {
+            b.hasProgress = true;
+            b.progress = progress.load(std::memory_order_relaxed);
+        }
+
+        const auto dropped = droppedLogs.exchange(0, std::memory_order_relaxed);
+        if (dropped > 0)
+            b.logText << "[UI] " << juce::String(dropped) << " log lines dropped (UI not keeping up)\n";
+
+        Event e;
+        while (b.numEvents < maxEvents && ring.tryPop(e))
+        {
+            ++b.numEvents;
+            Metrics::get().record(Metrics::Stage::uiDelivery, now - e.postedMs);
+
+            switch (e.type)
+            {
+                case Type::log:
+                    b.logText << "[" << juce::Time(e.wallTimeMs).formatted("%H:%M:%S") << "] " << e.text << "\n";
+                    break;
+                case Type::transcript:
+                    b.transcript << e.text << "\n";
+                    b.hasTranscript = true;
+                    break;
+                case Type::translation:
+                    b.translation << e.text << "\n";
+                    b.hasTranslation = true;
+                    break;
+                case Type::partial:
+                    b.partials[e.key] = e.text;
+                    break;
+            }
+        }
+
+        return b;
+    }
+
+private:
+    void post(Type type, const juce::String& text, int key = 0)
+    {
+        Event e;
+        e.type = type;
+        e.text = text;
+        e.key = key;
+        e.wallTimeMs = juce::Time::currentTimeMillis();
+        e.postedMs = juce::Time::getMillisecondCounterHiRes();
+
+        if (ring.tryPush(std::move(e)))
+            return;
+
+        // Ring full (no editor open, or it's far behind). Log lines are shed with a
+        // count; results evict the oldest entry so the latest one is never lost.
+        if (type == Type::log)
+        {
+            droppedLogs.fetch_add(1, std::memory_order_relaxed);
+            Metrics::get().increment(Metrics::Counter::drops);
+            return;
+        }
+
+        for (int attempt = 0; attempt < 4; ++attempt)
+        {
+            Event evicted;
+            if (ring.tryPop(evicted))
+            {
+                Metrics::get().increment(Metrics::Counter::drops);
+                if (evicted.type == Type::log)
+                    droppedLogs.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            if (ring.tryPush(std::move(e)))
+                return;
+        }
+
+        Metrics::get().increment(Metrics::Counter::drops);
+    }
+
+    MpmcQueue<Event> ring;
+    std::atomic<double> progress{ 0.0 };
+    std::atomic<bool> progressDirty{ false };
+    std::atomic<juce::int64> droppedLogs{ 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(UiEventQueue)
+};
@@ -0,0 +1,302 @@
+// Source/VirtualTextView.cpp
+#include "VirtualTextView.h"
+
+VirtualTextView::VirtualTextView(int maxLinesInMemory, const juce::File& spillFile)
+    : store(maxLinesInMemory, spillFile)
+{
+    setColour(backgroundColourId, juce::Colours::white);
+    setColour(textColourId, juce::Colours::black);
+    setColour(highlightColourId, juce::Colours::lightblue);
+    setOpaque(true);
+    setWantsKeyboardFocus(true);
+    setMouseCursor(juce::MouseCursor::IBeamCursor);
+
+    scrollBar.setAutoHide(false);
+    scrollBar.setSingleStepSize(1.0);
+    scrollBar.addListener(this);
+    addAndMakeVisible(scrollBar);
+}
+
+void VirtualTextView::append(const juce::String& text)
+{
+    auto lines = juce::StringArray::fromLines(text);
+    if (text.endsWithChar('\n') && !lines.isEmpty())
+        lines.remove(lines.size() - 1);
+
+    for (const auto& l : lines)
+        addLine(l);
+
+    updateScrollBar();
+    repaint();
+}
+
+void VirtualTextView::addLine(const juce::String& line)
+{
+    if (wrapColumn <= 0 || line.length() <= wrapColumn)
+    {
+        store.append(line);
+        return;
+    }
+
+    // Break at the last space before the column where there is one
+    auto rest = line;
+    while (rest.length() > wrapColumn)
+    {
+        int cut = rest.substring(0, wrapColumn).lastIndexOfChar(' ');
+        if (cut <= wrapColumn / 2)
+            cut = wrapColumn;
+
+        store.append(rest.substring(0, cut));
+        rest = rest.substring(cut).trimStart();
+    }
+
+    if (rest.isNotEmpty())
+        store.append(rest);
+}
+
+void VirtualTextView::clear()
+{
+    store.clear();
+    anchor = caret = {};
+    followTail = true;
+    updateScrollBar();
+    repaint();
+}
+
+void VirtualTextView::setFont(const juce::Font& f)
+{
+    font = f;
+    updateScrollBar();
+    repaint();
+}
+
+int VirtualTextView::getNumVisibleLines() const
+{
+    return juce::jmax(1, (int)((float)getHeight() / font.getHeight()));
+}
+
+void VirtualTextView::updateScrollBar()
+{
+    const auto first = (double)store.getFirstLineIndex();
+    const auto total = (double)store.getNumLines();
+    const auto visible = (double)getNumVisibleLines();
+
+    scrollBar.setRangeLimits(first, juce::jmax(first + visible, total), juce::dontSendNotification);
+
+    if (followTail)
+        scrollBar.setCurrentRange(juce::jmax(first, total - visible), visible, juce::dontSendNotification);
+    else
+        scrollBar.setCurrentRange(juce::jmax(first, scrollBar.getCurrentRangeStart()), visible, juce::dontSendNotification);
+}
+
+juce::Rectangle<int> VirtualTextView::getTextArea() const
+{
+    return getLocalBounds().withTrimmedRight(scrollBar.getWidth()).reduced(4, 0);
+}
+
+void VirtualTextView::paint(juce::Graphics& g)
+{
+    g.fillAll(findColour(backgroundColourId));
+    g.setFont(font);
+
+    const auto lineHeight = font.getHeight();
+    const auto textArea = getTextArea();
+    const auto firstVisible = (juce::int64)scrollBar.getCurrentRangeStart();
+    const auto end = juce::jmin(store.getNumLines(), firstVisible + getNumVisibleLines() + 1);
+
+    const bool selecting = hasSelection();
+    const auto selStart = juce::jmin(anchor, caret), selEnd = juce::jmax(anchor, caret);
+
+    float y = 0.0f;
+    for (auto i = firstVisible; i < end; ++i, y += lineHeight)
+    {
+        const auto line = store.getLine(i);
+
+        if (selecting && i >= selStart.line && i <= selEnd.line)
+        {
+            const float x0 = i == selStart.line ? columnToX(line, selStart.column) : 0.0f;
+            const float x1 = i == selEnd.line ? columnToX(line, selEnd.column) : (float)textArea.getWidth();
+            g.setColour(findColour(highlightColourId));
+            g.fillRect(juce::Rectangle<float>((float)textArea.getX() + x0, y, juce::jmax(2.0f, x1 - x0), lineHeight));
+        }
+
+        g.setColour(findColour(textColourId));
+        g.drawText(line, juce::Rectangle<float>((float)textArea.getX(), y, (float)textArea.getWidth(), lineHeight),
+            juce::Justification::centredLeft, true);
+    }
+}
+
+void VirtualTextView::resized()
+{
+    scrollBar.setBounds(getLocalBounds().removeFromRight(12));
+    updateScrollBar();
+}
+
+void VirtualTextView::mouseWheelMove(const juce::MouseEvent&, const juce::MouseWheelDetails& wheel)
+{
+    if (wheel.deltaY != 0.0f)
+        scrollBar.moveScrollbarInSteps(wheel.deltaY < 0 ? 3 : -3);
+}
+
+float VirtualTextView::columnToX(const juce::String& line, int column) const
+{
+    return font.getStringWidthFloat(line.substring(0, column));
+}
+
+VirtualTextView::Position VirtualTextView::positionAt(juce::Point<int> p) const
+{
+    Position pos;
+    if (store.getNumLines() <= store.getFirstLineIndex())
+        return pos;
+
+    const auto row = (juce::int64)std::floor((float)p.y / font.getHeight());
+    pos.line = juce::jlimit(store.getFirstLineIndex(), store.getNumLines() - 1,
+        (juce::int64)scrollBar.getCurrentRangeStart() + row);
+
+    // Above the first line or below the last: the start or end of the line
+    const auto line = store.getLine(pos.line);
+    if (p.y < 0 && pos.line == store.getFirstLineIndex())
+        return pos;
+    if (row >= store.getNumLines() - (juce::int64)scrollBar.getCurrentRangeStart())
+    {
+        pos.column = line.length();
+        return pos;
+    }
+
+    // Nearest gap between characters; lines are at most wrapColumn long
+    const float x = (float)(p.x - getTextArea().getX());
+    float left = 0.0f;
+    for (int i = 0; i < line.length(); ++i)
+    {
+        const float right = columnToX(line, i + 1);
+        if (x < (left + right) * 0.5f)
+            break;
+        pos.column = i + 1;
+        left = right;
+    }
+    return pos;
+}
+
+bool VirtualTextView::hasSelection() const noexcept
+{
+    return anchor.line >= 0 && caret.line >= 0 && (anchor.line != caret.line || anchor.column != caret.column);
+}
+
+juce::String VirtualTextView::getSelectedText() const
+{
+    if (!hasSelection())
+        return {};
+
+    auto start = juce::jmin(anchor, caret);
+    const auto end = juce::jmax(anchor, caret);
+
+    // Lines dropped from the store since they were selected are gone for good
+    if (start.line < store.getFirstLineIndex())
+        start = { store.getFirstLineIndex(), 0 };
+
+    juce::String text;
+    for (auto i = start.line; i <= end.line && i < store.getNumLines(); ++i)
+    {
+        const auto line = store.getLine(i);
+        const int from = i == start.line ? start.column : 0;
+        const int to = i == end.line ? end.column : line.length();
+
+        if (i > start.line)
+            text << juce::newLine;
+        text << line.substring(from, to);
+    }
+    return text;
+}
+
+void VirtualTextView::selectAll()
+{
+    if (store.getNumLines() <= store.getFirstLineIndex())
+        return;
+
+    anchor = { store.getFirstLineIndex(), 0 };
+    caret = { store.getNumLines() - 1, store.getLine(store.getNumLines() - 1).length() };
+    repaint();
+}
+
+void VirtualTextView::copy() const
+{
+    if (hasSelection())
+        juce::SystemClipboard::copyTextToClipboard(getSelectedText());
+}
+
+void VirtualTextView::mouseDown(const juce::MouseEvent& e)
+{
+    grabKeyboardFocus();
+
+    if (e.mods.isPopupMenu())
+    {
+        juce::PopupMenu menu;
+        menu.addItem(1, "Copy", hasSelection());
+        menu.addItem(2, "Select All", store.getNumLines() > store.getFirstLineIndex());
+
+        juce::Component::SafePointer<VirtualTextView> safe(this);
+        menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(this), [safe](int result)
+            {
+                if (safe == nullptr)
+                    return;
+                if (result == 1) safe->copy();
+                if (result == 2) safe->selectAll();
+            });
+        return;
+    }
+
+    caret = positionAt(e.getPosition());
+    if (!e.mods.isShiftDown() || anchor.line < 0)
+        anchor = caret;
+    repaint();
+}
+
+void VirtualTextView::mouseDrag(const juce::MouseEvent& e)
+{
+    if (e.mods.isPopupMenu() || anchor.line < 0)
+        return;
+
+    // Dragging past the top or bottom scrolls history into view
+    if (e.y < 0)
+        scrollBar.moveScrollbarInSteps(-1);
+    else if (e.y > getHeight())
+        scrollBar.moveScrollbarInSteps(1);
+
+    caret = positionAt(e.getPosition());
+    repaint();
+}
+
+void VirtualTextView::mouseDoubleClick(const juce::MouseEvent& e)
+{
+    const auto p = positionAt(e.getPosition());
+    if (p.line < 0)
+        return;
+
+    anchor = { p.line, 0 };
+    caret = { p.line, store.getLine(p.line).length() };
+    repaint();
+}
+
+bool VirtualTextView::keyPressed(const juce::KeyPress& key)
+{
+    if (key == juce::KeyPress('c', juce::ModifierKeys::commandModifier, 0)
+        || key == juce::KeyPress(juce::KeyPress::insertKey, juce::ModifierKeys::ctrlModifier, 0))
+    {
+        copy();
+        return true;
+    }
+
+    if (key == juce::KeyPress('a', juce::ModifierKeys::commandModifier, 0))
+    {
+        selectAll();
+        return true;
+    }
+
+    return false;
+}
+
+void VirtualTextView::scrollBarMoved(juce::ScrollBar*, double newRangeStart)
+{
+    followTail = newRangeStart + scrollBar.getCurrentRangeSize() >= scrollBar.getMaximumRangeLimit() - 0.5;
+    repaint();
+}
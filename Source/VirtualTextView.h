@@ -0,0 +1,79 @@
+// Source/VirtualTextView.h
+#pragma once
+
+#include <juce_gui_basics/juce_gui_basics.h>
+#include "TextLineStore.h"
+
+/** Read-only, append-only text view that only lays out and paints the visible lines.
+ *  Replaces juce::TextEditor for logs and transcripts, whose append cost and memory
+ *  grow with the document. Long lines are soft-wrapped at append time at a fixed
+ *  column so appends stay O(1) and resizing never re-flows history.
+ *
+ *  Text can be selected with the mouse (drag, shift-click, double-click for a line) and
+ *  copied with Ctrl/Cmd-C or the right-click menu; the copy reads from the store, spilled
+ *  history included. Wrapped lines copy as the separate lines they were stored as.
+ */
+class VirtualTextView : public juce::Component,
+    private juce::ScrollBar::Listener
+{
+public:
+    explicit VirtualTextView(int maxLinesInMemory = 64 * TextLineStore::linesPerChunk,
+        const juce::File& spillFile = {});
+
+    // Text may contain several lines; a trailing newline doesn't add an empty one
+    void append(const juce::String& text);
+    void clear();
+
+    void setFont(const juce::Font& f);
+    void setWrapColumn(int numChars) { wrapColumn = juce::jmax(0, numChars); }
+
+    enum ColourIds
+    {
+        backgroundColourId = 0x2f10001,
+        textColourId       = 0x2f10002,
+        highlightColourId  = 0x2f10003
+    };
+
+    juce::int64 getNumLines() const { return store.getNumLines(); }
+
+    bool hasSelection() const noexcept;
+    juce::String getSelectedText() const;
+    void selectAll();
+    void copy() const;
+
+    void paint(juce::Graphics&) override;
+    void resized() override;
+    void mouseWheelMove(const juce::MouseEvent&, const juce::MouseWheelDetails&) override;
+    void mouseDown(const juce::MouseEvent&) override;
+    void mouseDrag(const juce::MouseEvent&) override;
+    void mouseDoubleClick(const juce::MouseEvent&) override;
+    bool keyPressed(const juce::KeyPress&) override;
+
+private:
+    // A caret position: before character column of line
+    struct Position
+    {
+        juce::int64 line = -1;
+        int column = 0;
+
+        bool operator<(const Position& o) const noexcept { return line != o.line ? line < o.line : column < o.column; }
+    };
+
+    Position positionAt(juce::Point<int> p) const;
+    float columnToX(const juce::String& line, int column) const;
+    juce::Rectangle<int> getTextArea() const;
+
+    void scrollBarMoved(juce::ScrollBar*, double newRangeStart) override;
+    void updateScrollBar();
+    void addLine(const juce::String& line);
+    int getNumVisibleLines() const;
+
+    TextLineStore store;
+    juce::ScrollBar scrollBar{ true };
+    juce::Font font{ 14.0f };
+    int wrapColumn = 160;
+    bool followTail = true;     // stick to the bottom until the user scrolls up
+    Position anchor, caret;     // selection between the two, in either order
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(VirtualTextView)
+};
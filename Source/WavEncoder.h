@@ -3,11 +3,15 @@
 #include <juce_audio_basics/juce_audio_basics.h>
 #include <juce_audio_formats/juce_audio_formats.h>
 
+#include "AudioBlockOps.h"
+#include "WavStreamWriter.h"
+
 /**
  * Asynchronous, thread-safe WAV encoder.
- * - Deep-copies input (no races)
- * - Sanitizes NaN/Inf
- * - Writes in chunks to avoid huge single memcpy
+ * - Deep-copies input (no races), downmixing to mono in the same pass
+ * - Sanitizes NaN/Inf while converting
+ * - Streams into a preallocated memory block, no temp file
+ * - Runs on the shared AudioBlockOps worker pool
  * - Calls onDone on the JUCE message thread
  */
 class WavEncoderAsync
@@ -16,6 +20,37 @@ public:
     using LogFn = std::function<void(const juce::String&)>;
     using DoneFn = std::function<void(const juce::MemoryBlock&)>;
 
+    /** Synchronous core of encode(): chunked WAV write of a mono buffer into memory.
+     *  Throws std::runtime_error if the writer can't be created.
+     */
+    static juce::MemoryBlock encodeMono(const juce::AudioBuffer<float>& mono,
+        double sampleRate,
+        int bitsPerSample,
+        int chunkSamples,
+        const LogFn& log)
+    {
+        juce::MemoryBlock result;
+        const int total = mono.getNumSamples();
+
+        auto writer = WavStreamWriter::toMemory(result, sampleRate, 1, bitsPerSample, total);
+        if (!writer)
+            throw std::runtime_error("WavStreamWriter::toMemory failed");
+
+        const float* ch = mono.getReadPointer(0);
+        for (int pos = 0; pos < total; pos += chunkSamples)
+        {
+            const float* p = ch + pos;
+            writer->write(&p, juce::jmin(chunkSamples, total - pos));
+        }
+
+        writer->finish();
+
+        if (log && writer->getNumSanitised() > 0)
+            log("[WAV] Sanitized " + juce::String(writer->getNumSanitised()) + " samples");
+
+        return result;
+    }
+
     void encode(const juce::AudioBuffer<float>& input,
         double sampleRate,
         LogFn onLog,
@@ -23,8 +58,6 @@ public:
         int bitsPerSample = 16,
         int chunkSamples = 16384 /* ~0.34s @ 48k */)
     {
-        if (onLog)  onLog("[WAV] Async encode request...");
-
         if (input.getNumSamples() <= 0 || sampleRate <= 0.0)
         {
             if (onLog) onLog("[WAV] Invalid input or sampleRate");
@@ -33,7 +66,7 @@ public:
             return;
         }
 
-        // Build a job payload (shared across thread)
+        // Build a job payload (shared with the pool job)
         struct Job {
             juce::AudioBuffer<float> mono;
             double sampleRate = 16000.0;
@@ -44,18 +77,11 @@ public:
         };
         auto job = std::make_shared<Job>();
 
-        // Convert to mono (deep copy)
+        // Downmix into our own copy (one SIMD pass)
         const int n = input.getNumSamples();
-        const int chans = juce::jmax(1, input.getNumChannels());
-        job->mono.setSize(1, n);
-        job->mono.clear();
-        for (int ch = 0; ch < chans; ++ch)
-            job->mono.addFrom(0, 0, input, ch, 0, n, 1.0f / float(chans));
-
-        // Sanitize
-        int fixed = 0;
-        auto* d = job->mono.getWritePointer(0);
-        for (int i = 0; i < n; ++i) { float s = d[i]; if (!std::isfinite(s)) { d[i] = 0.0f; ++fixed; } }
+        job->mono.setSize(1, n, false, false, true);
+        AudioBlockOps::downmixToMono(input.getArrayOfReadPointers(), input.getNumChannels(), 0,
+            job->mono.getWritePointer(0), n);
 
         job->sampleRate = sampleRate;
         job->chunk = juce::jmax(512, chunkSamples);
@@ -64,66 +90,25 @@ public:
         job->done = std::move(onDone);
 
         if (job->log)
-        {
             job->log("[WAV] Encoding started (1 ch, " + juce::String(n) +
                 " samples @ " + juce::String(sampleRate) + " Hz)");
-            if (fixed > 0) job->log("[WAV] Sanitized " + juce::String(fixed) + " samples");
-        }
 
-        // Fire background work
-        std::thread([job]()
+        AudioBlockOps::getWorkerPool().addJob([job]()
             {
                 try
                 {
-                    auto memStream = std::make_shared<juce::MemoryOutputStream>();
-                    juce::WavAudioFormat wav;
-
-                    if (job->log) job->log("[WAV] Creating writer...");
-                    std::unique_ptr<juce::AudioFormatWriter> writer(
-                        wav.createWriterFor(memStream.get(),
-                            (int)job->sampleRate,
-                            1,
-                            job->bits,
-                            {},
-                            0));
-
-                    if (!writer)
-                        throw std::runtime_error("createWriterFor failed");
-
-                    if (job->log)
-                        job->log("[WAV] Writer OK. Header size = " + juce::String(memStream->getDataSize()) + " bytes");
-
-                    // Chunked write
-                    const int total = job->mono.getNumSamples();
-                    int pos = 0;
-                    while (pos < total)
-                    {
-                        const int toWrite = juce::jmin(job->chunk, total - pos);
-                        if (job->log)
-                            job->log("[WAV] Writing chunk " + juce::String(pos) + " .. " + juce::String(pos + toWrite));
+                    juce::MemoryBlock result = encodeMono(job->mono, job->sampleRate, job->bits, job->chunk, job->log);
 
-                        writer->writeFromAudioSampleBuffer(job->mono, pos, toWrite);
-                        pos += toWrite;
-                    }
-
-                    writer->flush();
-                    writer.reset();
-
-                    const auto finalSize = memStream->getDataSize();
                     if (job->log)
-                        job->log("[WAV] Finished. Total stream size = " + juce::String(finalSize) + " bytes");
-
-                    juce::MemoryBlock result = memStream->getMemoryBlock();
+                        job->log("[WAV] Done (" + juce::String(result.getSize() / 1024.0, 2) + " KB)");
 
                     // Hand back on the message thread
                     if (job->done)
                     {
-                        juce::MessageManager::callAsync([done = job->done, result]() {
+                        juce::MessageManager::callAsync([done = job->done, result = std::move(result)]() {
                             done(result);
                             });
                     }
-                    if (job->log)
-                        job->log("[WAV] Done (" + juce::String(result.getSize() / 1024.0, 2) + " KB)");
                 }
                 catch (const std::exception& e)
                 {
@@ -137,6 +122,6 @@ public:
                     if (job->done)
                         juce::MessageManager::callAsync([done = job->done] { juce::MemoryBlock m; done(m); });
                 }
-            }).detach();
+            });
     }
 };
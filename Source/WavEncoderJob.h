@@ -3,62 +3,61 @@
 #include <juce_audio_basics/juce_audio_basics.h>
 #include <juce_audio_formats/juce_audio_formats.h>
 
+#include "AudioBlockOps.h"
+#include "WavStreamWriter.h"
+
 /** Cancellable, chunked WAV encoder (safe for long clips, Debug-friendly).
  *  Use startEncode(...). Call stopEncode() in your destructor.
+ *  Runs as a job on the shared AudioBlockOps worker pool and streams straight
+ *  into memory, so there's no thread per job and no temp-file round trip.
  */
-class WavEncoderJob : public juce::Thread
+class WavEncoderJob
 {
 public:
     using LogFn = std::function<void(const juce::String&)>;
     using DoneFn = std::function<void(const juce::MemoryBlock&)>;
 
-    WavEncoderJob() : juce::Thread("WavEncoderJob") {}
-    ~WavEncoderJob() override { stopEncode(); }
+    WavEncoderJob() = default;
+    ~WavEncoderJob() { stopEncode(); }
 
     void startEncode(const juce::AudioBuffer<float>& input,
         double sampleRate,
         LogFn onLog,
         DoneFn onDone,
         int bitsPerSample = 16,
-        int chunkSamples = 16384,
-        bool diskFallback = true)
+        int chunkSamples = 16384)
     {
         stopEncode();
 
-        job = std::make_shared<Job>();
+        auto job = std::make_shared<Job>();
         job->sr = sampleRate;
         job->bits = bitsPerSample;
         job->chunk = juce::jlimit(1024, 131072, chunkSamples);
-        job->disk = diskFallback;
         job->log = std::move(onLog);
         job->done = std::move(onDone);
 
+        // Downmix into our own copy (one SIMD pass); NaN/Inf are fixed while writing
         const int n = input.getNumSamples();
-        const int c = juce::jmax(1, input.getNumChannels());
-        job->mono.setSize(1, n);
-        job->mono.clear();
-        for (int ch = 0; ch < c; ++ch)
-            job->mono.addFrom(0, 0, input, ch, 0, n, 1.0f / float(c));
-
-        // sanitize NaN/Inf
-        int fixed = 0;
-        auto* w = job->mono.getWritePointer(0);
-        for (int i = 0; i < n; ++i) { float s = w[i]; if (!std::isfinite(s)) { w[i] = 0.0f; ++fixed; } }
+        job->mono.setSize(1, n, false, false, true);
+        AudioBlockOps::downmixToMono(input.getArrayOfReadPointers(), input.getNumChannels(), 0,
+            job->mono.getWritePointer(0), n);
+
         if (job->log)
-        {
             job->log("[WAV] Job queued (" + juce::String(n) + " samples @ " + juce::String(sampleRate) + " Hz)");
-            if (fixed > 0) job->log("[WAV] Sanitized " + juce::String(fixed) + " samples");
-        }
 
-        shouldCancel = false;
-        startThread(); // will call run()
+        runner = std::make_unique<Runner>(job);
+        AudioBlockOps::getWorkerPool().addJob(runner.get(), false);
     }
 
     void stopEncode()
     {
-        shouldCancel = true;
-        stopThread(4000);
-        job.reset();
+        if (runner == nullptr)
+            return;
+
+        // Interrupt, then wait however long it takes: the pool may still be running it, and
+        // it checks shouldExit() every chunk, so that is never long
+        AudioBlockOps::getWorkerPool().removeJob(runner.get(), true, -1);
+        runner.reset();
     }
 
 private:
@@ -67,82 +66,60 @@ private:
         double sr = 16000.0;
         int bits = 16;
         int chunk = 16384;
-        bool disk = true;
         LogFn  log;
         DoneFn done;
     };
 
-    std::shared_ptr<Job> job;
-    std::atomic<bool> shouldCancel{ false };
-
-    void run() override
+    class Runner : public juce::ThreadPoolJob
     {
-        auto p = job;
-        if (!p) return;
+    public:
+        explicit Runner(std::shared_ptr<Job> j) : juce::ThreadPoolJob("WavEncoderJob"), job(std::move(j)) {}
 
-        try
+        JobStatus runJob() override
         {
-            juce::WavAudioFormat wav;
-            juce::MemoryBlock out;
+            auto p = job;
 
-            if (p->disk)
-            {
-                auto tmp = juce::File::getSpecialLocation(juce::File::tempDirectory)
-                    .getNonexistentChildFile("whisper_enc_", ".wav");
-                if (p->log) p->log("[WAV] Using temp file: " + tmp.getFullPathName());
-                std::unique_ptr<juce::FileOutputStream> fos(tmp.createOutputStream());
-                if (!fos) { finishEmpty(p, "[WAV] Could not create temp stream"); return; }
-
-                std::unique_ptr<juce::AudioFormatWriter> w(
-                    wav.createWriterFor(fos.get(), (int)p->sr, 1, p->bits, {}, 0));
-                if (!w) { finishEmpty(p, "[WAV] createWriterFor failed"); return; }
-                fos.release(); // writer owns
-
-                const int total = p->mono.getNumSamples();
-                for (int pos = 0; pos < total && !shouldCancel; pos += p->chunk)
-                {
-                    const int n = juce::jmin(p->chunk, total - pos);
-                    if (p->log) p->log("[WAV] Writing chunk " + juce::String(pos) + " .. " + juce::String(pos + n));
-                    w->writeFromAudioSampleBuffer(p->mono, pos, n);
-                }
-                w.reset();
-                tmp.loadFileAsData(out);
-                tmp.deleteFile();
-            }
-            else
+            try
             {
-                auto mem = std::make_unique<juce::MemoryOutputStream>();
-                std::unique_ptr<juce::AudioFormatWriter> w(
-                    wav.createWriterFor(mem.get(), (int)p->sr, 1, p->bits, {}, 0));
-                if (!w) { finishEmpty(p, "[WAV] createWriterFor failed"); return; }
+                juce::MemoryBlock out;
                 const int total = p->mono.getNumSamples();
-                for (int pos = 0; pos < total && !shouldCancel; pos += p->chunk)
+                auto writer = WavStreamWriter::toMemory(out, p->sr, 1, p->bits, total);
+                if (!writer) { finishEmpty(p, "[WAV] Could not create writer"); return jobHasFinished; }
+
+                // Chunked so a cancel lands quickly
+                const float* ch = p->mono.getReadPointer(0);
+                for (int pos = 0; pos < total && !shouldExit(); pos += p->chunk)
                 {
-                    const int n = juce::jmin(p->chunk, total - pos);
-                    if (p->log) p->log("[WAV] Writing chunk " + juce::String(pos) + " .. " + juce::String(pos + n));
-                    w->writeFromAudioSampleBuffer(p->mono, pos, n);
+                    const float* ptr = ch + pos;
+                    writer->write(&ptr, juce::jmin(p->chunk, total - pos));
                 }
-                w->flush(); w.reset();
-                out = mem->getMemoryBlock();
-            }
 
-            if (shouldCancel) { finishEmpty(p, "[WAV] Cancelled"); return; }
+                if (shouldExit()) { finishEmpty(p, "[WAV] Cancelled"); return jobHasFinished; }
 
-            if (p->done)
-            {
-                juce::MemoryBlock copy(out);
-                juce::MessageManager::callAsync([d = p->done, copy]() { d(copy); });
+                writer->finish();
+                if (p->log && writer->getNumSanitised() > 0)
+                    p->log("[WAV] Sanitized " + juce::String(writer->getNumSanitised()) + " samples");
+                if (p->log) p->log("[WAV] Done (" + juce::String(out.getSize() / 1024.0, 2) + " KB)");
+
+                if (p->done)
+                    juce::MessageManager::callAsync([d = p->done, out = std::move(out)]() { d(out); });
             }
-            if (p->log) p->log("[WAV] Done (" + juce::String(out.getSize() / 1024.0, 2) + " KB)");
+            catch (const std::exception& e) { finishEmpty(p, juce::String("[WAV] Exception: ") + e.what()); }
+            catch (...) { finishEmpty(p, "[WAV] Unknown exception"); }
+
+            return jobHasFinished;
         }
-        catch (const std::exception& e) { finishEmpty(p, juce::String("[WAV] Exception: ") + e.what()); }
-        catch (...) { finishEmpty(p, "[WAV] Unknown exception"); }
-    }
 
-    void finishEmpty(const std::shared_ptr<Job>& p, const juce::String& msg)
-    {
-        if (p && p->log) p->log(msg);
-        if (p && p->done)
-            juce::MessageManager::callAsync([d = p->done] { juce::MemoryBlock m; d(m); });
-    }
+    private:
+        static void finishEmpty(const std::shared_ptr<Job>& p, const juce::String& msg)
+        {
+            if (p && p->log) p->log(msg);
+            if (p && p->done)
+                juce::MessageManager::callAsync([d = p->done] { juce::MemoryBlock m; d(m); });
+        }
+
+        std::shared_ptr<Job> job;
+    };
+
+    std::unique_ptr<Runner> runner;
 };
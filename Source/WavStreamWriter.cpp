@@ -0,0 +1,143 @@
+// Source/WavStreamWriter.cpp
+#include "WavStreamWriter.h"
+#include "AudioBlockOps.h"
+
+namespace
+{
+    constexpr int wavHeaderSize = 44;
+    constexpr int maxBlock = 8192;     // frames converted per pass through the scratch buffers
+}
+
+std::unique_ptr<WavStreamWriter> WavStreamWriter::toMemory(juce::MemoryBlock& dest, double sr,
+    int channels, int bits, juce::int64 expectedSamples)
+{
+    dest.setSize(0);
+    if (expectedSamples > 0)
+        dest.ensureSize((size_t)(wavHeaderSize + expectedSamples * channels * (bits / 8)));
+
+    std::unique_ptr<WavStreamWriter> w(new WavStreamWriter(
+        std::make_unique<juce::MemoryOutputStream>(dest, false), sr, channels, bits));
+
+    if (!w->writeHeader(expectedSamples))
+        return nullptr;
+
+    return w;
+}
+
+std::unique_ptr<WavStreamWriter> WavStreamWriter::toFile(const juce::File& file, double sr,
+    int channels, int bits, juce::int64 expectedSamples)
+{
+    file.deleteFile();
+    std::unique_ptr<juce::FileOutputStream> fos(file.createOutputStream());
+    if (!fos || !fos->openedOk())
+        return nullptr;
+
+    std::unique_ptr<WavStreamWriter> w(new WavStreamWriter(std::move(fos), sr, channels, bits));
+    if (!w->writeHeader(expectedSamples))
+        return nullptr;
+
+    return w;
+}
+
+WavStreamWriter::WavStreamWriter(std::unique_ptr<juce::OutputStream> stream, double sr, int channels, int bits)
+    : out(std::move(stream)),
+    sampleRate(sr),
+    numChannels(juce::jmax(1, channels)),
+    bitsPerSample(bits == 24 || bits == 32 ? bits : 16),
+    bytesPerFrame(numChannels * (bitsPerSample / 8))
+{
+    headerPos = out->getPosition();
+}
+
+WavStreamWriter::~WavStreamWriter()
+{
+    finish();
+}
+
+bool WavStreamWriter::writeHeader(juce::int64 numSamples)
+{
+    const auto dataBytes = (juce::uint32)juce::jmin((juce::int64)0xffffffff - wavHeaderSize,
+        juce::jmax((juce::int64)0, numSamples) * bytesPerFrame);
+
+    if (!out->setPosition(headerPos))
+        return false;
+
+    out->write("RIFF", 4);
+    out->writeInt((int)(dataBytes + wavHeaderSize - 8));
+    out->write("WAVE", 4);
+
+    out->write("fmt ", 4);
+    out->writeInt(16);
+    out->writeShort((short)(bitsPerSample == 32 ? 3 : 1));   // IEEE float / PCM
+    out->writeShort((short)numChannels);
+    out->writeInt((int)sampleRate);
+    out->writeInt((int)(sampleRate * bytesPerFrame));
+    out->writeShort((short)bytesPerFrame);
+    out->writeShort((short)bitsPerSample);
+
+    out->write("data", 4);
+    out->writeInt((int)dataBytes);
+    return true;
+}
+
+bool WavStreamWriter::write(const float* const* channels, int numSamples)
+{
+    if (finished || out == nullptr)
+        return false;
+
+    if (scratchSize == 0)
+    {
+        scratchSize = maxBlock;
+        scratch.malloc((size_t)scratchSize);
+        packed.malloc((size_t)scratchSize * (size_t)bytesPerFrame);
+    }
+
+    using AD = juce::AudioData;
+    using Src = AD::Pointer<AD::Float32, AD::NativeEndian, AD::NonInterleaved, AD::Const>;
+
+    for (int pos = 0; pos < numSamples; pos += scratchSize)
+    {
+        const int n = juce::jmin(scratchSize, numSamples - pos);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            juce::FloatVectorOperations::copy(scratch.get(), channels[ch] + pos, n);
+            sanitised += AudioBlockOps::sanitise(scratch.get(), n);
+
+            void* dst = packed.get() + ch * (bitsPerSample / 8);
+            Src src(scratch.get());
+
+            if (bitsPerSample == 16)
+                AD::Pointer<AD::Int16, AD::LittleEndian, AD::Interleaved, AD::NonConst>(dst, numChannels).convertSamples(src, n);
+            else if (bitsPerSample == 24)
+                AD::Pointer<AD::Int24, AD::LittleEndian, AD::Interleaved, AD::NonConst>(dst, numChannels).convertSamples(src, n);
+            else
+                AD::Pointer<AD::Float32, AD::LittleEndian, AD::Interleaved, AD::NonConst>(dst, numChannels).convertSamples(src, n);
+        }
+
+        if (!out->write(packed.get(), (size_t)n * (size_t)bytesPerFrame))
+            return false;
+
+        samplesWritten += n;
+    }
+
+    return true;
+}
+
+bool WavStreamWriter::finish()
+{
+    if (finished)
+        return true;
+
+    if (out == nullptr)
+        return false;
+
+    finished = true;
+
+    // Patch the sizes in place, then leave the stream at the end
+    const auto end = out->getPosition();
+    const bool ok = writeHeader(samplesWritten) && out->setPosition(end);
+    out->flush();
+    out.reset();
+    return ok;
+}
@@ -0,0 +1,76 @@
+// Source/WavStreamWriter.h
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+
+/** Destination for blocks of float audio, fed incrementally.
+ *  Implementations are used from one thread at a time (normally a pool worker).
+ */
+class AudioCaptureSink
+{
+public:
+    virtual ~AudioCaptureSink() = default;
+
+    virtual int getNumChannels() const = 0;
+    virtual double getSampleRate() const = 0;
+
+    /** Appends numSamples frames; channels has getNumChannels() pointers. */
+    virtual bool write(const float* const* channels, int numSamples) = 0;
+
+    /** Flushes and finalises the container. Further writes fail. */
+    virtual bool finish() = 0;
+};
+
+/** Streaming RIFF/WAVE PCM writer into memory or a file.
+ *
+ *  The 44-byte header is written up front (sized from the expected length when
+ *  known) and fixed up in finish(), so there's no temp file and no second pass.
+ *  Samples are converted straight into the sink, non-finite values are zeroed.
+ *  bitsPerSample is 16, 24 or 32 (32 = IEEE float).
+ */
+class WavStreamWriter : public AudioCaptureSink
+{
+public:
+    /** Writes into dest (cleared first; must outlive the writer).
+     *  expectedSamples > 0 preallocates the block.
+     */
+    static std::unique_ptr<WavStreamWriter> toMemory(juce::MemoryBlock& dest, double sampleRate,
+        int numChannels, int bitsPerSample = 16, juce::int64 expectedSamples = 0);
+
+    static std::unique_ptr<WavStreamWriter> toFile(const juce::File& file, double sampleRate,
+        int numChannels, int bitsPerSample = 16, juce::int64 expectedSamples = 0);
+
+    ~WavStreamWriter() override;
+
+    int getNumChannels() const override { return numChannels; }
+    double getSampleRate() const override { return sampleRate; }
+
+    bool write(const float* const* channels, int numSamples) override;
+    bool finish() override;
+
+    juce::int64 getNumSamplesWritten() const { return samplesWritten; }
+    int getNumSanitised() const { return sanitised; }
+
+private:
+    WavStreamWriter(std::unique_ptr<juce::OutputStream> stream, double sampleRate, int numChannels, int bitsPerSample);
+
+    bool writeHeader(juce::int64 numSamples);
+
+    std::unique_ptr<juce::OutputStream> out;
+    const double sampleRate;
+    const int numChannels;
+    const int bitsPerSample;
+    const int bytesPerFrame;
+
+    juce::int64 headerPos = 0;
+    juce::int64 samplesWritten = 0;
+    int sanitised = 0;
+    bool finished = false;
+
+    juce::HeapBlock<float> scratch;       // sanitised copy of one channel
+    juce::HeapBlock<char> packed;         // interleaved PCM for one block
+    int scratchSize = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WavStreamWriter)
+};
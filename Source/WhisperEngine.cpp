@@ -1,10 +1,13 @@
 #include "WhisperEngine.h"
+#include "Metrics.h"
+#include "Trace.h"
 #include <juce_dsp/juce_dsp.h>
 
 // Include whisper.cpp C API
 extern "C" {
 #include <whisper.h>
 }
+#include "third_party/whisper-ext.h"
 
 static void logMsg(const std::function<void(const juce::String&)>& log,
     const juce::String& s)
@@ -12,10 +15,369 @@ static void logMsg(const std::function<void(const juce::String&)>& log,
     if (log) log(s);
 }
 
+namespace
+{
+    ggml_type toGgmlType(WhisperEngine::Quantisation q)
+    {
+        switch (q)
+        {
+            case WhisperEngine::Quantisation::q8_0: return GGML_TYPE_Q8_0;
+            case WhisperEngine::Quantisation::q5_1: return GGML_TYPE_Q5_1;
+            case WhisperEngine::Quantisation::q4_k: return GGML_TYPE_Q4_K;
+            case WhisperEngine::Quantisation::none: break;
+        }
+        return GGML_TYPE_F16;
+    }
+
+    // Weights and KV caches alike: whisper_kv_cache_init() clears a new cache, so under
+    // first-touch its pages land on the node of the thread creating the state (the loader,
+    // for the state createModel() warms), not on the jobs' nodes
+    whisper_ext_mem_policy toMemPolicy(const WhisperEngine::MemoryPlacement& p, int numaNode)
+    {
+        using P = WhisperEngine::MemoryPlacement;
+
+        whisper_ext_mem_policy policy{};
+        policy.huge_pages = p.hugePages == P::HugePages::explicitPages ? WHISPER_EXT_HUGE_PAGES_EXPLICIT
+                          : p.hugePages == P::HugePages::transparent   ? WHISPER_EXT_HUGE_PAGES_TRANSPARENT
+                                                                       : WHISPER_EXT_HUGE_PAGES_NONE;
+        if (numaNode >= 0)
+        {
+            policy.numa = WHISPER_EXT_NUMA_BIND;
+            policy.node = numaNode;
+        }
+        else if (p.numa == P::Numa::interleave)
+        {
+            policy.numa = WHISPER_EXT_NUMA_INTERLEAVE;
+        }
+        return policy;
+    }
+
+    juce::String describeTarget(const WhisperEngine::Model& m)
+    {
+        if (m.getEndpoint().isNotEmpty())
+            return m.getEndpoint();
+        return m.getNumaNode() >= 0 ? "NUMA node " + juce::String(m.getNumaNode()) : juce::String("local CPU");
+    }
+
+    struct Fnv1a
+    {
+        juce::uint64 h = 14695981039346656037ull;
+
+        void mix(const void* data, size_t n) noexcept
+        {
+            auto* p = static_cast<const juce::uint8*>(data);
+            for (size_t i = 0; i < n; ++i)
+                h = (h ^ p[i]) * 1099511628211ull;
+        }
+
+        juce::String toString() const { return juce::String::toHexString((juce::int64)h).paddedLeft('0', 16); }
+    };
+
+    // Only files in here are ever written or deleted by the quantiser, never the user's
+    juce::File quantisedCacheFolder()
+    {
+        return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+            .getChildFile("WhisperFreeWin").getChildFile("QuantisedModels");
+    }
+
+    // FNV-1a over every byte of the file; empty if it can't be read to the end
+    juce::String fileHash(const juce::File& f)
+    {
+        juce::FileInputStream in(f);
+        if (!in.openedOk())
+            return {};
+
+        Fnv1a h;
+        constexpr int chunk = 1 << 20;
+        juce::HeapBlock<char> buf(chunk);
+
+        for (;;)
+        {
+            const int n = in.read(buf.get(), chunk);
+            if (n <= 0)
+                break;
+            h.mix(buf.get(), (size_t)n);
+        }
+
+        return in.isExhausted() ? h.toString() : juce::String();
+    }
+
+    // Hashing a multi-GB model takes seconds, so it is done once per path, size and
+    // modification time and remembered in the cache folder
+    juce::String contentHash(const juce::File& f, const juce::String& pathKey)
+    {
+        Fnv1a stamp;
+        const juce::int64 size = f.getSize(), modified = f.getLastModificationTime().toMilliseconds();
+        stamp.mix(&size, sizeof(size));
+        stamp.mix(&modified, sizeof(modified));
+
+        const auto record = quantisedCacheFolder().getChildFile(pathKey + "-" + stamp.toString() + ".hash");
+        const auto known = record.loadFileAsString().trim();
+        if (known.length() == 16)
+            return known;
+
+        const auto hash = fileHash(f);
+        if (hash.isEmpty())
+            return {};
+
+        // Records for older versions of this path are ours and useless now
+        for (const auto& stale : record.getParentDirectory().findChildFiles(juce::File::findFiles, false, pathKey + "-*.hash"))
+            stale.deleteFile();
+
+        record.replaceWithText(hash);
+        return hash;
+    }
+}
+
+WhisperEngine::Model::~Model()
+{
+    decodeScheduler.reset();
+    encodeBatcher.reset();
+
+    for (auto* st : freeStates)
+        whisper_free_state(st);
+    freeStates.clear();
+
+    if (ctx) { whisper_free(ctx); ctx = nullptr; }
+}
+
+whisper_state* WhisperEngine::Model::acquireState()
+{
+    {
+        std::lock_guard<std::mutex> lg(poolLock);
+        if (!freeStates.empty())
+        {
+            auto* st = freeStates.back();
+            freeStates.pop_back();
+            Metrics::get().increment(Metrics::Counter::cacheHits);
+            return st;
+        }
+    }
+
+    Metrics::get().increment(Metrics::Counter::cacheMisses);
+    return whisper_init_state(ctx);
+}
+
+void WhisperEngine::Model::releaseState(whisper_state* st)
+{
+    std::lock_guard<std::mutex> lg(poolLock);
+    freeStates.push_back(st);
+}
+
+int WhisperEngine::Model::getNumComputeThreads() const noexcept
+{
+    if (computePool != nullptr)
+        return whisper_ext_threadpool_n_threads(computePool.get());
+    return juce::jmax(1, juce::SystemStats::getNumCpus() - 1);
+}
+
+EncodeBatcher* WhisperEngine::Model::getEncodeBatcher(int maxBatch, double deadlineMs)
+{
+    std::lock_guard<std::mutex> lg(schedulerLock);
+    if (!encodeBatcherTried)
+    {
+        encodeBatcherTried = true;
+        auto b = std::make_unique<EncodeBatcher>(ctx, maxBatch, deadlineMs, getNumComputeThreads());
+        if (b->isValid())
+            encodeBatcher = std::move(b);
+    }
+    return encodeBatcher.get();
+}
+
+DecodeScheduler* WhisperEngine::Model::getDecodeScheduler()
+{
+    std::lock_guard<std::mutex> lg(schedulerLock);
+    if (!schedulerTried)
+    {
+        schedulerTried = true;
+        auto s = std::make_unique<DecodeScheduler>(ctx, 16, getNumComputeThreads());
+        if (s->isValid())
+            decodeScheduler = std::move(s);
+    }
+    return decodeScheduler.get();
+}
+
 WhisperEngine::WhisperEngine() {}
+
+juce::String WhisperEngine::getQuantisationName(Quantisation q)
+{
+    switch (q)
+    {
+        case Quantisation::q8_0: return "q8_0";
+        case Quantisation::q5_1: return "q5_1";
+        case Quantisation::q4_k: return "q4_k";
+        case Quantisation::none: break;
+    }
+    return "none";
+}
+
+WhisperEngine::Quantisation WhisperEngine::quantisationFromName(const juce::String& name)
+{
+    for (auto q : { Quantisation::q8_0, Quantisation::q5_1, Quantisation::q4_k })
+        if (name.trim().equalsIgnoreCase(getQuantisationName(q)))
+            return q;
+    return Quantisation::none;
+}
+
+juce::File WhisperEngine::prepareQuantised(const juce::File& source, Quantisation q,
+    const std::function<void(const juce::String&)>& logFn) const
+{
+    if (q == Quantisation::none)
+        return source;
+
+    const auto dir = quantisedCacheFolder();
+    if (!dir.createDirectory())
+        return source;
+
+    // Same name in another folder is another model
+    Fnv1a path;
+    const auto fullPath = source.getFullPathName();
+    path.mix(fullPath.toRawUTF8(), fullPath.getNumBytesAsUTF8());
+    const auto pathKey = source.getFileNameWithoutExtension() + "-" + path.toString().substring(0, 8);
+
+    const auto hash = contentHash(source, pathKey);
+    if (hash.isEmpty())
+        return source;
+
+    const auto typeName = getQuantisationName(q);
+    const auto prefix = pathKey + "." + typeName + "-";
+    const auto cached = dir.getChildFile(prefix + hash + ".bin");
+
+    if (cached.existsAsFile())
+    {
+        logMsg(logFn, "[Whisper] Using cached " + typeName + " model: " + cached.getFileName());
+        return cached;
+    }
+
+    // Our own conversion of an earlier version of the same file
+    for (const auto& stale : dir.findChildFiles(juce::File::findFiles, false, prefix + "*.bin"))
+        stale.deleteFile();
+
+    logMsg(logFn, "[Whisper] Quantising " + source.getFileName() + " to " + typeName + " (first load only)");
+
+    // Written under a private name and renamed, so a concurrent load never sees a partial file
+    const auto part = cached.getSiblingFile(cached.getFileName() + ".part"
+        + juce::String::toHexString(juce::Random::getSystemRandom().nextInt()));
+
+    const double t0 = juce::Time::getMillisecondCounterHiRes();
+    const int rc = whisper_ext_model_quantize(source.getFullPathName().toRawUTF8(),
+        part.getFullPathName().toRawUTF8(), toGgmlType(q),
+        juce::jmax(1, juce::SystemStats::getNumCpus() - 1));
+
+    if (rc != 0 || !part.moveFileTo(cached))
+    {
+        part.deleteFile();
+        logMsg(logFn, "[Whisper] Could not quantise to " + typeName + "; loading " + source.getFileName() + " as-is");
+        return source;
+    }
+
+    logMsg(logFn, "[Whisper] Wrote " + cached.getFileName() + " ("
+        + juce::File::descriptionOfSizeInBytes(source.getSize()) + " -> "
+        + juce::File::descriptionOfSizeInBytes(cached.getSize()) + ") in "
+        + juce::String((juce::Time::getMillisecondCounterHiRes() - t0) / 1000.0, 1) + " s");
+    return cached;
+}
 WhisperEngine::~WhisperEngine()
 {
-    if (ctx) { whisper_free(ctx); ctx = nullptr; }
+    std::atomic_store(&current, ModelPtr());
+    std::atomic_store(&fallback, ModelPtr());
+}
+
+WhisperEngine::ModelPtr WhisperEngine::createModel(const juce::File& modelFile, bool fallbackModel,
+    const std::function<void(const juce::String&)>& logFn) const
+{
+    whisper_context_params cparams = whisper_context_default_params();
+    cparams.use_gpu = false;
+
+    // The quantised copy is what gets loaded (and uploaded); the model still reports the original
+    const auto weightsFile = prepareQuantised(modelFile, quantisation.load(), logFn);
+
+    // perNode: the main copy lives on node 0, replicas below take the others
+    const auto mem = getMemoryPlacement();
+    const int numNodes = mem.numa == MemoryPlacement::Numa::perNode ? whisper_ext_numa_n_nodes() : 1;
+
+    std::shared_ptr<Model> model(new Model());
+    model->file = modelFile;
+    model->weightsFile = weightsFile;
+    model->numaNode = numNodes > 1 ? 0 : -1;
+    model->ctx = loadLocalContext(weightsFile, cparams, mem, model->numaNode);
+    if (!model->ctx)
+    {
+        logMsg(logFn, "[Whisper] Failed to load model");
+        return nullptr;
+    }
+
+    // Every state and batch graph on this context reuses the same workers
+    if ((model->computePool = getComputePool(model->numaNode, fallbackModel)) != nullptr)
+        whisper_ext_set_threadpool(model->ctx, model->computePool.get());
+
+    // Warm one state so the first job after the swap doesn't pay for it
+    if (auto* st = model->acquireState())
+        model->releaseState(st);
+
+    for (int node = 1; !fallbackModel && node < numNodes; ++node)
+    {
+        logMsg(logFn, "[Whisper] Loading copy for NUMA node " + juce::String(node));
+
+        std::shared_ptr<Model> replica(new Model());
+        replica->file = modelFile;
+        replica->weightsFile = weightsFile;
+        replica->numaNode = node;
+        replica->ctx = loadLocalContext(weightsFile, cparams, mem, node);
+
+        if (replica->ctx != nullptr && (replica->computePool = getComputePool(node)) != nullptr)
+            whisper_ext_set_threadpool(replica->ctx, replica->computePool.get());
+
+        auto* st = replica->ctx ? replica->acquireState() : nullptr;
+        if (st == nullptr)
+        {
+            logMsg(logFn, "[Whisper] NUMA node " + juce::String(node) + " copy failed, skipping");
+            continue;
+        }
+
+        replica->releaseState(st);
+        model->replicas.push_back(std::move(replica));
+    }
+
+    for (const auto& endpoint : !fallbackModel ? getRpcEndpoints() : juce::StringArray())
+    {
+        logMsg(logFn, "[Whisper] Uploading model to " + endpoint);
+
+        std::shared_ptr<Model> replica(new Model());
+        replica->file = modelFile;
+        replica->weightsFile = weightsFile;
+        replica->endpoint = endpoint;
+        replica->ctx = whisper_ext_init_from_file_rpc(weightsFile.getFullPathName().toRawUTF8(),
+            cparams, endpoint.toRawUTF8());
+
+        auto* st = replica->ctx ? replica->acquireState() : nullptr;
+        if (st == nullptr)
+        {
+            logMsg(logFn, "[Whisper] RPC server " + endpoint + " unavailable, skipping");
+            continue;
+        }
+
+        replica->releaseState(st);
+        model->replicas.push_back(std::move(replica));
+    }
+
+    return model;
+}
+
+whisper_context* WhisperEngine::loadLocalContext(const juce::File& weightsFile, const whisper_context_params& cparams,
+    const MemoryPlacement& mem, int numaNode) const
+{
+    const auto path = weightsFile.getFullPathName();
+    const auto policy = toMemPolicy(mem, numaNode);
+
+    auto* ctx = policy.huge_pages == WHISPER_EXT_HUGE_PAGES_NONE && policy.numa == WHISPER_EXT_NUMA_FIRST_TOUCH
+        ? whisper_init_from_file_with_params_no_state(path.toRawUTF8(), cparams)
+        : whisper_ext_init_from_file_placed(path.toRawUTF8(), cparams, policy);
+
+    // Before the first state exists, so every KV cache follows it
+    if (ctx != nullptr)
+        whisper_ext_set_state_placement(ctx, policy);
+    return ctx;
 }
 
 bool WhisperEngine::loadModel(const juce::File& modelFile,
@@ -27,31 +389,234 @@ bool WhisperEngine::loadModel(const juce::File& modelFile,
         return false;
     }
 
-    if (ctx != nullptr)
+    // Newest request wins if several loads overlap
+    const auto generation = ++loadGeneration;
+
+    auto model = createModel(modelFile, false, logFn);
+    if (!model)
+        return false;
+
+    const bool quantised = model->weightsFile != modelFile;
+    int numReplicas = 0, numNodeCopies = 0;
+    for (const auto& r : model->replicas)
+        ++(r->getEndpoint().isNotEmpty() ? numReplicas : numNodeCopies);
+
+    // The check and the swap go together, or an older load finishing second could still
+    // replace a newer model between them
+    ModelPtr previous;
     {
-        whisper_free(ctx);
-        ctx = nullptr;
+        std::lock_guard<std::mutex> lg(swapLock);
+        if (generation != loadGeneration.load())
+        {
+            logMsg(logFn, "[Whisper] Discarding superseded model: " + modelFile.getFileName());
+            return false;
+        }
+        previous = std::atomic_exchange(&current, std::move(model));
     }
 
-    whisper_context_params cparams = whisper_context_default_params();
-    cparams.use_gpu = false;
+    logMsg(logFn, "[Whisper] Model loaded: " + modelFile.getFileName()
+        + (quantised ? " [" + getQuantisationName(quantisation.load()) + "]" : juce::String())
+        + (previous ? " (replaced " + previous->getFile().getFileName() + ")" : juce::String())
+        + (numNodeCopies > 0 ? ", " + juce::String(numNodeCopies + 1) + " NUMA node copies" : juce::String())
+        + (numReplicas > 0 ? ", " + juce::String(numReplicas) + " RPC replica(s)" : juce::String()));
+    return true;
+}
 
-    ctx = whisper_init_from_file_with_params(modelFile.getFullPathName().toRawUTF8(),
-        cparams);
-    if (!ctx)
+bool WhisperEngine::loadFallbackModel(const juce::File& modelFile,
+    std::function<void(const juce::String&)> logFn)
+{
+    if (!modelFile.existsAsFile())
     {
-        logMsg(logFn, "[Whisper] Failed to load model");
+        logMsg(logFn, "[Whisper] Fallback model not found: " + modelFile.getFullPathName());
         return false;
     }
 
-    logMsg(logFn, "[Whisper] Model loaded: " + modelFile.getFileName());
+    auto model = createModel(modelFile, true, logFn);
+    if (!model)
+        return false;
+
+    std::atomic_store(&fallback, std::move(model));
+    logMsg(logFn, "[Whisper] Fallback model loaded: " + modelFile.getFileName());
     return true;
 }
 
+double WhisperEngine::getSpeculativeAcceptanceRate() const noexcept
+{
+    const auto drafted = draftedTokens.load();
+    return drafted > 0 ? (double)acceptedTokens.load() / (double)drafted : 0.0;
+}
+
+void WhisperEngine::setThreadPoolOptions(const ThreadPoolOptions& o)
+{
+    std::lock_guard<std::mutex> lg(computePoolLock);
+    threadPoolOptions = o;
+    computePools.clear();
+}
+
+WhisperEngine::ThreadPoolOptions WhisperEngine::getThreadPoolOptions() const
+{
+    std::lock_guard<std::mutex> lg(computePoolLock);
+    return threadPoolOptions;
+}
+
+WhisperEngine::ThreadPoolOptions WhisperEngine::threadPoolOptionsFromString(const juce::String& s)
+{
+    ThreadPoolOptions o;
+    if (s.trim().equalsIgnoreCase("off"))
+    {
+        o.enabled = false;
+        return o;
+    }
+
+    for (auto token : juce::StringArray::fromTokens(s, ",", {}))
+    {
+        const auto key = token.upToFirstOccurrenceOf("=", false, false).trim().toLowerCase();
+        const auto value = token.fromFirstOccurrenceOf("=", false, false).trim();
+
+        if (key == "threads")   o.threads = value.getIntValue();
+        else if (key == "poll") o.poll = value.getIntValue();
+        else if (key == "cpus")
+        {
+            for (const auto& range : juce::StringArray::fromTokens(value, "+", {}))
+            {
+                const int first = range.upToFirstOccurrenceOf("-", false, false).getIntValue();
+                const int last = range.containsChar('-') ? range.fromFirstOccurrenceOf("-", false, false).getIntValue() : first;
+                for (int cpu = first; cpu <= last; ++cpu)
+                    o.cpus.addIfNotAlreadyThere(cpu);
+            }
+        }
+    }
+    return o;
+}
+
+std::shared_ptr<whisper_ext_threadpool> WhisperEngine::getComputePool(int numaNode, bool fallbackModel) const
+{
+    std::lock_guard<std::mutex> lg(computePoolLock);
+    if (!threadPoolOptions.enabled)
+        return nullptr;
+
+    auto& pool = computePools[{ numaNode, fallbackModel }];
+    if (pool == nullptr)
+    {
+        const auto& o = threadPoolOptions;
+        auto cpus = o.cpus;
+
+        // A node's pool gets that node's CPUs, of the configured ones if any were given
+        if (numaNode >= 0)
+        {
+            juce::Array<int> nodeCpus;
+            for (int cpu = 0; cpu < juce::SystemStats::getNumCpus(); ++cpu)
+                if (whisper_ext_numa_node_of_cpu(cpu) == numaNode && (o.cpus.isEmpty() || o.cpus.contains(cpu)))
+                    nodeCpus.add(cpu);
+            if (!nodeCpus.isEmpty())
+                cpus = nodeCpus;
+        }
+
+        // Pinned workers get a CPU each unless a count was asked for
+        int threads = o.threads > 0 ? o.threads : juce::jmax(1, juce::SystemStats::getNumCpus() - 1);
+        if (o.threads <= 0 && !cpus.isEmpty())
+            threads = cpus.size();
+        else if (numaNode >= 0 && !cpus.isEmpty())
+            threads = juce::jmin(threads, cpus.size());
+
+        pool.reset(whisper_ext_threadpool_init(threads, cpus.isEmpty() ? nullptr : cpus.begin(), cpus.size(), o.poll),
+                   whisper_ext_threadpool_free);
+    }
+    return pool;
+}
+
+void WhisperEngine::setMemoryPlacement(const MemoryPlacement& p)
+{
+    std::lock_guard<std::mutex> lg(placementLock);
+    placement = p;
+}
+
+WhisperEngine::MemoryPlacement WhisperEngine::getMemoryPlacement() const
+{
+    std::lock_guard<std::mutex> lg(placementLock);
+    return placement;
+}
+
+WhisperEngine::MemoryPlacement WhisperEngine::memoryPlacementFromString(const juce::String& s)
+{
+    MemoryPlacement p;
+    for (auto token : juce::StringArray::fromTokens(s, ",", {}))
+    {
+        const auto key = token.upToFirstOccurrenceOf("=", false, false).trim().toLowerCase();
+        const auto value = token.fromFirstOccurrenceOf("=", false, false).trim().toLowerCase();
+
+        if (key == "huge")
+        {
+            if (value == "thp")           p.hugePages = MemoryPlacement::HugePages::transparent;
+            else if (value == "explicit") p.hugePages = MemoryPlacement::HugePages::explicitPages;
+            else if (value == "off")      p.hugePages = MemoryPlacement::HugePages::none;
+        }
+        else if (key == "numa")
+        {
+            if (value == "interleave") p.numa = MemoryPlacement::Numa::interleave;
+            else if (value == "node")  p.numa = MemoryPlacement::Numa::perNode;
+            else if (value == "off")   p.numa = MemoryPlacement::Numa::firstTouch;
+        }
+    }
+    return p;
+}
+
+void WhisperEngine::setDecodingOptions(const DecodingOptions& d)
+{
+    std::lock_guard<std::mutex> lg(decodingLock);
+    decoding = d;
+}
+
+WhisperEngine::DecodingOptions WhisperEngine::getDecodingOptions() const
+{
+    std::lock_guard<std::mutex> lg(decodingLock);
+    return decoding;
+}
+
+WhisperEngine::DecodingOptions WhisperEngine::decodingOptionsFromString(const juce::String& s)
+{
+    DecodingOptions d;
+    for (auto token : juce::StringArray::fromTokens(s, ",", {}))
+    {
+        const auto key = token.upToFirstOccurrenceOf("=", false, false).trim().toLowerCase();
+        const auto value = token.fromFirstOccurrenceOf("=", false, false).trim();
+
+        if (key == "beam")
+        {
+            d.beamSearch = value.getIntValue() > 0;
+            if (d.beamSearch)
+                d.beamSize = value.getIntValue();
+        }
+        else if (key == "best_of")   d.bestOf = value.getIntValue();
+        else if (key == "temp_inc")  d.temperatureInc = value.getFloatValue();
+        else if (key == "fallbacks") d.maxFallbacks = value.getIntValue();
+        else if (key == "logprob")   d.logprobThold = value.getFloatValue();
+        else if (key == "entropy")   d.entropyThold = value.getFloatValue();
+        else if (key == "no_speech") d.noSpeechThold = value.getFloatValue();
+        else if (key == "budget")    d.budgetMs = value.getDoubleValue();
+    }
+    return d;
+}
+
+void WhisperEngine::setRpcEndpoints(const juce::StringArray& endpoints)
+{
+    std::lock_guard<std::mutex> lg(endpointLock);
+    rpcEndpoints = endpoints;
+    rpcEndpoints.trim();
+    rpcEndpoints.removeEmptyStrings();
+    rpcEndpoints.removeDuplicates(false);
+}
+
+juce::StringArray WhisperEngine::getRpcEndpoints() const
+{
+    std::lock_guard<std::mutex> lg(endpointLock);
+    return rpcEndpoints;
+}
+
 juce::AudioBuffer<float> WhisperEngine::resampleTo16k(
     const juce::AudioBuffer<float>& in,
     double inRate,
-    std::function<void(const juce::String&)>& logCb)
+    const std::function<void(const juce::String&)>& logCb)
 {
     constexpr double targetRate = 16000.0;
 
@@ -94,9 +659,46 @@ juce::AudioBuffer<float> WhisperEngine::resampleTo16k(
 juce::String WhisperEngine::transcribe(const juce::AudioBuffer<float>& monoIn,
     double sampleRate,
     std::function<void(double)> progressCb,
-    std::function<void(const juce::String&)> logCb)
+    std::function<void(const juce::String&)> logCb,
+    JobStats* stats,
+    const JobToken* cancel,
+    const JobOptions* options)
+{
+    return runJob(monoIn, sampleRate, std::move(progressCb), logCb, stats, nullptr, cancel, options);
+}
+
+WhisperEngine::DualResult WhisperEngine::transcribeAndTranslate(const juce::AudioBuffer<float>& monoIn,
+    double sampleRate,
+    std::function<void(double)> progressCb,
+    std::function<void(const juce::String&)> logCb,
+    JobStats* stats,
+    const JobToken* cancel,
+    const JobOptions* options)
+{
+    DualResult r;
+    r.transcript = runJob(monoIn, sampleRate, std::move(progressCb), logCb, stats, &r, cancel, options);
+    return r;
+}
+
+juce::String WhisperEngine::runJob(const juce::AudioBuffer<float>& monoIn,
+    double sampleRate,
+    std::function<void(double)> progressCb,
+    const std::function<void(const juce::String&)>& logCb,
+    JobStats* stats,
+    DualResult* dual,
+    const JobToken* cancel,
+    const JobOptions* options)
 {
-    if (!ctx)
+    auto isCancelled = [cancel] { return cancel != nullptr && cancel->isCancelled(); };
+    const JobOptions opts = options != nullptr ? *options : JobOptions();
+
+    // Pin the model for the whole job; a concurrent swap only affects later jobs
+    ModelPtr model;
+    if (opts.useFallbackModel)
+        model = std::atomic_load(&fallback);
+    if (!model)
+        model = acquireModel();
+    if (!model)
     {
         logMsg(logCb, "[Whisper] No model loaded");
         return {};
@@ -108,16 +710,49 @@ juce::String WhisperEngine::transcribe(const juce::AudioBuffer<float>& monoIn,
         return {};
     }
 
-    auto mono16 = resampleTo16k(monoIn, sampleRate,
-        const_cast<std::function<void(const juce::String&)>&>(logCb));
+    // Superseded while it sat in a queue: nothing has been spent on it yet
+    if (isCancelled())
+    {
+        Metrics::get().increment(Metrics::Counter::cancelled);
+        return {};
+    }
+
+    const double tResample = juce::Time::getMillisecondCounterHiRes();
+    juce::AudioBuffer<float> mono16;
+    {
+        WFW_TRACE_SCOPE("asr", "resampleTo16k");
+        mono16 = resampleTo16k(monoIn, sampleRate, logCb);
+    }
     if (mono16.getNumSamples() <= 0)
         return {};
 
+    const double resampleMs = juce::Time::getMillisecondCounterHiRes() - tResample;
+    Metrics::get().record(Metrics::Stage::resample, resampleMs);
+
+    if (stats)
+    {
+        stats->audioSeconds = monoIn.getNumSamples() / sampleRate;
+        stats->resampleMs = resampleMs;
+    }
+
     const int nSamples = mono16.getNumSamples();
     std::vector<float> pcm(nSamples);
     std::memcpy(pcm.data(), mono16.getReadPointer(0), sizeof(float) * (size_t)nSamples);
 
-    whisper_full_params wparams = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    auto dec = getDecodingOptions();
+    if (opts.budgetMs >= 0.0)
+        dec.budgetMs = opts.budgetMs;
+
+    // One candidate per step and no re-decoding at higher temperatures
+    if (opts.fastDecode)
+    {
+        dec.beamSearch = false;
+        dec.bestOf = 1;
+        dec.temperatureInc = 0.0f;
+    }
+
+    whisper_full_params wparams = whisper_full_default_params(dec.beamSearch ? WHISPER_SAMPLING_BEAM_SEARCH
+                                                                             : WHISPER_SAMPLING_GREEDY);
     wparams.print_progress = false;
     wparams.print_realtime = false;
     wparams.print_timestamps = false;
@@ -125,6 +760,23 @@ juce::String WhisperEngine::transcribe(const juce::AudioBuffer<float>& monoIn,
     wparams.language = "auto";
     wparams.n_threads = juce::jmax(1, juce::SystemStats::getNumCpus() - 1);
 
+    // whisper.cpp refuses more than WHISPER_MAX_DECODERS (8) candidates
+    wparams.greedy.best_of = juce::jlimit(1, 8, dec.bestOf);
+    wparams.beam_search.beam_size = juce::jlimit(1, 8, dec.beamSize);
+    wparams.temperature_inc = juce::jmax(0.0f, dec.temperatureInc);
+    wparams.logprob_thold = dec.logprobThold;
+    wparams.entropy_thold = dec.entropyThold;
+    wparams.no_speech_thold = dec.noSpeechThold;
+
+    // The encoder otherwise always runs over 30 s; 50 positions per second plus a margin
+    if (opts.trimAudioContext && nSamples <= 30 * WHISPER_SAMPLE_RATE)
+    {
+        const int needed = (int)((juce::int64)nSamples * 50 / WHISPER_SAMPLE_RATE) + 64;
+        wparams.audio_ctx = juce::jlimit(256, 1500, (needed + 127) / 128 * 128);
+        if (wparams.audio_ctx >= 1500)
+            wparams.audio_ctx = 0;
+    }
+
     wparams.progress_callback = [](whisper_context*, whisper_state*, int progress, void* user_data)
         {
             auto* cb = reinterpret_cast<std::function<void(double)>*>(user_data);
@@ -133,9 +785,286 @@ juce::String WhisperEngine::transcribe(const juce::AudioBuffer<float>& monoIn,
         };
     wparams.progress_callback_user_data = &progressCb;
 
+    // Cancellation: refuse the next encoder window, and abort any graph already computing
+    if (cancel != nullptr)
+    {
+        wparams.encoder_begin_callback = [](whisper_context*, whisper_state*, void* user_data)
+            {
+                return !static_cast<const JobToken*>(user_data)->isCancelled();
+            };
+        wparams.encoder_begin_callback_user_data = const_cast<JobToken*>(cancel);
+
+        wparams.abort_callback = [](void* user_data)
+            {
+                return static_cast<const JobToken*>(user_data)->isCancelled();
+            };
+        wparams.abort_callback_user_data = const_cast<JobToken*>(cancel);
+    }
+
     if (progressCb) progressCb(0.02);
 
-    const int rc = whisper_full(ctx, wparams, pcm.data(), pcm.size());
+    // Round-robin over the NUMA node copies and RPC replicas, starting after the last one
+    // used; if they are all busy the job runs on the main copy rather than queueing
+    Model* target = model.get();
+    std::unique_lock<std::mutex> replicaLock;
+    if (const auto n = (unsigned)model->replicas.size())
+    {
+        const auto first = model->nextReplica.fetch_add(1);
+        for (unsigned i = 0; i < n; ++i)
+        {
+            auto& r = *model->replicas[(first + i) % n];
+            std::unique_lock<std::mutex> lk(r.busy, std::try_to_lock);
+            if (lk.owns_lock())
+            {
+                target = &r;
+                replicaLock = std::move(lk);
+                break;
+            }
+        }
+
+        logMsg(logCb, "[Whisper] Running on " + describeTarget(*target));
+    }
+
+    ScopedState state(*target);
+    if (!state.get())
+    {
+        logMsg(logCb, "[Whisper] Failed to create decoder state");
+        return {};
+    }
+
+    if (target->computePool != nullptr)
+        wparams.n_threads = target->getNumComputeThreads();
+
+    // Pooled states carry timings from earlier jobs; start this one from zero
+    whisper_ext_reset_state_timings(state.get());
+
+    // Lets language detection's encode double as the first window's
+    whisper_ext_set_reuse_encoding(state.get(), 1);
+
+    // The batched paths encode outside whisper_full, which would otherwise set this
+    whisper_ext_set_audio_ctx(state.get(), wparams.audio_ctx);
+
+    // The budget counts from here, so queueing and resampling don't eat into it
+    whisper_ext_set_decode_budget(state.get(), dec.maxFallbacks, (int64_t)(juce::jmax(0.0, dec.budgetMs) * 1000.0));
+
+    auto* ctx = target->getContext();
+    const whisper_token firstSpecial = whisper_token_eot(ctx);
+
+    // Text of the state's last whisper_full run
+    auto collect = [&](bool countTokens)
+        {
+            juce::String text;
+            const int nSegments = whisper_full_n_segments_from_state(state.get());
+            for (int i = 0; i < nSegments; ++i)
+            {
+                if (countTokens && stats)
+                {
+                    const int nTok = whisper_full_n_tokens_from_state(state.get(), i);
+                    for (int k = 0; k < nTok; ++k)
+                        if (whisper_full_get_token_id_from_state(state.get(), i, k) < firstSpecial)
+                            ++stats->numTokens;
+                }
+
+                text += whisper_full_get_segment_text_from_state(state.get(), i);
+                if (i + 1 < nSegments)
+                    text += " ";
+            }
+            return text.trim();
+        };
+
+    const double tAsr = juce::Time::getMillisecondCounterHiRes();
+    int rc = 0;
+    juce::String transcript, english;
+
+    // Batched encoding: this job's first window is encoded together with other jobs'
+    bool melReady = false;
+    // A trimmed context can't share a graph with full-length windows
+    if (dual == nullptr && target == model.get() && encodeBatchSize.load() > 1 && wparams.audio_ctx == 0)
+    {
+        if (auto* batcher = model->getEncodeBatcher(encodeBatchSize.load(), encodeDeadlineMs.load()))
+        {
+            {
+                WFW_TRACE_SCOPE("asr", "whisper_pcm_to_mel");
+                melReady = whisper_pcm_to_mel_with_state(ctx, state.get(), pcm.data(), (int)pcm.size(), wparams.n_threads) == 0;
+            }
+
+            // If the batch fails the job simply encodes on its own below
+            if (melReady)
+                batcher->encode(state.get(), 0, cancel);
+        }
+    }
+
+    DecodeScheduler* scheduler = nullptr;
+    if (dual == nullptr && !dec.beamSearch && batchedDecoding.load() && target == model.get() && nSamples <= 30 * WHISPER_SAMPLE_RATE)
+        scheduler = model->getDecodeScheduler();
+
+    // Speculative decoding drafts with the fallback model, if it shares the main one's vocabulary
+    ModelPtr draftModel;
+    if (dual == nullptr && !dec.beamSearch && speculativeTokens.load() > 0 && target == model.get())
+    {
+        draftModel = std::atomic_load(&fallback);
+        if (draftModel == model)
+            draftModel.reset();
+
+        if (draftModel != nullptr && whisper_n_vocab(draftModel->getContext()) != whisper_n_vocab(ctx))
+        {
+            logMsg(logCb, "[Whisper] Draft model " + draftModel->getFile().getFileName()
+                + " has a different vocabulary; decoding without it");
+            draftModel.reset();
+        }
+    }
+
+    if (isCancelled())
+    {
+        rc = -7;
+    }
+    else if (dual == nullptr)
+    {
+        WFW_TRACE_SCOPE("asr", "whisper_full");
+
+        // Greedy decoder passes either check a draft's tokens or share the batched graph with
+        // other jobs'; everything else is whisper_full's, so the text is the same either way
+        std::unique_ptr<ScopedState> draftState;
+        if (draftModel != nullptr)
+        {
+            draftState = std::make_unique<ScopedState>(*draftModel);
+
+            // whisper_full only computes the draft's mel when it is given the samples
+            if (draftState->get() != nullptr
+                && (!melReady || whisper_pcm_to_mel_with_state(draftModel->getContext(), draftState->get(),
+                                     pcm.data(), (int)pcm.size(), wparams.n_threads) == 0))
+                whisper_ext_set_draft(state.get(), draftModel->getContext(), draftState->get(), speculativeTokens.load());
+            else
+                draftState.reset();
+        }
+
+        std::unique_ptr<DecodeScheduler::Stream> batched;
+        if (scheduler != nullptr && draftState == nullptr)
+            batched = std::make_unique<DecodeScheduler::Stream>(*scheduler, state.get(), cancel);
+
+        rc = melReady ? whisper_full_with_state(ctx, state.get(), wparams, nullptr, 0)
+                      : whisper_full_with_state(ctx, state.get(), wparams, pcm.data(), (int)pcm.size());
+        batched.reset();
+
+        if (draftState != nullptr)
+        {
+            whisper_ext_set_draft(state.get(), nullptr, nullptr, 0);
+            draftState.reset();
+
+            whisper_ext_timings t{};
+            whisper_ext_get_state_timings(state.get(), &t);
+            draftedTokens += (juce::uint64)t.n_drafted;
+            acceptedTokens += (juce::uint64)t.n_accepted;
+            if (t.n_drafted > 0)
+                logMsg(logCb, "[Whisper] Speculative: " + juce::String(t.n_accepted) + "/"
+                    + juce::String(t.n_drafted) + " draft tokens accepted");
+        }
+
+        if (rc == 0)
+            transcript = collect(true);
+    }
+    else
+    {
+        // One mel, then per encoder window: transcribe, and translate on the same
+        // encoding. Windows go one at a time so the translate pass covers exactly the
+        // span the transcribe pass encoded and moved past, wherever its timestamps put
+        // the next seek; it then costs a decoder run, not another encode.
+        wparams.progress_callback = nullptr;
+
+        {
+            WFW_TRACE_SCOPE("asr", "whisper_pcm_to_mel");
+            rc = whisper_pcm_to_mel_with_state(ctx, state.get(), pcm.data(), (int)pcm.size(), wparams.n_threads);
+        }
+
+        whisper_ext_set_max_windows(state.get(), 1);
+
+        const int totalMs = (int)((juce::int64)nSamples * 1000 / 16000);
+        int seekMs = 0;
+
+        while (rc == 0 && !isCancelled())
+        {
+            // whisper_full skips anything under a second anyway
+            if (seekMs > 0 && totalMs - seekMs < 1000)
+                break;
+
+            wparams.offset_ms = seekMs;
+            wparams.duration_ms = totalMs - seekMs;
+
+            {
+                WFW_TRACE_SCOPE("asr", "whisper_full");
+                wparams.translate = false;
+                rc = whisper_full_with_state(ctx, state.get(), wparams, nullptr, 0);
+            }
+            if (rc != 0)
+                break;
+
+            const int nextMs = whisper_ext_get_seek(state.get()) * 10;
+            const juce::String window = collect(true);
+            transcript << (transcript.isEmpty() || window.isEmpty() ? "" : " ") << window;
+            if (progressCb) progressCb(juce::jlimit(0.02, 1.0, nextMs / (double)juce::jmax(1, totalMs)));
+
+            // The first window settles the language for the rest; English needs no second pass
+            const char* lang = whisper_lang_str(whisper_full_lang_id_from_state(state.get()));
+            wparams.language = lang != nullptr ? lang : "en";
+            if (!whisper_is_multilingual(ctx) || std::strcmp(wparams.language, "en") == 0)
+            {
+                english = transcript;
+            }
+            else if (nextMs > seekMs)
+            {
+                // Same offset, so the same encoding; at least a second or whisper_full skips it
+                wparams.duration_ms = juce::jmax(1000, nextMs - seekMs);
+
+                WFW_TRACE_SCOPE("asr", "whisper_full translate");
+                wparams.translate = true;
+                rc = whisper_full_with_state(ctx, state.get(), wparams, nullptr, 0);
+                if (rc == 0)
+                {
+                    const juce::String windowEnglish = collect(false);
+                    english << (english.isEmpty() || windowEnglish.isEmpty() ? "" : " ") << windowEnglish;
+                }
+            }
+
+            // Nothing left that whisper_full would encode
+            if (nextMs <= seekMs)
+                break;
+            seekMs = nextMs;
+        }
+
+        whisper_ext_set_max_windows(state.get(), 0);
+    }
+
+    whisper_ext_set_reuse_encoding(state.get(), 0);
+
+    if (stats)
+        stats->asrMs = juce::Time::getMillisecondCounterHiRes() - tAsr;
+
+    {
+        whisper_ext_timings t{};
+        whisper_ext_get_state_timings(state.get(), &t);
+
+        auto& m = Metrics::get();
+        m.recordMicros(Metrics::Stage::mel, t.t_mel_us);
+        if (t.n_encode > 0)
+            m.recordMicros(Metrics::Stage::encode, t.t_encode_us);
+        m.recordMicros(Metrics::Stage::decode, t.t_decode_us + t.t_batchd_us + t.t_prompt_us + t.t_sample_us);
+
+        if (t.n_fail_cut > 0)
+        {
+            m.increment(Metrics::Counter::fallbacksCut, t.n_fail_cut);
+            logMsg(logCb, "[Whisper] Decode budget reached: kept the best attempt for "
+                + juce::String(t.n_fail_cut) + " window(s)");
+        }
+    }
+    // encoder_begin_callback stops whisper_full without an error code; either way the text is stale
+    if (isCancelled())
+    {
+        Metrics::get().increment(Metrics::Counter::cancelled);
+        logMsg(logCb, "[Whisper] Job cancelled");
+        if (progressCb) progressCb(0.0);
+        return {};
+    }
+
     if (rc != 0)
     {
         logMsg(logCb, "[Whisper] whisper_full failed: " + juce::String(rc));
@@ -143,18 +1072,19 @@ juce::String WhisperEngine::transcribe(const juce::AudioBuffer<float>& monoIn,
         return {};
     }
 
+    if (stats)
+        stats->succeeded = true;
+
     if (progressCb) progressCb(1.0);
 
-    juce::String transcript;
-    const int nSegments = whisper_full_n_segments(ctx);
-    for (int i = 0; i < nSegments; ++i)
+    logMsg(logCb, "[Whisper] Transcript: " + transcript);
+
+    if (dual != nullptr)
     {
-        transcript += whisper_full_get_segment_text(ctx, i);
-        if (i + 1 < nSegments)
-            transcript += " ";
+        dual->english = english.trim();
+        dual->language = wparams.language;
+        logMsg(logCb, "[Whisper] English: " + dual->english);
     }
 
-    transcript = transcript.trim();
-    logMsg(logCb, "[Whisper] Transcript: " + transcript);
     return transcript;
-}
\ No newline at end of file
+}
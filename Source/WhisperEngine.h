@@ -2,6 +2,14 @@
 #include <juce_core/juce_core.h>
 #include <juce_audio_basics/juce_audio_basics.h>
 #include <juce_audio_formats/juce_audio_formats.h>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "DecodeScheduler.h"
+#include "EncodeBatcher.h"
+#include "JobHandle.h"
 
 // whisper.cpp C API
 extern "C" {
@@ -9,33 +17,324 @@ extern "C" {
 }
 // Forward-declare to avoid including whisper.h in every file
 struct whisper_context;
+struct whisper_state;
+struct whisper_ext_threadpool;
 
 class WhisperEngine
 {
 public:
+    /** One loaded model plus a pool of reusable decoder states.
+     *  Jobs keep a ModelPtr for their whole run, so publishing a new model never
+     *  frees a context that is still decoding; the old one goes away with its last job.
+     */
+    class Model
+    {
+    public:
+        ~Model();
+
+        whisper_context* getContext() const noexcept { return ctx; }
+        const juce::File& getFile() const noexcept { return file; }
+        const juce::String& getEndpoint() const noexcept { return endpoint; }   // empty = local
+        int getNumaNode() const noexcept { return numaNode; }                   // -1 = not bound to one
+        int getNumRemoteReplicas() const noexcept { return (int)replicas.size(); }
+
+        // Borrow a state for one job (created lazily); give it back when done.
+        whisper_state* acquireState();
+        void releaseState(whisper_state* st);
+
+        // Shared cross-job decoder / encoder, created on first use; null if this context can't batch
+        DecodeScheduler* getDecodeScheduler();
+        EncodeBatcher* getEncodeBatcher(int maxBatch, double deadlineMs);
+
+        // Threads a graph on this model runs with: the compute pool's size, if it has one
+        int getNumComputeThreads() const noexcept;
+
+    private:
+        friend class WhisperEngine;
+        Model() = default;
+
+        whisper_context* ctx = nullptr;
+        juce::File file, weightsFile;   // weightsFile: what was actually loaded (quantised copy)
+        juce::String endpoint;
+        int numaNode = -1;
+
+        // Set on the context before any state exists; released after the context in ~Model
+        std::shared_ptr<whisper_ext_threadpool> computePool;
+
+        std::mutex poolLock;
+        std::vector<whisper_state*> freeStates;
+
+        std::mutex schedulerLock;
+        std::unique_ptr<DecodeScheduler> decodeScheduler;
+        std::unique_ptr<EncodeBatcher> encodeBatcher;
+        bool schedulerTried = false, encodeBatcherTried = false;
+
+        // Copies of this model on other NUMA nodes and on ggml-rpc servers; jobs round-robin
+        // over the free ones. busy serialises jobs per replica: ggml-rpc shares one socket
+        // per endpoint, and a node copy's compute pool runs one graph at a time anyway.
+        std::vector<std::shared_ptr<Model>> replicas;
+        std::atomic<unsigned> nextReplica{ 0 };
+        std::mutex busy;
+
+        JUCE_DECLARE_NON_COPYABLE(Model)
+    };
+
+    using ModelPtr = std::shared_ptr<Model>;
+
+    /** RAII borrow of a pooled state. */
+    class ScopedState
+    {
+    public:
+        explicit ScopedState(Model& m) : model(m), state(m.acquireState()) {}
+        ~ScopedState() { if (state) model.releaseState(state); }
+        whisper_state* get() const noexcept { return state; }
+    private:
+        Model& model;
+        whisper_state* state;
+        JUCE_DECLARE_NON_COPYABLE(ScopedState)
+    };
+
+    /** Optional per-job measurements filled in by transcribe(). */
+    struct JobStats
+    {
+        double audioSeconds = 0.0;
+        double resampleMs   = 0.0;
+        double asrMs        = 0.0;  // whisper_full, including mel/encode/decode
+        int    numTokens    = 0;    // decoded text tokens across all segments
+        bool   succeeded    = false;// ran to the end; an empty transcript is then just silence
+    };
+
+    /** Cheaper settings an overloaded caller can ask for, per job. */
+    struct JobOptions
+    {
+        bool fastDecode       = false;  // best_of 1 and no temperature fallback
+        bool trimAudioContext = false;  // jobs under 30 s encode only the context their audio needs
+        bool useFallbackModel = false;  // run on the fallback model, if one is loaded
+        double budgetMs       = -1.0;   // overrides DecodingOptions::budgetMs when >= 0
+    };
+
+    /** How whisper_full decodes each 30 s window. Defaults are whisper.cpp's own. */
+    struct DecodingOptions
+    {
+        bool  beamSearch     = false;   // greedy otherwise
+        int   beamSize       = 5;
+        int   bestOf         = 5;       // candidates sampled per fallback temperature
+        float temperatureInc = 0.2f;    // step between fallback temperatures; 0 = never fall back
+        int   maxFallbacks   = -1;      // re-decodes per window; -1 = every step up to 1.0
+        float logprobThold   = -1.0f;   // fall back when the average log-probability is lower
+        float entropyThold   = 2.4f;    // ... or the token entropy is lower (repetition loops)
+        float noSpeechThold  = 0.6f;
+
+        // Per-job time budget: no fallback starts that looks set to end after it, and a
+        // window that runs out keeps its best attempt so far. A job still runs every window
+        // at least once, so it can overrun by that much. 0 = no budget.
+        double budgetMs      = 0.0;
+    };
+
+    /** Persistent compute threads shared by every local model's graphs. */
+    struct ThreadPoolOptions
+    {
+        bool enabled = true;        // off = ggml starts and joins its workers per graph
+        int threads = 0;            // 0 = one per core, less one
+        juce::Array<int> cpus;      // pin the workers to these CPUs; empty = no pinning
+        int poll = 1;               // 0..100: how long idle workers spin before sleeping
+    };
+
+    /** Where local weights, KV caches and compute threads live in memory. */
+    struct MemoryPlacement
+    {
+        enum class HugePages { none, transparent, explicitPages };
+        enum class Numa { firstTouch, interleave, perNode };
+
+        HugePages hugePages = HugePages::none;  // explicit pages must be reserved by the OS first
+        Numa numa = Numa::firstTouch;
+    };
+
+    /** Weight format loadModel() converts F16/F32 models to before loading. */
+    enum class Quantisation { none, q8_0, q5_1, q4_k };
+
     WhisperEngine();
     ~WhisperEngine();
 
-    // Load a model (.bin / .ggml) once; returns false on failure
+    // Applies to later loadModel() calls. The quantised model is written once to the app's
+    // data folder (WhisperFreeWin/QuantisedModels) under the source's name, path and full
+    // content hash, and reused after; if it can't be produced the original is loaded as-is.
+    // The model's own folder is only ever read.
+    void setQuantisation(Quantisation q) noexcept { quantisation = q; }
+    Quantisation getQuantisation() const noexcept { return quantisation.load(); }
+
+    // Live-sized jobs (up to 30 s, local context) share one batched decoder: each runs its own
+    // whisper_full(), whose greedy decoder passes advance together with the other jobs', one
+    // token per step. The text is the same as without it; temperature fallbacks and beam
+    // search decode on the job's own state. Off by default.
+    void setBatchedDecoding(bool b) noexcept { batchedDecoding = b; }
+    bool isBatchedDecoding() const noexcept { return batchedDecoding.load(); }
+
+    // Local jobs stack their first encoder window with up to maxBatch - 1 others that arrive
+    // within deadlineMs of it; maxBatch <= 1 turns it off. A model reads these the first time
+    // it batches, so set them before loading.
+    void setBatchedEncoding(int maxBatch, double deadlineMs = 15.0) noexcept
+    {
+        encodeDeadlineMs = deadlineMs;
+        encodeBatchSize = maxBatch;
+    }
+    int getEncodeBatchSize() const noexcept { return encodeBatchSize.load(); }
+
+    // Speculative decoding: inside whisper_full's greedy passes, the fallback model
+    // (loadFallbackModel) drafts up to draftTokens tokens and the main model scores them all
+    // in one decoder pass. Every row still goes through whisper_full's own suppression,
+    // timestamp rules and sampling, and is used only while the sampled tokens match the
+    // drafts, so the text is that of the same job with this off, up to floating-point
+    // differences between multi-token and one-token passes. Temperature fallbacks decode as
+    // usual. Needs a draft with the same vocabulary; applies to local jobs. 0 turns it off.
+    void setSpeculativeDecoding(int draftTokens) noexcept { speculativeTokens = draftTokens; }
+    int getSpeculativeDraftTokens() const noexcept { return speculativeTokens.load(); }
+
+    // Fraction of drafted tokens the main model accepted so far
+    double getSpeculativeAcceptanceRate() const noexcept;
+
+    // Applies to jobs that start afterwards. JobOptions::fastDecode still overrides it, and
+    // beam search keeps jobs off the batched and speculative decoders, which are greedy only.
+    void setDecodingOptions(const DecodingOptions& d);
+    DecodingOptions getDecodingOptions() const;
+
+    // Options from a comma-separated key=value list, e.g. "beam=5,fallbacks=2,budget=1500".
+    // Keys: beam (size, 0 = greedy), best_of, temp_inc, fallbacks, logprob, entropy,
+    // no_speech, budget (ms). Missing keys keep their defaults; unknown ones are ignored.
+    static DecodingOptions decodingOptionsFromString(const juce::String& s);
+
+    // Applies to models loaded afterwards; models already loaded keep their pool. The
+    // encoder and each decoded token run as separate graphs, so a short utterance is mostly
+    // per-graph thread start-up without one. Graphs on one pool run one at a time, each on
+    // all of its threads; the fallback model has pools of its own, so its partials don't
+    // queue behind the main model's finals. With cpus, the job thread driving a graph is
+    // left unpinned next to the pinned pool threads.
+    void setThreadPoolOptions(const ThreadPoolOptions& o);
+    ThreadPoolOptions getThreadPoolOptions() const;
+
+    // "off", or a comma-separated key=value list: threads=N, cpus=0-7 (ranges joined by
+    // '+', e.g. 0-3+8-11), poll=0..100
+    static ThreadPoolOptions threadPoolOptionsFromString(const juce::String& s);
+
+    // Applies to models loaded afterwards. interleave spreads the weights and KV caches over
+    // every NUMA node so no single memory controller serves all the reads. perNode loads one copy of
+    // the main model per node instead, each with its weights, states and (pinned) compute
+    // pool on that node, and jobs round-robin over the copies like RPC replicas; on a
+    // single-node machine it is the same as firstTouch. Costs one model's memory per node.
+    void setMemoryPlacement(const MemoryPlacement& p);
+    MemoryPlacement getMemoryPlacement() const;
+
+    // Comma-separated key=value list: huge=off|thp|explicit, numa=off|interleave|node
+    static MemoryPlacement memoryPlacementFromString(const juce::String& s);
+
+    static juce::String getQuantisationName(Quantisation q);
+    static Quantisation quantisationFromName(const juce::String& name);   // unknown = none
+
+    // Load a model (.bin / .ggml) and swap it in atomically; returns false on failure.
+    // Jobs already running keep the previous model until they finish.
     bool loadModel(const juce::File& modelFile, std::function<void(const juce::String&)> logCb);
 
+    // A second, smaller model for jobs that ask for it (JobOptions::useFallbackModel), e.g.
+    // tiny next to small, and the draft model for speculative decoding. Local only;
+    // quantised like the main model.
+    bool loadFallbackModel(const juce::File& modelFile, std::function<void(const juce::String&)> logCb);
+    bool hasFallbackModel() const { return std::atomic_load(&fallback) != nullptr; }
+
+    // ggml-rpc servers ("host:port") that later loadModel() calls also upload the model to.
+    // Jobs then run on whichever server is free, the local context taking the rest.
+    // ggml-rpc treats a server lost mid-session as fatal, so prefer this inside the
+    // engine daemon rather than the host process.
+    void setRpcEndpoints(const juce::StringArray& endpoints);
+    juce::StringArray getRpcEndpoints() const;
+
     // Transcribe a mono float buffer at sampleRate (any rate). Internally resamples to 16k.
     // Returns the transcript string (empty on failure). Progress/log callbacks are optional.
+    // Setting cancel aborts the job at the next encoder window or graph compute; the
+    // result is then empty.
     juce::String transcribe(const juce::AudioBuffer<float>& mono,
                             double sampleRate,
                             std::function<void(double)> progressCb,
-                            std::function<void(const juce::String&)> logCb);
+                            std::function<void(const juce::String&)> logCb,
+                            JobStats* stats = nullptr,
+                            const JobToken* cancel = nullptr,
+                            const JobOptions* options = nullptr);
 
-    bool isReady() const { return ctx != nullptr; }
-    juce::File getModelPath() const { return modelPath; }
+    /** Output of transcribeAndTranslate(). */
+    struct DualResult
+    {
+        juce::String transcript;    // source language
+        juce::String english;       // Whisper's own X->English; equals transcript for English input
+        juce::String language;      // detected language code
+    };
 
-private:
-    whisper_context* ctx = nullptr;
-    juce::File modelPath;
+    // Transcribe and translate to English from one encoder pass per window: the
+    // translate task re-runs only the decoder on each encoding the transcribe task
+    // made, wherever whisper_full seeked to. Costs about one transcribe() plus a
+    // decode, against two full transcribe() runs.
+    DualResult transcribeAndTranslate(const juce::AudioBuffer<float>& mono,
+                                      double sampleRate,
+                                      std::function<void(double)> progressCb,
+                                      std::function<void(const juce::String&)> logCb,
+                                      JobStats* stats = nullptr,
+                                      const JobToken* cancel = nullptr,
+                                      const JobOptions* options = nullptr);
+
+    // Snapshot of the current model; stays valid for as long as the caller holds it.
+    ModelPtr acquireModel() const { return std::atomic_load(&current); }
 
-    juce::AudioBuffer<float> resampleTo16k(const juce::AudioBuffer<float>& in,
+    // Mono resample to Whisper's 16 kHz input rate (public so the kernel benchmarks can drive it).
+    static juce::AudioBuffer<float> resampleTo16k(const juce::AudioBuffer<float>& in,
         double inRate,
-        std::function<void(const juce::String&)>& logCb);
+        const std::function<void(const juce::String&)>& logCb = nullptr);
+
+    bool isReady() const { return acquireModel() != nullptr; }
+    juce::File getModelPath() const { auto m = acquireModel(); return m ? m->getFile() : juce::File(); }
+
+private:
+    juce::String runJob(const juce::AudioBuffer<float>& mono, double sampleRate,
+                        std::function<void(double)> progressCb,
+                        const std::function<void(const juce::String&)>& logCb,
+                        JobStats* stats, DualResult* dual, const JobToken* cancel,
+                        const JobOptions* options);
+
+    // The pool new models run on, created on first use; null if disabled. numaNode >= 0
+    // gives that node's own pool, pinned to its CPUs; fallbackModel a separate set of pools.
+    std::shared_ptr<whisper_ext_threadpool> getComputePool(int numaNode = -1, bool fallbackModel = false) const;
+
+    // Loads one local context with its weights and future states placed for numaNode
+    whisper_context* loadLocalContext(const juce::File& weightsFile, const whisper_context_params& cparams,
+                                      const MemoryPlacement& placement, int numaNode) const;
+
+    // Loads modelFile (quantised if configured), plus NUMA node copies and RPC replicas
+    // unless fallbackModel, which runs on compute pools of its own instead
+    ModelPtr createModel(const juce::File& modelFile, bool fallbackModel,
+                         const std::function<void(const juce::String&)>& logFn) const;
+
+    juce::File prepareQuantised(const juce::File& source, Quantisation q,
+                                const std::function<void(const juce::String&)>& logFn) const;
+
+    ModelPtr current, fallback;
+    std::atomic<Quantisation> quantisation{ Quantisation::none };
+    std::atomic<bool> batchedDecoding{ false };
+    std::atomic<int> encodeBatchSize{ 1 };
+    std::atomic<double> encodeDeadlineMs{ 15.0 };
+    std::atomic<int> speculativeTokens{ 0 };
+    std::atomic<juce::uint64> draftedTokens{ 0 }, acceptedTokens{ 0 };
+    std::atomic<juce::uint32> loadGeneration{ 0 };
+    std::mutex swapLock;    // held across loadGeneration's check and the swap of current
+
+    mutable std::mutex endpointLock;
+    juce::StringArray rpcEndpoints;
+
+    mutable std::mutex decodingLock;
+    DecodingOptions decoding;
+
+    mutable std::mutex computePoolLock;
+    ThreadPoolOptions threadPoolOptions;
+    mutable std::map<std::pair<int, bool>, std::shared_ptr<whisper_ext_threadpool>> computePools;   // by (NUMA node, -1 = shared; fallback model); lazily created
+
+    mutable std::mutex placementLock;
+    MemoryPlacement placement;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WhisperEngine)
 };
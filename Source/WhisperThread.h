@@ -6,6 +6,10 @@
 #include <deque>
 #include "WhisperEngine.h"
 #include "TranslationEngine.h"
+#include "JobHandle.h"
+#include "OverloadController.h"
+#include "Metrics.h"
+#include "Trace.h"
 
 class WhisperThread : public juce::Thread
 {
@@ -29,31 +33,69 @@ public:
     ~WhisperThread() override
     {
         signalThreadShouldExit();
-        flushQueue();
+        cancelAll();
         stopThread(3000);
     }
 
-    void sendBufferNow(const juce::AudioBuffer<float>& buf,
+    // Queues a buffer and returns its handle. With supersedeOlder, jobs still queued are
+    // dropped and the running one is cancelled: for callers whose newest buffer replaces
+    // the older ones (a re-sent file, a sliding live window), not for independent jobs.
+    // Otherwise a full queue refuses the buffer: logs "busy" and returns nullptr.
+    JobHandle sendBufferNow(const juce::AudioBuffer<float>& buf,
         double sampleRate,
-        bool autoTranslateFlag)
+        bool autoTranslateFlag,
+        bool supersedeOlder = false)
     {
         juce::ScopedLock sl(queueLock);
+        if (supersedeOlder)
+            cancelAllLocked();
+
+        // Bounded, so latency and memory stay capped; every queued job was accepted and will
+        // get its result, so it is the new buffer that gets turned away
+        if ((int)queue.size() >= juce::jmax(1, maxQueued.load()))
+        {
+            Metrics::get().increment(Metrics::Counter::drops);
+            if (logCb) logCb("[ASR] Busy: " + juce::String((int)queue.size())
+                + " buffers already waiting; this one was not queued");
+            return nullptr;
+        }
+
         Task t;
         t.buffer.makeCopyOf(buf);
         t.sampleRate = sampleRate;
         t.autoTranslate = autoTranslateFlag;
+        t.enqueuedMs = juce::Time::getMillisecondCounterHiRes();
+        t.id = ++lastTaskId;
+        t.job = makeJobHandle();
+        auto handle = t.job;
+        WFW_TRACE_ASYNC_BEGIN("queue", "queued", t.id);
         queue.push_back(std::move(t));
+        Metrics::get().increment(Metrics::Counter::jobsQueued);
         notify();
+        return handle;
     }
 
     void flushQueue()
     {
         juce::ScopedLock sl(queueLock);
-        queue.clear();
+        flushQueueLocked();
+    }
+
+    // Drops queued jobs and aborts the running one (e.g. the file it came from was replaced)
+    void cancelAll()
+    {
+        juce::ScopedLock sl(queueLock);
+        cancelAllLocked();
     }
 
     void setTranslatorLoaded(bool b) { translatorLoaded = b; }
 
+    void setMaxQueuedBuffers(int n) noexcept { maxQueued = n; }
+
+    // Degrades jobs while the worker runs slower than real time (see OverloadController).
+    // Only fastDecode and smallerModel apply here; the other steps are for live segments.
+    OverloadController& getOverloadController() noexcept { return overload; }
+
     void run() override
     {
         while (!threadShouldExit())
@@ -66,6 +108,7 @@ public:
                 {
                     task = std::move(queue.front());
                     queue.pop_front();
+                    running = task.job;
                 }
             }
 
@@ -74,23 +117,56 @@ public:
 
             if (task.buffer.getNumSamples() > 0)
             {
+                WFW_TRACE_ASYNC_END("queue", "queued", task.id);
+                WFW_TRACE_SCOPE("queue", "job");
+
+                const double startMs = juce::Time::getMillisecondCounterHiRes();
+                Metrics::get().record(Metrics::Stage::queueWait, startMs - task.enqueuedMs);
+
+                // A whole file is one buffer: no segment length to shorten, and one RMS over
+                // all of it says nothing about speech, so those steps stay with live segments
+                auto options = overload.getJobOptions();
+                options.trimAudioContext = false;
+
                 try
                 {
                     if (logCb)
                         logCb("[ASR] Processing " +
                             juce::String(task.buffer.getNumSamples()) + " samples");
 
+                    WhisperEngine::JobStats stats;
                     auto text = asr.transcribe(task.buffer,
                         task.sampleRate,
                         progressCb,
-                        logCb);
+                        logCb,
+                        &stats,
+                        task.job.get(),
+                        &options);
+
+                    // A superseded job's text is stale even if it finished first
+                    if (task.job->isCancelled())
+                    {
+                        text.clear();
+                    }
+                    else
+                    {
+                        Metrics::get().increment(Metrics::jobOutcome(stats.succeeded, text.isNotEmpty()));
+
+                        if (overload.jobFinished(task.buffer.getNumSamples() / task.sampleRate,
+                                startMs - task.enqueuedMs, juce::Time::getMillisecondCounterHiRes() - startMs)
+                            && logCb)
+                        {
+                            logCb("[ASR] Overload level " + juce::String(overload.getLevel()) + ": " + overload.describe());
+                        }
+                    }
 
                     if (text.isNotEmpty() && transcriptCb)
                         transcriptCb(text);
 
                     if (task.autoTranslate && translatorLoaded && text.isNotEmpty())
                     {
-                        auto translated = translator.translate(text, logCb);
+                        WFW_TRACE_SCOPE("mt", "translate");
+                        auto translated = translator.translate(text, logCb, nullptr, task.job.get());
                         if (translated.isNotEmpty() && translationCb)
                             translationCb(translated);
                     }
@@ -100,10 +176,16 @@ public:
                 }
                 catch (const std::exception& e)
                 {
+                    Metrics::get().increment(Metrics::Counter::jobsFailed);
                     if (logCb)
                         logCb("[ASR] Exception: " + juce::String(e.what()));
                 }
 
+                {
+                    juce::ScopedLock sl(queueLock);
+                    running.reset();
+                }
+
                 continue;
             }
 
@@ -112,11 +194,31 @@ public:
     }
 
 private:
+    void flushQueueLocked()
+    {
+        Metrics::get().increment(Metrics::Counter::drops, (juce::int64)queue.size());
+       #if WFW_ENABLE_TRACE
+        for (auto& t : queue)
+            WFW_TRACE_ASYNC_END("queue", "queued", t.id);
+       #endif
+        queue.clear();
+    }
+
+    void cancelAllLocked()
+    {
+        flushQueueLocked();
+        if (running != nullptr)
+            running->cancel();
+    }
+
     struct Task
     {
         juce::AudioBuffer<float> buffer;
         double sampleRate = 16000.0;
         bool   autoTranslate = false;
+        double enqueuedMs = 0.0;
+        juce::uint64 id = 0;
+        JobHandle job;
     };
 
     WhisperEngine& asr;
@@ -129,6 +231,11 @@ private:
 
     juce::CriticalSection queueLock;
     std::deque<Task>      queue;
+    juce::uint64          lastTaskId = 0;
+    JobHandle             running;      // job of the task being processed, if any
+    std::atomic<int>      maxQueued{ 8 };
+
+    OverloadController overload;
 
-    bool translatorLoaded = false;
+    std::atomic<bool> translatorLoaded{ false };
 };
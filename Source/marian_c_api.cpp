@@ -1,5 +1,7 @@
 // Source/marian_c_api.cpp
 #include "marian_c_api.h"
+#include "Metrics.h"
+#include "Trace.h"
 
 #include <string>
 #include <vector>
@@ -99,18 +101,24 @@ extern "C"
         const char* src,
         char* dstBuf,
         int               dstBufSize,
-        std::function<void(const juce::String&)> logCb)
+        std::function<void(const juce::String&)> logCb,
+        int* numOutputTokens)
     {
         if (!t || !dstBuf || dstBufSize <= 0)
             return false;
 
         if (!src) src = "";
 
+        WFW_TRACE_SCOPE("mt", "marianTranslate");
+
         try
         {
             if (logCb) logCb("[MT] Input: " + juce::String(src));
+            // SentencePiece time is encode + decode, recorded once per call
+            double spMs = juce::Time::getMillisecondCounterHiRes();
             std::vector<std::string> srcTokens;
             {
+                WFW_TRACE_SCOPE("mt", "sentencepiece_encode");
                 std::vector<std::string> pieces;
                 auto status = t->spSrc->Encode(src, &pieces);
                 if (!status.ok()) {
@@ -119,21 +127,35 @@ extern "C"
                 }
                 srcTokens = std::move(pieces);
             }
+            spMs = juce::Time::getMillisecondCounterHiRes() - spMs;
             std::vector<std::vector<std::string>> batch;
             batch.emplace_back(std::move(srcTokens));
             /*ctranslate2::TranslationOptions opts;
             opts.output_type = ctranslate2::TranslationResult::hypotheses::Tokens;*/
 
-            auto results = t->translator->translate_batch(batch);
+            std::vector<ctranslate2::TranslationResult> results;
+            {
+                Metrics::ScopedTimer timer(Metrics::Stage::ct2Decode);
+                WFW_TRACE_SCOPE("mt", "translate_batch");
+                results = t->translator->translate_batch(batch);
+            }
             if (results.empty() || results[0].output().empty())
             {
                 if (logCb) logCb("[MT] translate_batch returned empty!");
                 return false;
             }
             const auto& outTokens = results[0].output();
+            if (numOutputTokens) *numOutputTokens = (int)outTokens.size();
 
             std::string detok;
-            auto status = t->spTgt->Decode(outTokens, &detok);
+            const double tDecode = juce::Time::getMillisecondCounterHiRes();
+            sentencepiece::util::Status status;
+            {
+                WFW_TRACE_SCOPE("mt", "sentencepiece_decode");
+                status = t->spTgt->Decode(outTokens, &detok);
+            }
+            spMs += juce::Time::getMillisecondCounterHiRes() - tDecode;
+            Metrics::get().record(Metrics::Stage::sentencePiece, spMs);
             if (!status.ok()) {
                 if (logCb) logCb("[MT] SentencePiece decode failed: " + status.ToString());
                 return false;
@@ -158,4 +180,96 @@ extern "C"
         }
     }
 
+    bool marianTranslateBatch(MarianTranslator* t,
+        const std::vector<std::string>& src,
+        std::vector<std::string>& dst,
+        std::function<void(const juce::String&)> logCb,
+        std::vector<int>* numOutputTokens)
+    {
+        dst.assign(src.size(), std::string());
+        if (numOutputTokens) numOutputTokens->assign(src.size(), 0);
+
+        if (!t || src.empty())
+            return false;
+
+        WFW_TRACE_SCOPE("mt", "marianTranslateBatch");
+
+        try
+        {
+            double spMs = juce::Time::getMillisecondCounterHiRes();
+            std::vector<std::vector<std::string>> batch(src.size());
+            for (size_t i = 0; i < src.size(); ++i)
+            {
+                auto status = t->spSrc->Encode(src[i], &batch[i]);
+                if (!status.ok() && logCb)
+                    logCb("[MT] SentencePiece encode failed: " + status.ToString());
+            }
+            spMs = juce::Time::getMillisecondCounterHiRes() - spMs;
+
+            std::vector<ctranslate2::TranslationResult> results;
+            {
+                Metrics::ScopedTimer timer(Metrics::Stage::ct2Decode);
+                WFW_TRACE_SCOPE("mt", "translate_batch");
+                results = t->translator->translate_batch(batch);
+            }
+
+            const double tDecode = juce::Time::getMillisecondCounterHiRes();
+            for (size_t i = 0; i < results.size() && i < dst.size(); ++i)
+            {
+                if (results[i].output().empty())
+                    continue;
+
+                if (numOutputTokens) (*numOutputTokens)[i] = (int)results[i].output().size();
+                t->spTgt->Decode(results[i].output(), &dst[i]);
+            }
+            spMs += juce::Time::getMillisecondCounterHiRes() - tDecode;
+            Metrics::get().record(Metrics::Stage::sentencePiece, spMs);
+
+            if (logCb) logCb("[MT] Batch of " + juce::String((int)src.size()) + " translated");
+            return true;
+        }
+        catch (const std::exception& e) {
+            if (logCb) logCb("[MT] exception: " + juce::String(e.what()));
+            return false;
+        }
+        catch (...) {
+            if (logCb) logCb("[MT] unknown error");
+            return false;
+        }
+    }
+
+    int marianTokenRoundTrip(MarianTranslator* t,
+        const char* src,
+        char* dstBuf,
+        int               dstBufSize)
+    {
+        if (!t || !dstBuf || dstBufSize <= 0)
+            return -1;
+
+        if (!src) src = "";
+
+        try
+        {
+            std::vector<std::string> pieces;
+            if (!t->spSrc->Encode(src, &pieces).ok())
+                return -1;
+
+            std::string detok;
+            if (!t->spTgt->Decode(pieces, &detok).ok())
+                return -1;
+
+            if ((int)detok.size() + 1 > dstBufSize)
+                detok.resize(static_cast<size_t>(dstBufSize - 1));
+
+            std::memcpy(dstBuf, detok.c_str(), detok.size());
+            dstBuf[detok.size()] = '\0';
+
+            return (int)pieces.size();
+        }
+        catch (...)
+        {
+            return -1;
+        }
+    }
+
 } // extern "C"
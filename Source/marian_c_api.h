@@ -1,6 +1,8 @@
 // Source/marian_c_api.h
 #pragma once
 #include <juce_core/juce_core.h>
+#include <string>
+#include <vector>
 
 extern "C"
 {
@@ -16,5 +18,21 @@ extern "C"
         const char* src,
         char* dstBuf,
         int               dstBufSize,
-        std::function<void(const juce::String&)> logCb);
+        std::function<void(const juce::String&)> logCb,
+        int* numOutputTokens = nullptr);
+
+    // Translates several sentences with one translate_batch call. dst gets one entry per
+    // src entry (empty on failure for that entry). Returns false if the whole batch failed.
+    bool marianTranslateBatch(MarianTranslator* t,
+        const std::vector<std::string>& src,
+        std::vector<std::string>& dst,
+        std::function<void(const juce::String&)> logCb,
+        std::vector<int>* numOutputTokens = nullptr);
+
+    // SentencePiece encode (source model) + decode (target model) only, no CTranslate2.
+    // Returns the number of source pieces, or -1 on failure. Used by the kernel benchmarks.
+    int marianTokenRoundTrip(MarianTranslator* t,
+        const char* src,
+        char* dstBuf,
+        int               dstBufSize);
 }
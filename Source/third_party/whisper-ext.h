@@ -0,0 +1,216 @@
+#pragma once
+
+// Local extensions to the bundled whisper.cpp.
+// Implemented at the end of whisper.cpp; kept out of whisper.h so that header
+// stays identical to upstream.
+
+#include "whisper.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    // Per-state timings accumulated since the last whisper_ext_reset_state_timings().
+    // Same counters whisper_print_timings() prints, but for an arbitrary state.
+    struct whisper_ext_timings {
+        int64_t t_mel_us;
+        int64_t t_sample_us;
+        int64_t t_encode_us;
+        int64_t t_decode_us;   // single-token decoder calls
+        int64_t t_batchd_us;   // small batched decoder calls
+        int64_t t_prompt_us;   // prompt decoder calls
+
+        int32_t n_sample;
+        int32_t n_encode;
+        int32_t n_decode;
+        int32_t n_batchd;
+        int32_t n_prompt;
+        int32_t n_fail_p;      // logprob threshold fallbacks
+        int32_t n_fail_h;      // entropy threshold fallbacks
+        int32_t n_fail_cut;    // fallbacks skipped for whisper_ext_set_decode_budget()
+        int32_t n_drafted;     // draft tokens the target scored, see whisper_ext_set_draft()
+        int32_t n_accepted;    // ... and of those, the ones it went on to sample
+    };
+
+    WHISPER_API void whisper_ext_get_state_timings(struct whisper_state * state, struct whisper_ext_timings * out);
+    WHISPER_API void whisper_ext_reset_state_timings(struct whisper_state * state);
+
+    // Called with is_begin = 1/0 around the mel, encoder, decoder and logits phases
+    // and every ggml graph compute. name is a string literal. Process-wide; install
+    // once before any transcription starts, pass NULL to remove.
+    typedef void (*whisper_ext_trace_fn)(const char * name, int is_begin, void * user_data);
+
+    WHISPER_API void whisper_ext_set_trace_callback(whisper_ext_trace_fn fn, void * user_data);
+
+    // While enabled, an encode of the same mel offset (and audio_ctx) as the state's last
+    // one is skipped: the cross-attention KV it produced is still there and decoding only
+    // reads it. Saves the second encode of language auto-detection, and lets
+    // whisper_full_with_state(ctx, state, params, NULL, 0) run another task (e.g.
+    // translate) on the mel already in the state for the cost of its decoder alone.
+    // New mel data invalidates it.
+    WHISPER_API void whisper_ext_set_reuse_encoding(struct whisper_state * state, int enable);
+
+    // Later whisper_full runs on state return after n_windows encoder windows (0 = no
+    // limit); whisper_ext_get_seek() then gives the mel frame (10 ms) the next window
+    // starts at. Run a second task over [offset, seek) with reuse-encoding on and it
+    // decodes the encoding just made, however whisper_full moved through the audio.
+    WHISPER_API void whisper_ext_set_max_windows(struct whisper_state * state, int n_windows);
+    WHISPER_API int  whisper_ext_get_seek(struct whisper_state * state);
+
+    // Encoder context for encodes that don't go through whisper_full (which sets it from
+    // params.audio_ctx); 0 = the model's full 1500. Pooled states otherwise keep the value
+    // of whichever job used them last.
+    WHISPER_API void whisper_ext_set_audio_ctx(struct whisper_state * state, int n_audio_ctx);
+
+    // Limits temperature fallback in later whisper_full runs on this state: at most
+    // max_fallbacks re-decodes per window (-1 = as many as params allow), and none that
+    // looks set to end more than budget_us from now (0 = no time limit). A window that
+    // hits either keeps its best attempt that didn't fail, or else the last one. Pooled
+    // states keep the limits of whichever job set them last.
+    WHISPER_API void whisper_ext_set_decode_budget(struct whisper_state * state, int max_fallbacks, int64_t budget_us);
+
+    // Persistent ggml compute threads. Without one, ggml starts and joins a fresh set of
+    // workers for every graph: each conv, encoder and cross pass and each decoded token.
+    // With cpus (n_cpus ids, NULL = no pinning) the n_threads - 1 pool threads are pinned
+    // one each to them in ascending order; the thread that calls into whisper computes as
+    // worker 0 and is never pinned, so it can be any job's thread. poll (0..100) is how long
+    // idle workers spin before they sleep. Graphs run one at a time per pool. Under
+    // GGML_USE_OPENMP ggml keeps OpenMP's own team and none of this applies.
+    struct whisper_ext_threadpool;
+
+    WHISPER_API struct whisper_ext_threadpool * whisper_ext_threadpool_init(int n_threads, const int * cpus, int n_cpus, int poll);
+    WHISPER_API void whisper_ext_threadpool_free(struct whisper_ext_threadpool * pool);
+    WHISPER_API int  whisper_ext_threadpool_n_threads(const struct whisper_ext_threadpool * pool);
+
+    // Every later graph on ctx (its states' and its batch decoder's and encoder's) runs on
+    // pool, with n_threads capped at its size; NULL = ggml's own threads per graph. The pool
+    // must outlive the context.
+    WHISPER_API void whisper_ext_set_threadpool(struct whisper_context * ctx, struct whisper_ext_threadpool * pool);
+
+    // Where CPU weights and KV caches live. Huge pages cut TLB misses on the weight reads
+    // of every graph; explicit ones need pages reserved up front (vm.nr_hugepages, or the
+    // "Lock pages in memory" right on Windows) and fall back to transparent, then normal
+    // pages. Interleave spreads pages round-robin over all NUMA nodes (Linux only); bind
+    // keeps them all on node. Anything the platform can't do falls back to the default.
+    enum whisper_ext_huge_pages {
+        WHISPER_EXT_HUGE_PAGES_NONE        = 0,
+        WHISPER_EXT_HUGE_PAGES_TRANSPARENT = 1,
+        WHISPER_EXT_HUGE_PAGES_EXPLICIT    = 2,
+    };
+
+    enum whisper_ext_numa {
+        WHISPER_EXT_NUMA_FIRST_TOUCH = 0, // the node of the thread that first writes a page
+        WHISPER_EXT_NUMA_INTERLEAVE  = 1,
+        WHISPER_EXT_NUMA_BIND        = 2,
+    };
+
+    struct whisper_ext_mem_policy {
+        int huge_pages; // enum whisper_ext_huge_pages
+        int numa;       // enum whisper_ext_numa
+        int node;       // for WHISPER_EXT_NUMA_BIND
+    };
+
+    // whisper_init_from_file_with_params_no_state() with the weights placed per weights.
+    WHISPER_API struct whisper_context * whisper_ext_init_from_file_placed(const char * path_model, struct whisper_context_params params, struct whisper_ext_mem_policy weights);
+
+    // KV caches of ctx's states created (or regrown) from now on follow policy.
+    WHISPER_API void whisper_ext_set_state_placement(struct whisper_context * ctx, struct whisper_ext_mem_policy policy);
+
+    // Number of NUMA nodes (1 when unknown), and the node of a logical CPU (-1 when unknown).
+    WHISPER_API int whisper_ext_numa_n_nodes(void);
+    WHISPER_API int whisper_ext_numa_node_of_cpu(int cpu);
+
+    // whisper_decode_with_state() that keeps the logits of every position, not just the
+    // last: row i of whisper_get_logits_from_state() scores the token after tokens[i].
+    // Cache entries at n_past and beyond are dropped first, so calling again with a
+    // smaller n_past rolls back rejected tokens; n_past == 0 starts from an empty cache.
+    WHISPER_API int whisper_ext_decode_all_logits(struct whisper_context * ctx, struct whisper_state * state, const whisper_token * tokens, int n_tokens, int n_past, int n_threads);
+
+    // ggml-rpc offload (needs a build with GGML_RPC; endpoints are "host:port").
+    // The returned context keeps its weights on the server, uploaded tensor by tensor at
+    // load; states created from it hold their KV caches there too, so a job only ships
+    // the mel and the logits. One connection per endpoint per process: callers must not
+    // run two states of the same endpoint at once. NULL if the server is unreachable.
+    WHISPER_API struct whisper_context * whisper_ext_init_from_file_rpc(const char * path_model, struct whisper_context_params params, const char * endpoint);
+
+    // 1 if the server answers; free/total memory in bytes when non-NULL.
+    WHISPER_API int whisper_ext_rpc_ping(const char * endpoint, size_t * free_mem, size_t * total_mem);
+
+    // Serves this process's CPU backend on endpoint; blocks for the life of the process.
+    WHISPER_API int whisper_ext_rpc_serve(const char * endpoint, int n_threads);
+
+    // Rewrites an F32/F16 ggml model with its 2D weights quantised to type (Q8_0, Q5_1
+    // or Q4_K), as examples/quantize does. Q4_K needs n_audio_state % 256 == 0, so not
+    // tiny. Rows are split over n_threads. 0 on success; fname_out is left partial on error.
+    WHISPER_API int whisper_ext_model_quantize(const char * fname_inp, const char * fname_out, enum ggml_type type, int n_threads);
+
+    // Continuous batching across states: one decoder graph advances several independent
+    // streams (each a state that has been encoded) by one step, reading the weights once
+    // for all of them. Each stream keeps its own KV caches; positions in the self-attention
+    // cache are n_past .. n_past + n_tokens - 1, independent of whisper_decode()'s slots.
+    // The decoder object owns the compute buffers and must be used by one thread at a time.
+    struct whisper_ext_batch_decoder;
+
+    struct whisper_ext_stream_step {
+        struct whisper_state * state;
+        const whisper_token  * tokens;   // the prompt on a stream's first step, then its last token
+        int                    n_tokens;
+        int                    n_past;   // tokens already in this state's cache
+        float                * logits;   // out: n_vocab logits after the last token
+    };
+
+    // NULL for flash-attention or ggml-rpc contexts.
+    WHISPER_API struct whisper_ext_batch_decoder * whisper_ext_batch_decoder_init(struct whisper_context * ctx, int max_streams);
+    WHISPER_API void whisper_ext_batch_decoder_free(struct whisper_ext_batch_decoder * decoder);
+
+    // 0 on success; n_steps must not exceed max_streams.
+    WHISPER_API int whisper_ext_batch_decode(struct whisper_ext_batch_decoder * decoder, struct whisper_ext_stream_step * steps, int n_steps, int n_threads);
+
+    // Hands the decoder passes of whisper_full_with_state()'s single-decoder attempts (greedy
+    // at temperature 0) to fn, e.g. to run them through whisper_ext_batch_decode() with other
+    // states'. fn decodes n_tokens tokens at positions n_past .. into the state's self-attention
+    // cache as whisper_ext_batch_decode() does, writes the n_vocab logits after the last one,
+    // and returns 0; anything else fails the run. Logits processing, sampling, timestamps,
+    // seeking and the temperature fallbacks (which need several decoders, so decode on the
+    // state as usual) are whisper_full's own, so the output is the same as without the hook.
+    // NULL removes it.
+    typedef int (*whisper_ext_decode_fn)(struct whisper_state * state, const whisper_token * tokens, int n_tokens, int n_past, float * logits, void * user_data);
+
+    WHISPER_API void whisper_ext_set_decode_callback(struct whisper_state * state, whisper_ext_decode_fn fn, void * user_data);
+
+    // Speculative decoding inside whisper_full_with_state(): in its single-decoder attempts
+    // (greedy at temperature 0), draft_state proposes up to n_draft tokens (argmax under the
+    // run's fixed suppressions) and the target scores its own next token and all of them in
+    // one pass (whisper_ext_decode_all_logits()). Each row then goes through whisper_full's
+    // own logits processing and sampling, and a row is used only while the sampled tokens
+    // match the drafts, so the output is whisper_full's greedy output. The draft must share
+    // the target's vocabulary (n_vocab), else it is ignored. whisper_full computes the draft's
+    // mel when it is given samples; with NULL samples it must already hold the same audio's.
+    // Takes precedence over whisper_ext_set_decode_callback(). NULL / 0 turns it off.
+    WHISPER_API void whisper_ext_set_draft(struct whisper_state * state, struct whisper_context * draft_ctx, struct whisper_state * draft_state, int n_draft);
+
+    // Batched encoding: the mel windows of several states (each already holding its mel)
+    // go through one conv + encoder + cross-KV graph, side by side along the token axis,
+    // so the encoder's matmuls run over n_batch windows at once. Each state ends up as if
+    // it had encoded its window itself, with reuse-encoding bookkeeping set, so a following
+    // whisper_full_with_state(..., NULL, 0) under whisper_ext_set_reuse_encoding() skips
+    // that encode. All states must share exp_n_audio_ctx. One thread at a time per encoder.
+    struct whisper_ext_batch_encoder;
+
+    // NULL for flash-attention or ggml-rpc contexts.
+    WHISPER_API struct whisper_ext_batch_encoder * whisper_ext_batch_encoder_init(struct whisper_context * ctx, int max_batch);
+    WHISPER_API void whisper_ext_batch_encoder_free(struct whisper_ext_batch_encoder * encoder);
+
+    // 0 on success; on failure no state is marked encoded.
+    WHISPER_API int whisper_ext_batch_encode(struct whisper_ext_batch_encoder * encoder, struct whisper_state ** states, const int * mel_offsets, int n_batch, int n_threads);
+
+    // The sampler's per-step logits kernels, for benchmarking and checking them against
+    // the scalar code they replaced (use_simd = 0). logprobs = log_softmax(logits) and,
+    // if probs is non-NULL, probs = exp(logprobs); -INFINITY logits stay suppressed.
+    // The argmax is the first index of the largest logit.
+    WHISPER_API void whisper_ext_logits_log_softmax(const float * logits, float * logprobs, float * probs, int n, int use_simd);
+    WHISPER_API int  whisper_ext_logits_argmax(const float * logits, int n, int use_simd);
+
+#ifdef __cplusplus
+}
+#endif
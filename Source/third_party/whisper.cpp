@@ -9,6 +9,7 @@
 
 
 #include "whisper.h"
+#include "whisper-ext.h"
 
 #ifdef WHISPER_USE_COREML
 #include "coreml/whisper-encoder.h"
@@ -46,6 +47,10 @@
 #include "ggml-alloc.h"
 #include "ggml-backend.h"
 
+#ifdef GGML_USE_RPC
+#include "ggml-rpc.h"
+#endif
+
 #include <atomic>
 #include <algorithm>
 #include <cassert>
@@ -59,12 +64,25 @@
 #include <set>
 #include <string>
 #include <thread>
+#include <mutex>
 #include <vector>
 #include <regex>
 #include <random>
 #include <functional>
 #include <codecvt>
 
+// SIMD for the sampler's logits kernels (see whisper_process_logits)
+#if defined(__AVX2__)
+#define WHISPER_VEC_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WHISPER_VEC_SSE2
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define WHISPER_VEC_NEON
+#include <arm_neon.h>
+#endif
+
 #if defined(_MSC_VER)
 #pragma warning(disable: 4244 4267) // possible loss of data
 #endif
@@ -173,6 +191,33 @@ static void whisper_log_callback_default(ggml_log_level level, const char * text
 #define WHISPER_MAX_DECODERS 8
 #define WHISPER_MAX_NODES 4096
 
+//
+// trace markers (see whisper_ext_set_trace_callback)
+//
+
+static whisper_ext_trace_fn g_ext_trace_fn        = nullptr;
+static void *               g_ext_trace_user_data = nullptr;
+
+struct whisper_ext_trace_scope {
+    const char * name;
+
+    explicit whisper_ext_trace_scope(const char * name) : name(name) {
+        if (g_ext_trace_fn) {
+            g_ext_trace_fn(name, 1, g_ext_trace_user_data);
+        }
+    }
+
+    ~whisper_ext_trace_scope() {
+        if (g_ext_trace_fn) {
+            g_ext_trace_fn(name, 0, g_ext_trace_user_data);
+        }
+    }
+};
+
+#define WHISPER_EXT_TRACE_CONCAT2(a, b) a##b
+#define WHISPER_EXT_TRACE_CONCAT(a, b) WHISPER_EXT_TRACE_CONCAT2(a, b)
+#define WHISPER_EXT_TRACE(name) whisper_ext_trace_scope WHISPER_EXT_TRACE_CONCAT(whisper_ext_trace_, __LINE__)(name)
+
 //
 // ggml helpers
 //
@@ -196,15 +241,48 @@ static bool ggml_graph_compute_helper(
     return ggml_graph_compute(graph, &plan);
 }
 
+// local extension: pages that weights or KV caches were placed in by
+// whisper_ext_alloc_ctx_tensors(); freed after the ggml buffer that wraps them
+struct whisper_ext_mem {
+    void * data = nullptr;
+    size_t size = 0;
+    int    kind = 0; // 0 = none, 1 = mmap, 2 = VirtualAlloc
+};
+
+static ggml_backend_buffer_t whisper_ext_alloc_ctx_tensors(struct ggml_context * ctx, const whisper_ext_mem_policy & policy, whisper_ext_mem & mem);
+static void whisper_ext_mem_free(whisper_ext_mem & mem);
+
+static bool whisper_ext_mem_policy_is_default(const whisper_ext_mem_policy & policy) {
+    return policy.huge_pages == WHISPER_EXT_HUGE_PAGES_NONE && policy.numa == WHISPER_EXT_NUMA_FIRST_TOUCH;
+}
+
+// local extension: persistent compute threads, see whisper_ext_threadpool_init()
+struct whisper_ext_threadpool {
+    ggml_threadpool * tp = nullptr;
+    int n_threads = 0;
+
+    std::mutex lock; // a ggml threadpool runs one graph at a time
+};
+
 static bool ggml_graph_compute_helper(
       ggml_backend_sched_t   sched,
         struct ggml_cgraph * graph,
-                       int   n_threads) {
+                       int   n_threads,
+    whisper_ext_threadpool * pool = nullptr) {
+
+    std::unique_lock<std::mutex> pool_lock;
+    if (pool != nullptr) {
+        pool_lock = std::unique_lock<std::mutex>(pool->lock);
+        n_threads = std::min(n_threads, pool->n_threads);
+    }
 
     for (int i = 0; i < ggml_backend_sched_get_n_backends(sched); ++i) {
         ggml_backend_t backend = ggml_backend_sched_get_backend(sched, i);
         if (ggml_backend_is_cpu(backend)) {
             ggml_backend_cpu_set_n_threads(backend, n_threads);
+            if (pool != nullptr) {
+                ggml_backend_cpu_set_threadpool(backend, pool->tp);
+            }
         }
 #ifdef GGML_USE_BLAS
         if (ggml_backend_is_blas(backend)) {
@@ -213,7 +291,11 @@ static bool ggml_graph_compute_helper(
 #endif
     }
 
-    bool t = ggml_backend_sched_graph_compute(sched, graph) == GGML_STATUS_SUCCESS;
+    bool t;
+    {
+        WHISPER_EXT_TRACE("ggml_graph_compute");
+        t = ggml_backend_sched_graph_compute(sched, graph) == GGML_STATUS_SUCCESS;
+    }
     ggml_backend_sched_reset(sched);
     return t;
 }
@@ -710,6 +792,8 @@ struct whisper_kv_cache {
     struct ggml_context * ctx = nullptr;
 
     ggml_backend_buffer_t buffer = nullptr;
+
+    whisper_ext_mem ext_mem; // local extension: backs buffer when placed, see whisper_ext_set_state_placement()
 };
 
 struct whisper_model {
@@ -752,6 +836,8 @@ struct whisper_model {
     // the model backend data is read-only and can be shared between processors
     ggml_backend_buffer_t buffer = nullptr;
 
+    whisper_ext_mem ext_mem; // local extension: backs buffer when placed, see whisper_ext_init_from_file_placed()
+
     // tensors
     int n_loaded;
     std::map<std::string, struct ggml_tensor *> tensors;
@@ -906,6 +992,42 @@ struct whisper_state {
 
     // [EXPERIMENTAL] speed-up techniques
     int32_t exp_n_audio_ctx = 0; // 0 - use default
+
+    // local extension: what kv_cross currently holds, for whisper_ext_set_reuse_encoding()
+    bool    ext_reuse_enc = false;
+    int32_t ext_enc_seek  = -1;  // mel offset of the last encode, -1 = none / stale
+    int32_t ext_enc_n_ctx = 0;   // exp_n_audio_ctx it was encoded with
+
+    // local extension: whisper_full window limit and stop point, see whisper_ext_set_max_windows()
+    int32_t ext_max_windows = 0; // 0 = no limit
+    int32_t ext_seek        = 0; // mel frame the last whisper_full run stopped at
+
+    // local extension: temperature fallback limits, for whisper_ext_set_decode_budget()
+    int32_t ext_max_fallbacks = -1; // per window, -1 = no limit
+    int64_t ext_deadline_us   = 0;  // ggml_time_us() no fallback may run past, 0 = none
+    int32_t ext_n_fail_cut    = 0;  // fallbacks skipped for either limit
+
+    // local extension: per-run suppression masks, see whisper_ext_build_suppress_mask()
+    std::vector<float> ext_suppress;
+    std::vector<float> ext_suppress_post;
+
+    // local extension: decoder passes handed elsewhere, see whisper_ext_set_decode_callback()
+    whisper_ext_decode_fn ext_decode_fn = nullptr;
+    void * ext_decode_user_data = nullptr;
+
+    // local extension: speculative decoding, see whisper_ext_set_draft()
+    whisper_context * ext_draft_ctx   = nullptr;
+    whisper_state   * ext_draft_state = nullptr;
+    int32_t ext_draft_n = 0;
+
+    std::vector<whisper_token> ext_draft_cached; // what the draft's self-attention cache holds
+    std::vector<whisper_token> ext_spec_drafts;  // scored drafts not yet reached, in order
+    std::vector<float>         ext_draft_logits; // scratch for the draft's masked logits
+    int32_t ext_spec_row = 0;                    // row of logits holding the scores after the last one reached
+    int32_t ext_spec_pos = 0;                    // position the first of ext_spec_drafts is at
+
+    int32_t ext_n_drafted  = 0;
+    int32_t ext_n_accepted = 0;
 };
 
 struct whisper_context {
@@ -923,6 +1045,13 @@ struct whisper_context {
     whisper_state * state = nullptr;
 
     std::string path_model; // populated by whisper_init_from_file_with_params()
+
+    std::string ext_rpc_endpoint; // local extension: weights and states live on this ggml-rpc server
+
+    whisper_ext_threadpool * ext_threadpool = nullptr; // local extension: see whisper_ext_set_threadpool()
+
+    whisper_ext_mem_policy ext_weights_placement = {}; // local extension: see whisper_ext_init_from_file_placed()
+    whisper_ext_mem_policy ext_state_placement = {}; // local extension: see whisper_ext_set_state_placement()
 };
 
 struct whisper_global {
@@ -933,6 +1062,12 @@ struct whisper_global {
 
 static whisper_global g_state;
 
+// local extension: set by whisper_ext_init_from_file_rpc() for the duration of one load
+static thread_local std::string g_ext_pending_rpc_endpoint;
+
+// local extension: set by whisper_ext_init_from_file_placed() for the duration of one load
+static thread_local whisper_ext_mem_policy g_ext_pending_placement = {};
+
 template<typename T>
 static void read_safe(whisper_model_loader * loader, T & dest) {
     loader->read(loader->context, &dest, sizeof(T));
@@ -945,7 +1080,8 @@ static bool whisper_kv_cache_init(
                            ggml_type   wtype,
                              int64_t   n_text_state,
                              int64_t   n_text_layer,
-                                 int   n_ctx) {
+                                 int   n_ctx,
+       const whisper_ext_mem_policy * placement = nullptr) {
     const int64_t n_mem      = n_text_layer*n_ctx;
     const int64_t n_elements = n_text_state*n_mem;
 
@@ -971,7 +1107,14 @@ static bool whisper_kv_cache_init(
     cache.k = ggml_new_tensor_1d(cache.ctx, wtype, n_elements);
     cache.v = ggml_new_tensor_1d(cache.ctx, wtype, n_elements);
 
-    cache.buffer = ggml_backend_alloc_ctx_tensors(cache.ctx, backend);
+    // local extension: CPU caches can go to huge pages or a NUMA node; anything the
+    // placement can't serve falls back to the backend's own allocation
+    if (placement != nullptr && !whisper_ext_mem_policy_is_default(*placement) && ggml_backend_is_cpu(backend)) {
+        cache.buffer = whisper_ext_alloc_ctx_tensors(cache.ctx, *placement, cache.ext_mem);
+    }
+    if (!cache.buffer) {
+        cache.buffer = ggml_backend_alloc_ctx_tensors(cache.ctx, backend);
+    }
     if (!cache.buffer) {
         WHISPER_LOG_ERROR("%s: failed to allocate memory for the kv cache\n", __func__);
         return false;
@@ -985,7 +1128,9 @@ static bool whisper_kv_cache_init(
 static void whisper_kv_cache_free(struct whisper_kv_cache & cache) {
     ggml_free(cache.ctx);
     ggml_backend_buffer_free(cache.buffer);
+    whisper_ext_mem_free(cache.ext_mem);
     cache.ctx = nullptr;
+    cache.buffer = nullptr;
 }
 
 static bool whisper_kv_cache_find_slot(
@@ -1381,6 +1526,19 @@ static ggml_backend_buffer_type_t whisper_default_buffer_type(const whisper_cont
     return result;
 }
 
+// local extension: contexts from whisper_ext_init_from_file_rpc() keep their weights on the server
+static ggml_backend_buffer_type_t whisper_model_buffer_type(const whisper_context & wctx) {
+    if (!wctx.ext_rpc_endpoint.empty()) {
+#ifdef GGML_USE_RPC
+        return ggml_backend_rpc_buffer_type(wctx.ext_rpc_endpoint.c_str());
+#else
+        return nullptr;
+#endif
+    }
+
+    return whisper_default_buffer_type(wctx.params);
+}
+
 // load the model from a ggml file
 //
 // file format:
@@ -1806,7 +1964,19 @@ static bool whisper_model_load(struct whisper_model_loader * loader, whisper_con
     }
 
     // allocate tensors in the backend buffers
-    model.buffer = ggml_backend_alloc_ctx_tensors_from_buft(model.ctx, whisper_default_buffer_type(wctx.params));
+    ggml_backend_buffer_type_t buft = whisper_model_buffer_type(wctx);
+    if (!buft) {
+        WHISPER_LOG_ERROR("%s: no buffer type for '%s'\n", __func__, wctx.ext_rpc_endpoint.c_str());
+        return false;
+    }
+
+    // local extension: placed weights, for the CPU buffer type only
+    if (!whisper_ext_mem_policy_is_default(wctx.ext_weights_placement) && buft == ggml_backend_cpu_buffer_type()) {
+        model.buffer = whisper_ext_alloc_ctx_tensors(model.ctx, wctx.ext_weights_placement, model.ext_mem);
+    }
+    if (!model.buffer) {
+        model.buffer = ggml_backend_alloc_ctx_tensors_from_buft(model.ctx, buft);
+    }
     if (!model.buffer) {
         WHISPER_LOG_ERROR("%s: failed to allocate memory for the model\n", __func__);
         return false;
@@ -2322,6 +2492,14 @@ static bool whisper_encode_internal(
               const int   n_threads,
     ggml_abort_callback   abort_callback,
                    void * abort_callback_data) {
+    WHISPER_EXT_TRACE("whisper_encode");
+
+    // local extension: kv_cross already holds this window (e.g. a second task on the same audio)
+    if (wstate.ext_reuse_enc && wstate.ext_enc_seek == mel_offset && wstate.ext_enc_n_ctx == wstate.exp_n_audio_ctx) {
+        return !(abort_callback && abort_callback(abort_callback_data));
+    }
+    wstate.ext_enc_seek = -1;
+
     const int64_t t_start_us = ggml_time_us();
 
     // conv
@@ -2363,7 +2541,7 @@ static bool whisper_encode_internal(
         }
 
         if (!whisper_encode_external(wstate)) {
-            if (!ggml_graph_compute_helper(sched, gf, n_threads)) {
+            if (!ggml_graph_compute_helper(sched, gf, n_threads, wctx.ext_threadpool)) {
                 return false;
             }
         } else {
@@ -2386,7 +2564,7 @@ static bool whisper_encode_internal(
             return false;
         }
 
-        if (!ggml_graph_compute_helper(sched, gf, n_threads)) {
+        if (!ggml_graph_compute_helper(sched, gf, n_threads, wctx.ext_threadpool)) {
             return false;
         }
     }
@@ -2402,7 +2580,7 @@ static bool whisper_encode_internal(
             return false;
         }
 
-        if (!ggml_graph_compute_helper(sched, gf, n_threads)) {
+        if (!ggml_graph_compute_helper(sched, gf, n_threads, wctx.ext_threadpool)) {
             return false;
         }
     }
@@ -2410,6 +2588,9 @@ static bool whisper_encode_internal(
     wstate.t_encode_us += ggml_time_us() - t_start_us;
     wstate.n_encode++;
 
+    wstate.ext_enc_seek  = mel_offset;
+    wstate.ext_enc_n_ctx = wstate.exp_n_audio_ctx;
+
     return !(abort_callback && abort_callback(abort_callback_data));
 }
 
@@ -2811,6 +2992,8 @@ static bool whisper_decode_internal(
                    bool   save_alignment_heads_QKs,
     ggml_abort_callback   abort_callback,
                    void * abort_callback_data) {
+    WHISPER_EXT_TRACE("whisper_decode");
+
     const int64_t t_start_us = ggml_time_us();
 
     const auto & model   = wctx.model;
@@ -2899,7 +3082,7 @@ static bool whisper_decode_internal(
 
         logits = ggml_graph_node(gf, -1);
 
-        if (!ggml_graph_compute_helper(sched, gf, n_threads)) {
+        if (!ggml_graph_compute_helper(sched, gf, n_threads, wctx.ext_threadpool)) {
             return false;
         }
     }
@@ -3339,13 +3522,25 @@ struct whisper_state * whisper_init_state(whisper_context * ctx) {
         return nullptr;
     }
 
+    // local extension: KV caches and compute buffers follow the weights to the RPC server;
+    // the CPU backend stays last so the scheduler can fall back to it
+    if (!ctx->ext_rpc_endpoint.empty()) {
+#ifdef GGML_USE_RPC
+        state->backends.insert(state->backends.begin(), ggml_backend_rpc_init(ctx->ext_rpc_endpoint.c_str()));
+#else
+        whisper_free_state(state);
+        return nullptr;
+#endif
+    }
+
     // at this point, we don't know yet how many decoders will be used
     // later during decoding, if more decoders are used, we will recreate the KV cache respectively
     state->kv_self_n_dec = 1;
     if (!whisper_kv_cache_init(state->kv_self, state->backends[0], ctx->itype,
                 ctx->model.hparams.n_text_state,
                 ctx->model.hparams.n_text_layer,
-                GGML_PAD(ctx->model.hparams.n_text_ctx, 256))) {
+                GGML_PAD(ctx->model.hparams.n_text_ctx, 256),
+                &ctx->ext_state_placement)) {
         WHISPER_LOG_ERROR("%s: whisper_kv_cache_init() failed for self-attention cache\n", __func__);
         whisper_free_state(state);
         return nullptr;
@@ -3359,7 +3554,8 @@ struct whisper_state * whisper_init_state(whisper_context * ctx) {
     if (!whisper_kv_cache_init(state->kv_cross, state->backends[0], ctx->itype,
                 ctx->model.hparams.n_text_state,
                 ctx->model.hparams.n_text_layer,
-                GGML_PAD(ctx->model.hparams.n_audio_ctx, 256))) {
+                GGML_PAD(ctx->model.hparams.n_audio_ctx, 256),
+                &ctx->ext_state_placement)) {
         WHISPER_LOG_ERROR("%s: whisper_kv_cache_init() failed for cross-attention cache\n", __func__);
         whisper_free_state(state);
         return nullptr;
@@ -3373,7 +3569,8 @@ struct whisper_state * whisper_init_state(whisper_context * ctx) {
     if (!whisper_kv_cache_init(state->kv_pad, state->backends[0], ctx->itype,
                 ctx->model.hparams.n_audio_state,
                 1,
-                GGML_PAD(ctx->model.hparams.n_audio_ctx, 256))) {
+                GGML_PAD(ctx->model.hparams.n_audio_ctx, 256),
+                &ctx->ext_state_placement)) {
         WHISPER_LOG_ERROR("%s: whisper_kv_cache_init() failed for self-attention cache\n", __func__);
         whisper_free_state(state);
         return nullptr;
@@ -3665,6 +3862,8 @@ struct whisper_context * whisper_init_with_params_no_state(struct whisper_model_
 
     whisper_context * ctx = new whisper_context;
     ctx->params = params;
+    ctx->ext_rpc_endpoint = g_ext_pending_rpc_endpoint;
+    ctx->ext_weights_placement = g_ext_pending_placement;
 
     if (!whisper_model_load(loader, *ctx)) {
         loader->close(loader->context);
@@ -3790,6 +3989,7 @@ void whisper_free(struct whisper_context * ctx) {
         ggml_free(ctx->model.ctx);
 
         ggml_backend_buffer_free(ctx->model.buffer);
+        whisper_ext_mem_free(ctx->model.ext_mem);
 
         whisper_free_state(ctx->state);
 
@@ -3810,11 +4010,15 @@ void whisper_free_params(struct whisper_full_params * params) {
 }
 
 int whisper_pcm_to_mel_with_state(struct whisper_context * ctx, struct whisper_state * state, const float * samples, int n_samples, int n_threads) {
+    WHISPER_EXT_TRACE("whisper_pcm_to_mel");
+
     if (!log_mel_spectrogram(*state, samples, n_samples, WHISPER_SAMPLE_RATE, WHISPER_N_FFT, WHISPER_HOP_LENGTH, ctx->model.filters.n_mel, n_threads, ctx->model.filters, false, state->mel)) {
         WHISPER_LOG_ERROR("%s: failed to compute mel spectrogram\n", __func__);
         return -1;
     }
 
+    state->ext_enc_seek = -1;
+
     return 0;
 }
 
@@ -3840,6 +4044,8 @@ int whisper_set_mel_with_state(
     state->mel.data.resize(n_len*n_mel);
     memcpy(state->mel.data.data(), data, n_len*n_mel*sizeof(float));
 
+    state->ext_enc_seek = -1;
+
     return 0;
 }
 
@@ -4887,16 +5093,439 @@ static const std::vector<std::string> non_speech_tokens = {
     "♪♪♪","♩", "♪", "♫", "♬", "♭", "♮", "♯"
 };
 
+//
+// logits kernels (local extension): the passes the sampler makes over the whole
+// vocabulary every step, per decoder
+//
+
+#if defined(WHISPER_VEC_AVX2)
+
+#define WHISPER_VEC_N 8
+typedef __m256 whisper_vec;
+
+static inline whisper_vec whisper_vec_load(const float * p)            { return _mm256_loadu_ps(p); }
+static inline void        whisper_vec_store(float * p, whisper_vec v)  { _mm256_storeu_ps(p, v); }
+static inline whisper_vec whisper_vec_set1(float x)                    { return _mm256_set1_ps(x); }
+static inline whisper_vec whisper_vec_add(whisper_vec a, whisper_vec b) { return _mm256_add_ps(a, b); }
+static inline whisper_vec whisper_vec_sub(whisper_vec a, whisper_vec b) { return _mm256_sub_ps(a, b); }
+static inline whisper_vec whisper_vec_mul(whisper_vec a, whisper_vec b) { return _mm256_mul_ps(a, b); }
+static inline whisper_vec whisper_vec_max(whisper_vec a, whisper_vec b) { return _mm256_max_ps(a, b); }
+static inline whisper_vec whisper_vec_min(whisper_vec a, whisper_vec b) { return _mm256_min_ps(a, b); }
+
+// v where x > -inf, else 0
+static inline whisper_vec whisper_vec_finite_or_zero(whisper_vec x, whisper_vec v) {
+    return _mm256_and_ps(_mm256_cmp_ps(x, _mm256_set1_ps(-INFINITY), _CMP_GT_OQ), v);
+}
+
+// n = round(x), and 2^n for integral n in [-126, 127]
+static inline whisper_vec whisper_vec_round(whisper_vec x) { return _mm256_round_ps(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+static inline whisper_vec whisper_vec_pow2i(whisper_vec n) {
+    return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23));
+}
+
+#elif defined(WHISPER_VEC_SSE2)
+
+#define WHISPER_VEC_N 4
+typedef __m128 whisper_vec;
+
+static inline whisper_vec whisper_vec_load(const float * p)            { return _mm_loadu_ps(p); }
+static inline void        whisper_vec_store(float * p, whisper_vec v)  { _mm_storeu_ps(p, v); }
+static inline whisper_vec whisper_vec_set1(float x)                    { return _mm_set1_ps(x); }
+static inline whisper_vec whisper_vec_add(whisper_vec a, whisper_vec b) { return _mm_add_ps(a, b); }
+static inline whisper_vec whisper_vec_sub(whisper_vec a, whisper_vec b) { return _mm_sub_ps(a, b); }
+static inline whisper_vec whisper_vec_mul(whisper_vec a, whisper_vec b) { return _mm_mul_ps(a, b); }
+static inline whisper_vec whisper_vec_max(whisper_vec a, whisper_vec b) { return _mm_max_ps(a, b); }
+static inline whisper_vec whisper_vec_min(whisper_vec a, whisper_vec b) { return _mm_min_ps(a, b); }
+
+static inline whisper_vec whisper_vec_finite_or_zero(whisper_vec x, whisper_vec v) {
+    return _mm_and_ps(_mm_cmpgt_ps(x, _mm_set1_ps(-INFINITY)), v);
+}
+
+// SSE2 has no round instruction; the conversion rounds to nearest under the default MXCSR
+static inline whisper_vec whisper_vec_round(whisper_vec x) { return _mm_cvtepi32_ps(_mm_cvtps_epi32(x)); }
+static inline whisper_vec whisper_vec_pow2i(whisper_vec n) {
+    return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(n), _mm_set1_epi32(127)), 23));
+}
+
+#elif defined(WHISPER_VEC_NEON)
+
+#define WHISPER_VEC_N 4
+typedef float32x4_t whisper_vec;
+
+static inline whisper_vec whisper_vec_load(const float * p)            { return vld1q_f32(p); }
+static inline void        whisper_vec_store(float * p, whisper_vec v)  { vst1q_f32(p, v); }
+static inline whisper_vec whisper_vec_set1(float x)                    { return vdupq_n_f32(x); }
+static inline whisper_vec whisper_vec_add(whisper_vec a, whisper_vec b) { return vaddq_f32(a, b); }
+static inline whisper_vec whisper_vec_sub(whisper_vec a, whisper_vec b) { return vsubq_f32(a, b); }
+static inline whisper_vec whisper_vec_mul(whisper_vec a, whisper_vec b) { return vmulq_f32(a, b); }
+static inline whisper_vec whisper_vec_max(whisper_vec a, whisper_vec b) { return vmaxq_f32(a, b); }
+static inline whisper_vec whisper_vec_min(whisper_vec a, whisper_vec b) { return vminq_f32(a, b); }
+
+static inline whisper_vec whisper_vec_finite_or_zero(whisper_vec x, whisper_vec v) {
+    return vreinterpretq_f32_u32(vandq_u32(vcgtq_f32(x, vdupq_n_f32(-INFINITY)), vreinterpretq_u32_f32(v)));
+}
+
+static inline whisper_vec whisper_vec_round(whisper_vec x) { return vrndnq_f32(x); }
+static inline whisper_vec whisper_vec_pow2i(whisper_vec n) {
+    return vreinterpretq_f32_s32(vshlq_n_s32(vaddq_s32(vcvtnq_s32_f32(n), vdupq_n_s32(127)), 23));
+}
+
+#endif
+
+#if defined(WHISPER_VEC_N)
+
+// expf to within a couple of ulp (Cephes polynomial); inputs below -87.3 give ~1e-38, not 0
+static inline whisper_vec whisper_vec_exp(whisper_vec x) {
+    x = whisper_vec_min(whisper_vec_max(x, whisper_vec_set1(-87.3f)), whisper_vec_set1(88.3f));
+
+    const whisper_vec n = whisper_vec_round(whisper_vec_mul(x, whisper_vec_set1(1.44269504088896341f)));
+    const whisper_vec r = whisper_vec_sub(whisper_vec_sub(x, whisper_vec_mul(n, whisper_vec_set1(0.693359375f))),
+                                          whisper_vec_mul(n, whisper_vec_set1(-2.12194440e-4f)));
+
+    whisper_vec p = whisper_vec_set1(1.9875691500e-4f);
+    p = whisper_vec_add(whisper_vec_mul(p, r), whisper_vec_set1(1.3981999507e-3f));
+    p = whisper_vec_add(whisper_vec_mul(p, r), whisper_vec_set1(8.3334519073e-3f));
+    p = whisper_vec_add(whisper_vec_mul(p, r), whisper_vec_set1(4.1665795894e-2f));
+    p = whisper_vec_add(whisper_vec_mul(p, r), whisper_vec_set1(1.6666665459e-1f));
+    p = whisper_vec_add(whisper_vec_mul(p, r), whisper_vec_set1(5.0000001201e-1f));
+
+    const whisper_vec y = whisper_vec_add(whisper_vec_add(whisper_vec_mul(whisper_vec_mul(p, r), r), r), whisper_vec_set1(1.0f));
+
+    return whisper_vec_mul(y, whisper_vec_pow2i(n));
+}
+
+static inline float whisper_vec_reduce_max(whisper_vec v) {
+    float tmp[WHISPER_VEC_N];
+    whisper_vec_store(tmp, v);
+    float m = tmp[0];
+    for (int j = 1; j < WHISPER_VEC_N; ++j) {
+        m = std::max(m, tmp[j]);
+    }
+    return m;
+}
+
+static inline float whisper_vec_reduce_sum(whisper_vec v) {
+    float tmp[WHISPER_VEC_N];
+    whisper_vec_store(tmp, v);
+    float s = 0.0f;
+    for (int j = 0; j < WHISPER_VEC_N; ++j) {
+        s += tmp[j];
+    }
+    return s;
+}
+
+#endif
+
+// max of x[0..n)
+static float whisper_logits_max(const float * x, int n) {
+    float m = -INFINITY;
+    int i = 0;
+#if defined(WHISPER_VEC_N)
+    if (n >= WHISPER_VEC_N) {
+        whisper_vec vm = whisper_vec_load(x);
+        for (i = WHISPER_VEC_N; i + WHISPER_VEC_N <= n; i += WHISPER_VEC_N) {
+            vm = whisper_vec_max(vm, whisper_vec_load(x + i));
+        }
+        m = whisper_vec_reduce_max(vm);
+    }
+#endif
+    for (; i < n; ++i) {
+        m = std::max(m, x[i]);
+    }
+    return m;
+}
+
+// first index of the largest x[i]
+static int whisper_logits_argmax(const float * x, int n) {
+    const float m = whisper_logits_max(x, n);
+    for (int i = 0; i < n; ++i) {
+        if (x[i] == m) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+// dst = src*scale + mask, mask holding 0 or -INFINITY per token (or nullptr)
+static void whisper_logits_init(float * dst, const float * src, const float * mask, float scale, int n) {
+    int i = 0;
+#if defined(WHISPER_VEC_N)
+    const whisper_vec vs = whisper_vec_set1(scale);
+    for (; i + WHISPER_VEC_N <= n; i += WHISPER_VEC_N) {
+        whisper_vec v = whisper_vec_mul(whisper_vec_load(src + i), vs);
+        if (mask) {
+            v = whisper_vec_add(v, whisper_vec_load(mask + i));
+        }
+        whisper_vec_store(dst + i, v);
+    }
+#endif
+    for (; i < n; ++i) {
+        dst[i] = src[i]*scale + (mask ? mask[i] : 0.0f);
+    }
+}
+
+// sum of exp(x[i] - m) over the x[i] > -inf
+static float whisper_logits_sum_exp(const float * x, int n, float m) {
+    float sum = 0.0f;
+    int i = 0;
+#if defined(WHISPER_VEC_N)
+    const whisper_vec vm = whisper_vec_set1(m);
+    whisper_vec vsum = whisper_vec_set1(0.0f);
+    for (; i + WHISPER_VEC_N <= n; i += WHISPER_VEC_N) {
+        const whisper_vec v = whisper_vec_load(x + i);
+        vsum = whisper_vec_add(vsum, whisper_vec_finite_or_zero(v, whisper_vec_exp(whisper_vec_sub(v, vm))));
+    }
+    sum = whisper_vec_reduce_sum(vsum);
+#endif
+    for (; i < n; ++i) {
+        if (x[i] > -INFINITY) {
+            sum += expf(x[i] - m);
+        }
+    }
+    return sum;
+}
+
+// logprobs = log_softmax(logits); suppressed (-inf) logits stay -inf
+static void whisper_logits_log_softmax(const float * logits, float * logprobs, int n) {
+    const float logit_max = whisper_logits_max(logits, n);
+    const float logsumexp = logf(whisper_logits_sum_exp(logits, n, logit_max)) + logit_max;
+
+    int i = 0;
+#if defined(WHISPER_VEC_N)
+    const whisper_vec vl = whisper_vec_set1(logsumexp);
+    for (; i + WHISPER_VEC_N <= n; i += WHISPER_VEC_N) {
+        whisper_vec_store(logprobs + i, whisper_vec_sub(whisper_vec_load(logits + i), vl));
+    }
+#endif
+    for (; i < n; ++i) {
+        logprobs[i] = logits[i] - logsumexp;
+    }
+}
+
+// probs = exp(logprobs), exactly 0 where the token is suppressed
+static void whisper_logits_probs(const float * logprobs, float * probs, int n) {
+    int i = 0;
+#if defined(WHISPER_VEC_N)
+    for (; i + WHISPER_VEC_N <= n; i += WHISPER_VEC_N) {
+        const whisper_vec v = whisper_vec_load(logprobs + i);
+        whisper_vec_store(probs + i, whisper_vec_finite_or_zero(v, whisper_vec_exp(v)));
+    }
+#endif
+    for (; i < n; ++i) {
+        probs[i] = logprobs[i] > -INFINITY ? expf(logprobs[i]) : 0.0f;
+    }
+}
+
+// local extension: the suppressions that stay fixed for a whole whisper_full run, as
+// additive 0 / -INFINITY masks built once per run instead of re-applied (and, for the
+// regex and non-speech lists, looked up again) every step. The second mask holds the ones
+// upstream applies after logits_filter_callback, and is only kept separate if one is set.
+static void whisper_ext_build_suppress_mask(
+              struct whisper_context & ctx,
+               struct whisper_state  & state,
+    const struct whisper_full_params & params) {
+    const auto & vocab    = ctx.vocab;
+    const int    n_logits = vocab.n_vocab;
+
+    auto & pre  = state.ext_suppress;
+    auto & post = state.ext_suppress_post;
+
+    pre.assign(n_logits, 0.0f);
+    post.assign(n_logits, 0.0f);
+
+    pre[vocab.token_not] = -INFINITY;
+    if (params.no_timestamps) {
+        for (int i = vocab.token_beg; i < n_logits; ++i) {
+            pre[i] = -INFINITY;
+        }
+    }
+
+    pre[vocab.token_sot]  = -INFINITY;
+    pre[vocab.token_nosp] = -INFINITY;
+
+    if (params.tdrz_enable == false) {
+        pre[vocab.token_solm] = -INFINITY;
+    }
+
+    pre[vocab.token_translate]  = -INFINITY;
+    pre[vocab.token_transcribe] = -INFINITY;
+    pre[vocab.token_prev]       = -INFINITY;
+
+    for (size_t i = 0; i < g_lang.size(); ++i) {
+        pre[whisper_token_lang(&ctx, i)] = -INFINITY;
+    }
+
+    if (params.suppress_regex != nullptr) {
+        std::regex re(params.suppress_regex);
+        for (const auto & token_id : vocab.token_to_id) {
+            if (std::regex_match(token_id.first, re)) {
+                post[token_id.second] = -INFINITY;
+            }
+        }
+    }
+
+    if (params.suppress_non_speech_tokens) {
+        for (const std::string & token : non_speech_tokens) {
+            for (const std::string & suppress_token : { token, " " + token }) {
+                const auto it = vocab.token_to_id.find(suppress_token);
+                if (it != vocab.token_to_id.end()) {
+                    post[it->second] = -INFINITY;
+                }
+            }
+        }
+
+        for (const char * suppress_token : { " -", " '" }) {
+            const auto it = vocab.token_to_id.find(suppress_token);
+            if (it != vocab.token_to_id.end()) {
+                post[it->second] = -INFINITY;
+            }
+        }
+    }
+
+    if (params.logits_filter_callback == nullptr) {
+        for (int i = 0; i < n_logits; ++i) {
+            pre[i] += post[i];
+        }
+        post.clear();
+    }
+}
+
+// local extension: one decoder pass through whisper_ext_set_decode_callback()'s hook; the
+// logits after the last token land in row 0 of state.logits
+static bool whisper_ext_decode_hooked(
+        struct whisper_context & ctx,
+          struct whisper_state & state,
+           const whisper_token * tokens,
+                           int   n_tokens,
+                           int   n_past) {
+    const int n_vocab = ctx.vocab.n_vocab;
+
+    if ((int) state.logits.size() < n_vocab) {
+        state.logits.resize(n_vocab);
+    }
+
+    return state.ext_decode_fn(&state, tokens, n_tokens, n_past, state.logits.data(), state.ext_decode_user_data) == 0;
+}
+
+// local extension: up to n_max draft tokens following committed, greedy under the run's
+// fixed suppressions; the draft's cache keeps whatever prefix of committed it already holds
+static bool whisper_ext_draft(
+        struct whisper_state & state,
+        const std::vector<whisper_token> & committed,
+                         int   n_max,
+                         int   n_threads,
+        std::vector<whisper_token> & out) {
+    auto * dctx = state.ext_draft_ctx;
+    auto * dst  = state.ext_draft_state;
+
+    const int n_vocab = dctx->vocab.n_vocab;
+    auto & cached = state.ext_draft_cached;
+
+    // at least the last committed token is fed, for the logits after it
+    int n_keep = 0;
+    while (n_keep < (int) cached.size() && n_keep + 1 < (int) committed.size() && cached[n_keep] == committed[n_keep]) {
+        ++n_keep;
+    }
+
+    const int n_feed = committed.size() - n_keep;
+    if (whisper_ext_decode_all_logits(dctx, dst, committed.data() + n_keep, n_feed, n_keep, n_threads) != 0) {
+        cached.clear();
+        return false;
+    }
+    cached = committed;
+
+    const float * logits = dst->logits.data() + (n_feed - 1)*n_vocab;
+
+    state.ext_draft_logits.resize(n_vocab);
+    float * masked = state.ext_draft_logits.data();
+
+    out.clear();
+    while (true) {
+        whisper_logits_init(masked, logits, state.ext_suppress.data(), 1.0f, n_vocab);
+
+        const whisper_token d = whisper_logits_argmax(masked, n_vocab);
+        if (d == dctx->vocab.token_eot) {
+            break;
+        }
+
+        out.push_back(d);
+        if ((int) out.size() == n_max) {
+            break;
+        }
+
+        if (whisper_ext_decode_all_logits(dctx, dst, &d, 1, cached.size(), n_threads) != 0) {
+            cached.clear();
+            return false;
+        }
+        cached.push_back(d);
+        logits = dst->logits.data();
+    }
+
+    return true;
+}
+
+// local extension: the logits after the decoder's last token, at n_past, for a speculative
+// attempt. A token the target already scored as a draft reuses that row; anything else
+// (including the first mismatch) drafts afresh and scores the token plus the new drafts in
+// one pass, rolling the cache back to n_past. Sets decoder.i_batch to the row.
+static bool whisper_ext_spec_step(
+        struct whisper_context & ctx,
+          struct whisper_state & state,
+        struct whisper_decoder & decoder,
+        const std::vector<whisper_token> & prompt,
+                           int   n_past,
+                           int   n_threads) {
+    const whisper_token token = decoder.sequence.tokens.back().id;
+
+    if (!state.ext_spec_drafts.empty() && state.ext_spec_pos == n_past && state.ext_spec_drafts.front() == token) {
+        state.ext_spec_drafts.erase(state.ext_spec_drafts.begin());
+        decoder.i_batch = ++state.ext_spec_row;
+        state.ext_spec_pos++;
+        state.ext_n_accepted++;
+        return true;
+    }
+
+    std::vector<whisper_token> committed = prompt;
+    for (const auto & t : decoder.sequence.tokens) {
+        committed.push_back(t.id);
+    }
+
+    const int n_ctx_t = ctx.model.hparams.n_text_ctx;
+    const int n_ctx_d = state.ext_draft_ctx->model.hparams.n_text_ctx;
+    const int n_max   = std::min({ state.ext_draft_n, n_ctx_t - n_past - 1, n_ctx_d - (int) committed.size() });
+
+    std::vector<whisper_token> drafts;
+    if (n_max > 0 && !whisper_ext_draft(state, committed, n_max, n_threads, drafts)) {
+        drafts.clear(); // a failed draft only costs the speed-up
+    }
+
+    std::vector<whisper_token> fed = { token };
+    fed.insert(fed.end(), drafts.begin(), drafts.end());
+
+    if (whisper_ext_decode_all_logits(&ctx, &state, fed.data(), fed.size(), n_past, n_threads) != 0) {
+        return false;
+    }
+
+    state.ext_spec_drafts = std::move(drafts);
+    state.ext_spec_row    = 0;
+    state.ext_spec_pos    = n_past + 1;
+    state.ext_n_drafted  += state.ext_spec_drafts.size();
+
+    decoder.i_batch = 0;
+    return true;
+}
+
 // process the logits for the selected decoder
 // - applies logit filters
 // - computes logprobs and probs
-// TODO: optimize
 static void whisper_process_logits(
               struct whisper_context & ctx,
                struct whisper_state  & state,
               struct whisper_decoder & decoder,
     const struct whisper_full_params   params,
                                float   temperature) {
+    WHISPER_EXT_TRACE("whisper_process_logits");
+
     const auto & vocab      = ctx.vocab;
     const auto & tokens_cur = decoder.sequence.tokens;
 
@@ -4911,14 +5540,12 @@ static void whisper_process_logits(
     auto & logits   = decoder.logits;
     auto & logprobs = decoder.logprobs;
     {
-        logits.resize(n_logits);
-        memcpy(logits.data(), state.logits.data() + decoder.i_batch*n_logits, n_logits*sizeof(float));
+        // local extension: copy, temperature and the per-run suppressions in one pass
+        WHISPER_ASSERT((int) state.ext_suppress.size() == n_logits);
 
-        if (temperature > 0.0f) {
-            for (int i = 0; i < n_logits; i++) {
-                logits[i] /= temperature;
-            }
-        }
+        logits.resize(n_logits);
+        whisper_logits_init(logits.data(), state.logits.data() + decoder.i_batch*n_logits, state.ext_suppress.data(),
+                temperature > 0.0f ? 1.0f/temperature : 1.0f, n_logits);
 
         // will be populated a bit later
         probs.resize(n_logits);
@@ -4937,70 +5564,14 @@ static void whisper_process_logits(
             }
         }
 
-        // suppress <|notimestamps|> token
-        // ref: https://github.com/openai/whisper/blob/0b1ba3d46ebf7fe6f953acfd8cad62a4f851b49f/whisper/decoding.py#L410-L412
-        logits[vocab.token_not] = -INFINITY;
-        if (params.no_timestamps) {
-            for (int i = vocab.token_beg; i < n_logits; ++i) {
-                logits[i] = -INFINITY;
-            }
-        }
-
-        // suppress sot and nosp tokens
-        logits[vocab.token_sot]  = -INFINITY;
-        logits[vocab.token_nosp] = -INFINITY; // TODO: ignore this token for now
-
-        // [TDRZ] when tinydiarize is disabled, suppress solm token
-        if (params.tdrz_enable == false) {
-            logits[vocab.token_solm] = -INFINITY;
-        }
-
-        // suppress task tokens
-        logits[vocab.token_translate]  = -INFINITY;
-        logits[vocab.token_transcribe] = -INFINITY;
-        logits[vocab.token_prev]       = -INFINITY;
-
-        // suppress lang tokens
-        for (size_t i = 0; i < g_lang.size(); ++i) {
-            logits[whisper_token_lang(&ctx, i)] = -INFINITY;
-        }
-
-        // suppress prev token
-        logits[vocab.token_prev] = -INFINITY;
+        // <|notimestamps|>, sot/nosp/solm, task and language tokens, and the regex and
+        // non-speech lists are in state.ext_suppress (whisper_ext_build_suppress_mask)
 
         if (params.logits_filter_callback) {
             params.logits_filter_callback(&ctx, &state, tokens_cur.data(), tokens_cur.size(), logits.data(), params.logits_filter_callback_user_data);
-        }
-
-        // suppress any tokens matching a regular expression
-        // ref: https://github.com/openai/whisper/discussions/1041
-        if (params.suppress_regex != nullptr) {
-            std::regex re(params.suppress_regex);
-            for (std::pair<whisper_vocab::token, whisper_vocab::id> token_id : vocab.token_to_id) {
-                if (std::regex_match(token_id.first, re)) {
-                    logits[token_id.second] = -INFINITY;
-                }
-            }
-        }
-
-        // suppress non-speech tokens
-        // ref: https://github.com/openai/whisper/blob/7858aa9c08d98f75575035ecd6481f462d66ca27/whisper/tokenizer.py#L224-L253
-        if (params.suppress_non_speech_tokens) {
-            for (const std::string & token : non_speech_tokens) {
-                const std::string suppress_tokens[] = {token, " " + token};
-                for (const std::string & suppress_token : suppress_tokens) {
-                    if (vocab.token_to_id.find(suppress_token) != vocab.token_to_id.end()) {
-                        logits[vocab.token_to_id.at(suppress_token)] = -INFINITY;
-                    }
-                }
-            }
 
-            // allow hyphens "-" and single quotes "'" between words, but not at the beginning of a word
-            if (vocab.token_to_id.find(" -") != vocab.token_to_id.end()) {
-                logits[vocab.token_to_id.at(" -")] = -INFINITY;
-            }
-            if (vocab.token_to_id.find(" '") != vocab.token_to_id.end()) {
-                logits[vocab.token_to_id.at(" '")] = -INFINITY;
+            if (!state.ext_suppress_post.empty()) {
+                whisper_logits_init(logits.data(), logits.data(), state.ext_suppress_post.data(), 1.0f, n_logits);
             }
         }
 
@@ -5047,24 +5618,7 @@ static void whisper_process_logits(
         }
 
         // populate the logprobs array (log_softmax)
-        {
-            const float logit_max = *std::max_element(logits.begin(), logits.end());
-            float logsumexp = 0.0f;
-            for (int i = 0; i < n_logits; ++i) {
-                if (logits[i] > -INFINITY) {
-                    logsumexp += expf(logits[i] - logit_max);
-                }
-            }
-            logsumexp = logf(logsumexp) + logit_max;
-
-            for (int i = 0; i < n_logits; ++i) {
-                if (logits[i] > -INFINITY) {
-                    logprobs[i] = logits[i] - logsumexp;
-                } else {
-                    logprobs[i] = -INFINITY;
-                }
-            }
-        }
+        whisper_logits_log_softmax(logits.data(), logprobs.data(), n_logits);
 
         // if sum of probability over timestamps is above any other token, sample timestamp
         // ref: https://github.com/openai/whisper/blob/0b1ba3d46ebf7fe6f953acfd8cad62a4f851b49f/whisper/decoding.py#L431-L437
@@ -5072,19 +5626,15 @@ static void whisper_process_logits(
             // logsumexp over timestamps
             float timestamp_logprob = -INFINITY;
             {
-                float logsumexp = 0.0f;
-                const float logprob_max = *std::max_element(logprobs.begin() + vocab.token_beg, logprobs.end());
-                for (int i = vocab.token_beg; i < n_logits; ++i) {
-                    if (logprobs[i] > -INFINITY) {
-                        logsumexp += expf(logprobs[i] - logprob_max);
-                    }
-                }
+                const int   n_ts        = n_logits - vocab.token_beg;
+                const float logprob_max = whisper_logits_max(logprobs.data() + vocab.token_beg, n_ts);
+                const float logsumexp   = whisper_logits_sum_exp(logprobs.data() + vocab.token_beg, n_ts, logprob_max);
                 if (logsumexp > 0.0f) {
                     timestamp_logprob = logf(logsumexp) + logprob_max;
                 }
             }
 
-            const float max_text_token_logprob = *std::max_element(logprobs.begin(), logprobs.begin() + vocab.token_beg);
+            const float max_text_token_logprob = whisper_logits_max(logprobs.data(), vocab.token_beg);
 
             //WHISPER_LOG_INFO("timestamp_logprob=%f max_text_token_logprob=%f\n", timestamp_logprob, max_text_token_logprob);
 
@@ -5098,39 +5648,14 @@ static void whisper_process_logits(
                     whisper_suppress_invalid_grammar(ctx, params, logits, decoder.grammar);
 
                     // populate the logprobs array (log_softmax)
-                    {
-                        const float logit_max = *std::max_element(logits.begin(), logits.end());
-                        float logsumexp = 0.0f;
-                        for (int i = 0; i < n_logits; ++i) {
-                            if (logits[i] > -INFINITY) {
-                                logsumexp += expf(logits[i] - logit_max);
-                            }
-                        }
-                        logsumexp = logf(logsumexp) + logit_max;
-
-                        for (int i = 0; i < n_logits; ++i) {
-                            if (logits[i] > -INFINITY) {
-                                logprobs[i] = logits[i] - logsumexp;
-                            } else {
-                                logprobs[i] = -INFINITY;
-                            }
-                        }
-                    }
+                    whisper_logits_log_softmax(logits.data(), logprobs.data(), n_logits);
                 }
             }
         }
     }
 
     // compute probs
-    {
-        for (int i = 0; i < n_logits; ++i) {
-            if (logits[i] == -INFINITY) {
-                probs[i] = 0.0f;
-            } else {
-                probs[i] = expf(logprobs[i]);
-            }
-        }
-    }
+    whisper_logits_probs(logprobs.data(), probs.data(), n_logits);
 
 #if 0
     // print first 100 logits - token string : logit
@@ -5235,13 +5760,9 @@ static whisper_token_data whisper_sample_token(
     }
 
     if (best) {
-        for (int i = 0; i < n_logits; ++i) {
-            if (result.p < probs[i]) {
-                result.id   = i;
-                result.p    = probs[i];
-                result.plog = logprobs[i];
-            }
-        }
+        result.id   = whisper_logits_argmax(probs.data(), n_logits);
+        result.p    = probs[result.id];
+        result.plog = logprobs[result.id];
     } else {
         std::discrete_distribution<> dist(probs.begin(), probs.end());
 
@@ -5265,28 +5786,12 @@ static std::vector<whisper_token_data> whisper_sample_token_topk(
     const auto & vocab = ctx.vocab;
 
     const auto & probs    = decoder.probs;
-    const auto & logits   = decoder.logits;
     const auto & logprobs = decoder.logprobs;
 
     const int n_logits = vocab.n_vocab;
 
-    auto & logits_id = decoder.logits_id;
-
-    logits_id.resize(n_logits);
-    for (int i = 0; i < n_logits; ++i) {
-        logits_id[i].first = logits[i];
-        logits_id[i].second = i;
-    }
-
-    {
-        using pair_type = std::remove_reference<decltype(logits_id)>::type::value_type;
-        std::partial_sort(
-                logits_id.begin(),
-                logits_id.begin() + k, logits_id.end(),
-                [](const pair_type & a, const pair_type & b) {
-            return a.first > b.first;
-        });
-    }
+    // local extension: upstream partial-sorted a (logit, id) copy of the whole vocabulary
+    // here, but the candidates are drawn from probs below and never read it
 
     std::vector<whisper_token_data> result;
     result.reserve(k);
@@ -5431,6 +5936,10 @@ int whisper_full_with_state(
     const int seek_start = params.offset_ms/10;
     const int seek_end = params.duration_ms == 0 ? whisper_n_len_from_state(state) : seek_start + params.duration_ms/10;
 
+    // local extension: see whisper_ext_get_seek()
+    state->ext_seek = seek_start;
+    int ext_n_windows = 0;
+
     // if length of spectrogram is less than 1.0s (100 frames), then return
     // basically don't process anything that is less than 1.0s
     // see issue #39: https://github.com/ggerganov/whisper.cpp/issues/39
@@ -5450,6 +5959,21 @@ int whisper_full_with_state(
         temperatures.push_back(params.temperature);
     }
 
+    whisper_ext_build_suppress_mask(*ctx, *state, params);
+
+    // local extension: the draft for speculative attempts, with its own mel of the same audio
+    bool ext_draft_ok = false;
+    if (state->ext_draft_ctx != nullptr && state->ext_draft_state != nullptr && state->ext_draft_n > 0) {
+        if (state->ext_draft_ctx->vocab.n_vocab != ctx->vocab.n_vocab) {
+            WHISPER_LOG_WARN("%s: draft vocabulary differs from the model's, decoding without it\n", __func__);
+        } else if (n_samples > 0 && whisper_pcm_to_mel_with_state(state->ext_draft_ctx, state->ext_draft_state, samples, n_samples, params.n_threads) != 0) {
+            WHISPER_LOG_WARN("%s: failed to compute the draft's mel, decoding without it\n", __func__);
+        } else {
+            ext_draft_ok = true;
+            state->ext_draft_cached.clear();
+        }
+    }
+
     // initialize the decoders
     int n_decoders = 1;
 
@@ -5480,7 +6004,6 @@ int whisper_full_with_state(
         decoder.probs.resize   (ctx->vocab.n_vocab);
         decoder.logits.resize  (ctx->vocab.n_vocab);
         decoder.logprobs.resize(ctx->vocab.n_vocab);
-        decoder.logits_id.reserve(ctx->model.hparams.n_vocab);
 
         decoder.rng = std::mt19937(0);
     }
@@ -5605,8 +6128,17 @@ int whisper_full_with_state(
 
         int best_decoder_id = 0;
 
+        // local extension: best attempt so far, kept for a window whose fallbacks are cut short
+        whisper_sequence ext_best_seq;
+        int  ext_best_seek_delta = 0;
+        bool ext_have_best       = false;
+
         for (int it = 0; it < (int) temperatures.size(); ++it) {
             const float t_cur = temperatures[it];
+            const int64_t t_attempt_us = ggml_time_us();
+
+            bool ext_hooked = false; // local extension: see whisper_ext_set_decode_callback()
+            bool ext_spec   = false; // local extension: see whisper_ext_set_draft()
 
             int n_decoders_cur = 1;
 
@@ -5691,7 +6223,8 @@ int whisper_full_with_state(
                     if (!whisper_kv_cache_init(state->kv_self, state->backends[0], ctx->itype,
                                 ctx->model.hparams.n_text_state,
                                 ctx->model.hparams.n_text_layer,
-                                GGML_PAD(ctx->model.hparams.n_text_ctx, 256)*factor)) {
+                                GGML_PAD(ctx->model.hparams.n_text_ctx, 256)*factor,
+                                &ctx->ext_state_placement)) {
                         WHISPER_LOG_ERROR("%s: whisper_kv_cache_init() failed for self-attention cache\n", __func__);
                         whisper_free_state(state);
                         return -7;
@@ -5702,17 +6235,43 @@ int whisper_full_with_state(
 
                 whisper_kv_cache_clear(state->kv_self);
 
-                whisper_batch_prep_legacy(state->batch, prompt.data(), prompt.size(), 0, 0);
+                // local extension: a single decoder can decode speculatively, on this window's
+                // draft encoding (kept across attempts), or through the decode hook. The hook
+                // writes its own cache positions; the next attempt clears them as above.
+                if (ext_draft_ok && n_decoders_cur == 1) {
+                    auto * dst = state->ext_draft_state;
+
+                    dst->exp_n_audio_ctx = state->exp_n_audio_ctx;
+                    dst->ext_reuse_enc   = true;
+
+                    ext_spec = whisper_encode_internal(*state->ext_draft_ctx, *dst, seek, params.n_threads, params.abort_callback, params.abort_callback_user_data);
+                    if (!ext_spec) {
+                        WHISPER_LOG_WARN("%s: failed to encode for the draft, decoding without it\n", __func__);
+                    }
+
+                    state->ext_spec_drafts.clear();
+                }
+
+                ext_hooked = !ext_spec && state->ext_decode_fn != nullptr && n_decoders_cur == 1;
+
+                if (ext_hooked) {
+                    if (!whisper_ext_decode_hooked(*ctx, *state, prompt.data(), prompt.size(), 0)) {
+                        WHISPER_LOG_ERROR("%s: failed to decode\n", __func__);
+                        return -8;
+                    }
+                } else {
+                    whisper_batch_prep_legacy(state->batch, prompt.data(), prompt.size(), 0, 0);
 
-                if (!whisper_decode_internal(*ctx, *state, state->batch, params.n_threads, false, params.abort_callback, params.abort_callback_user_data)) {
-                    WHISPER_LOG_ERROR("%s: failed to decode\n", __func__);
-                    return -8;
+                    if (!whisper_decode_internal(*ctx, *state, state->batch, params.n_threads, false, params.abort_callback, params.abort_callback_user_data)) {
+                        WHISPER_LOG_ERROR("%s: failed to decode\n", __func__);
+                        return -8;
+                    }
                 }
 
                 {
                     const int64_t t_start_sample_us = ggml_time_us();
 
-                    state->decoders[0].i_batch = prompt.size() - 1;
+                    state->decoders[0].i_batch = ext_hooked ? 0 : prompt.size() - 1;
 
                     whisper_process_logits(*ctx, *state, state->decoders[0], params, t_cur);
 
@@ -6004,7 +6563,11 @@ int whisper_full_with_state(
 
                     assert(batch.n_tokens > 0);
 
-                    if (!whisper_decode_internal(*ctx, *state, state->batch, params.n_threads, false, params.abort_callback, params.abort_callback_user_data)) {
+                    const bool ok = ext_spec   ? whisper_ext_spec_step(*ctx, *state, state->decoders[0], prompt, n_past, params.n_threads)
+                                  : ext_hooked ? whisper_ext_decode_hooked(*ctx, *state, batch.token, batch.n_tokens, n_past)
+                                  : whisper_decode_internal(*ctx, *state, state->batch, params.n_threads, false, params.abort_callback, params.abort_callback_user_data);
+
+                    if (!ok) {
                         WHISPER_LOG_ERROR("%s: failed to decode\n", __func__);
                         return -9;
                     }
@@ -6107,6 +6670,34 @@ int whisper_full_with_state(
                 }
             }
 
+            // local extension: stop falling back once whisper_ext_set_decode_budget()'s limits
+            // are reached, and keep the best attempt that didn't fail
+            if (!success) {
+                auto & decoder = state->decoders[best_decoder_id];
+
+                if (!decoder.failed && (!ext_have_best || decoder.sequence.avg_logprobs > ext_best_seq.avg_logprobs)) {
+                    ext_best_seq        = decoder.sequence;
+                    ext_best_seek_delta = decoder.seek_delta;
+                    ext_have_best       = true;
+                }
+
+                // the next attempt samples more candidates, so it costs at least as much as this one
+                const int64_t t_now_us = ggml_time_us();
+                const bool out_of_fallbacks = state->ext_max_fallbacks >= 0 && it >= state->ext_max_fallbacks;
+                const bool out_of_time      = state->ext_deadline_us > 0 && 2*t_now_us - t_attempt_us > state->ext_deadline_us;
+
+                if (out_of_fallbacks || out_of_time) {
+                    if (ext_have_best) {
+                        decoder.sequence   = ext_best_seq;
+                        decoder.seek_delta = ext_best_seek_delta;
+                    }
+
+                    WHISPER_LOG_DEBUG("%s: fallback budget reached at temperature = %.2f\n", __func__, t_cur);
+                    success = true;
+                    state->ext_n_fail_cut++;
+                }
+            }
+
             if (success) {
                 //for (auto & token : ctx->decoders[best_decoder_id].sequence.tokens) {
                 //    WHISPER_LOG_DEBUG("%s: token = %d, p = %6.3f, pt = %6.3f, ts = %s, str = %s\n", __func__, token.id, token.p, token.pt, ctx->vocab.id_to_token.at(token.tid).c_str(), ctx->vocab.id_to_token.at(token.id).c_str());
@@ -6262,6 +6853,12 @@ int whisper_full_with_state(
             seek += seek_delta;
 
             WHISPER_LOG_DEBUG("seek = %d, seek_delta = %d\n", seek, seek_delta);
+
+            // local extension: stop after whisper_ext_set_max_windows() encoder windows
+            state->ext_seek = seek;
+            if (state->ext_max_windows > 0 && ++ext_n_windows >= state->ext_max_windows) {
+                break;
+            }
         }
     }
 
@@ -7405,3 +8002,1371 @@ static void whisper_log_callback_default(ggml_log_level level, const char * text
     fputs(text, stderr);
     fflush(stderr);
 }
+
+//
+// local extensions (see whisper-ext.h)
+//
+
+#include "whisper-ext.h"
+
+void whisper_ext_get_state_timings(struct whisper_state * state, struct whisper_ext_timings * out) {
+    if (state == nullptr || out == nullptr) {
+        return;
+    }
+
+    out->t_mel_us    = state->t_mel_us;
+    out->t_sample_us = state->t_sample_us;
+    out->t_encode_us = state->t_encode_us;
+    out->t_decode_us = state->t_decode_us;
+    out->t_batchd_us = state->t_batchd_us;
+    out->t_prompt_us = state->t_prompt_us;
+
+    out->n_sample = state->n_sample;
+    out->n_encode = state->n_encode;
+    out->n_decode = state->n_decode;
+    out->n_batchd = state->n_batchd;
+    out->n_prompt = state->n_prompt;
+    out->n_fail_p = state->n_fail_p;
+    out->n_fail_h = state->n_fail_h;
+    out->n_fail_cut = state->ext_n_fail_cut;
+    out->n_drafted  = state->ext_n_drafted;
+    out->n_accepted = state->ext_n_accepted;
+}
+
+void whisper_ext_reset_state_timings(struct whisper_state * state) {
+    if (state == nullptr) {
+        return;
+    }
+
+    state->t_mel_us    = 0;
+    state->t_sample_us = 0;
+    state->t_encode_us = 0;
+    state->t_decode_us = 0;
+    state->t_batchd_us = 0;
+    state->t_prompt_us = 0;
+
+    state->n_sample = 0;
+    state->n_encode = 0;
+    state->n_decode = 0;
+    state->n_batchd = 0;
+    state->n_prompt = 0;
+    state->n_fail_p = 0;
+    state->n_fail_h = 0;
+    state->ext_n_fail_cut = 0;
+    state->ext_n_drafted  = 0;
+    state->ext_n_accepted = 0;
+}
+
+void whisper_ext_set_trace_callback(whisper_ext_trace_fn fn, void * user_data) {
+    g_ext_trace_user_data = user_data;
+    g_ext_trace_fn        = fn;
+}
+
+#ifdef GGML_USE_RPC
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#endif
+
+int whisper_ext_rpc_ping(const char * endpoint, size_t * free_mem, size_t * total_mem) {
+    size_t free_bytes = 0;
+    size_t total_bytes = 0;
+#ifdef GGML_USE_RPC
+    ggml_backend_rpc_get_device_memory(endpoint, &free_bytes, &total_bytes);
+#else
+    GGML_UNUSED(endpoint);
+#endif
+    if (free_mem)  *free_mem  = free_bytes;
+    if (total_mem) *total_mem = total_bytes;
+    return total_bytes > 0 ? 1 : 0;
+}
+
+struct whisper_context * whisper_ext_init_from_file_rpc(const char * path_model, struct whisper_context_params params, const char * endpoint) {
+#ifdef GGML_USE_RPC
+    // An unreachable server would trip the asserts inside ggml-rpc; check first
+    if (!whisper_ext_rpc_ping(endpoint, nullptr, nullptr)) {
+        WHISPER_LOG_ERROR("%s: ggml-rpc server %s is not reachable\n", __func__, endpoint);
+        return nullptr;
+    }
+
+    g_ext_pending_rpc_endpoint = endpoint;
+    whisper_context * ctx = whisper_init_from_file_with_params_no_state(path_model, params);
+    g_ext_pending_rpc_endpoint.clear();
+    return ctx;
+#else
+    GGML_UNUSED(path_model);
+    GGML_UNUSED(params);
+    WHISPER_LOG_ERROR("%s: built without GGML_RPC, cannot use %s\n", __func__, endpoint);
+    return nullptr;
+#endif
+}
+
+int whisper_ext_rpc_serve(const char * endpoint, int n_threads) {
+#ifdef GGML_USE_RPC
+    ggml_backend_t backend = ggml_backend_cpu_init();
+    if (!backend) {
+        return 1;
+    }
+    ggml_backend_cpu_set_n_threads(backend, n_threads > 0 ? n_threads : 1);
+
+    // The CPU backend has no device memory query; advertise what the host has
+    size_t total_mem = 0;
+#ifdef _WIN32
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    GlobalMemoryStatusEx(&status);
+    total_mem = (size_t)status.ullTotalPhys;
+#else
+    total_mem = (size_t)sysconf(_SC_PHYS_PAGES) * (size_t)sysconf(_SC_PAGE_SIZE);
+#endif
+
+    start_rpc_server(backend, endpoint, total_mem, total_mem);
+    ggml_backend_free(backend);
+    return 0;
+#else
+    GGML_UNUSED(endpoint);
+    GGML_UNUSED(n_threads);
+    WHISPER_LOG_ERROR("%s: built without GGML_RPC\n", __func__);
+    return 1;
+#endif
+}
+
+int whisper_ext_model_quantize(const char * fname_inp, const char * fname_out, enum ggml_type type, int n_threads) {
+    enum ggml_ftype ftype_out;
+    switch (type) {
+        case GGML_TYPE_Q8_0: ftype_out = GGML_FTYPE_MOSTLY_Q8_0; break;
+        case GGML_TYPE_Q5_1: ftype_out = GGML_FTYPE_MOSTLY_Q5_1; break;
+        case GGML_TYPE_Q4_K: ftype_out = GGML_FTYPE_MOSTLY_Q4_K; break;
+        default:
+            WHISPER_LOG_ERROR("%s: unsupported quantisation type %s\n", __func__, ggml_type_name(type));
+            return 1;
+    }
+
+    std::ifstream fin(fname_inp, std::ios::binary);
+    if (!fin) {
+        WHISPER_LOG_ERROR("%s: failed to open '%s'\n", __func__, fname_inp);
+        return 1;
+    }
+
+    std::ofstream fout(fname_out, std::ios::binary);
+    if (!fout) {
+        WHISPER_LOG_ERROR("%s: failed to create '%s'\n", __func__, fname_out);
+        return 1;
+    }
+
+    auto copy_i32 = [&](int32_t & v) {
+        fin.read((char *) &v, sizeof(v));
+        fout.write((const char *) &v, sizeof(v));
+    };
+
+    uint32_t magic = 0;
+    fin.read((char *) &magic, sizeof(magic));
+    if (magic != GGML_FILE_MAGIC) {
+        WHISPER_LOG_ERROR("%s: '%s' is not a ggml model\n", __func__, fname_inp);
+        return 1;
+    }
+    fout.write((const char *) &magic, sizeof(magic));
+
+    // n_vocab .. n_mels as-is; ftype rewritten
+    int32_t hparams[11];
+    fin.read((char *) hparams, sizeof(hparams));
+
+    const int32_t ftype_in = hparams[10] % GGML_QNT_VERSION_FACTOR;
+    if (ftype_in != GGML_FTYPE_ALL_F32 && ftype_in != GGML_FTYPE_MOSTLY_F16) {
+        WHISPER_LOG_ERROR("%s: '%s' is already quantised (ftype %d)\n", __func__, fname_inp, ftype_in);
+        return 1;
+    }
+
+    const int32_t n_audio_state = hparams[2];
+    if (n_audio_state % ggml_blck_size(type) != 0) {
+        WHISPER_LOG_ERROR("%s: %s needs rows that are a multiple of %d; this model has %d (use q5_1 or q8_0)\n",
+                __func__, ggml_type_name(type), (int) ggml_blck_size(type), n_audio_state);
+        return 1;
+    }
+
+    hparams[10] = ftype_out + GGML_QNT_VERSION * GGML_QNT_VERSION_FACTOR;
+    fout.write((const char *) hparams, sizeof(hparams));
+
+    // mel filters
+    {
+        int32_t n_mel = 0, n_fft = 0;
+        copy_i32(n_mel);
+        copy_i32(n_fft);
+
+        std::vector<char> data((size_t) n_mel * n_fft * sizeof(float));
+        fin.read(data.data(), data.size());
+        fout.write(data.data(), data.size());
+    }
+
+    // vocab
+    {
+        int32_t n_vocab = 0;
+        copy_i32(n_vocab);
+
+        std::string word;
+        for (int i = 0; i < n_vocab; i++) {
+            uint32_t len = 0;
+            fin.read((char *) &len, sizeof(len));
+            word.resize(len);
+            fin.read(&word[0], len);
+            fout.write((const char *) &len, sizeof(len));
+            fout.write(word.data(), len);
+        }
+    }
+
+    if (!fin) {
+        WHISPER_LOG_ERROR("%s: '%s' is truncated\n", __func__, fname_inp);
+        return 1;
+    }
+
+    // Same selection as examples/quantize: 2D weights only; conv kernels stay F16 and
+    // positional embeddings / conv biases (stored 2D) stay F32, which is what the loader expects
+    const std::vector<std::string> to_skip = {
+        "encoder.positional_embedding",
+        "decoder.positional_embedding",
+        "encoder.conv1.bias",
+        "encoder.conv2.bias",
+    };
+
+    const int nt = n_threads > 0 ? n_threads : 1;
+    ggml_quantize_init(type);
+
+    std::vector<char>    data_raw;
+    std::vector<float>   data_f32;
+    std::vector<uint8_t> data_q;
+
+    size_t total_in = 0;
+    size_t total_out = 0;
+
+    while (true) {
+        int32_t n_dims = 0, length = 0, ttype = 0;
+        fin.read((char *) &n_dims, sizeof(n_dims));
+        if (fin.eof()) {
+            break;
+        }
+        fin.read((char *) &length, sizeof(length));
+        fin.read((char *) &ttype, sizeof(ttype));
+
+        int32_t ne[4] = { 1, 1, 1, 1 };
+        int64_t nelements = 1;
+        for (int i = 0; i < n_dims; ++i) {
+            fin.read((char *) &ne[i], sizeof(ne[i]));
+            nelements *= ne[i];
+        }
+
+        std::string name(length, 0);
+        fin.read(&name[0], length);
+
+        if (!fin || n_dims < 1 || n_dims > 4) {
+            WHISPER_LOG_ERROR("%s: bad tensor header in '%s'\n", __func__, fname_inp);
+            return 1;
+        }
+
+        const size_t nbytes_in = (size_t) nelements * ggml_type_size((ggml_type) ttype) / ggml_blck_size((ggml_type) ttype);
+        data_raw.resize(nbytes_in);
+        fin.read(data_raw.data(), nbytes_in);
+        total_in += nbytes_in;
+
+        const bool quantize = n_dims == 2
+            && (ttype == GGML_TYPE_F32 || ttype == GGML_TYPE_F16)
+            && std::find(to_skip.begin(), to_skip.end(), name) == to_skip.end();
+
+        const int32_t ttype_out = quantize ? (int32_t) type : ttype;
+
+        fout.write((const char *) &n_dims,    sizeof(n_dims));
+        fout.write((const char *) &length,    sizeof(length));
+        fout.write((const char *) &ttype_out, sizeof(ttype_out));
+        for (int i = 0; i < n_dims; ++i) {
+            fout.write((const char *) &ne[i], sizeof(ne[i]));
+        }
+        fout.write(name.data(), length);
+
+        if (!quantize) {
+            fout.write(data_raw.data(), nbytes_in);
+            total_out += nbytes_in;
+            continue;
+        }
+
+        if (ne[0] % ggml_blck_size(type) != 0) {
+            WHISPER_LOG_ERROR("%s: tensor '%s' has %d columns, not a multiple of the %s block size\n",
+                    __func__, name.c_str(), ne[0], ggml_type_name(type));
+            return 1;
+        }
+
+        data_f32.resize((size_t) nelements);
+        if (ttype == GGML_TYPE_F16) {
+            ggml_fp16_to_fp32_row((const ggml_fp16_t *) data_raw.data(), data_f32.data(), nelements);
+        } else {
+            memcpy(data_f32.data(), data_raw.data(), nbytes_in);
+        }
+
+        const int64_t n_per_row = ne[0];
+        const int64_t nrows     = nelements / n_per_row;
+        const size_t  row_size  = ggml_row_size(type, n_per_row);
+        data_q.resize(row_size * nrows);
+
+        // Rows are independent; split them over the threads
+        const int64_t rows_per_thread = (nrows + nt - 1) / nt;
+        std::vector<std::thread> workers;
+        for (int t = 1; t < nt; ++t) {
+            const int64_t first = t * rows_per_thread;
+            const int64_t count = std::min(rows_per_thread, nrows - first);
+            if (count <= 0) {
+                break;
+            }
+            workers.emplace_back([&, first, count] {
+                ggml_quantize_chunk(type, data_f32.data(), data_q.data(), first * n_per_row, count, n_per_row, nullptr);
+            });
+        }
+        ggml_quantize_chunk(type, data_f32.data(), data_q.data(), 0, std::min(rows_per_thread, nrows), n_per_row, nullptr);
+        for (auto & w : workers) {
+            w.join();
+        }
+
+        fout.write((const char *) data_q.data(), data_q.size());
+        total_out += data_q.size();
+    }
+
+    fout.flush();
+    if (!fout) {
+        WHISPER_LOG_ERROR("%s: write to '%s' failed\n", __func__, fname_out);
+        return 1;
+    }
+
+    WHISPER_LOG_INFO("%s: %s -> %s, tensors %.1f MB -> %.1f MB\n", __func__, fname_inp, ggml_type_name(type),
+            total_in / 1024.0 / 1024.0, total_out / 1024.0 / 1024.0);
+    return 0;
+}
+
+void whisper_ext_set_reuse_encoding(struct whisper_state * state, int enable) {
+    if (state == nullptr) {
+        return;
+    }
+
+    state->ext_reuse_enc = enable != 0;
+    state->ext_enc_seek  = -1;
+}
+
+void whisper_ext_set_max_windows(struct whisper_state * state, int n_windows) {
+    if (state == nullptr) {
+        return;
+    }
+
+    state->ext_max_windows = std::max(0, n_windows);
+}
+
+int whisper_ext_get_seek(struct whisper_state * state) {
+    return state != nullptr ? state->ext_seek : 0;
+}
+
+void whisper_ext_set_audio_ctx(struct whisper_state * state, int n_audio_ctx) {
+    if (state == nullptr) {
+        return;
+    }
+
+    state->exp_n_audio_ctx = std::max(0, n_audio_ctx);
+}
+
+void whisper_ext_set_decode_callback(struct whisper_state * state, whisper_ext_decode_fn fn, void * user_data) {
+    if (state == nullptr) {
+        return;
+    }
+
+    state->ext_decode_fn        = fn;
+    state->ext_decode_user_data = fn != nullptr ? user_data : nullptr;
+}
+
+void whisper_ext_set_draft(struct whisper_state * state, struct whisper_context * draft_ctx, struct whisper_state * draft_state, int n_draft) {
+    if (state == nullptr) {
+        return;
+    }
+
+    const bool on = draft_ctx != nullptr && draft_state != nullptr && n_draft > 0;
+
+    state->ext_draft_ctx   = on ? draft_ctx   : nullptr;
+    state->ext_draft_state = on ? draft_state : nullptr;
+    state->ext_draft_n     = on ? n_draft     : 0;
+
+    state->ext_draft_cached.clear();
+    state->ext_spec_drafts.clear();
+}
+
+struct whisper_ext_threadpool * whisper_ext_threadpool_init(int n_threads, const int * cpus, int n_cpus, int poll) {
+    if (n_threads <= 0) {
+        return nullptr;
+    }
+
+    struct ggml_threadpool_params tpp = ggml_threadpool_params_default(n_threads);
+    tpp.poll = std::max(0, std::min(100, poll));
+
+    // ggml pins the thread that creates an unpaused pool (or first resumes a paused one)
+    // to worker 0's CPU for good. Create it unpaused on a thread of its own, so neither the
+    // loader nor the first job's thread stays pinned; callers run as worker 0 unpinned.
+    tpp.paused = false;
+
+    if (cpus != nullptr && n_cpus > 0) {
+        for (int i = 0; i < n_cpus; ++i) {
+            if (cpus[i] >= 0 && cpus[i] < GGML_MAX_N_THREADS) {
+                tpp.cpumask[cpus[i]] = true;
+            }
+        }
+        tpp.strict_cpu = true;
+    }
+
+    ggml_threadpool * tp = nullptr;
+    std::thread([&tpp, &tp] { tp = ggml_threadpool_new(&tpp); }).join();
+    if (tp == nullptr) {
+        return nullptr;
+    }
+
+    auto * pool = new whisper_ext_threadpool;
+    pool->tp        = tp;
+    pool->n_threads = n_threads;
+
+    return pool;
+}
+
+void whisper_ext_threadpool_free(struct whisper_ext_threadpool * pool) {
+    if (pool == nullptr) {
+        return;
+    }
+
+    ggml_threadpool_free(pool->tp);
+    delete pool;
+}
+
+int whisper_ext_threadpool_n_threads(const struct whisper_ext_threadpool * pool) {
+    return pool != nullptr ? pool->n_threads : 0;
+}
+
+void whisper_ext_set_threadpool(struct whisper_context * ctx, struct whisper_ext_threadpool * pool) {
+    if (ctx == nullptr) {
+        return;
+    }
+
+    ctx->ext_threadpool = pool;
+}
+
+#if defined(__linux__)
+#include <cerrno>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+#if defined(__linux__)
+// "0-3,8,10-11" as written by sysfs
+static std::vector<int> whisper_ext_parse_id_list(const std::string & list) {
+    std::vector<int> ids;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        const std::string item = list.substr(pos, end - pos);
+        const size_t dash = item.find('-');
+        try {
+            const int lo = std::stoi(item.substr(0, dash));
+            const int hi = dash == std::string::npos ? lo : std::stoi(item.substr(dash + 1));
+            for (int i = lo; i <= hi; ++i) {
+                ids.push_back(i);
+            }
+        } catch (const std::exception &) {
+        }
+        pos = end + 1;
+    }
+    return ids;
+}
+
+static std::vector<int> whisper_ext_read_id_list(const std::string & path) {
+    std::ifstream f(path);
+    std::string line;
+    if (!f || !std::getline(f, line)) {
+        return {};
+    }
+    return whisper_ext_parse_id_list(line);
+}
+
+static std::vector<int> whisper_ext_numa_nodes() {
+    return whisper_ext_read_id_list("/sys/devices/system/node/online");
+}
+
+// mbind(2) without libnuma; the kernel reads maxnode - 1 bits of the mask
+static bool whisper_ext_mbind(void * addr, size_t len, int mode, const std::vector<int> & nodes) {
+    constexpr int bits = 8*sizeof(unsigned long);
+
+    if (nodes.empty()) {
+        return false;
+    }
+
+    std::vector<unsigned long> mask(*std::max_element(nodes.begin(), nodes.end())/bits + 1, 0);
+    for (int n : nodes) {
+        mask[n/bits] |= 1UL << (n % bits);
+    }
+
+    return syscall(SYS_mbind, addr, len, mode, mask.data(), (unsigned long) (mask.size()*bits + 1), 0) == 0;
+}
+#endif
+
+static bool whisper_ext_mem_alloc(whisper_ext_mem & mem, size_t size, const whisper_ext_mem_policy & policy) {
+#if defined(__linux__)
+    constexpr int mpol_bind       = 2; // MPOL_BIND, MPOL_INTERLEAVE from <numaif.h>
+    constexpr int mpol_interleave = 3;
+    constexpr size_t huge_size    = 2u << 20;
+
+    void * data = MAP_FAILED;
+    size_t len  = 0;
+
+#ifdef MAP_HUGETLB
+    if (policy.huge_pages == WHISPER_EXT_HUGE_PAGES_EXPLICIT) {
+        len  = GGML_PAD(size, huge_size);
+        data = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (data == MAP_FAILED) {
+            WHISPER_LOG_WARN("%s: no %.1f MB of reserved huge pages (vm.nr_hugepages), using transparent ones\n", __func__, len/1e6);
+        }
+    }
+#endif
+
+    if (data == MAP_FAILED) {
+        // 2 MB aligned, so transparent huge pages can back all of it
+        len  = GGML_PAD(size, policy.huge_pages != WHISPER_EXT_HUGE_PAGES_NONE ? huge_size : (size_t) sysconf(_SC_PAGESIZE));
+        data = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED) {
+            return false;
+        }
+#ifdef MADV_HUGEPAGE
+        if (policy.huge_pages != WHISPER_EXT_HUGE_PAGES_NONE && madvise(data, len, MADV_HUGEPAGE) != 0) {
+            WHISPER_LOG_WARN("%s: transparent huge pages unavailable\n", __func__);
+        }
+#endif
+    }
+
+    // nothing has touched the pages yet, so the policy decides where each one lands
+    bool placed = true;
+    if (policy.numa == WHISPER_EXT_NUMA_INTERLEAVE) {
+        const std::vector<int> nodes = whisper_ext_numa_nodes();
+        placed = nodes.size() < 2 || whisper_ext_mbind(data, len, mpol_interleave, nodes);
+    } else if (policy.numa == WHISPER_EXT_NUMA_BIND && policy.node >= 0) {
+        placed = whisper_ext_mbind(data, len, mpol_bind, { policy.node });
+    }
+    if (!placed) {
+        WHISPER_LOG_WARN("%s: mbind failed (errno %d), pages follow first touch\n", __func__, errno);
+    }
+
+    mem.data = data;
+    mem.size = len;
+    mem.kind = 1;
+    return true;
+#elif defined(_WIN32)
+    const DWORD node = policy.numa == WHISPER_EXT_NUMA_BIND && policy.node >= 0 ? (DWORD) policy.node : NUMA_NO_PREFERRED_NODE;
+
+    void * data = nullptr;
+    size_t len  = 0;
+
+    if (policy.huge_pages == WHISPER_EXT_HUGE_PAGES_EXPLICIT && GetLargePageMinimum() > 0) {
+        len  = GGML_PAD(size, GetLargePageMinimum());
+        data = VirtualAllocExNuma(GetCurrentProcess(), nullptr, len, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE, node);
+        if (data == nullptr) {
+            WHISPER_LOG_WARN("%s: no large pages (needs SeLockMemoryPrivilege), using normal pages\n", __func__);
+        }
+    }
+
+    if (data == nullptr) {
+        len  = GGML_PAD(size, 4096);
+        data = VirtualAllocExNuma(GetCurrentProcess(), nullptr, len, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, node);
+        if (data == nullptr) {
+            return false;
+        }
+    }
+
+    mem.data = data;
+    mem.size = len;
+    mem.kind = 2;
+    return true;
+#else
+    GGML_UNUSED(mem);
+    GGML_UNUSED(size);
+    GGML_UNUSED(policy);
+    return false;
+#endif
+}
+
+static void whisper_ext_mem_free(whisper_ext_mem & mem) {
+#if defined(__linux__)
+    if (mem.kind == 1) {
+        munmap(mem.data, mem.size);
+    }
+#elif defined(_WIN32)
+    if (mem.kind == 2) {
+        VirtualFree(mem.data, 0, MEM_RELEASE);
+    }
+#endif
+    mem = {};
+}
+
+// ggml_backend_alloc_ctx_tensors() into placed pages: one CPU buffer over the whole block,
+// the tensors laid out in it as ggml would. nullptr (mem untouched) when it can't be done,
+// and the caller allocates as usual.
+static ggml_backend_buffer_t whisper_ext_alloc_ctx_tensors(struct ggml_context * ctx, const whisper_ext_mem_policy & policy, whisper_ext_mem & mem) {
+    ggml_backend_buffer_type_t buft = ggml_backend_cpu_buffer_type();
+    const size_t alignment = ggml_backend_buft_get_alignment(buft);
+
+    size_t size = 0;
+    for (ggml_tensor * t = ggml_get_first_tensor(ctx); t != nullptr; t = ggml_get_next_tensor(ctx, t)) {
+        if (t->view_src != nullptr) {
+            return nullptr;
+        }
+        size += GGML_PAD(ggml_backend_buft_get_alloc_size(buft, t), alignment);
+    }
+    if (size == 0) {
+        return nullptr;
+    }
+
+    whisper_ext_mem placed;
+    if (!whisper_ext_mem_alloc(placed, size, policy)) {
+        return nullptr;
+    }
+
+    ggml_backend_buffer_t buffer = ggml_backend_cpu_buffer_from_ptr(placed.data, placed.size);
+    if (buffer == nullptr) {
+        whisper_ext_mem_free(placed);
+        return nullptr;
+    }
+
+    struct ggml_tallocr talloc = ggml_tallocr_new(buffer);
+    for (ggml_tensor * t = ggml_get_first_tensor(ctx); t != nullptr; t = ggml_get_next_tensor(ctx, t)) {
+        ggml_tallocr_alloc(&talloc, t);
+    }
+
+    mem = placed;
+    return buffer;
+}
+
+struct whisper_context * whisper_ext_init_from_file_placed(const char * path_model, struct whisper_context_params params, struct whisper_ext_mem_policy weights) {
+    g_ext_pending_placement = weights;
+    whisper_context * ctx = whisper_init_from_file_with_params_no_state(path_model, params);
+    g_ext_pending_placement = {};
+    return ctx;
+}
+
+void whisper_ext_set_state_placement(struct whisper_context * ctx, struct whisper_ext_mem_policy policy) {
+    if (ctx == nullptr) {
+        return;
+    }
+
+    ctx->ext_state_placement = policy;
+}
+
+int whisper_ext_numa_n_nodes(void) {
+#if defined(__linux__)
+    return std::max(1, (int) whisper_ext_numa_nodes().size());
+#elif defined(_WIN32)
+    ULONG highest = 0;
+    return GetNumaHighestNodeNumber(&highest) ? (int) highest + 1 : 1;
+#else
+    return 1;
+#endif
+}
+
+int whisper_ext_numa_node_of_cpu(int cpu) {
+    if (cpu < 0) {
+        return -1;
+    }
+#if defined(__linux__)
+    for (int node : whisper_ext_numa_nodes()) {
+        const std::vector<int> cpus = whisper_ext_read_id_list("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (std::find(cpus.begin(), cpus.end(), cpu) != cpus.end()) {
+            return node;
+        }
+    }
+    return -1;
+#elif defined(_WIN32)
+    PROCESSOR_NUMBER pn = {};
+    pn.Group  = (WORD) (cpu / 64);
+    pn.Number = (BYTE) (cpu % 64);
+    USHORT node = 0;
+    return GetNumaProcessorNodeEx(&pn, &node) ? (int) node : -1;
+#else
+    return -1;
+#endif
+}
+
+void whisper_ext_set_decode_budget(struct whisper_state * state, int max_fallbacks, int64_t budget_us) {
+    if (state == nullptr) {
+        return;
+    }
+
+    state->ext_max_fallbacks = max_fallbacks < 0 ? -1 : max_fallbacks;
+    state->ext_deadline_us   = budget_us > 0 ? ggml_time_us() + budget_us : 0;
+}
+
+int whisper_ext_decode_all_logits(struct whisper_context * ctx, struct whisper_state * state, const whisper_token * tokens, int n_tokens, int n_past, int n_threads) {
+    if (ctx == nullptr || state == nullptr || tokens == nullptr || n_tokens <= 0 || n_past < 0) {
+        return -1;
+    }
+
+    if (n_past + n_tokens > ctx->model.hparams.n_text_ctx) {
+        WHISPER_LOG_ERROR("%s: %d + %d tokens exceed the text context\n", __func__, n_past, n_tokens);
+        return -2;
+    }
+
+    if (n_past == 0) {
+        whisper_kv_cache_clear(state->kv_self);
+    }
+
+    whisper_batch_prep_legacy(state->batch, tokens, n_tokens, n_past, 0);
+    for (int i = 0; i < n_tokens; ++i) {
+        state->batch.logits[i] = 1;
+    }
+
+    whisper_kv_cache_seq_rm(state->kv_self, 0, n_past, -1);
+
+    if (!whisper_decode_internal(*ctx, *state, state->batch, n_threads, false, nullptr, nullptr)) {
+        WHISPER_LOG_ERROR("%s: failed to eval\n", __func__);
+        return 1;
+    }
+
+    return 0;
+}
+
+struct whisper_ext_batch_decoder {
+    whisper_context * ctx = nullptr;
+
+    int max_streams = 0;
+    int max_nodes   = 0;
+
+    std::vector<ggml_backend_t> backends;
+    whisper_sched sched;
+
+    std::vector<int32_t> inp_embd;
+    std::vector<int32_t> inp_pos;
+    std::vector<int32_t> inp_last;
+    std::vector<float>   inp_mask;
+};
+
+struct whisper_ext_batch_decoder * whisper_ext_batch_decoder_init(struct whisper_context * ctx, int max_streams) {
+    if (ctx == nullptr) {
+        return nullptr;
+    }
+
+    // the per-stream attention below assumes the non-flash KV layout in host memory
+    if (ctx->params.flash_attn || !ctx->ext_rpc_endpoint.empty()) {
+        WHISPER_LOG_ERROR("%s: batched decoding needs a local context without flash attention\n", __func__);
+        return nullptr;
+    }
+
+    auto * d = new whisper_ext_batch_decoder;
+    d->ctx         = ctx;
+    d->max_streams = std::max(1, max_streams);
+
+    // shared layers + two attentions (~12 nodes each) per stream per layer
+    d->max_nodes = WHISPER_MAX_NODES + ctx->model.hparams.n_text_layer*d->max_streams*32;
+
+    d->backends = whisper_backend_init(ctx->params);
+    d->sched.sched = ggml_backend_sched_new(d->backends.data(), nullptr, d->backends.size(), d->max_nodes, false);
+    d->sched.meta.resize(ggml_tensor_overhead()*d->max_nodes + ggml_graph_overhead_custom(d->max_nodes, false));
+
+    return d;
+}
+
+void whisper_ext_batch_decoder_free(struct whisper_ext_batch_decoder * d) {
+    if (d == nullptr) {
+        return;
+    }
+
+    ggml_backend_sched_free(d->sched.sched);
+    for (auto & backend : d->backends) {
+        ggml_backend_free(backend);
+    }
+    delete d;
+}
+
+// The decoder graph of whisper_build_graph_decoder() for several states at once: embeddings,
+// projections, MLPs and the final norm run on all streams' tokens together (one pass over
+// the weights), while self- and cross-attention are done per stream on that stream's caches.
+static struct ggml_cgraph * whisper_ext_build_graph_streams(
+        whisper_ext_batch_decoder & d,
+        const whisper_ext_stream_step * steps,
+        int n_steps,
+        int n_tokens_all) {
+    const auto & model   = d.ctx->model;
+    const auto & hparams = model.hparams;
+
+    const int n_state = hparams.n_text_state;
+    const int n_head  = hparams.n_text_head;
+    const int n_layer = hparams.n_text_layer;
+
+    const int n_state_head = n_state/n_head;
+
+    const float KQscale = pow(float(n_state_head), -0.25);
+
+    struct ggml_init_params params = {
+        /*.mem_size   =*/ d.sched.meta.size(),
+        /*.mem_buffer =*/ d.sched.meta.data(),
+        /*.no_alloc   =*/ true,
+    };
+
+    struct ggml_context * ctx0 = ggml_init(params);
+
+    ggml_cgraph * gf = ggml_new_graph_custom(ctx0, d.max_nodes, false);
+
+    struct ggml_tensor * embd = ggml_new_tensor_1d(ctx0, GGML_TYPE_I32, n_tokens_all);
+    ggml_set_name(embd, "embd");
+    ggml_set_input(embd);
+
+    struct ggml_tensor * position = ggml_new_tensor_1d(ctx0, GGML_TYPE_I32, n_tokens_all);
+    ggml_set_name(position, "position");
+    ggml_set_input(position);
+
+    struct ggml_tensor * last = ggml_new_tensor_1d(ctx0, GGML_TYPE_I32, n_steps);
+    ggml_set_name(last, "last");
+    ggml_set_input(last);
+
+    std::vector<struct ggml_tensor *> masks(n_steps);
+    for (int s = 0; s < n_steps; ++s) {
+        const int n_kv = steps[s].n_past + steps[s].n_tokens;
+        masks[s] = ggml_new_tensor_2d(ctx0, GGML_TYPE_F32, n_kv, GGML_PAD(steps[s].n_tokens, GGML_KQ_MASK_PAD));
+        ggml_format_name(masks[s], "KQ_mask_%d", s);
+        ggml_set_input(masks[s]);
+    }
+
+    struct ggml_tensor * cur =
+        ggml_add(ctx0,
+                ggml_get_rows(ctx0, model.d_te, embd),
+                ggml_get_rows(ctx0, model.d_pe, position));
+
+    struct ggml_tensor * inpL = cur;
+
+    for (int il = 0; il < n_layer; ++il) {
+        const auto & layer = model.layers_decoder[il];
+
+        cur = ggml_norm(ctx0, inpL, hparams.eps);
+        cur = ggml_add(ctx0, ggml_mul(ctx0, cur, layer.attn_ln_0_w), layer.attn_ln_0_b);
+
+        // self-attention
+        {
+            struct ggml_tensor * Qcur = ggml_scale(ctx0, ggml_add(ctx0, ggml_mul_mat(ctx0, layer.attn_q_w, cur), layer.attn_q_b), KQscale);
+            struct ggml_tensor * Kcur = ggml_scale(ctx0, ggml_mul_mat(ctx0, layer.attn_k_w, cur), KQscale);
+            struct ggml_tensor * Vcur = ggml_add(ctx0, ggml_mul_mat(ctx0, layer.attn_v_w, cur), layer.attn_v_b);
+
+            struct ggml_tensor * attn = nullptr;
+
+            for (int s = 0, t0 = 0; s < n_steps; t0 += steps[s].n_tokens, ++s) {
+                auto & kv = steps[s].state->kv_self;
+
+                const int n_ctx  = kv.size;
+                const int ns     = steps[s].n_tokens;
+                const int n_past = steps[s].n_past;
+                const int n_kv   = n_past + ns;
+
+                const size_t esk = ggml_element_size(kv.k);
+                const size_t esv = ggml_element_size(kv.v);
+
+                struct ggml_tensor * Ks = ggml_view_2d(ctx0, Kcur, n_state, ns, Kcur->nb[1], t0*Kcur->nb[1]);
+                struct ggml_tensor * Vs = ggml_view_2d(ctx0, Vcur, n_state, ns, Vcur->nb[1], t0*Vcur->nb[1]);
+                struct ggml_tensor * Qs = ggml_view_2d(ctx0, Qcur, n_state, ns, Qcur->nb[1], t0*Qcur->nb[1]);
+
+                // this stream's cache: positions are contiguous from 0, one sequence per state
+                struct ggml_tensor * k = ggml_view_1d(ctx0, kv.k, ns*n_state, esk*n_state*(il*n_ctx + n_past));
+                struct ggml_tensor * v = ggml_view_2d(ctx0, kv.v, ns, n_state, n_ctx*esv, (il*n_ctx)*esv*n_state + n_past*esv);
+
+                ggml_build_forward_expand(gf, ggml_cpy(ctx0, Ks, k));
+                ggml_build_forward_expand(gf, ggml_cpy(ctx0, ggml_transpose(ctx0, Vs), v));
+
+                struct ggml_tensor * Q = ggml_permute(ctx0, ggml_reshape_3d(ctx0, Qs, n_state_head, n_head, ns), 0, 2, 1, 3);
+
+                struct ggml_tensor * K =
+                    ggml_view_3d(ctx0, kv.k,
+                            n_state_head, n_kv, n_head,
+                            esk*n_state,
+                            esk*n_state_head,
+                            esk*n_state*n_ctx*il);
+
+                struct ggml_tensor * V =
+                    ggml_view_3d(ctx0, kv.v,
+                            n_kv, n_state_head, n_head,
+                            n_ctx*esv,
+                            n_ctx*esv*n_state_head,
+                            n_ctx*esv*n_state*il);
+
+                struct ggml_tensor * KQ  = ggml_soft_max_ext(ctx0, ggml_mul_mat(ctx0, K, Q), masks[s], 1.0f, 0.0f);
+                struct ggml_tensor * KQV = ggml_permute(ctx0, ggml_mul_mat(ctx0, V, KQ), 0, 2, 1, 3);
+                struct ggml_tensor * out = ggml_cont_2d(ctx0, KQV, n_state, ns);
+
+                attn = attn ? ggml_concat(ctx0, attn, out, 1) : out;
+            }
+
+            cur = ggml_add(ctx0, ggml_mul_mat(ctx0, layer.attn_ln_1_w, attn), layer.attn_ln_1_b);
+        }
+
+        struct ggml_tensor * inpCA = ggml_add(ctx0, cur, inpL);
+
+        cur = ggml_norm(ctx0, inpCA, hparams.eps);
+        cur = ggml_add(ctx0, ggml_mul(ctx0, cur, layer.cross_attn_ln_0_w), layer.cross_attn_ln_0_b);
+
+        // cross-attention, each stream against its own encoding
+        {
+            struct ggml_tensor * Qcur = ggml_add(ctx0, ggml_mul_mat(ctx0, layer.cross_attn_q_w, cur), layer.cross_attn_q_b);
+
+            struct ggml_tensor * attn = nullptr;
+
+            for (int s = 0, t0 = 0; s < n_steps; t0 += steps[s].n_tokens, ++s) {
+                const auto & st = *steps[s].state;
+                auto & kvc = st.kv_cross;
+
+                const int ns          = steps[s].n_tokens;
+                const int n_audio_ctx = st.exp_n_audio_ctx > 0 ? st.exp_n_audio_ctx : hparams.n_audio_ctx;
+
+                const size_t esk = ggml_element_size(kvc.k);
+                const size_t esv = ggml_element_size(kvc.v);
+
+                struct ggml_tensor * Qs = ggml_view_2d(ctx0, Qcur, n_state, ns, Qcur->nb[1], t0*Qcur->nb[1]);
+                struct ggml_tensor * Q  = ggml_permute(ctx0, ggml_reshape_3d(ctx0, Qs, n_state_head, n_head, ns), 0, 2, 1, 3);
+
+                struct ggml_tensor * Kcross =
+                    ggml_view_3d(ctx0, kvc.k,
+                            n_state_head, n_audio_ctx, n_head,
+                            esk*n_state,
+                            esk*n_state_head,
+                            esk*n_state*n_audio_ctx*il);
+
+                struct ggml_tensor * Vcross =
+                    ggml_view_3d(ctx0, kvc.v,
+                            n_audio_ctx, n_state_head, n_head,
+                            n_audio_ctx*esv,
+                            n_audio_ctx*esv*n_state_head,
+                            n_audio_ctx*esv*n_state*il);
+
+                struct ggml_tensor * KQ  = ggml_soft_max_ext(ctx0, ggml_mul_mat(ctx0, Kcross, Q), nullptr, KQscale, 0.0f);
+                struct ggml_tensor * KQV = ggml_permute(ctx0, ggml_mul_mat(ctx0, Vcross, KQ), 0, 2, 1, 3);
+                struct ggml_tensor * out = ggml_cont_2d(ctx0, KQV, n_state, ns);
+
+                attn = attn ? ggml_concat(ctx0, attn, out, 1) : out;
+            }
+
+            cur = ggml_add(ctx0, ggml_mul_mat(ctx0, layer.cross_attn_ln_1_w, attn), layer.cross_attn_ln_1_b);
+        }
+
+        cur = ggml_add(ctx0, cur, inpCA);
+
+        struct ggml_tensor * inpFF = cur;
+
+        // feed-forward network
+        {
+            cur = ggml_norm(ctx0, inpFF, hparams.eps);
+            cur = ggml_add(ctx0, ggml_mul(ctx0, cur, layer.mlp_ln_w), layer.mlp_ln_b);
+
+            cur = ggml_add(ctx0, ggml_mul_mat(ctx0, layer.mlp_0_w, cur), layer.mlp_0_b);
+            cur = ggml_gelu(ctx0, cur);
+            cur = ggml_add(ctx0, ggml_mul_mat(ctx0, layer.mlp_1_w, cur), layer.mlp_1_b);
+        }
+
+        inpL = ggml_add(ctx0, cur, inpFF);
+    }
+
+    cur = ggml_norm(ctx0, inpL, hparams.eps);
+    cur = ggml_add(ctx0, ggml_mul(ctx0, cur, model.d_ln_w), model.d_ln_b);
+
+    // logits only for each stream's last token: n_steps rows instead of n_tokens_all
+    cur = ggml_get_rows(ctx0, cur, last);
+
+    struct ggml_tensor * logits = ggml_mul_mat(ctx0, model.d_te, cur);
+    ggml_set_name(logits, "logits");
+
+    ggml_build_forward_expand(gf, logits);
+
+    ggml_free(ctx0);
+
+    return gf;
+}
+
+int whisper_ext_batch_decode(struct whisper_ext_batch_decoder * d, struct whisper_ext_stream_step * steps, int n_steps, int n_threads) {
+    if (d == nullptr || steps == nullptr || n_steps <= 0 || n_steps > d->max_streams) {
+        return -1;
+    }
+
+    WHISPER_EXT_TRACE("whisper_ext_batch_decode");
+
+    const int64_t t_start_us = ggml_time_us();
+
+    const auto & hparams = d->ctx->model.hparams;
+    const int n_vocab = hparams.n_vocab;
+
+    int n_tokens_all = 0;
+    for (int s = 0; s < n_steps; ++s) {
+        const auto & step = steps[s];
+        if (step.state == nullptr || step.tokens == nullptr || step.n_tokens <= 0 || step.n_past < 0 || step.logits == nullptr ||
+            step.n_past + step.n_tokens > std::min<int>(hparams.n_text_ctx, step.state->kv_self.size)) {
+            WHISPER_LOG_ERROR("%s: invalid step %d\n", __func__, s);
+            return -1;
+        }
+        n_tokens_all += step.n_tokens;
+    }
+
+    auto & sched = d->sched.sched;
+
+    ggml_cgraph * gf = whisper_ext_build_graph_streams(*d, steps, n_steps, n_tokens_all);
+
+    if (!ggml_backend_sched_alloc_graph(sched, gf)) {
+        return -2;
+    }
+
+    d->inp_embd.clear();
+    d->inp_pos.clear();
+    d->inp_last.clear();
+
+    for (int s = 0; s < n_steps; ++s) {
+        for (int i = 0; i < steps[s].n_tokens; ++i) {
+            d->inp_embd.push_back(steps[s].tokens[i]);
+            d->inp_pos.push_back(steps[s].n_past + i);
+        }
+        d->inp_last.push_back((int32_t) d->inp_embd.size() - 1);
+
+        // causal within this step's tokens, everything already cached is visible
+        struct ggml_tensor * mask = ggml_graph_get_tensor(gf, ("KQ_mask_" + std::to_string(s)).c_str());
+
+        const int n_kv = steps[s].n_past + steps[s].n_tokens;
+        d->inp_mask.assign(ggml_nelements(mask), -INFINITY);
+        for (int j = 0; j < steps[s].n_tokens; ++j) {
+            for (int i = 0; i <= steps[s].n_past + j; ++i) {
+                d->inp_mask[j*n_kv + i] = 0.0f;
+            }
+        }
+        ggml_backend_tensor_set(mask, d->inp_mask.data(), 0, ggml_nbytes(mask));
+    }
+
+    ggml_backend_tensor_set(ggml_graph_get_tensor(gf, "embd"),     d->inp_embd.data(), 0, d->inp_embd.size()*sizeof(int32_t));
+    ggml_backend_tensor_set(ggml_graph_get_tensor(gf, "position"), d->inp_pos.data(),  0, d->inp_pos.size()*sizeof(int32_t));
+    ggml_backend_tensor_set(ggml_graph_get_tensor(gf, "last"),     d->inp_last.data(), 0, d->inp_last.size()*sizeof(int32_t));
+
+    if (!ggml_graph_compute_helper(sched, gf, n_threads, d->ctx->ext_threadpool)) {
+        return -3;
+    }
+
+    struct ggml_tensor * logits = ggml_graph_get_tensor(gf, "logits");
+    for (int s = 0; s < n_steps; ++s) {
+        ggml_backend_tensor_get(logits, steps[s].logits, sizeof(float)*n_vocab*s, sizeof(float)*n_vocab);
+    }
+
+    // each stream is charged its share of the step
+    const int64_t t_share_us = (ggml_time_us() - t_start_us)/n_steps;
+    for (int s = 0; s < n_steps; ++s) {
+        steps[s].state->t_decode_us += t_share_us;
+        steps[s].state->n_decode++;
+    }
+
+    return 0;
+}
+
+struct whisper_ext_batch_encoder {
+    whisper_context * ctx = nullptr;
+
+    int max_batch = 0;
+    int max_nodes = 0;
+
+    std::vector<ggml_backend_t> backends;
+    whisper_sched sched;
+
+    std::vector<float> inp_mel;
+};
+
+struct whisper_ext_batch_encoder * whisper_ext_batch_encoder_init(struct whisper_context * ctx, int max_batch) {
+    if (ctx == nullptr) {
+        return nullptr;
+    }
+
+    if (ctx->params.flash_attn || !ctx->ext_rpc_endpoint.empty()) {
+        WHISPER_LOG_ERROR("%s: batched encoding needs a local context without flash attention\n", __func__);
+        return nullptr;
+    }
+
+    auto * e = new whisper_ext_batch_encoder;
+    e->ctx       = ctx;
+    e->max_batch = std::max(1, max_batch);
+
+    const auto & hparams = ctx->model.hparams;
+    e->max_nodes = WHISPER_MAX_NODES + e->max_batch*(hparams.n_audio_layer*24 + hparams.n_text_layer*8 + 16);
+
+    e->backends = whisper_backend_init(ctx->params);
+    e->sched.sched = ggml_backend_sched_new(e->backends.data(), nullptr, e->backends.size(), e->max_nodes, false);
+    e->sched.meta.resize(ggml_tensor_overhead()*e->max_nodes + ggml_graph_overhead_custom(e->max_nodes, false));
+
+    return e;
+}
+
+void whisper_ext_batch_encoder_free(struct whisper_ext_batch_encoder * e) {
+    if (e == nullptr) {
+        return;
+    }
+
+    ggml_backend_sched_free(e->sched.sched);
+    for (auto & backend : e->backends) {
+        ggml_backend_free(backend);
+    }
+    delete e;
+}
+
+// conv + encoder + cross graphs of whisper_encode_internal() for several windows at once.
+// The windows sit side by side along the token dimension, so every projection and MLP is
+// one large matmul over n_batch*n_ctx columns; convolutions and self-attention stay per
+// window, and each window's cross-attention KV goes to its own state.
+static struct ggml_cgraph * whisper_ext_build_graph_encode_batch(
+        whisper_ext_batch_encoder & e,
+        struct whisper_state ** states,
+        int n_batch,
+        int n_ctx) {
+    const auto & model   = e.ctx->model;
+    const auto & hparams = model.hparams;
+
+    const int n_state = hparams.n_audio_state;
+    const int n_head  = hparams.n_audio_head;
+    const int n_layer = hparams.n_audio_layer;
+    const int n_mels  = hparams.n_mels;
+
+    const int n_state_head = n_state/n_head;
+
+    const float KQscale = 1.0f/sqrtf(float(n_state_head));
+    const float Kscale  = pow(float(n_state_head), -0.25);
+
+    struct ggml_init_params params = {
+        /*.mem_size   =*/ e.sched.meta.size(),
+        /*.mem_buffer =*/ e.sched.meta.data(),
+        /*.no_alloc   =*/ true,
+    };
+
+    struct ggml_context * ctx0 = ggml_init(params);
+
+    ggml_cgraph * gf = ggml_new_graph_custom(ctx0, e.max_nodes, false);
+
+    struct ggml_tensor * e_pe = ggml_view_2d(ctx0, model.e_pe, model.e_pe->ne[0], n_ctx, model.e_pe->nb[1], 0);
+
+    struct ggml_tensor * cur = nullptr;
+
+    for (int b = 0; b < n_batch; ++b) {
+        struct ggml_tensor * mel = ggml_new_tensor_2d(ctx0, GGML_TYPE_F32, 2*n_ctx, n_mels);
+        ggml_format_name(mel, "mel_%d", b);
+        ggml_set_input(mel);
+
+        struct ggml_tensor * x = ggml_conv_1d_ph(ctx0, model.e_conv_1_w, mel, 1, 1);
+        x = ggml_gelu(ctx0, ggml_add(ctx0, x, model.e_conv_1_b));
+
+        x = ggml_conv_1d_ph(ctx0, model.e_conv_2_w, x, 2, 1);
+        x = ggml_gelu(ctx0, ggml_add(ctx0, x, model.e_conv_2_b));
+
+        x = ggml_add(ctx0, e_pe, ggml_cont(ctx0, ggml_transpose(ctx0, x)));
+
+        cur = cur ? ggml_concat(ctx0, cur, x, 1) : x;
+    }
+
+    struct ggml_tensor * inpL = cur;
+
+    for (int il = 0; il < n_layer; ++il) {
+        const auto & layer = model.layers_encoder[il];
+
+        cur = ggml_norm(ctx0, inpL, hparams.eps);
+        cur = ggml_add(ctx0, ggml_mul(ctx0, cur, layer.attn_ln_0_w), layer.attn_ln_0_b);
+
+        // self-attention
+        {
+            struct ggml_tensor * Qcur = ggml_add(ctx0, ggml_mul_mat(ctx0, layer.attn_q_w, cur), layer.attn_q_b);
+            struct ggml_tensor * Kcur = ggml_mul_mat(ctx0, layer.attn_k_w, cur);
+            struct ggml_tensor * Vcur = ggml_add(ctx0, ggml_mul_mat(ctx0, layer.attn_v_w, cur), layer.attn_v_b);
+
+            struct ggml_tensor * attn = nullptr;
+
+            for (int b = 0; b < n_batch; ++b) {
+                const size_t off = (size_t) b*n_ctx;
+
+                struct ggml_tensor * Qs = ggml_view_2d(ctx0, Qcur, n_state, n_ctx, Qcur->nb[1], off*Qcur->nb[1]);
+                struct ggml_tensor * Ks = ggml_view_2d(ctx0, Kcur, n_state, n_ctx, Kcur->nb[1], off*Kcur->nb[1]);
+                struct ggml_tensor * Vs = ggml_view_2d(ctx0, Vcur, n_state, n_ctx, Vcur->nb[1], off*Vcur->nb[1]);
+
+                struct ggml_tensor * Q = ggml_permute(ctx0, ggml_reshape_3d(ctx0, Qs, n_state_head, n_head, n_ctx), 0, 2, 1, 3);
+
+                struct ggml_tensor * K =
+                    ggml_permute(ctx0,
+                            ggml_cast(ctx0, ggml_reshape_3d(ctx0, Ks, n_state_head, n_head, n_ctx), e.ctx->itype),
+                            0, 2, 1, 3);
+
+                struct ggml_tensor * KQ = ggml_soft_max_ext(ctx0, ggml_mul_mat(ctx0, K, Q), nullptr, KQscale, 0.0f);
+
+                struct ggml_tensor * V =
+                    ggml_cast(ctx0,
+                            ggml_permute(ctx0, ggml_reshape_3d(ctx0, Vs, n_state_head, n_head, n_ctx), 1, 2, 0, 3),
+                            e.ctx->itype);
+
+                struct ggml_tensor * KQV = ggml_permute(ctx0, ggml_mul_mat(ctx0, V, KQ), 0, 2, 1, 3);
+                struct ggml_tensor * out = ggml_cont_2d(ctx0, KQV, n_state, n_ctx);
+
+                attn = attn ? ggml_concat(ctx0, attn, out, 1) : out;
+            }
+
+            cur = ggml_add(ctx0, ggml_mul_mat(ctx0, layer.attn_ln_1_w, attn), layer.attn_ln_1_b);
+        }
+
+        cur = ggml_add(ctx0, cur, inpL);
+
+        struct ggml_tensor * inpFF = cur;
+
+        // feed-forward network
+        {
+            cur = ggml_norm(ctx0, inpFF, hparams.eps);
+            cur = ggml_add(ctx0, ggml_mul(ctx0, cur, layer.mlp_ln_w), layer.mlp_ln_b);
+
+            cur = ggml_add(ctx0, ggml_mul_mat(ctx0, layer.mlp_0_w, cur), layer.mlp_0_b);
+            cur = ggml_gelu(ctx0, cur);
+            cur = ggml_add(ctx0, ggml_mul_mat(ctx0, layer.mlp_1_w, cur), layer.mlp_1_b);
+        }
+
+        inpL = ggml_add(ctx0, cur, inpFF);
+    }
+
+    cur = ggml_norm(ctx0, inpL, hparams.eps);
+    cur = ggml_add(ctx0, ggml_mul(ctx0, cur, model.e_ln_w), model.e_ln_b);
+
+    // cross-attention memory: projections batched, copies per state
+    for (int il = 0; il < hparams.n_text_layer; ++il) {
+        auto & layer = model.layers_decoder[il];
+
+        struct ggml_tensor * Kcross = ggml_scale(ctx0, ggml_mul_mat(ctx0, layer.cross_attn_k_w, cur), Kscale);
+        struct ggml_tensor * Vcross = ggml_add(ctx0, ggml_mul_mat(ctx0, layer.cross_attn_v_w, cur), layer.cross_attn_v_b);
+
+        for (int b = 0; b < n_batch; ++b) {
+            auto & kv_cross = states[b]->kv_cross;
+
+            const size_t off = (size_t) b*n_ctx;
+
+            struct ggml_tensor * Kb = ggml_view_2d(ctx0, Kcross, n_state, n_ctx, Kcross->nb[1], off*Kcross->nb[1]);
+            struct ggml_tensor * Vb = ggml_view_2d(ctx0, Vcross, n_state, n_ctx, Vcross->nb[1], off*Vcross->nb[1]);
+
+            struct ggml_tensor * k = ggml_view_1d(ctx0, kv_cross.k, n_state*n_ctx,
+                    (ggml_element_size(kv_cross.k)*n_state)*(il*n_ctx));
+
+            struct ggml_tensor * v = ggml_view_2d(ctx0, kv_cross.v, n_ctx, n_state,
+                    (   n_ctx)*ggml_element_size(kv_cross.v),
+                    (il*n_ctx)*ggml_element_size(kv_cross.v)*n_state);
+
+            ggml_build_forward_expand(gf, ggml_cpy(ctx0, Kb, k));
+            ggml_build_forward_expand(gf, ggml_cpy(ctx0, ggml_transpose(ctx0, Vb), v));
+        }
+    }
+
+    ggml_free(ctx0);
+
+    return gf;
+}
+
+int whisper_ext_batch_encode(struct whisper_ext_batch_encoder * e, struct whisper_state ** states, const int * mel_offsets, int n_batch, int n_threads) {
+    if (e == nullptr || states == nullptr || mel_offsets == nullptr || n_batch <= 0 || n_batch > e->max_batch) {
+        return -1;
+    }
+
+    WHISPER_EXT_TRACE("whisper_ext_batch_encode");
+
+    const int64_t t_start_us = ggml_time_us();
+
+    const auto & hparams = e->ctx->model.hparams;
+    const int n_ctx = states[0]->exp_n_audio_ctx > 0 ? states[0]->exp_n_audio_ctx : hparams.n_audio_ctx;
+
+    for (int b = 0; b < n_batch; ++b) {
+        if (states[b] == nullptr || states[b]->exp_n_audio_ctx != states[0]->exp_n_audio_ctx || states[b]->mel.n_mel != hparams.n_mels) {
+            WHISPER_LOG_ERROR("%s: window %d does not match the batch\n", __func__, b);
+            return -1;
+        }
+        states[b]->ext_enc_seek = -1;
+    }
+
+    auto & sched = e->sched.sched;
+
+    ggml_cgraph * gf = whisper_ext_build_graph_encode_batch(*e, states, n_batch, n_ctx);
+
+    if (!ggml_backend_sched_alloc_graph(sched, gf)) {
+        return -2;
+    }
+
+    // each window's mel, zero padded to 30 s, as whisper_encode_internal() does
+    for (int b = 0; b < n_batch; ++b) {
+        struct ggml_tensor * mel = ggml_graph_get_tensor(gf, ("mel_" + std::to_string(b)).c_str());
+
+        const auto & mel_inp = states[b]->mel;
+
+        e->inp_mel.assign(ggml_nelements(mel), 0.0f);
+
+        const int i0 = std::min(mel_offsets[b],           mel_inp.n_len);
+        const int i1 = std::min(mel_offsets[b] + 2*n_ctx, mel_inp.n_len);
+
+        for (int j = 0; j < mel_inp.n_mel; ++j) {
+            for (int i = i0; i < i1; ++i) {
+                e->inp_mel[j*2*n_ctx + (i - i0)] = mel_inp.data[j*mel_inp.n_len + i];
+            }
+        }
+
+        ggml_backend_tensor_set(mel, e->inp_mel.data(), 0, ggml_nbytes(mel));
+    }
+
+    if (!ggml_graph_compute_helper(sched, gf, n_threads, e->ctx->ext_threadpool)) {
+        return -3;
+    }
+
+    // the states now hold these windows' encodings; whisper_ext_set_reuse_encoding() lets
+    // the jobs' own whisper_full() pick them up instead of encoding again
+    const int64_t t_share_us = (ggml_time_us() - t_start_us)/n_batch;
+    for (int b = 0; b < n_batch; ++b) {
+        states[b]->ext_enc_seek  = mel_offsets[b];
+        states[b]->ext_enc_n_ctx = states[b]->exp_n_audio_ctx;
+        states[b]->t_encode_us  += t_share_us;
+        states[b]->n_encode++;
+    }
+
+    return 0;
+}
+
+void whisper_ext_logits_log_softmax(const float * logits, float * logprobs, float * probs, int n, int use_simd) {
+    if (use_simd) {
+        whisper_logits_log_softmax(logits, logprobs, n);
+        if (probs) {
+            whisper_logits_probs(logprobs, probs, n);
+        }
+        return;
+    }
+
+    // upstream's passes, before the logits kernels
+    const float logit_max = *std::max_element(logits, logits + n);
+
+    float logsumexp = 0.0f;
+    for (int i = 0; i < n; ++i) {
+        if (logits[i] > -INFINITY) {
+            logsumexp += expf(logits[i] - logit_max);
+        }
+    }
+    logsumexp = logf(logsumexp) + logit_max;
+
+    for (int i = 0; i < n; ++i) {
+        logprobs[i] = logits[i] > -INFINITY ? logits[i] - logsumexp : -INFINITY;
+    }
+
+    if (probs) {
+        for (int i = 0; i < n; ++i) {
+            probs[i] = logprobs[i] == -INFINITY ? 0.0f : expf(logprobs[i]);
+        }
+    }
+}
+
+int whisper_ext_logits_argmax(const float * logits, int n, int use_simd) {
+    if (use_simd) {
+        return whisper_logits_argmax(logits, n);
+    }
+
+    return (int) (std::max_element(logits, logits + n) - logits);
+}